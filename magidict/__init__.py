@@ -2,7 +2,8 @@
 
 from typing import Any, Dict
 
-from .core import MagiDict, magi_loads, magi_load, enchant, none
+from .core import MagiDict, MagiPath, MagiView, MagiViewList, MagiRecords, MagiRow, MagiSnapshot, magi_loads, magi_load, magi_dumps, magi_dump, magi_iter, amagi_loads, enchant, enchant_many, aenchant, none, set_max_depth, set_stats, stats, reset_stats
+from .core import _has_c_type
 
 try:
     from ._magidict import fast_hook, fast_hook_with_memo
@@ -13,10 +14,26 @@ except ImportError:
 
 __all__ = [
     "MagiDict",
+    "MagiPath",
+    "MagiView",
+    "MagiViewList",
+    "MagiRecords",
+    "MagiRow",
+    "MagiSnapshot",
     "magi_loads",
     "magi_load",
+    "magi_dumps",
+    "magi_dump",
+    "magi_iter",
+    "amagi_loads",
     "enchant",
+    "enchant_many",
+    "aenchant",
     "none",
+    "set_max_depth",
+    "set_stats",
+    "stats",
+    "reset_stats",
 ]
 
 __version__ = "0.1.7"
@@ -30,4 +47,5 @@ def get_implementation_info():
         "implementation": __implementation__,
         "c_extension_loaded": _c_extension_loaded,
         "c_hook_available": _c_extension_loaded,
+        "c_type_available": _has_c_type,
     }
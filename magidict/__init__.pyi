@@ -5,10 +5,26 @@ from typing import Any, Dict
 # Import from the stub files - both have identical signatures now
 from magidict._magidict import (
     MagiDict as MagiDict,
+    MagiPath as MagiPath,
+    MagiView as MagiView,
+    MagiViewList as MagiViewList,
+    MagiRecords as MagiRecords,
+    MagiRow as MagiRow,
+    MagiSnapshot as MagiSnapshot,
     enchant as enchant,
+    enchant_many as enchant_many,
+    aenchant as aenchant,
+    magi_dump as magi_dump,
+    magi_dumps as magi_dumps,
+    magi_iter as magi_iter,
+    amagi_loads as amagi_loads,
     magi_load as magi_load,
     magi_loads as magi_loads,
     none as none,
+    set_max_depth as set_max_depth,
+    set_stats as set_stats,
+    stats as stats,
+    reset_stats as reset_stats,
 )
 
 __version__: str
@@ -1,167 +1,783 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <stddef.h>
+
+/* Free-threaded builds (3.13t) run without the GIL, so containers being
+ * converted may be changed by other threads at the same time. The hook
+ * reads and writes them under the container's critical section, which is
+ * an empty block on builds with a GIL. */
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+/* PyWeakref_GetRef is new in 3.13, where PyWeakref_GetObject is deprecated.
+ * Sets *pobj to a new reference and returns 1, sets it to NULL and returns
+ * 0 for a dead referent, or returns -1 with an exception set. */
+#if PY_VERSION_HEX < 0x030D0000
+static inline int PyWeakref_GetRef(PyObject *ref, PyObject **pobj)
+{
+    PyObject *obj = PyWeakref_GetObject(ref);
+    if (obj == NULL)
+    {
+        *pobj = NULL;
+        return -1;
+    }
+    if (obj == Py_None)
+    {
+        *pobj = NULL;
+        return 0;
+    }
+    Py_INCREF(obj);
+    *pobj = obj;
+    return 1;
+}
+#endif
 
 static PyObject *fast_hook_with_memo(PyObject *item, PyObject *memo, PyObject *magidict_class);
 static PyObject *fast_hook(PyObject *self, PyObject *args);
 static PyObject *py_fast_hook_with_memo(PyObject *self, PyObject *args);
+static PyObject *py_hook_into(PyObject *self, PyObject *args);
+static PyObject *py_hook_many(PyObject *self, PyObject *args);
+static PyObject *py_hook_range(PyObject *self, PyObject *args);
+static PyObject *py_set_max_depth(PyObject *self, PyObject *args);
+static PyObject *fast_unhook(PyObject *self, PyObject *args);
 static PyObject *py_split_dotted(PyObject *self, PyObject *args);
+static PyObject *py_register(PyObject *self, PyObject *args);
+static PyObject *py_register_view(PyObject *self, PyObject *args);
+static PyObject *py_loads(PyObject *self, PyObject *args);
+static PyObject *py_dumps(PyObject *self, PyObject *args);
+static PyObject *py_raw_decode(PyObject *self, PyObject *args);
+static PyObject *py_skip_value(PyObject *self, PyObject *args);
+static PyObject *py_get_path(PyObject *self, PyObject *args);
+static PyObject *py_extract(PyObject *self, PyObject *args);
+static PyObject *py_search_key(PyObject *self, PyObject *args);
+static PyObject *py_search_keys(PyObject *self, PyObject *args);
+static PyObject *py_filter(PyObject *self, PyObject *args);
+static PyObject *py_cow_copy(PyObject *self, PyObject *args);
+static PyObject *py_notify_watchers(PyObject *self, PyObject *args);
+static PyObject *py_get_state(PyObject *self, PyObject *args);
+static PyObject *py_set_state(PyObject *self, PyObject *args);
+static PyObject *py_deep_merge(PyObject *self, PyObject *args);
+static PyObject *py_stats(PyObject *self, PyObject *Py_UNUSED(ignored));
+static PyObject *py_reset_stats(PyObject *self, PyObject *Py_UNUSED(ignored));
+static PyObject *py_set_stats(PyObject *self, PyObject *args);
 
-static PyObject *fast_hook_with_memo(PyObject *item, PyObject *memo, PyObject *magidict_class)
+/* MagiDictBase: dict subclass carrying the hot paths (attribute access,
+ * subscripting, mget) in C. The Python-level MagiDict in core.py derives
+ * from it and adds the remaining methods. Instance attributes (the
+ * _from_none/_from_missing flags) live in inst_dict, exposed as __dict__,
+ * so the layout mirrors what the pure Python class does. watchers holds
+ * what must hear about mutations of this MagiDict: key index tokens (see
+ * build_index in core.py) and copy-on-write forks reaching it. cow_pending
+ * and cow_group are only set on such forks. */
+typedef struct
 {
-    if (item == NULL)
+    PyDictObject dict;
+    PyObject *inst_dict;
+    PyObject *watchers;
+    PyObject *cow_pending;
+    PyObject *cow_group;
+} MagiDictObject;
+
+static PyTypeObject MagiDictBase_Type;
+
+#define MagiDict_Check(op) PyObject_TypeCheck(op, &MagiDictBase_Type)
+
+/* Set once by core.py through register() */
+static PyObject *magidict_class = NULL;
+static PyObject *path_compiler = NULL;
+static PyObject *none_sentinel = NULL;
+static PyObject *missing_sentinel = NULL;
+static PyObject *abc_mapping = NULL;
+static PyObject *abc_sequence = NULL;
+
+/* The registered objects are read as borrowed references without locking,
+ * so registering again never frees the objects it replaces: they are kept
+ * alive in register_retired. On free-threaded builds register_lock
+ * serialises the register calls themselves. */
+static PyObject *register_retired = NULL;
+#ifdef Py_GIL_DISABLED
+static PyMutex register_lock = {0};
+#define REGISTER_LOCK() PyMutex_Lock(&register_lock)
+#define REGISTER_UNLOCK() PyMutex_Unlock(&register_lock)
+#else
+#define REGISTER_LOCK()
+#define REGISTER_UNLOCK()
+#endif
+
+/* Store value in *slot; call with register_lock held */
+static int register_swap(PyObject **slot, PyObject *value)
+{
+    PyObject *old = *slot;
+    if (old == value)
+        return 0;
+    if (old != NULL)
+    {
+        if (register_retired == NULL && (register_retired = PyList_New(0)) == NULL)
+            return -1;
+        if (PyList_Append(register_retired, old) < 0)
+            return -1;
+        Py_DECREF(old);
+    }
+    Py_XINCREF(value);
+    *slot = value;
+    return 0;
+}
+
+static PyObject *str_from_none = NULL;
+static PyObject *str_from_missing = NULL;
+static PyObject *empty_tuple = NULL;
+static PyObject *str_missing = NULL;
+static PyObject *str_keys = NULL;
+static PyObject *str_update = NULL;
+/* Names core.py uses for the bookkeeping of a MagiDict (see get_state) */
+static PyObject *str_lazy_memo = NULL;
+static PyObject *str_watchers = NULL;
+static PyObject *str_cow_pending = NULL;
+static PyObject *str_cow_group = NULL;
+static PyObject *str_key_index = NULL;
+static PyObject *str_dir_keys = NULL;
+/* Unbound dict.values / dict.items */
+static PyObject *dict_values = NULL;
+static PyObject *dict_items = NULL;
+/* Exceptions that count as a miss when indexing a sequence along a path */
+static PyObject *sequence_misses = NULL;
+/* copyreg.__newobj__, so unpickling creates MagiDicts without __init__ */
+static PyObject *copyreg_newobj = NULL;
+
+/* Opt-in counters of the hot paths, read by stats() in core.py. They are
+ * only touched while stats_enabled is set; increments are not atomic, so
+ * under free threading the counts are approximate. */
+typedef struct
+{
+    unsigned long long hook_dicts;
+    unsigned long long hook_lists;
+    unsigned long long hook_tuples;
+    unsigned long long hook_scalars;
+    unsigned long long hook_magidicts;
+    unsigned long long memo_hits;
+    unsigned long long magidicts_created;
+    unsigned long long key_hits;
+    unsigned long long key_misses;
+    unsigned long long dotted_lookups;
+    unsigned long long none_sentinels;
+    unsigned long long missing_sentinels;
+    unsigned long long python_fallbacks;
+} MagiStats;
+
+static int stats_enabled = 0;
+static MagiStats stats;
+
+#define STAT(field)              \
+    do                           \
+    {                            \
+        if (stats_enabled)       \
+            stats.field++;       \
+    } while (0)
+
+/* Create an empty instance of a MagiDictBase subclass without running __init__ */
+static PyObject *magidict_new_empty(PyTypeObject *type)
+{
+    STAT(magidicts_created);
+    return type->tp_new(type, empty_tuple, NULL);
+}
+
+/* An empty MagiDict of class cls: built directly when fast_type (see
+ * hook_fast_type) is set, otherwise by calling the class */
+static PyObject *magidict_create(PyTypeObject *fast_type, PyObject *cls)
+{
+    if (fast_type != NULL)
+        return magidict_new_empty(fast_type);
+    STAT(magidicts_created);
+    STAT(python_fallbacks);
+    return PyObject_CallNoArgs(cls);
+}
+
+/* Return cls as a type when instances can be built with magidict_new_empty,
+ * i.e. cls is the registered MagiDict or a subclass that overrides neither
+ * __new__ nor __init__. Otherwise NULL and the class is called normally. */
+static PyTypeObject *hook_fast_type(PyObject *cls)
+{
+    if (magidict_class == NULL || cls == NULL || !PyType_Check(cls))
         return NULL;
 
-    PyObject *item_id = PyLong_FromVoidPtr(item);
-    if (item_id == NULL)
+    PyTypeObject *type = (PyTypeObject *)cls;
+    if (cls == magidict_class)
+        return type;
+    if (!PyType_IsSubtype(type, (PyTypeObject *)magidict_class))
+        return NULL;
+    if (type->tp_new != ((PyTypeObject *)magidict_class)->tp_new)
         return NULL;
 
-    PyObject *cached = PyDict_GetItem(memo, item_id);
-    if (cached != NULL)
+    PyObject *init_name = PyUnicode_InternFromString("__init__");
+    if (init_name == NULL)
     {
-        Py_DECREF(item_id);
-        Py_INCREF(cached);
-        return cached;
+        PyErr_Clear();
+        return NULL;
     }
+    PyObject *init = _PyType_Lookup(type, init_name);
+    PyObject *base_init = _PyType_Lookup((PyTypeObject *)magidict_class, init_name);
+    Py_DECREF(init_name);
+    return init == base_init ? type : NULL;
+}
+
+/* Pointer-keyed open-addressing map used as the hook memo. Only containers
+ * that can take part in cycles (dicts and lists) are ever stored, so scalar
+ * leaves never touch it. Keys and values are strong references. When the
+ * caller supplied a Python memo dict (fast_hook_with_memo), it is consulted
+ * on a miss and kept in sync as id(obj) -> obj entries. */
+typedef struct
+{
+    PyObject *key;
+    PyObject *value;
+} MemoEntry;
 
-    int is_magidict = PyObject_IsInstance(item, magidict_class);
-    if (is_magidict < 0)
+#define MEMO_INLINE_SIZE 8
+
+typedef struct
+{
+    MemoEntry *entries;
+    size_t mask;
+    Py_ssize_t used;
+    PyObject *py_memo;
+    /* Set when nested MagiDicts can skip the Python-level constructor */
+    PyTypeObject *fast_type;
+    /* Optional str -> str dict sharing one object per distinct key */
+    PyObject *key_cache;
+    MemoEntry inline_entries[MEMO_INLINE_SIZE];
+} PtrMemo;
+
+#define MEMO_MIRRORS(memo) ((memo)->py_memo != NULL)
+
+static void memo_init(PtrMemo *memo, PyObject *py_memo, PyObject *magidict_class)
+{
+    memset(memo->inline_entries, 0, sizeof(memo->inline_entries));
+    memo->entries = memo->inline_entries;
+    memo->mask = MEMO_INLINE_SIZE - 1;
+    memo->used = 0;
+    memo->py_memo = py_memo;
+    memo->fast_type = hook_fast_type(magidict_class);
+    memo->key_cache = NULL;
+}
+
+static void memo_free(PtrMemo *memo)
+{
+    for (size_t i = 0; i <= memo->mask; i++)
     {
-        Py_DECREF(item_id);
-        return NULL;
+        if (memo->entries[i].key != NULL)
+        {
+            Py_DECREF(memo->entries[i].key);
+            Py_DECREF(memo->entries[i].value);
+        }
     }
-    if (is_magidict)
+    if (memo->entries != memo->inline_entries)
+        PyMem_Free(memo->entries);
+    Py_CLEAR(memo->key_cache);
+    memo->entries = memo->inline_entries;
+    memo->mask = MEMO_INLINE_SIZE - 1;
+    memo->used = 0;
+}
+
+static inline size_t memo_slot(const PtrMemo *memo, const PyObject *key)
+{
+    size_t h = (size_t)(uintptr_t)key >> 4;
+    h *= (size_t)0x9E3779B97F4A7C15ULL;
+    return (h ^ (h >> 29)) & memo->mask;
+}
+
+static int memo_resize(PtrMemo *memo)
+{
+    size_t old_size = memo->mask + 1;
+    size_t new_size = old_size * 2;
+    MemoEntry *old = memo->entries;
+    MemoEntry *entries = PyMem_Calloc(new_size, sizeof(MemoEntry));
+    if (entries == NULL)
     {
-        PyDict_SetItem(memo, item_id, item);
-        Py_DECREF(item_id);
-        Py_INCREF(item);
-        return item;
+        PyErr_NoMemory();
+        return -1;
     }
 
-    if (PyDict_Check(item))
+    memo->entries = entries;
+    memo->mask = new_size - 1;
+    for (size_t i = 0; i < old_size; i++)
     {
-        PyObject *new_dict = PyObject_CallFunctionObjArgs(magidict_class, NULL);
-        if (new_dict == NULL)
-        {
-            Py_DECREF(item_id);
-            return NULL;
-        }
+        if (old[i].key == NULL)
+            continue;
+        size_t j = memo_slot(memo, old[i].key);
+        while (entries[j].key != NULL)
+            j = (j + 1) & memo->mask;
+        entries[j] = old[i];
+    }
 
-        PyDict_SetItem(memo, item_id, new_dict);
+    if (old != memo->inline_entries)
+        PyMem_Free(old);
+    return 0;
+}
 
-        PyObject *key, *value;
-        Py_ssize_t pos = 0;
+/* Insert without touching the Python mirror */
+static int memo_put(PtrMemo *memo, PyObject *key, PyObject *value)
+{
+    if ((size_t)(memo->used + 1) * 3 > (memo->mask + 1) * 2 && memo_resize(memo) < 0)
+        return -1;
+
+    size_t i = memo_slot(memo, key);
+    while (memo->entries[i].key != NULL && memo->entries[i].key != key)
+        i = (i + 1) & memo->mask;
+
+    Py_INCREF(value);
+    if (memo->entries[i].key == NULL)
+    {
+        Py_INCREF(key);
+        memo->entries[i].key = key;
+        memo->used++;
+    }
+    else
+    {
+        Py_DECREF(memo->entries[i].value);
+    }
+    memo->entries[i].value = value;
+    return 0;
+}
+
+static int memo_set(PtrMemo *memo, PyObject *key, PyObject *value)
+{
+    if (memo_put(memo, key, value) < 0)
+        return -1;
+
+    if (MEMO_MIRRORS(memo))
+    {
+        PyObject *key_id = PyLong_FromVoidPtr(key);
+        if (key_id == NULL)
+            return -1;
+        int res = PyDict_SetItem(memo->py_memo, key_id, value);
+        Py_DECREF(key_id);
+        return res;
+    }
+    return 0;
+}
+
+/* Borrowed reference, or NULL on a miss (check PyErr_Occurred) */
+static PyObject *memo_get(PtrMemo *memo, PyObject *key)
+{
+    size_t i = memo_slot(memo, key);
+    while (memo->entries[i].key != NULL)
+    {
+        if (memo->entries[i].key == key)
+            return memo->entries[i].value;
+        i = (i + 1) & memo->mask;
+    }
+
+    if (!MEMO_MIRRORS(memo))
+        return NULL;
+
+    PyObject *key_id = PyLong_FromVoidPtr(key);
+    if (key_id == NULL)
+        return NULL;
+    PyObject *cached = PyDict_GetItemWithError(memo->py_memo, key_id);
+    Py_DECREF(key_id);
+    if (cached == NULL || memo_put(memo, key, cached) < 0)
+        return NULL;
+    return cached;
+}
+
+/* New reference to list[i], or NULL (no exception set) past its end */
+static PyObject *list_item_ref(PyObject *list, Py_ssize_t i)
+{
+    PyObject *item = NULL;
+    Py_BEGIN_CRITICAL_SECTION(list);
+    if (i >= 0 && i < PyList_GET_SIZE(list))
+    {
+        item = PyList_GET_ITEM(list, i);
+        Py_INCREF(item);
+    }
+    Py_END_CRITICAL_SECTION();
+    return item;
+}
+
+/* Store value (stolen) at list[i] unless it is there already. A slot that
+ * is gone because the list shrank meanwhile is skipped. */
+static int list_store(PyObject *list, Py_ssize_t i, PyObject *value)
+{
+    int res = 0;
+    Py_BEGIN_CRITICAL_SECTION(list);
+    if (i < PyList_GET_SIZE(list) && PyList_GET_ITEM(list, i) != value)
+        res = PyList_SetItem(list, i, value);
+    else
+        Py_DECREF(value);
+    Py_END_CRITICAL_SECTION();
+    return res;
+}
+
+/* PyDict_Next returning new references to the key and value */
+static int dict_next_ref(PyObject *dict, Py_ssize_t *pos, PyObject **key, PyObject **value)
+{
+    int res;
+    Py_BEGIN_CRITICAL_SECTION(dict);
+    res = PyDict_Next(dict, pos, key, value);
+    if (res)
+    {
+        Py_INCREF(*key);
+        Py_INCREF(*value);
+    }
+    Py_END_CRITICAL_SECTION();
+    return res;
+}
+
+/* Build a tuple of the same type as item from hooked_values (stolen).
+ * Named tuples are called with the values as positional arguments. */
+static PyObject *tuple_rebuild(PyObject *item, PyObject *hooked_values)
+{
+    PyTypeObject *item_type = Py_TYPE(item);
+    PyTypeObject *tuple_type = &PyTuple_Type;
 
-        while (PyDict_Next(item, &pos, &key, &value))
+    PyObject *result;
+    if (item_type == tuple_type)
+    {
+        result = hooked_values;
+    }
+    else
+    {
+        PyObject *fields = PyObject_GetAttrString(item, "_fields");
+        if (fields != NULL)
         {
-            PyObject *hooked_value = fast_hook_with_memo(value, memo, magidict_class);
-            if (hooked_value == NULL)
-            {
-                Py_DECREF(new_dict);
-                Py_DECREF(item_id);
-                return NULL;
-            }
+            Py_DECREF(fields);
+            result = PyObject_CallObject((PyObject *)item_type, hooked_values);
+            Py_DECREF(hooked_values);
+        }
+        else
+        {
+            PyErr_Clear();
 
-            if (PyDict_SetItem(new_dict, key, hooked_value) < 0)
+            PyObject *args = PyTuple_Pack(1, hooked_values);
+            if (args == NULL)
             {
-                Py_DECREF(hooked_value);
-                Py_DECREF(new_dict);
-                Py_DECREF(item_id);
+                Py_DECREF(hooked_values);
                 return NULL;
             }
-            Py_DECREF(hooked_value);
+
+            result = PyObject_CallObject((PyObject *)item_type, args);
+            Py_DECREF(args);
+            Py_DECREF(hooked_values);
+        }
+    }
+
+    return result;
+}
+
+/* The hook runs on an explicit stack of frames, one per dict, list or tuple
+ * being converted, so deeply nested input cannot overflow the C stack.
+ * hook_max_depth (set_max_depth) bounds the number of open frames; 0 means
+ * no limit. */
+static Py_ssize_t hook_max_depth = 0;
+
+enum
+{
+    HOOK_DICT,
+    HOOK_LIST,
+    HOOK_TUPLE
+};
+
+typedef struct
+{
+    int kind;
+    PyObject *src;
+    /* The new MagiDict, the list itself, or the tuple of hooked values */
+    PyObject *result;
+    /* Dict frames: key of the value being converted */
+    PyObject *key;
+    Py_ssize_t pos;
+} HookFrame;
+
+#define HOOK_INLINE_FRAMES 16
+
+typedef struct
+{
+    HookFrame *frames;
+    Py_ssize_t len;
+    Py_ssize_t cap;
+    HookFrame inline_frames[HOOK_INLINE_FRAMES];
+} HookStack;
+
+static void hook_stack_free(HookStack *stack)
+{
+    for (Py_ssize_t i = 0; i < stack->len; i++)
+    {
+        Py_XDECREF(stack->frames[i].src);
+        Py_XDECREF(stack->frames[i].result);
+        Py_XDECREF(stack->frames[i].key);
+    }
+    if (stack->frames != stack->inline_frames)
+        PyMem_Free(stack->frames);
+}
+
+/* Push a frame for src; steals result */
+static int hook_push(HookStack *stack, int kind, PyObject *src, PyObject *result)
+{
+    if (hook_max_depth > 0 && stack->len >= hook_max_depth)
+    {
+        Py_DECREF(result);
+        PyErr_Format(PyExc_RecursionError, "maximum nesting depth of %zd exceeded while converting to MagiDict",
+                     hook_max_depth);
+        return -1;
+    }
+    if (stack->len == stack->cap)
+    {
+        Py_ssize_t cap = stack->cap * 2;
+        HookFrame *frames;
+        if (stack->frames == stack->inline_frames)
+        {
+            frames = PyMem_Malloc(cap * sizeof(HookFrame));
+            if (frames != NULL)
+                memcpy(frames, stack->inline_frames, stack->len * sizeof(HookFrame));
+        }
+        else
+            frames = PyMem_Realloc(stack->frames, cap * sizeof(HookFrame));
+        if (frames == NULL)
+        {
+            Py_DECREF(result);
+            PyErr_NoMemory();
+            return -1;
         }
+        stack->frames = frames;
+        stack->cap = cap;
+    }
+
+    HookFrame *frame = &stack->frames[stack->len++];
+    frame->kind = kind;
+    Py_INCREF(src);
+    frame->src = src;
+    frame->result = result;
+    frame->key = NULL;
+    frame->pos = 0;
+    return 0;
+}
 
-        Py_DECREF(item_id);
-        return new_dict;
+/* Start converting item: returns 0 with *out set (new reference) when it is
+ * done right away, 1 when a frame was pushed, -1 on error. */
+static int hook_start(HookStack *stack, PyObject *item, PtrMemo *memo, PyObject *magidict_class, PyObject **out)
+{
+    if (PyDict_Check(item) || PyList_Check(item))
+    {
+        PyObject *cached = memo_get(memo, item);
+        if (cached != NULL)
+        {
+            STAT(memo_hits);
+            Py_INCREF(cached);
+            *out = cached;
+            return 0;
+        }
+        if (PyErr_Occurred())
+            return -1;
     }
 
-    if (PyList_Check(item))
+    if (PyDict_Check(item))
     {
-        PyDict_SetItem(memo, item_id, item);
-        Py_ssize_t size = PyList_Size(item);
+        int is_magidict = PyDict_CheckExact(item) ? 0 : PyObject_IsInstance(item, magidict_class);
+        if (is_magidict < 0)
+            return -1;
+        if (is_magidict)
+        {
+            STAT(hook_magidicts);
+            Py_INCREF(item);
+            *out = item;
+            return 0;
+        }
 
-        for (Py_ssize_t i = 0; i < size; i++)
+        STAT(hook_dicts);
+        PyObject *new_dict = magidict_create(memo->fast_type, magidict_class);
+        if (new_dict == NULL)
+            return -1;
+        if (memo_set(memo, item, new_dict) < 0)
         {
-            PyObject *elem = PyList_GetItem(item, i);
-            PyObject *hooked = fast_hook_with_memo(elem, memo, magidict_class);
-            if (hooked == NULL)
-            {
-                Py_DECREF(item_id);
-                return NULL;
-            }
-            PyList_SetItem(item, i, hooked);
+            Py_DECREF(new_dict);
+            return -1;
         }
+        return hook_push(stack, HOOK_DICT, item, new_dict) < 0 ? -1 : 1;
+    }
 
-        Py_DECREF(item_id);
+    if (PyList_Check(item))
+    {
+        STAT(hook_lists);
+        if (memo_set(memo, item, item) < 0)
+            return -1;
         Py_INCREF(item);
-        return item;
+        return hook_push(stack, HOOK_LIST, item, item) < 0 ? -1 : 1;
     }
 
     if (PyTuple_Check(item))
     {
-        Py_ssize_t size = PyTuple_Size(item);
-        PyObject *hooked_values = PyTuple_New(size);
+        STAT(hook_tuples);
+        PyObject *hooked_values = PyTuple_New(PyTuple_GET_SIZE(item));
         if (hooked_values == NULL)
-        {
-            Py_DECREF(item_id);
-            return NULL;
-        }
+            return -1;
+        return hook_push(stack, HOOK_TUPLE, item, hooked_values) < 0 ? -1 : 1;
+    }
 
-        for (Py_ssize_t i = 0; i < size; i++)
+    Py_INCREF(item);
+    *out = item;
+    return 0;
+}
+
+/* Next child of frame to convert (new reference), or NULL when the frame is
+ * done (check PyErr_Occurred). For dict frames *key is set (new reference) too. */
+static PyObject *hook_next_child(HookFrame *frame, PtrMemo *memo, PyObject **key)
+{
+    if (frame->kind == HOOK_DICT)
+    {
+        PyObject *value;
+        if (!dict_next_ref(frame->src, &frame->pos, key, &value))
+            return NULL;
+        if (memo->key_cache != NULL && PyUnicode_CheckExact(*key))
         {
-            PyObject *elem = PyTuple_GetItem(item, i);
-            PyObject *hooked = fast_hook_with_memo(elem, memo, magidict_class);
-            if (hooked == NULL)
+            PyObject *cached = PyDict_SetDefault(memo->key_cache, *key, *key);
+            Py_XINCREF(cached);
+            Py_SETREF(*key, cached);
+            if (cached == NULL)
             {
-                Py_DECREF(hooked_values);
-                Py_DECREF(item_id);
+                Py_DECREF(value);
                 return NULL;
             }
-            PyTuple_SetItem(hooked_values, i, hooked);
         }
+        return value;
+    }
+    if (frame->kind == HOOK_LIST)
+        return list_item_ref(frame->src, frame->pos++);
+    if (frame->pos >= PyTuple_GET_SIZE(frame->src))
+        return NULL;
+    PyObject *child = PyTuple_GET_ITEM(frame->src, frame->pos++);
+    Py_INCREF(child);
+    return child;
+}
+
+/* Store the converted child into frame under key (dict frames) or at the
+ * current position. Steals value. */
+static int hook_deliver(HookFrame *frame, PyObject *key, PyObject *value)
+{
+    if (frame->kind == HOOK_DICT)
+    {
+        int res = PyDict_SetItem(frame->result, key, value);
+        Py_DECREF(value);
+        return res;
+    }
+    if (frame->kind == HOOK_LIST)
+        return list_store(frame->src, frame->pos - 1, value);
+    PyTuple_SET_ITEM(frame->result, frame->pos - 1, value);
+    return 0;
+}
 
-        PyTypeObject *item_type = Py_TYPE(item);
-        PyTypeObject *tuple_type = &PyTuple_Type;
+#define HOOK_CONTAINER(o) (PyDict_Check(o) || PyList_Check(o) || PyTuple_Check(o))
 
-        PyObject *result;
-        if (item_type == tuple_type)
+static PyObject *hook_value(PyObject *item, PtrMemo *memo, PyObject *magidict_class)
+{
+    if (item == NULL)
+        return NULL;
+    if (!HOOK_CONTAINER(item))
+    {
+        STAT(hook_scalars);
+        Py_INCREF(item);
+        return item;
+    }
+
+    HookStack stack;
+    stack.frames = stack.inline_frames;
+    stack.len = 0;
+    stack.cap = HOOK_INLINE_FRAMES;
+
+    PyObject *value = NULL;
+    int started = hook_start(&stack, item, memo, magidict_class, &value);
+    if (started <= 0)
+        return started < 0 ? NULL : value;
+
+    while (stack.len > 0)
+    {
+        HookFrame *top = &stack.frames[stack.len - 1];
+        if (value != NULL)
         {
-            result = hooked_values;
+            /* A child frame just finished */
+            int res = hook_deliver(top, top->key, value);
+            value = NULL;
+            Py_CLEAR(top->key);
+            if (res < 0)
+                goto error;
         }
-        else
+
+        int pushed = 0;
+        PyObject *key = NULL, *child;
+        while (!pushed && (child = hook_next_child(top, memo, &key)) != NULL)
         {
-            PyObject *fields = PyObject_GetAttrString(item, "_fields");
-            if (fields != NULL)
+            PyObject *hooked = child;
+            if (HOOK_CONTAINER(child))
             {
-                Py_DECREF(fields);
-                result = PyObject_CallObject((PyObject *)item_type, hooked_values);
-                Py_DECREF(hooked_values);
+                int res = hook_start(&stack, child, memo, magidict_class, &hooked);
+                Py_DECREF(child);
+                if (res < 0)
+                {
+                    Py_XDECREF(key);
+                    goto error;
+                }
+                if (res > 0)
+                {
+                    /* stack.frames may have moved */
+                    top = &stack.frames[stack.len - 2];
+                    top->key = key;
+                    pushed = 1;
+                    continue;
+                }
             }
             else
             {
-                PyErr_Clear();
-
-                PyObject *args = PyTuple_Pack(1, hooked_values);
-                if (args == NULL)
-                {
-                    Py_DECREF(hooked_values);
-                    Py_DECREF(item_id);
-                    return NULL;
-                }
-
-                result = PyObject_CallObject((PyObject *)item_type, args);
-                Py_DECREF(args);
-                Py_DECREF(hooked_values);
+                STAT(hook_scalars);
             }
+            int res = hook_deliver(top, key, hooked);
+            Py_CLEAR(key);
+            if (res < 0)
+                goto error;
         }
+        if (pushed)
+            continue;
+        if (PyErr_Occurred())
+            goto error;
 
-        Py_DECREF(item_id);
-        return result;
+        PyObject *result = top->result;
+        top->result = NULL;
+        if (top->kind == HOOK_TUPLE)
+            result = tuple_rebuild(top->src, result);
+        Py_CLEAR(top->src);
+        stack.len--;
+        if (result == NULL)
+            goto error;
+        value = result;
     }
 
-    Py_DECREF(item_id);
-    Py_INCREF(item);
-    return item;
+    hook_stack_free(&stack);
+    return value;
+
+error:
+    Py_XDECREF(value);
+    hook_stack_free(&stack);
+    return NULL;
+}
+
+/* set_max_depth(depth): limit the nesting depth the hook accepts; 0 or less
+ * removes the limit. Returns the previous limit. */
+static PyObject *py_set_max_depth(PyObject *self, PyObject *args)
+{
+    Py_ssize_t depth;
+    if (!PyArg_ParseTuple(args, "n:set_max_depth", &depth))
+        return NULL;
+    Py_ssize_t previous = hook_max_depth;
+    hook_max_depth = depth > 0 ? depth : 0;
+    return PyLong_FromSsize_t(previous);
+}
+
+static PyObject *fast_hook_with_memo(PyObject *item, PyObject *memo, PyObject *magidict_class)
+{
+    PtrMemo ptr_memo;
+    memo_init(&ptr_memo, memo, magidict_class);
+    PyObject *result = hook_value(item, &ptr_memo, magidict_class);
+    memo_free(&ptr_memo);
+    return result;
 }
 
 static PyObject *fast_hook(PyObject *self, PyObject *args)
@@ -174,14 +790,7 @@ static PyObject *fast_hook(PyObject *self, PyObject *args)
         return NULL;
     }
 
-    PyObject *memo = PyDict_New();
-    if (memo == NULL)
-        return NULL;
-
-    PyObject *result = fast_hook_with_memo(item, memo, magidict_class);
-    Py_DECREF(memo);
-
-    return result;
+    return fast_hook_with_memo(item, NULL, magidict_class);
 }
 
 static PyObject *py_fast_hook_with_memo(PyObject *self, PyObject *args)
@@ -204,78 +813,5465 @@ static PyObject *py_fast_hook_with_memo(PyObject *self, PyObject *args)
     return fast_hook_with_memo(item, memo, magidict_class);
 }
 
-static PyObject *
-py_split_dotted(PyObject *self, PyObject *args)
+/* Store a plain dict record as a tuple of hooked values in rows and its
+ * key tuple, shared through schemas by every record with the same keys in
+ * the same order, in keys. Returns 1 when stored, 0 when the record ended
+ * up in the memo (it is part of a cycle) and must be hooked as a whole. */
+static int compact_record(PyObject *record, PtrMemo *memo, PyObject *magidict_class, PyObject *schemas,
+                          PyObject **keys_out, PyObject **values_out)
 {
-    PyObject *py_s = NULL;
-    if (!PyArg_ParseTuple(args, "U", &py_s))
-    { /* accept only Unicode objects */
-        return NULL;
-    }
+    Py_ssize_t n = PyDict_GET_SIZE(record);
+    PyObject *keys = PyTuple_New(n);
+    PyObject *values = PyTuple_New(n);
+    if (keys == NULL || values == NULL)
+        goto error;
 
-    Py_ssize_t length = PyUnicode_GetLength(py_s);
-    PyObject *result = PyList_New(0);
-    if (result == NULL)
+    PyObject *key, *value;
+    Py_ssize_t pos = 0, i = 0;
+    while (i < n && dict_next_ref(record, &pos, &key, &value))
     {
-        return NULL;
+        if (memo->key_cache != NULL && PyUnicode_CheckExact(key))
+        {
+            PyObject *cached = PyDict_SetDefault(memo->key_cache, key, key);
+            Py_XINCREF(cached);
+            Py_SETREF(key, cached);
+            if (key == NULL)
+            {
+                Py_DECREF(value);
+                goto error;
+            }
+        }
+        PyTuple_SET_ITEM(keys, i, key);
+        PyObject *hooked = hook_value(value, memo, magidict_class);
+        Py_DECREF(value);
+        if (hooked == NULL)
+            goto error;
+        PyTuple_SET_ITEM(values, i, hooked);
+        i++;
+    }
+    if (i != n || PyDict_GET_SIZE(record) != n)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "dictionary changed size during iteration");
+        goto error;
+    }
+    if (memo_get(memo, record) != NULL)
+    {
+        Py_DECREF(keys);
+        Py_DECREF(values);
+        return 0;
     }
+    if (PyErr_Occurred())
+        goto error;
 
-    Py_UCS4 quote = 0; /* 0 = not inside a quote, otherwise store quote char */
-    Py_ssize_t start = 0;
+    PyObject *schema = PyDict_SetDefault(schemas, keys, keys);
+    if (schema == NULL)
+        goto error;
+    Py_INCREF(schema);
+    Py_DECREF(keys);
+    *keys_out = schema;
+    *values_out = values;
+    return 1;
 
-    for (Py_ssize_t i = 0; i < length; ++i)
+error:
+    Py_XDECREF(keys);
+    Py_XDECREF(values);
+    return -1;
+}
+
+/* Convert a batch of dicts with one memo and one class lookup, optionally
+ * interning str keys across the batch:
+ * hook_many(records, cls, intern_keys, compact). With compact, returns
+ * (keys, rows) where plain dict records become a shared key tuple and a
+ * tuple of values, and any other record is hooked with None as its keys. */
+static PyObject *py_hook_many(PyObject *self, PyObject *args)
+{
+    PyObject *records;
+    PyObject *magidict_class;
+    PyObject *intern_keys = Py_False;
+    int compact = 0;
+    PyObject *py_memo = Py_None;
+    Py_ssize_t start = 0, stop = PY_SSIZE_T_MAX;
+
+    if (!PyArg_ParseTuple(args, "OO|OpOnn:hook_many", &records, &magidict_class, &intern_keys, &compact, &py_memo,
+                          &start, &stop))
+    {
+        return NULL;
+    }
+    if (py_memo != Py_None && !PyDict_Check(py_memo))
+    {
+        PyErr_SetString(PyExc_TypeError, "memo must be a dict or None");
+        return NULL;
+    }
+    int intern = PyDict_Check(intern_keys) ? 1 : PyObject_IsTrue(intern_keys);
+    if (intern < 0)
+        return NULL;
+
+    PyObject *all = PySequence_Fast(records, "records must be an iterable of dicts");
+    if (all == NULL)
+        return NULL;
+    /* A private copy of the slice, so other threads may change records meanwhile */
+    PyObject *seq = PySequence_GetSlice(all, start, stop);
+    Py_DECREF(all);
+    if (seq == NULL)
+        return NULL;
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+    PyObject *result = PyList_New(size);
+    PyObject *keys = compact ? PyList_New(size) : NULL;
+    PyObject *schemas = compact ? PyDict_New() : NULL;
+
+    PtrMemo memo;
+    memo_init(&memo, py_memo == Py_None ? NULL : py_memo, magidict_class);
+    if (result == NULL || (compact && (keys == NULL || schemas == NULL)))
+        goto error;
+    if (PyDict_Check(intern_keys))
+    {
+        Py_INCREF(intern_keys);
+        memo.key_cache = intern_keys;
+    }
+    else if (intern && (memo.key_cache = PyDict_New()) == NULL)
+        goto error;
+
+    for (Py_ssize_t i = 0; i < size; i++)
+    {
+        PyObject *record = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyDict_Check(record))
+        {
+            PyErr_Format(PyExc_TypeError, "Expected dict, got %.100s", Py_TYPE(record)->tp_name);
+            goto error;
+        }
+        if (compact)
+        {
+            PyObject *schema = Py_None, *values = NULL;
+            int stored = 0;
+            if (PyDict_CheckExact(record) && memo_get(&memo, record) == NULL)
+            {
+                if (PyErr_Occurred())
+                    goto error;
+                stored = compact_record(record, &memo, magidict_class, schemas, &schema, &values);
+                if (stored < 0)
+                    goto error;
+            }
+            if (!stored)
+            {
+                Py_INCREF(Py_None);
+                schema = Py_None;
+                if ((values = hook_value(record, &memo, magidict_class)) == NULL)
+                {
+                    Py_DECREF(schema);
+                    goto error;
+                }
+            }
+            PyList_SET_ITEM(keys, i, schema);
+            PyList_SET_ITEM(result, i, values);
+            continue;
+        }
+        PyObject *hooked = hook_value(record, &memo, magidict_class);
+        if (hooked == NULL)
+            goto error;
+        PyList_SET_ITEM(result, i, hooked);
+    }
+
+    memo_free(&memo);
+    Py_DECREF(seq);
+    if (compact)
+    {
+        Py_DECREF(schemas);
+        PyObject *pair = PyTuple_Pack(2, keys, result);
+        Py_DECREF(keys);
+        Py_DECREF(result);
+        return pair;
+    }
+    return result;
+
+error:
+    memo_free(&memo);
+    Py_DECREF(seq);
+    Py_XDECREF(result);
+    Py_XDECREF(keys);
+    Py_XDECREF(schemas);
+    return NULL;
+}
+
+/* Convert list[start:stop] in place. memo receives every converted
+ * container, so that whatever another slice shares with this one can be
+ * reconciled afterwards (a reference count cannot tell: converting the list
+ * in place drops parents while the slice is being walked). */
+static PyObject *py_hook_range(PyObject *self, PyObject *args)
+{
+    PyObject *list;
+    Py_ssize_t start, stop;
+    PyObject *magidict_class;
+    PyObject *py_memo;
+
+    if (!PyArg_ParseTuple(args, "O!nnOO!:hook_range", &PyList_Type, &list, &start, &stop, &magidict_class,
+                          &PyDict_Type, &py_memo))
+    {
+        return NULL;
+    }
+
+    PtrMemo memo;
+    memo_init(&memo, py_memo, magidict_class);
+    PyObject *item;
+    for (Py_ssize_t i = start; i < stop && (item = list_item_ref(list, i)) != NULL; i++)
+    {
+        PyObject *hooked = hook_value(item, &memo, magidict_class);
+        Py_DECREF(item);
+        if (hooked == NULL || list_store(list, i, hooked) < 0)
+        {
+            memo_free(&memo);
+            return NULL;
+        }
+    }
+    memo_free(&memo);
+    Py_RETURN_NONE;
+}
+
+/* Hook every value of source into target with one shared memo in which
+ * source maps to target, as MagiDict.__init__ does. */
+static PyObject *py_hook_into(PyObject *self, PyObject *args)
+{
+    PyObject *target;
+    PyObject *source;
+    PyObject *magidict_class;
+
+    if (!PyArg_ParseTuple(args, "O!O!O", &PyDict_Type, &target, &PyDict_Type, &source, &magidict_class))
+    {
+        return NULL;
+    }
+
+    PtrMemo memo;
+    memo_init(&memo, NULL, magidict_class);
+    if (memo_put(&memo, source, target) < 0)
+        return NULL;
+
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (dict_next_ref(source, &pos, &key, &value))
+    {
+        PyObject *hooked = hook_value(value, &memo, magidict_class);
+        Py_DECREF(value);
+        if (hooked == NULL || PyDict_SetItem(target, key, hooked) < 0)
+        {
+            Py_DECREF(key);
+            Py_XDECREF(hooked);
+            memo_free(&memo);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(hooked);
+    }
+
+    memo_free(&memo);
+    Py_RETURN_NONE;
+}
+
+/* Lazy trees (enchant(d, lazy=True)): nested dicts are shallow-copied into
+ * MagiDicts only when first reached. All nodes of a tree share one memo
+ * dict, stored as _MagiDict__lazy_memo in their __dict__, mapping id(source) to a
+ * (source, converted) pair so shared references and cycles keep their
+ * identity. Lists are converted in place, one level at a time. */
+static PyObject *lazy_memo_of(PyObject *self)
+{
+    PyObject *inst_dict = ((MagiDictObject *)self)->inst_dict;
+    if (inst_dict == NULL)
+        return NULL;
+    return PyDict_GetItemWithError(inst_dict, str_lazy_memo);
+}
+
+static inline int lazy_candidate(PyObject *value)
+{
+    return PyList_Check(value) || PyTuple_Check(value) ||
+           (PyDict_Check(value) && !MagiDict_Check(value));
+}
+
+static PyObject *lazy_hook(PyObject *item, PyObject *memo, PyObject *cls)
+{
+    if (!lazy_candidate(item))
+    {
+        Py_INCREF(item);
+        return item;
+    }
+
+    if (PyTuple_Check(item))
+    {
+        Py_ssize_t size = PyTuple_GET_SIZE(item);
+        PyObject *hooked_values = PyTuple_New(size);
+        if (hooked_values == NULL)
+            return NULL;
+        for (Py_ssize_t i = 0; i < size; i++)
+        {
+            PyObject *hooked = lazy_hook(PyTuple_GET_ITEM(item, i), memo, cls);
+            if (hooked == NULL)
+            {
+                Py_DECREF(hooked_values);
+                return NULL;
+            }
+            PyTuple_SET_ITEM(hooked_values, i, hooked);
+        }
+        return tuple_rebuild(item, hooked_values);
+    }
+
+    PyObject *key = PyLong_FromVoidPtr(item);
+    if (key == NULL)
+        return NULL;
+    PyObject *entry = PyDict_GetItemWithError(memo, key);
+    if (entry != NULL && PyTuple_Check(entry) && PyTuple_GET_SIZE(entry) == 2 &&
+        PyTuple_GET_ITEM(entry, 0) == item)
+    {
+        Py_DECREF(key);
+        PyObject *cached = PyTuple_GET_ITEM(entry, 1);
+        Py_INCREF(cached);
+        return cached;
+    }
+    if (PyErr_Occurred())
+    {
+        Py_DECREF(key);
+        return NULL;
+    }
+
+    PyObject *result;
+    if (PyDict_Check(item))
+    {
+        result = magidict_create(hook_fast_type(cls), cls);
+        if (result == NULL || PyDict_Update(result, item) < 0 ||
+            PyObject_GenericSetAttr(result, str_lazy_memo, memo) < 0)
+        {
+            Py_XDECREF(result);
+            Py_DECREF(key);
+            return NULL;
+        }
+    }
+    else
+    {
+        Py_INCREF(item);
+        result = item;
+    }
+
+    entry = PyTuple_Pack(2, item, result);
+    if (entry == NULL || PyDict_SetItem(memo, key, entry) < 0)
+    {
+        Py_XDECREF(entry);
+        Py_DECREF(key);
+        Py_DECREF(result);
+        return NULL;
+    }
+    Py_DECREF(entry);
+    Py_DECREF(key);
+
+    if (PyList_Check(item))
+    {
+        PyObject *elem;
+        for (Py_ssize_t i = 0; (elem = list_item_ref(item, i)) != NULL; i++)
+        {
+            if (!lazy_candidate(elem))
+            {
+                Py_DECREF(elem);
+                continue;
+            }
+            PyObject *hooked = lazy_hook(elem, memo, cls);
+            Py_DECREF(elem);
+            if (hooked == NULL || list_store(item, i, hooked) < 0)
+            {
+                Py_DECREF(result);
+                return NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+/* value is the (borrowed) entry self[key]. If self belongs to a lazy tree,
+ * convert it and store the result back; otherwise return it unchanged. */
+static int magidict_materialize_all(PyObject *self);
+
+/* Copy-on-write forks (copy(cow=True)). A fork node starts as a shallow copy
+ * of its source whose MagiDict children are still borrowed from the source;
+ * cow_pending maps their keys to the borrowed nodes. A borrowed child is
+ * replaced by a fork of its own when it is reached through the fork. Lists,
+ * tuples and sets cannot report changes, so they are copied together with
+ * their node.
+ *
+ * The nodes of one fork share a CowGroup, whose memo maps id(source) to a
+ * (source, weakref to fork) pair so shared references and cycles keep their
+ * identity. MagiDicts do not know their parents, so a change deep inside a
+ * borrowed subtree cannot be traced back to the node borrowing it. Instead
+ * the group sits, as a weak reference, in the watchers of every MagiDict of
+ * the source the fork can reach, and when one of them is about to be mutated
+ * the group completes its copy (cow_complete). Only the fork's nodes hold
+ * the group strongly, so a dropped fork is freed right away. */
+typedef struct
+{
+    PyObject_HEAD
+    PyObject *memo;
+    PyObject *weakreflist;
+} CowGroupObject;
+
+static int cow_group_traverse(PyObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(((CowGroupObject *)self)->memo);
+    return 0;
+}
+
+static int cow_group_clear(PyObject *self)
+{
+    Py_CLEAR(((CowGroupObject *)self)->memo);
+    return 0;
+}
+
+static void cow_group_dealloc(PyObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    if (((CowGroupObject *)self)->weakreflist != NULL)
+        PyObject_ClearWeakRefs(self);
+    Py_CLEAR(((CowGroupObject *)self)->memo);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyTypeObject CowGroup_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "magidict._magidict.CowGroup",
+    .tp_doc = "State shared by the nodes of a copy-on-write fork",
+    .tp_basicsize = sizeof(CowGroupObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = cow_group_dealloc,
+    .tp_traverse = cow_group_traverse,
+    .tp_clear = cow_group_clear,
+    .tp_weaklistoffset = offsetof(CowGroupObject, weakreflist),
+};
+
+static PyObject *cow_group_new(void)
+{
+    CowGroupObject *group = PyObject_GC_New(CowGroupObject, &CowGroup_Type);
+    if (group == NULL)
+        return NULL;
+    group->weakreflist = NULL;
+    group->memo = PyDict_New();
+    if (group->memo == NULL)
+    {
+        Py_DECREF(group);
+        return NULL;
+    }
+    PyObject_GC_Track((PyObject *)group);
+    return (PyObject *)group;
+}
+
+#define COW_MEMO(group) (((CowGroupObject *)(group))->memo)
+
+static PyObject *cow_fork(PyObject *src, PyObject *group);
+static int magidict_is_protected(PyObject *self);
+
+/* A key index token or fork reference that no longer needs notifying */
+static int watcher_is_stale(PyObject *entry)
+{
+    if (PyList_Check(entry))
+        return PyList_GET_SIZE(entry) == 0;
+    if (!PyWeakref_Check(entry))
+        return 0;
+    PyObject *group;
+    if (PyWeakref_GetRef(entry, &group) <= 0)
+    {
+        PyErr_Clear();
+        return 1;
+    }
+    int stale = Py_TYPE(group) != &CowGroup_Type || COW_MEMO(group) == NULL;
+    Py_DECREF(group);
+    return stale;
+}
+
+/* Append watcher (a key index token or a weak reference to a fork's group)
+ * to the watchers of md. Stale entries are dropped whenever the list
+ * reaches a power of two, so appends stay amortized O(1). */
+static int magidict_add_watcher(PyObject *md, PyObject *watcher)
+{
+    MagiDictObject *self = (MagiDictObject *)md;
+    if (self->watchers == NULL)
+    {
+        self->watchers = PyList_New(0);
+        if (self->watchers == NULL)
+            return -1;
+    }
+
+    PyObject *watchers = self->watchers;
+    Py_ssize_t size = PyList_GET_SIZE(watchers);
+    if ((size & (size - 1)) != 0)
+        return PyList_Append(watchers, watcher);
+    for (Py_ssize_t i = size - 1; i >= 0; i--)
+    {
+        if (watcher_is_stale(PyList_GET_ITEM(watchers, i)) && PyList_SetSlice(watchers, i, i + 1, NULL) < 0)
+            return -1;
+    }
+    return PyList_Append(watchers, watcher);
+}
+
+/* New reference to the copy of src in memo, or NULL. Entries hold the copy
+ * itself or, for forks, a weak reference to it. */
+static PyObject *cow_group_get(PyObject *memo, PyObject *src)
+{
+    if (memo == NULL)
+        return NULL;
+    PyObject *key_id = PyLong_FromVoidPtr(src);
+    if (key_id == NULL)
+        return NULL;
+    PyObject *entry = PyDict_GetItemWithError(memo, key_id);
+    Py_DECREF(key_id);
+    if (entry == NULL || PyTuple_GET_ITEM(entry, 0) != src)
+        return NULL;
+    PyObject *copy = PyTuple_GET_ITEM(entry, 1);
+    if (!PyWeakref_CheckRef(copy))
+    {
+        Py_INCREF(copy);
+        return copy;
+    }
+    PyWeakref_GetRef(copy, &copy);
+    return copy;
+}
+
+static int cow_group_put(PyObject *memo, PyObject *src, PyObject *copy, int weak)
+{
+    PyObject *key_id = PyLong_FromVoidPtr(src);
+    if (key_id == NULL)
+        return -1;
+    PyObject *ref = weak ? PyWeakref_NewRef(copy, NULL) : copy;
+    PyObject *entry = ref != NULL ? PyTuple_Pack(2, src, ref) : NULL;
+    if (weak)
+        Py_XDECREF(ref);
+    if (entry == NULL)
+    {
+        Py_DECREF(key_id);
+        return -1;
+    }
+    int res = PyDict_SetItem(memo, key_id, entry);
+    Py_DECREF(key_id);
+    Py_DECREF(entry);
+    return res;
+}
+
+/* Growable stack of borrowed pointers for cow_watch_tree. Nothing in the
+ * walk runs Python code, so the containers keep their items alive. */
+typedef struct
+{
+    PyObject **items;
+    Py_ssize_t size;
+    Py_ssize_t capacity;
+} WatchStack;
+
+static int watch_push(WatchStack *stack, PyObject *value)
+{
+    if (!MagiDict_Check(value) && !PyList_CheckExact(value) && !PyTuple_Check(value))
+        return 0;
+    if (value == none_sentinel || value == missing_sentinel)
+        return 0;
+    if (stack->size == stack->capacity)
+    {
+        Py_ssize_t capacity = stack->capacity ? stack->capacity * 2 : 64;
+        PyObject **items = PyMem_Realloc(stack->items, capacity * sizeof(PyObject *));
+        if (items == NULL)
+        {
+            PyErr_NoMemory();
+            return -1;
+        }
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+    stack->items[stack->size++] = value;
+    return 0;
+}
+
+/* Record ref in the watchers of every MagiDict reachable from root through
+ * MagiDicts, lists and tuples. A MagiDict whose last watcher already is ref
+ * has been visited; lists are tracked by id (a tuple cannot hold itself). */
+static int cow_watch_tree(PyObject *root, PyObject *ref)
+{
+    WatchStack stack = {NULL, 0, 0};
+    PyObject *seen = NULL;
+    if (watch_push(&stack, root) < 0)
+        goto error;
+
+    while (stack.size > 0)
+    {
+        PyObject *item = stack.items[--stack.size];
+        if (MagiDict_Check(item))
+        {
+            PyObject *watchers = ((MagiDictObject *)item)->watchers;
+            if (watchers != NULL && PyList_GET_SIZE(watchers) > 0 &&
+                PyList_GET_ITEM(watchers, PyList_GET_SIZE(watchers) - 1) == ref)
+                continue;
+            if (magidict_add_watcher(item, ref) < 0)
+                goto error;
+            Py_ssize_t pos = 0;
+            PyObject *key, *value;
+            while (PyDict_Next(item, &pos, &key, &value))
+            {
+                if (watch_push(&stack, value) < 0)
+                    goto error;
+            }
+            continue;
+        }
+
+        if (PyList_CheckExact(item))
+        {
+            if (seen == NULL && (seen = PySet_New(NULL)) == NULL)
+                goto error;
+            PyObject *key_id = PyLong_FromVoidPtr(item);
+            int visited = key_id == NULL ? -1 : PySet_Contains(seen, key_id);
+            if (visited == 0)
+                visited = PySet_Add(seen, key_id);
+            Py_XDECREF(key_id);
+            if (visited < 0)
+                goto error;
+            if (visited)
+                continue;
+        }
+        for (Py_ssize_t i = 0; i < Py_SIZE(item); i++)
+        {
+            PyObject *element = PyList_CheckExact(item) ? PyList_GET_ITEM(item, i) : PyTuple_GET_ITEM(item, i);
+            if (watch_push(&stack, element) < 0)
+                goto error;
+        }
+    }
+    PyMem_Free(stack.items);
+    Py_XDECREF(seen);
+    return 0;
+
+error:
+    PyMem_Free(stack.items);
+    Py_XDECREF(seen);
+    return -1;
+}
+
+/* Copy a value stored in a node being forked. Nested MagiDicts (inside
+ * lists and tuples) are forked eagerly, raw dicts of lazy trees are hooked
+ * and other leaves are shared. *seqs memoizes the lists and tuples copied
+ * for this node and is created on first use. */
+static PyObject *cow_copy_value(PyObject *value, PyObject *group, PyObject **seqs, PyObject *cls)
+{
+    if (MagiDict_Check(value))
+        return cow_fork(value, group);
+
+    if (PyDict_Check(value))
+        return fast_hook_with_memo(value, NULL, cls);
+
+    if (Py_IS_TYPE(value, &PySet_Type))
+        return PySet_New(value);
+
+    int is_list = PyList_CheckExact(value);
+    if (!is_list && !PyTuple_Check(value))
+    {
+        Py_INCREF(value);
+        return value;
+    }
+
+    PyObject *cached = cow_group_get(*seqs, value);
+    if (cached != NULL)
+        return cached;
+    if (PyErr_Occurred())
+        return NULL;
+    if (*seqs == NULL && (*seqs = PyDict_New()) == NULL)
+        return NULL;
+
+    Py_ssize_t size = Py_SIZE(value);
+    PyObject *copy = is_list ? PyList_New(size) : PyTuple_New(size);
+    if (copy == NULL)
+        return NULL;
+    if (Py_EnterRecursiveCall(" while forking a MagiDict"))
+    {
+        Py_DECREF(copy);
+        return NULL;
+    }
+    /* The memo entry comes first so a list containing itself stays cyclic */
+    if (is_list && cow_group_put(*seqs, value, copy, 0) < 0)
+        goto error;
+
+    int changed = is_list;
+    for (Py_ssize_t i = 0; i < size; i++)
+    {
+        PyObject *element = is_list ? PyList_GET_ITEM(value, i) : PyTuple_GET_ITEM(value, i);
+        PyObject *copied = cow_copy_value(element, group, seqs, cls);
+        if (copied == NULL)
+            goto error;
+        changed |= copied != element;
+        if (is_list)
+            PyList_SET_ITEM(copy, i, copied);
+        else
+            PyTuple_SET_ITEM(copy, i, copied);
+    }
+    Py_LeaveRecursiveCall();
+
+    if (is_list)
+        return copy;
+    if (!changed)
+    {
+        Py_DECREF(copy);
+        Py_INCREF(value);
+        return value;
+    }
+    copy = tuple_rebuild(value, copy);
+    if (copy != NULL && cow_group_put(*seqs, value, copy, 0) < 0)
+        Py_CLEAR(copy);
+    return copy;
+
+error:
+    Py_LeaveRecursiveCall();
+    Py_DECREF(copy);
+    return NULL;
+}
+
+/* New reference to the fork of src within group, creating it if needed */
+static PyObject *cow_fork(PyObject *src, PyObject *group)
+{
+    PyObject *fork = cow_group_get(COW_MEMO(group), src);
+    if (fork != NULL)
+        return fork;
+    if (PyErr_Occurred())
+        return NULL;
+
+    int protected_ = magidict_is_protected(src);
+    if (protected_ != 0)
+    {
+        if (protected_ < 0)
+            return NULL;
+        Py_INCREF(src);
+        return src;
+    }
+    if (lazy_memo_of(src) != NULL && magidict_materialize_all(src) < 0)
+        return NULL;
+    if (PyErr_Occurred())
+        return NULL;
+
+    fork = magidict_create(hook_fast_type((PyObject *)Py_TYPE(src)), (PyObject *)Py_TYPE(src));
+    if (fork == NULL)
+        return NULL;
+    if (cow_group_put(COW_MEMO(group), src, fork, 1) < 0)
+        goto error;
+
+    PyObject *cls = (PyObject *)Py_TYPE(src);
+    PyObject *pending = NULL;
+    PyObject *seqs = NULL;
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    while (PyDict_Next(src, &pos, &key, &value))
+    {
+        Py_INCREF(key);
+        Py_INCREF(value);
+        PyObject *copied = NULL;
+        if (!MagiDict_Check(value) || value == none_sentinel || value == missing_sentinel)
+        {
+            copied = cow_copy_value(value, group, &seqs, cls);
+        }
+        else if ((copied = cow_group_get(COW_MEMO(group), value)) == NULL && !PyErr_Occurred())
+        {
+            /* Borrow the child until it is reached */
+            if (pending == NULL)
+                pending = PyDict_New();
+            if (pending != NULL && PyDict_SetItem(pending, key, value) == 0)
+            {
+                Py_INCREF(value);
+                copied = value;
+            }
+        }
+        int res = copied != NULL ? PyDict_SetItem(fork, key, copied) : -1;
+        Py_XDECREF(copied);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (res < 0)
+        {
+            Py_XDECREF(pending);
+            Py_XDECREF(seqs);
+            goto error;
+        }
+    }
+    Py_XDECREF(seqs);
+
+    if (pending != NULL)
+    {
+        MagiDictObject *self = (MagiDictObject *)fork;
+        Py_XSETREF(self->cow_pending, pending);
+        Py_INCREF(group);
+        Py_XSETREF(self->cow_group, group);
+    }
+    return fork;
+
+error:
+    Py_DECREF(fork);
+    return NULL;
+}
+
+/* Return the value stored under key in a fork, replacing a borrowed child
+ * with its fork first. value is the raw (borrowed) value. */
+static PyObject *cow_resolve(PyObject *self, PyObject *key, PyObject *value)
+{
+    MagiDictObject *md = (MagiDictObject *)self;
+    PyObject *src = key != NULL ? PyDict_GetItemWithError(md->cow_pending, key) : NULL;
+    if (src != value || md->cow_group == NULL || COW_MEMO(md->cow_group) == NULL)
+    {
+        if (PyErr_Occurred())
+            return NULL;
+        Py_INCREF(value);
+        return value;
+    }
+
+    PyObject *group = md->cow_group;
+    Py_INCREF(group);
+    Py_INCREF(src);
+    PyObject *fork = cow_fork(src, group);
+    Py_DECREF(group);
+    if (fork != NULL && PyDict_SetItem(self, key, fork) < 0)
+        Py_CLEAR(fork);
+    if (fork != NULL && md->cow_pending != NULL)
+    {
+        if (PyDict_DelItem(md->cow_pending, key) < 0)
+            Py_CLEAR(fork);
+        else if (PyDict_GET_SIZE(md->cow_pending) == 0)
+            Py_CLEAR(md->cow_pending);
+    }
+    Py_DECREF(src);
+    return fork;
+}
+
+/* New list of the live forks recorded in memo */
+static PyObject *cow_group_forks(PyObject *memo)
+{
+    PyObject *forks = PyList_New(0);
+    if (forks == NULL)
+        return NULL;
+    Py_ssize_t pos = 0;
+    PyObject *key, *entry;
+    while (PyDict_Next(memo, &pos, &key, &entry))
+    {
+        PyObject *fork;
+        int res = PyWeakref_GetRef(PyTuple_GET_ITEM(entry, 1), &fork);
+        if (res > 0)
+        {
+            res = PyList_Append(forks, fork);
+            Py_DECREF(fork);
+        }
+        if (res < 0)
+        {
+            Py_DECREF(forks);
+            return NULL;
+        }
+    }
+    return forks;
+}
+
+/* Copy everything the fork still borrows, then release the group so the
+ * fork no longer depends on its source */
+static int cow_complete(PyObject *group)
+{
+    PyObject *memo = COW_MEMO(group);
+    if (memo == NULL)
+        return 0;
+    Py_INCREF(memo);
+
+    PyObject *forks = NULL;
+    int progress = 1;
+    while (progress)
+    {
+        progress = 0;
+        Py_XSETREF(forks, cow_group_forks(memo));
+        if (forks == NULL)
+            goto error;
+        for (Py_ssize_t i = 0; i < PyList_GET_SIZE(forks); i++)
+        {
+            MagiDictObject *fork = (MagiDictObject *)PyList_GET_ITEM(forks, i);
+            if (fork->cow_pending == NULL)
+                continue;
+            progress = 1;
+            if (magidict_materialize_all((PyObject *)fork) < 0)
+                goto error;
+            /* Whatever is left was replaced through plain dict methods */
+            Py_CLEAR(fork->cow_pending);
+        }
+    }
+
+    Py_CLEAR(COW_MEMO(group));
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(forks); i++)
+        Py_CLEAR(((MagiDictObject *)PyList_GET_ITEM(forks, i))->cow_group);
+    Py_DECREF(forks);
+    Py_DECREF(memo);
+    return 0;
+
+error:
+    Py_XDECREF(forks);
+    Py_DECREF(memo);
+    return -1;
+}
+
+/* Called before self is mutated: clear the key index tokens covering it and
+ * let forks reaching it complete their copy */
+static int magidict_notify_watchers(PyObject *self)
+{
+    PyObject *watchers = ((MagiDictObject *)self)->watchers;
+    ((MagiDictObject *)self)->watchers = NULL;
+
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(watchers); i++)
+    {
+        PyObject *entry = PyList_GET_ITEM(watchers, i);
+        int res = 0;
+        if (PyList_Check(entry))
+        {
+            res = PyList_SetSlice(entry, 0, PyList_GET_SIZE(entry), NULL);
+        }
+        else if (!watcher_is_stale(entry))
+        {
+            PyObject *group;
+            res = PyWeakref_GetRef(entry, &group);
+            if (res > 0)
+            {
+                res = cow_complete(group);
+                Py_DECREF(group);
+            }
+        }
+        if (res < 0)
+        {
+            Py_DECREF(watchers);
+            return -1;
+        }
+    }
+    Py_DECREF(watchers);
+    return 0;
+}
+
+/* Lazy trees create MagiDicts as they are reached; the forks watching the
+ * parent must watch the new child as well */
+static int magidict_share_watchers(PyObject *self, PyObject *child)
+{
+    PyObject *watchers = ((MagiDictObject *)self)->watchers;
+    Py_INCREF(watchers);
+    int res = 0;
+    for (Py_ssize_t i = 0; res == 0 && i < PyList_GET_SIZE(watchers); i++)
+    {
+        PyObject *entry = PyList_GET_ITEM(watchers, i);
+        if (PyWeakref_Check(entry) && !watcher_is_stale(entry))
+            res = cow_watch_tree(child, entry);
+    }
+    Py_DECREF(watchers);
+    return res;
+}
+
+static PyObject *lazy_materialize(PyObject *self, PyObject *key, PyObject *value)
+{
+    if (((MagiDictObject *)self)->cow_pending != NULL && MagiDict_Check(value))
+        return cow_resolve(self, key, value);
+    if (!lazy_candidate(value))
+    {
+        Py_INCREF(value);
+        return value;
+    }
+
+    PyObject *memo = lazy_memo_of(self);
+    if (memo == NULL)
+    {
+        if (PyErr_Occurred())
+            return NULL;
+        Py_INCREF(value);
+        return value;
+    }
+
+    Py_INCREF(memo);
+    PyObject *hooked = lazy_hook(value, memo, (PyObject *)Py_TYPE(self));
+    Py_DECREF(memo);
+    if (hooked != NULL && hooked != value && key != NULL && PyDict_SetItem(self, key, hooked) < 0)
+        Py_CLEAR(hooked);
+    if (hooked != NULL && ((MagiDictObject *)self)->watchers != NULL && magidict_share_watchers(self, hooked) < 0)
+        Py_CLEAR(hooked);
+    return hooked;
+}
+
+static PyObject *
+py_split_dotted(PyObject *self, PyObject *args)
+{
+    PyObject *py_s = NULL;
+    if (!PyArg_ParseTuple(args, "U", &py_s))
+    { /* accept only Unicode objects */
+        return NULL;
+    }
+
+    Py_ssize_t length = PyUnicode_GetLength(py_s);
+    PyObject *result = PyList_New(0);
+    if (result == NULL)
+    {
+        return NULL;
+    }
+
+    Py_UCS4 quote = 0; /* 0 = not inside a quote, otherwise store quote char */
+    Py_ssize_t start = 0;
+
+    for (Py_ssize_t i = 0; i < length; ++i)
+    {
+        Py_UCS4 ch = PyUnicode_ReadChar(py_s, i);
+        /* toggle quote state when encountering a quote char */
+        if (ch == (Py_UCS4)'\'' || ch == (Py_UCS4)'"')
+        {
+            if (quote == 0)
+            {
+                quote = ch;
+            }
+            else if (quote == ch)
+            {
+                quote = 0;
+            }
+            /* continue; quote characters are part of the token */
+        }
+
+        /* split on dot only when not inside quotes */
+        if (ch == (Py_UCS4)'.' && quote == 0)
+        {
+            PyObject *part = PyUnicode_Substring(py_s, start, i);
+            if (part == NULL)
+            {
+                Py_DECREF(result);
+                return NULL;
+            }
+            if (PyList_Append(result, part) < 0)
+            {
+                Py_DECREF(part);
+                Py_DECREF(result);
+                return NULL;
+            }
+            Py_DECREF(part);
+            start = i + 1;
+        }
+    }
+
+    /* append last part (from start to end) */
+    PyObject *last = PyUnicode_Substring(py_s, start, length);
+    if (last == NULL)
+    {
+        Py_DECREF(result);
+        return NULL;
+    }
+    if (PyList_Append(result, last) < 0)
+    {
+        Py_DECREF(last);
+        Py_DECREF(result);
+        return NULL;
+    }
+    Py_DECREF(last);
+
+    return result;
+}
+
+static int magidict_is_protected(PyObject *self)
+{
+    PyObject *inst_dict = ((MagiDictObject *)self)->inst_dict;
+    if (inst_dict == NULL)
+        return 0;
+
+    PyObject *names[2] = {str_from_none, str_from_missing};
+    for (int i = 0; i < 2; i++)
+    {
+        PyObject *flag = PyDict_GetItemWithError(inst_dict, names[i]);
+        if (flag != NULL)
+        {
+            int truth = PyObject_IsTrue(flag);
+            if (truth != 0)
+                return truth;
+        }
+        else if (PyErr_Occurred())
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int magidict_raise_if_protected(PyObject *self)
+{
+    int protected_ = magidict_is_protected(self);
+    if (protected_ < 0)
+        return -1;
+    if (protected_)
+    {
+        PyErr_SetString(PyExc_TypeError, "Cannot modify NoneType or missing keys.");
+        return -1;
+    }
+    return 0;
+}
+
+/* Return the empty, protected MagiDict used for missing keys and None values.
+ * core.py registers one shared instance per flag; before that a fresh
+ * flagged instance is created. */
+static PyObject *magidict_new_flagged(PyObject *self, PyObject *flag)
+{
+    if (flag == str_from_none)
+        STAT(none_sentinels);
+    else
+        STAT(missing_sentinels);
+    PyObject *shared = flag == str_from_none ? none_sentinel : missing_sentinel;
+    if (shared != NULL)
+    {
+        Py_INCREF(shared);
+        return shared;
+    }
+
+    PyObject *md = PyObject_CallFunctionObjArgs((PyObject *)Py_TYPE(self), NULL);
+    if (md == NULL)
+        return NULL;
+
+    if (PyObject_GenericSetAttr(md, flag, Py_True) < 0)
+    {
+        Py_DECREF(md);
+        return NULL;
+    }
+    return md;
+}
+
+/* self[name] as an attribute: the value, or a flagged empty MagiDict */
+static PyObject *magidict_key_attr(PyObject *self, PyObject *name);
+
+/* Equivalent of MagiDict.__getattr__: only reached once normal attribute
+ * lookup found nothing on the type or the instance. */
+static PyObject *magidict_getattr_fallback(PyObject *self, PyObject *name)
+{
+    if (PyUnicode_GET_LENGTH(name) > 0 && PyUnicode_READ_CHAR(name, 0) == '_' &&
+        (PyUnicode_CompareWithASCIIString(name, "_from_none") == 0 ||
+         PyUnicode_CompareWithASCIIString(name, "_from_missing") == 0))
+    {
+        Py_RETURN_FALSE;
+    }
+
+    return magidict_key_attr(self, name);
+}
+
+static PyObject *magidict_key_attr(PyObject *self, PyObject *name)
+{
+    PyObject *value = PyDict_GetItemWithError(self, name);
+    if (value == NULL)
+    {
+        if (PyErr_Occurred())
+            return NULL;
+        STAT(key_misses);
+        return magidict_new_flagged(self, str_from_missing);
+    }
+    STAT(key_hits);
+
+    if (value == Py_None)
+        return magidict_new_flagged(self, str_from_none);
+
+    PyObject *lazy = lazy_materialize(self, name, value);
+    if (lazy != value)
+        return lazy;
+    Py_DECREF(lazy);
+
+    if (PyDict_Check(value) && !MagiDict_Check(value))
+    {
+        PyObject *cls = magidict_class != NULL ? magidict_class : (PyObject *)Py_TYPE(self);
+        STAT(magidicts_created);
+        STAT(python_fallbacks);
+        PyObject *converted = PyObject_CallFunctionObjArgs(cls, value, NULL);
+        if (converted == NULL)
+            return NULL;
+        if (PyObject_SetItem(self, name, converted) < 0)
+        {
+            Py_DECREF(converted);
+            return NULL;
+        }
+        return converted;
+    }
+
+    Py_INCREF(value);
+    return value;
+}
+
+/* Attribute descriptor for one key of a class made by MagiDict.specialize().
+ * magidict_getattro recognises it and reads the key directly, skipping the
+ * generic lookup of the instance dict and the special attribute names. */
+typedef struct
+{
+    PyObject_HEAD
+    PyObject *key;
+} KeyAttrObject;
+
+static PyTypeObject KeyAttr_Type;
+
+static PyObject *key_attr_new(PyTypeObject *type, PyObject *args, PyObject *Py_UNUSED(kwds))
+{
+    PyObject *key;
+    if (!PyArg_ParseTuple(args, "U:KeyAttr", &key))
+        return NULL;
+    KeyAttrObject *attr = (KeyAttrObject *)type->tp_alloc(type, 0);
+    if (attr == NULL)
+        return NULL;
+    Py_INCREF(key);
+    PyUnicode_InternInPlace(&key);
+    attr->key = key;
+    return (PyObject *)attr;
+}
+
+static void key_attr_dealloc(PyObject *self)
+{
+    Py_CLEAR(((KeyAttrObject *)self)->key);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject *key_attr_get(PyObject *self, PyObject *obj, PyObject *Py_UNUSED(type))
+{
+    if (obj == NULL || obj == Py_None)
+    {
+        Py_INCREF(self);
+        return self;
+    }
+    if (!MagiDict_Check(obj))
+    {
+        PyErr_Format(PyExc_TypeError, "KeyAttr applies to MagiDict objects, not %.100s", Py_TYPE(obj)->tp_name);
+        return NULL;
+    }
+    return magidict_key_attr(obj, ((KeyAttrObject *)self)->key);
+}
+
+static PyObject *key_attr_get_key(PyObject *self, void *Py_UNUSED(closure))
+{
+    Py_INCREF(((KeyAttrObject *)self)->key);
+    return ((KeyAttrObject *)self)->key;
+}
+
+static PyGetSetDef key_attr_getset[] = {
+    {"key", key_attr_get_key, NULL, "The key read by this attribute", NULL},
+    {NULL}};
+
+static PyTypeObject KeyAttr_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "magidict._magidict.KeyAttr",
+    .tp_doc = "Attribute reading one key of a specialized MagiDict",
+    .tp_basicsize = sizeof(KeyAttrObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = key_attr_new,
+    .tp_dealloc = key_attr_dealloc,
+    .tp_descr_get = key_attr_get,
+    .tp_getset = key_attr_getset,
+};
+
+static PyObject *magidict_getattro(PyObject *self, PyObject *name)
+{
+    if (!PyUnicode_Check(name))
+        return PyObject_GenericGetAttr(self, name);
+
+    /* Type attributes (methods, descriptors) win over keys, as with __getattr__ */
+    PyObject *descr = _PyType_Lookup(Py_TYPE(self), name);
+    if (descr != NULL && Py_TYPE(descr) == &KeyAttr_Type && ((MagiDictObject *)self)->inst_dict == NULL)
+        return magidict_key_attr(self, ((KeyAttrObject *)descr)->key);
+    if (descr != NULL)
+    {
+        PyObject *res = PyObject_GenericGetAttr(self, name);
+        if (res != NULL || !PyErr_ExceptionMatches(PyExc_AttributeError))
+            return res;
+        PyErr_Clear();
+    }
+    else
+    {
+        PyObject *inst_dict = ((MagiDictObject *)self)->inst_dict;
+        if (inst_dict != NULL)
+        {
+            PyObject *res = PyDict_GetItemWithError(inst_dict, name);
+            if (res != NULL)
+            {
+                Py_INCREF(res);
+                return res;
+            }
+            if (PyErr_Occurred())
+                return NULL;
+        }
+    }
+
+    return magidict_getattr_fallback(self, name);
+}
+
+/* Dotted-path traversal shared by MagiDict.__getitem__ and get_path(). The
+ * rules mirror _py_walk_path in core.py: exact dicts, lists and tuples (and
+ * MagiDicts) are indexed directly, anything else goes through the
+ * Mapping/Sequence ABCs. A miss is reported as NULL without an exception. */
+static PyObject *magidict_subscript(PyObject *self, PyObject *key);
+
+static PyObject *path_getitem(PyObject *obj, PyObject *key, PyObject *misses)
+{
+    PyObject *value = PyObject_GetItem(obj, key);
+    if (value == NULL && PyErr_ExceptionMatches(misses))
+        PyErr_Clear();
+    return value;
+}
+
+static int is_dotted(PyObject *key)
+{
+    return PyUnicode_Check(key) &&
+           PyUnicode_FindChar(key, '.', 0, PyUnicode_GET_LENGTH(key), 1) >= 0;
+}
+
+static PyObject *path_step(PyObject *obj, PyObject *key)
+{
+    PyTypeObject *type = Py_TYPE(obj);
+
+    if (PyDict_CheckExact(obj) ||
+        (type->tp_as_mapping != NULL && type->tp_as_mapping->mp_subscript == magidict_subscript))
+    {
+        PyObject *value = PyDict_GetItemWithError(obj, key);
+        if (value != NULL)
+        {
+            Py_INCREF(value);
+            return value;
+        }
+        if (PyErr_Occurred() || PyDict_CheckExact(obj))
+            return NULL;
+
+        /* A MagiDict can still define __missing__. dict's own subscript is
+         * used so that a segment containing a dot is not parsed again as a
+         * path of its own. */
+        if (_PyType_Lookup(type, str_missing) == NULL)
+            return NULL;
+        value = PyDict_Type.tp_as_mapping->mp_subscript(obj, key);
+        if (value == NULL && PyErr_ExceptionMatches(PyExc_KeyError))
+            PyErr_Clear();
+        return value;
+    }
+
+    if (PyList_CheckExact(obj) || PyTuple_CheckExact(obj))
+    {
+        if (PyBool_Check(key))
+            return NULL;
+        if (!PyLong_CheckExact(key))
+            return path_getitem(obj, key, sequence_misses);
+
+        Py_ssize_t index = PyLong_AsSsize_t(key);
+        if (index == -1 && PyErr_Occurred())
+        {
+            PyErr_Clear();
+            return NULL;
+        }
+        if (index < 0)
+            index += Py_SIZE(obj);
+        if (PyList_CheckExact(obj))
+            return list_item_ref(obj, index);
+        if (index < 0 || index >= PyTuple_GET_SIZE(obj))
+            return NULL;
+        PyObject *value = PyTuple_GET_ITEM(obj, index);
+        Py_INCREF(value);
+        return value;
+    }
+
+    if (abc_mapping == NULL)
+        return NULL;
+
+    /* Other containers are only recognised through the ABCs */
+    STAT(python_fallbacks);
+    int is_mapping = PyDict_Check(obj) ? 1 : PyObject_IsInstance(obj, abc_mapping);
+    if (is_mapping < 0)
+        return NULL;
+    if (is_mapping)
+        return path_getitem(obj, key, PyExc_KeyError);
+
+    if (PyUnicode_Check(obj) || PyBytes_Check(obj))
+        return NULL;
+
+    int is_sequence = PyObject_IsInstance(obj, abc_sequence);
+    if (is_sequence < 0)
+        return NULL;
+    if (!is_sequence || PyBool_Check(key))
+        return NULL;
+    return path_getitem(obj, key, sequence_misses);
+}
+
+/* New reference to the value at the end of parts, or NULL (no exception set
+ * on a plain miss) */
+static PyObject *path_walk(PyObject *obj, PyObject *parts)
+{
+    PyObject *seq = PySequence_Fast(parts, "path must be a string or a sequence of keys");
+    if (seq == NULL)
+        return NULL;
+
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+
+    Py_INCREF(obj);
+    for (Py_ssize_t i = 0; i < size && obj != NULL; i++)
+    {
+        PyObject *next = path_step(obj, items[i]);
+        Py_DECREF(obj);
+        obj = next;
+    }
+
+    Py_DECREF(seq);
+    return obj;
+}
+
+static PyObject *path_resolve(PyObject *obj, PyObject *path)
+{
+    if (path_compiler == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "dotted paths need register() to be called first");
+        return NULL;
+    }
+
+    PyObject *parts = PyObject_CallOneArg(path_compiler, path);
+    if (parts == NULL)
+        return NULL;
+
+    if (Py_EnterRecursiveCall(" while resolving a dotted path"))
+    {
+        Py_DECREF(parts);
+        return NULL;
+    }
+    PyObject *value = path_walk(obj, parts);
+    Py_LeaveRecursiveCall();
+    Py_DECREF(parts);
+    return value;
+}
+
+static PyObject *py_get_path(PyObject *self, PyObject *args)
+{
+    PyObject *obj;
+    PyObject *path;
+    PyObject *default_value = Py_None;
+
+    if (!PyArg_ParseTuple(args, "OO|O:get_path", &obj, &path, &default_value))
+    {
+        return NULL;
+    }
+
+    PyObject *value = PyUnicode_Check(path) ? path_resolve(obj, path) : path_walk(obj, path);
+    if (value == NULL && !PyErr_Occurred())
+    {
+        Py_INCREF(default_value);
+        return default_value;
+    }
+    return value;
+}
+
+/* record[path] with the dotted semantics of MagiDict.__getitem__: a key
+ * equal to the whole path wins, then parts (the compiled path) is walked.
+ * New reference; None when the path is missing. */
+static PyObject *extract_value(PyObject *record, PyObject *path, PyObject *parts)
+{
+    int is_magidict = MagiDict_Check(record);
+    if (PyDict_Check(record) && PyUnicode_Check(path))
+    {
+        PyObject *value = PyDict_GetItemWithError(record, path);
+        if (value != NULL)
+        {
+            if (is_magidict)
+                return lazy_materialize(record, path, value);
+            Py_INCREF(value);
+            return value;
+        }
+        if (PyErr_Occurred())
+            return NULL;
+    }
+
+    PyObject *value = path_walk(record, parts);
+    if (value == NULL)
+    {
+        if (PyErr_Occurred())
+            return NULL;
+        Py_RETURN_NONE;
+    }
+    if (!is_magidict)
+        return value;
+    PyObject *hooked = lazy_materialize(record, NULL, value);
+    Py_DECREF(value);
+    return hooked;
+}
+
+/* array.array, imported the first time extract() builds arrays */
+static PyObject *array_type = NULL;
+
+/* column (stolen) as an array.array of int64 ('q') when every value is an
+ * int, or of double ('d') when every value is a float. Otherwise, and for
+ * empty columns, columns mixing ints and floats (large ints would lose
+ * precision as doubles) or ints that do not fit in 64 bits, column itself. */
+static PyObject *extract_array(PyObject *column)
+{
+    Py_ssize_t size = PyList_GET_SIZE(column);
+    if (size == 0)
+        return column;
+    int ints = PyLong_CheckExact(PyList_GET_ITEM(column, 0));
+    for (Py_ssize_t i = 0; i < size; i++)
+    {
+        PyObject *value = PyList_GET_ITEM(column, i);
+        if (ints ? !PyLong_CheckExact(value) : !PyFloat_CheckExact(value))
+            return column;
+    }
+
+    if (array_type == NULL)
+    {
+        PyObject *module = PyImport_ImportModule("array");
+        if (module == NULL)
+            goto error;
+        array_type = PyObject_GetAttrString(module, "array");
+        Py_DECREF(module);
+        if (array_type == NULL)
+            goto error;
+    }
+
+    PyObject *array = PyObject_CallFunction(array_type, "sO", ints ? "q" : "d", column);
+    if (array == NULL && ints && PyErr_ExceptionMatches(PyExc_OverflowError))
+    {
+        PyErr_Clear();
+        return column;
+    }
+    Py_DECREF(column);
+    return array;
+
+error:
+    Py_DECREF(column);
+    return NULL;
+}
+
+/* extract(records, paths, arrays=False) -> {path: column} */
+static PyObject *py_extract(PyObject *self, PyObject *args)
+{
+    PyObject *records;
+    PyObject *paths;
+    int arrays = 0;
+
+    if (!PyArg_ParseTuple(args, "OO|p:extract", &records, &paths, &arrays))
+    {
+        return NULL;
+    }
+    if (path_compiler == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "dotted paths need register() to be called first");
+        return NULL;
+    }
+    if (PyUnicode_Check(paths))
+    {
+        PyErr_SetString(PyExc_TypeError, "paths must be a list of paths, not a string");
+        return NULL;
+    }
+
+    /* Private copies, so other threads may change the originals meanwhile */
+    PyObject *rows = PySequence_List(records);
+    PyObject *path_list = rows != NULL ? PySequence_List(paths) : NULL;
+    if (path_list == NULL)
+    {
+        Py_XDECREF(rows);
+        return NULL;
+    }
+    Py_ssize_t n = PyList_GET_SIZE(rows);
+    Py_ssize_t m = PyList_GET_SIZE(path_list);
+    PyObject *compiled = PyList_New(m);
+    PyObject *columns = PyList_New(m);
+    PyObject *result = NULL;
+    if (compiled == NULL || columns == NULL)
+        goto done;
+
+    for (Py_ssize_t j = 0; j < m; j++)
+    {
+        PyObject *path = PyList_GET_ITEM(path_list, j);
+        PyObject *parts;
+        if (is_dotted(path))
+            parts = PyObject_CallOneArg(path_compiler, path);
+        else if (PyUnicode_Check(path))
+            parts = PyTuple_Pack(1, path);
+        else if (PyTuple_Check(path))
+        {
+            Py_INCREF(path);
+            parts = path;
+        }
+        else
+        {
+            PyErr_Format(PyExc_TypeError, "paths must be str or tuples of keys, not %.100s", Py_TYPE(path)->tp_name);
+            goto done;
+        }
+        if (parts == NULL)
+            goto done;
+        PyList_SET_ITEM(compiled, j, parts);
+        PyObject *column = PyList_New(n);
+        if (column == NULL)
+            goto done;
+        PyList_SET_ITEM(columns, j, column);
+    }
+
+    for (Py_ssize_t i = 0; i < n; i++)
+    {
+        PyObject *record = PyList_GET_ITEM(rows, i);
+        for (Py_ssize_t j = 0; j < m; j++)
+        {
+            PyObject *value =
+                extract_value(record, PyList_GET_ITEM(path_list, j), PyList_GET_ITEM(compiled, j));
+            if (value == NULL)
+                goto done;
+            PyList_SET_ITEM(PyList_GET_ITEM(columns, j), i, value);
+        }
+    }
+
+    result = PyDict_New();
+    if (result == NULL)
+        goto done;
+    for (Py_ssize_t j = 0; j < m; j++)
+    {
+        PyObject *column = PyList_GET_ITEM(columns, j);
+        Py_INCREF(column);
+        if (arrays && (column = extract_array(column)) == NULL)
+        {
+            Py_CLEAR(result);
+            goto done;
+        }
+        int res = PyDict_SetItem(result, PyList_GET_ITEM(path_list, j), column);
+        Py_DECREF(column);
+        if (res < 0)
+        {
+            Py_CLEAR(result);
+            goto done;
+        }
+    }
+
+done:
+    Py_DECREF(rows);
+    Py_DECREF(path_list);
+    Py_XDECREF(compiled);
+    Py_XDECREF(columns);
+    return result;
+}
+
+static PyObject *magidict_subscript(PyObject *self, PyObject *key)
+{
+    PyObject *value = PyDict_GetItemWithError(self, key);
+    if (value != NULL)
+    {
+        STAT(key_hits);
+        return lazy_materialize(self, key, value);
+    }
+    if (PyErr_Occurred())
+        return NULL;
+
+    if (path_compiler != NULL && is_dotted(key))
+    {
+        STAT(dotted_lookups);
+        value = path_resolve(self, key);
+        if (value == NULL)
+        {
+            if (PyErr_Occurred())
+                return NULL;
+            Py_RETURN_NONE;
+        }
+        /* The end of a path has no parent to store back into */
+        PyObject *hooked = lazy_materialize(self, NULL, value);
+        Py_DECREF(value);
+        return hooked;
+    }
+
+    /* Plain miss: let dict raise KeyError (and honour __missing__) */
+    STAT(key_misses);
+    return PyDict_Type.tp_as_mapping->mp_subscript(self, key);
+}
+
+/* Drops key from the borrowed children of a copy-on-write fork */
+static int magidict_unborrow(PyObject *self, PyObject *key)
+{
+    PyObject *pending = ((MagiDictObject *)self)->cow_pending;
+    if (pending != NULL && PyDict_DelItem(pending, key) < 0)
+    {
+        if (!PyErr_ExceptionMatches(PyExc_KeyError))
+            return -1;
+        PyErr_Clear();
+    }
+    return 0;
+}
+
+static int magidict_ass_subscript(PyObject *self, PyObject *key, PyObject *value)
+{
+    if (magidict_raise_if_protected(self) < 0)
+        return -1;
+    MagiDictObject *md = (MagiDictObject *)self;
+    if (md->watchers != NULL && magidict_notify_watchers(self) < 0)
+        return -1;
+
+    int res;
+    if (value == NULL)
+    {
+        res = PyDict_DelItem(self, key);
+    }
+    else
+    {
+        PyObject *hooked = fast_hook_with_memo(value, NULL, (PyObject *)Py_TYPE(self));
+        if (hooked == NULL)
+            return -1;
+        res = PyDict_SetItem(self, key, hooked);
+        Py_DECREF(hooked);
+    }
+
+    /* The key no longer holds a borrowed child */
+    return res == 0 ? magidict_unborrow(self, key) : res;
+}
+
+/* self[key] = value for a value that is already converted, once the
+ * protection and watchers of self have been dealt with */
+static int magidict_store(PyObject *self, PyObject *key, PyObject *value)
+{
+    if (PyDict_SetItem(self, key, value) < 0)
+        return -1;
+    return magidict_unborrow(self, key);
+}
+
+/* A new dict holding the items of a mapping or an iterable of pairs, and
+ * then of kwargs, taken before any of them is stored; dict.update's rules
+ * apply */
+static PyObject *update_items(PyObject *arg, PyObject *kwargs)
+{
+    PyObject *merged = PyDict_New();
+    if (merged == NULL)
+        return NULL;
+    int res = 0;
+    if (arg != NULL)
+    {
+        if (PyDict_Check(arg) || PyObject_HasAttr(arg, str_keys))
+            res = PyDict_Merge(merged, arg, 1);
+        else
+            res = PyDict_MergeFromSeq2(merged, arg, 1);
+    }
+    if (res == 0 && kwargs != NULL)
+        res = PyDict_Merge(merged, kwargs, 1);
+    if (res < 0)
+        Py_CLEAR(merged);
+    return merged;
+}
+
+/* update(): dict.update that converts the new values as item assignment
+ * does, checking protection and notifying watchers once per call */
+static PyObject *magidict_update(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *arg = NULL;
+    if (!PyArg_UnpackTuple(args, "update", 0, 1, &arg))
+        return NULL;
+    if (magidict_raise_if_protected(self) < 0)
+        return NULL;
+
+    PyObject *items = update_items(arg, kwargs);
+    if (items == NULL)
+        return NULL;
+    if (((MagiDictObject *)self)->watchers != NULL && magidict_notify_watchers(self) < 0)
+    {
+        Py_DECREF(items);
+        return NULL;
+    }
+
+    /* A subclass overriding __setitem__ gets every item through it, as with
+     * self[k] = v; otherwise values are hooked and stored directly */
+    PyObject *cls = (PyObject *)Py_TYPE(self);
+    int direct = Py_TYPE(self)->tp_as_mapping->mp_ass_subscript == magidict_ass_subscript;
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    while (PyDict_Next(items, &pos, &key, &value))
+    {
+        int res;
+        PyObject *hooked = NULL;
+        if (!direct)
+            res = PyObject_SetItem(self, key, value);
+        else if ((hooked = fast_hook_with_memo(value, NULL, cls)) != NULL)
+            res = magidict_store(self, key, hooked);
+        else
+            res = -1;
+        Py_XDECREF(hooked);
+        if (res < 0)
+        {
+            Py_DECREF(items);
+            return NULL;
+        }
+    }
+    Py_DECREF(items);
+    Py_RETURN_NONE;
+}
+
+static PyObject *magidict_mget(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"key", "default", NULL};
+    PyObject *key;
+    PyObject *default_value = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:mget", kwlist, &key, &default_value))
+    {
+        return NULL;
+    }
+
+    PyObject *value = PyDict_GetItemWithError(self, key);
+    if (value != NULL)
+    {
+        if (value == Py_None && default_value != Py_None)
+            return magidict_new_flagged(self, str_from_none);
+        return lazy_materialize(self, key, value);
+    }
+    if (PyErr_Occurred())
+        return NULL;
+
+    if (default_value == NULL)
+        return magidict_new_flagged(self, str_from_missing);
+
+    Py_INCREF(default_value);
+    return default_value;
+}
+
+static PyObject *magidict_py_raise_if_protected(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (magidict_raise_if_protected(self) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* dict.get/values/items, converting values first when self is lazy */
+static PyObject *magidict_get(PyObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    if (nargs < 1 || nargs > 2)
+    {
+        PyErr_Format(PyExc_TypeError, "get expected 1 or 2 arguments, got %zd", nargs);
+        return NULL;
+    }
+
+    PyObject *key = args[0];
+    PyObject *default_value = nargs > 1 ? args[1] : Py_None;
+
+    PyObject *value = PyDict_GetItemWithError(self, key);
+    if (value != NULL)
+        return lazy_materialize(self, key, value);
+    if (PyErr_Occurred())
+        return NULL;
+    Py_INCREF(default_value);
+    return default_value;
+}
+
+static int magidict_materialize_all(PyObject *self)
+{
+    if (((MagiDictObject *)self)->cow_pending == NULL && lazy_memo_of(self) == NULL)
+        return PyErr_Occurred() ? -1 : 0;
+
+    PyObject *keys = PyDict_Keys(self);
+    if (keys == NULL)
+        return -1;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(keys); i++)
+    {
+        PyObject *key = PyList_GET_ITEM(keys, i);
+        PyObject *value = PyDict_GetItemWithError(self, key);
+        if (value == NULL)
+        {
+            if (PyErr_Occurred())
+            {
+                Py_DECREF(keys);
+                return -1;
+            }
+            continue;
+        }
+        PyObject *hooked = lazy_materialize(self, key, value);
+        if (hooked == NULL)
+        {
+            Py_DECREF(keys);
+            return -1;
+        }
+        Py_DECREF(hooked);
+    }
+    Py_DECREF(keys);
+    return 0;
+}
+
+static PyObject *magidict_py_materialize_all(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (magidict_materialize_all(self) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* __reduce_ex__: a plain MagiDict pickles as copyreg.__newobj__(cls) followed
+ * by its items, so unpickling neither runs __init__ nor builds a state dict;
+ * the items are stored with __setitem__, whose hook returns the already
+ * restored child MagiDicts as they are. Plain means the class can be built
+ * without calling it (see hook_fast_type) and the instance dict holds at
+ * most the key index and __dir__ caches. Anything else (subclasses with
+ * their own __new__ or __init__, instance attributes, flagged, lazy and
+ * copy-on-write nodes) calls the class and restores the __getstate__ dict
+ * with __setstate__. */
+static PyObject *magidict_reduce_ex(PyObject *self, PyObject *Py_UNUSED(protocol))
+{
+    PyObject *inst_dict = ((MagiDictObject *)self)->inst_dict;
+    int plain = ((MagiDictObject *)self)->cow_pending == NULL && hook_fast_type((PyObject *)Py_TYPE(self)) != NULL;
+    if (plain && inst_dict != NULL)
+    {
+        PyObject *name, *value;
+        Py_ssize_t pos = 0;
+        while (plain && PyDict_Next(inst_dict, &pos, &name, &value))
+            plain = PyUnicode_Check(name) &&
+                    (PyUnicode_Compare(name, str_key_index) == 0 || PyUnicode_Compare(name, str_dir_keys) == 0);
+    }
+
+    if (!plain)
+    {
+        PyObject *state = PyObject_CallMethod(self, "__getstate__", NULL);
+        if (state == NULL)
+            return NULL;
+        return Py_BuildValue("(O()N)", (PyObject *)Py_TYPE(self), state);
+    }
+
+    PyObject *items = PyObject_CallOneArg(dict_items, self);
+    if (items == NULL)
+        return NULL;
+    PyObject *iter = PyObject_GetIter(items);
+    Py_DECREF(items);
+    if (iter == NULL)
+        return NULL;
+    return Py_BuildValue("(O(O)OON)", copyreg_newobj, (PyObject *)Py_TYPE(self), Py_None, Py_None, iter);
+}
+
+/* __setstate__: a one-tuple of items (as pickled by the pure Python
+ * implementation) is stored as it is; the __getstate__ dict has its flags
+ * restored and its values hooked with one memo */
+static PyObject *magidict_setstate(PyObject *self, PyObject *state)
+{
+    if (PyTuple_Check(state) && PyTuple_GET_SIZE(state) == 1 && PyDict_Check(PyTuple_GET_ITEM(state, 0)))
+    {
+        if (PyDict_Update(self, PyTuple_GET_ITEM(state, 0)) < 0)
+            return NULL;
+        Py_RETURN_NONE;
+    }
+    if (!PyDict_Check(state))
+    {
+        PyErr_Format(PyExc_TypeError, "MagiDict state must be a dict or a 1-tuple, not %.100s",
+                     Py_TYPE(state)->tp_name);
+        return NULL;
+    }
+
+    PyObject *flags[2] = {str_from_none, str_from_missing};
+    for (int i = 0; i < 2; i++)
+    {
+        PyObject *flag = PyDict_GetItemWithError(state, flags[i]);
+        int set = flag != NULL ? PyObject_IsTrue(flag) : (PyErr_Occurred() ? -1 : 0);
+        if (set < 0 || (set && PyObject_GenericSetAttr(self, flags[i], Py_True) < 0))
+            return NULL;
+    }
+
+    PyObject *attrs = PyDict_GetItemString(state, "attrs");
+    if (attrs != NULL)
+    {
+        PyObject *inst_dict = PyObject_GenericGetDict(self, NULL);
+        if (inst_dict == NULL)
+            return NULL;
+        int res = PyDict_Update(inst_dict, attrs);
+        Py_DECREF(inst_dict);
+        if (res < 0)
+            return NULL;
+    }
+
+    PyObject *data = PyDict_GetItemString(state, "data");
+    if (data == NULL)
+        Py_RETURN_NONE;
+    if (!PyDict_Check(data))
+    {
+        PyErr_SetString(PyExc_TypeError, "MagiDict state data must be a dict");
+        return NULL;
+    }
+
+    PyObject *cls = (PyObject *)Py_TYPE(self);
+    PtrMemo memo;
+    memo_init(&memo, NULL, cls);
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (dict_next_ref(data, &pos, &key, &value))
+    {
+        PyObject *hooked = hook_value(value, &memo, cls);
+        Py_DECREF(value);
+        if (hooked == NULL || PyDict_SetItem(self, key, hooked) < 0)
+        {
+            Py_DECREF(key);
+            Py_XDECREF(hooked);
+            memo_free(&memo);
+            return NULL;
+        }
+        Py_DECREF(key);
+        Py_DECREF(hooked);
+    }
+    memo_free(&memo);
+    Py_RETURN_NONE;
+}
+
+static PyObject *magidict_values(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (magidict_materialize_all(self) < 0)
+        return NULL;
+    return PyObject_CallOneArg(dict_values, self);
+}
+
+static PyObject *magidict_items(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (magidict_materialize_all(self) < 0)
+        return NULL;
+    return PyObject_CallOneArg(dict_items, self);
+}
+
+static int magidict_traverse(PyObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(((MagiDictObject *)self)->inst_dict);
+    Py_VISIT(((MagiDictObject *)self)->watchers);
+    Py_VISIT(((MagiDictObject *)self)->cow_pending);
+    Py_VISIT(((MagiDictObject *)self)->cow_group);
+    return PyDict_Type.tp_traverse(self, visit, arg);
+}
+
+static int magidict_tp_clear(PyObject *self)
+{
+    Py_CLEAR(((MagiDictObject *)self)->inst_dict);
+    Py_CLEAR(((MagiDictObject *)self)->watchers);
+    Py_CLEAR(((MagiDictObject *)self)->cow_pending);
+    Py_CLEAR(((MagiDictObject *)self)->cow_group);
+    return PyDict_Type.tp_clear(self);
+}
+
+static void magidict_dealloc(PyObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    Py_CLEAR(((MagiDictObject *)self)->inst_dict);
+    Py_CLEAR(((MagiDictObject *)self)->watchers);
+    Py_CLEAR(((MagiDictObject *)self)->cow_pending);
+    Py_CLEAR(((MagiDictObject *)self)->cow_group);
+    PyDict_Type.tp_dealloc(self);
+}
+
+static PyMappingMethods magidict_as_mapping = {
+    .mp_subscript = magidict_subscript,
+    .mp_ass_subscript = magidict_ass_subscript,
+};
+
+/* self |= other: goes through update(), so the values are converted and
+ * protection, watchers and copy-on-write forks are dealt with as there */
+static PyObject *magidict_inplace_or(PyObject *self, PyObject *other)
+{
+    PyObject *res = PyObject_CallMethodOneArg(self, str_update, other);
+    if (res == NULL)
+        return NULL;
+    Py_DECREF(res);
+    Py_INCREF(self);
+    return self;
+}
+
+static PyNumberMethods magidict_as_number = {
+    .nb_inplace_or = magidict_inplace_or,
+};
+
+static PyMethodDef magidict_methods[] = {
+    {"mget", (PyCFunction)(void (*)(void))magidict_mget, METH_VARARGS | METH_KEYWORDS,
+     "Safe get: returns an empty MagiDict for missing keys or None values"},
+    {"mg", (PyCFunction)(void (*)(void))magidict_mget, METH_VARARGS | METH_KEYWORDS,
+     "Shorthand for mget()"},
+    {"_raise_if_protected", magidict_py_raise_if_protected, METH_NOARGS,
+     "Raise TypeError if created from a None or missing key"},
+    {"get", (PyCFunction)(void (*)(void))magidict_get, METH_FASTCALL,
+     "D.get(k[,d]) -> D[k] if k in D, else d. d defaults to None."},
+    {"update", (PyCFunction)(void (*)(void))magidict_update, METH_VARARGS | METH_KEYWORDS,
+     "Recursively convert nested dicts into MagiDicts on update."},
+    {"_materialize_all", magidict_py_materialize_all, METH_NOARGS,
+     "Convert every value still pending in a lazy MagiDict or copy-on-write fork"},
+    {"__reduce_ex__", magidict_reduce_ex, METH_O,
+     "Pickle support: restored without __init__ or a state dict"},
+    {"__setstate__", magidict_setstate, METH_O,
+     "Restore a pickled MagiDict from its items or its __getstate__ dict"},
+    {"values", magidict_values, METH_NOARGS,
+     "D.values() -> an object providing a view on D's values"},
+    {"items", magidict_items, METH_NOARGS,
+     "D.items() -> a set-like object providing a view on D's items"},
+    {NULL, NULL, 0, NULL}};
+
+static PyGetSetDef magidict_getset[] = {
+    {"__dict__", PyObject_GenericGetDict, PyObject_GenericSetDict, NULL, NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyTypeObject MagiDictBase_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "magidict._magidict.MagiDictBase",
+    .tp_doc = "C base of MagiDict implementing attribute and item access",
+    .tp_basicsize = sizeof(MagiDictObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = magidict_dealloc,
+    .tp_traverse = magidict_traverse,
+    .tp_clear = magidict_tp_clear,
+    .tp_getattro = magidict_getattro,
+    .tp_as_number = &magidict_as_number,
+    .tp_as_mapping = &magidict_as_mapping,
+    .tp_methods = magidict_methods,
+    .tp_getset = magidict_getset,
+    .tp_dictoffset = offsetof(MagiDictObject, inst_dict),
+};
+
+/* MagiViewBase: read-only MagiDict API over an existing mapping. Nothing is
+ * copied or converted; nested mappings are wrapped in new views and lists in
+ * MagiViewList (registered from core.py) only when they are returned. */
+typedef struct
+{
+    PyObject_HEAD
+    PyObject *data;
+} MagiViewObject;
+
+static PyTypeObject MagiViewBase_Type;
+
+#define MagiView_Check(op) PyObject_TypeCheck(op, &MagiViewBase_Type)
+
+/* Set once by core.py through register_view() */
+static PyObject *view_class = NULL;
+static PyObject *view_list_class = NULL;
+/* Optional lazy sequence type that is wrapped like a list */
+static PyObject *view_lazy_list_class = NULL;
+/* Optional lazy mapping type the JSON encoder writes like a dict */
+static PyObject *view_lazy_mapping_class = NULL;
+
+static PyObject *view_new_from(PyTypeObject *type, PyObject *data)
+{
+    MagiViewObject *view = (MagiViewObject *)type->tp_alloc(type, 0);
+    if (view == NULL)
+        return NULL;
+    Py_INCREF(data);
+    view->data = data;
+    return (PyObject *)view;
+}
+
+static int view_is_mapping(PyObject *value)
+{
+    if (PyDict_Check(value))
+        return 1;
+    if (abc_mapping == NULL || PyUnicode_Check(value) || PyList_Check(value) || PyTuple_Check(value))
+        return 0;
+    return PyObject_IsInstance(value, abc_mapping);
+}
+
+/* Wrap a value on its way out of a view. Takes ownership of value. */
+static PyObject *view_wrap(PyObject *value)
+{
+    if (MagiDict_Check(value) || MagiView_Check(value))
+        return value;
+
+    if (PyList_Check(value) || PyTuple_CheckExact(value) ||
+        (view_lazy_list_class != NULL && (PyObject *)Py_TYPE(value) == view_lazy_list_class))
+    {
+        if (view_list_class == NULL)
+            return value;
+        PyObject *wrapped = PyObject_CallOneArg(view_list_class, value);
+        Py_DECREF(value);
+        return wrapped;
+    }
+
+    int is_mapping = view_is_mapping(value);
+    if (is_mapping <= 0)
+    {
+        if (is_mapping < 0)
+            Py_CLEAR(value);
+        return value;
+    }
+
+    PyTypeObject *type = view_class != NULL ? (PyTypeObject *)view_class : &MagiViewBase_Type;
+    PyObject *wrapped = view_new_from(type, value);
+    Py_DECREF(value);
+    return wrapped;
+}
+
+/* New reference to data[key], or NULL without an exception on a miss */
+static PyObject *view_lookup(PyObject *data, PyObject *key)
+{
+    if (PyDict_CheckExact(data))
+    {
+        PyObject *value = PyDict_GetItemWithError(data, key);
+        Py_XINCREF(value);
+        return value;
+    }
+    return path_getitem(data, key, PyExc_KeyError);
+}
+
+static PyObject *view_sentinel(PyObject *sentinel, PyObject *name)
+{
+    if (sentinel == NULL)
+    {
+        PyErr_SetObject(PyExc_AttributeError, name);
+        return NULL;
+    }
+    Py_INCREF(sentinel);
+    return sentinel;
+}
+
+/* Whether name (a str) is a __dunder__ name */
+static int is_dunder(PyObject *name)
+{
+    Py_ssize_t len = PyUnicode_GET_LENGTH(name);
+    return len > 4 && PyUnicode_READ_CHAR(name, 0) == '_' && PyUnicode_READ_CHAR(name, 1) == '_' &&
+           PyUnicode_READ_CHAR(name, len - 1) == '_' && PyUnicode_READ_CHAR(name, len - 2) == '_';
+}
+
+static PyObject *view_getattro(PyObject *self, PyObject *name)
+{
+    if (!PyUnicode_Check(name))
+        return PyObject_GenericGetAttr(self, name);
+
+    PyObject *descr = _PyType_Lookup(Py_TYPE(self), name);
+    if (descr != NULL)
+    {
+        PyObject *res = PyObject_GenericGetAttr(self, name);
+        if (res != NULL || !PyErr_ExceptionMatches(PyExc_AttributeError))
+            return res;
+        PyErr_Clear();
+    }
+
+    if (PyUnicode_CompareWithASCIIString(name, "_from_none") == 0 ||
+        PyUnicode_CompareWithASCIIString(name, "_from_missing") == 0)
+    {
+        Py_RETURN_FALSE;
+    }
+
+    PyObject *value = view_lookup(((MagiViewObject *)self)->data, name);
+    if (value == NULL)
+    {
+        if (PyErr_Occurred())
+            return NULL;
+        /* Protocol lookups (__deepcopy__, __reduce_ex__, ...) must not get a sentinel */
+        if (is_dunder(name))
+        {
+            PyErr_Format(PyExc_AttributeError, "'%.100s' object has no attribute '%U'",
+                         Py_TYPE(self)->tp_name, name);
+            return NULL;
+        }
+        return view_sentinel(missing_sentinel, name);
+    }
+    if (value == Py_None)
+    {
+        Py_DECREF(value);
+        return view_sentinel(none_sentinel, name);
+    }
+    return view_wrap(value);
+}
+
+static PyObject *view_subscript(PyObject *self, PyObject *key)
+{
+    PyObject *data = ((MagiViewObject *)self)->data;
+    PyObject *value = view_lookup(data, key);
+    if (value != NULL)
+        return view_wrap(value);
+    if (PyErr_Occurred())
+        return NULL;
+
+    if (path_compiler != NULL && is_dotted(key))
+    {
+        value = path_resolve(data, key);
+        if (value == NULL)
+        {
+            if (PyErr_Occurred())
+                return NULL;
+            Py_RETURN_NONE;
+        }
+        return view_wrap(value);
+    }
+
+    PyObject *args = PyTuple_Pack(1, key);
+    if (args != NULL)
+    {
+        PyErr_SetObject(PyExc_KeyError, args);
+        Py_DECREF(args);
+    }
+    return NULL;
+}
+
+static Py_ssize_t view_length(PyObject *self)
+{
+    return PyObject_Size(((MagiViewObject *)self)->data);
+}
+
+static int view_contains(PyObject *self, PyObject *key)
+{
+    PyObject *data = ((MagiViewObject *)self)->data;
+    if (PyDict_Check(data))
+        return PyDict_Contains(data, key);
+    return PySequence_Contains(data, key);
+}
+
+static PyObject *view_iter(PyObject *self)
+{
+    return PyObject_GetIter(((MagiViewObject *)self)->data);
+}
+
+static PyObject *view_richcompare(PyObject *self, PyObject *other, int op)
+{
+    if (MagiView_Check(other))
+        other = ((MagiViewObject *)other)->data;
+    return PyObject_RichCompare(((MagiViewObject *)self)->data, other, op);
+}
+
+static PyObject *view_repr(PyObject *self)
+{
+    return PyUnicode_FromFormat("%s(%R)", Py_TYPE(self)->tp_name, ((MagiViewObject *)self)->data);
+}
+
+static PyObject *view_mget(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"key", "default", NULL};
+    PyObject *key;
+    PyObject *default_value = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:mget", kwlist, &key, &default_value))
+    {
+        return NULL;
+    }
+
+    PyObject *value = view_lookup(((MagiViewObject *)self)->data, key);
+    if (value != NULL)
+    {
+        if (value == Py_None && default_value != Py_None)
+        {
+            Py_DECREF(value);
+            return view_sentinel(none_sentinel, key);
+        }
+        return view_wrap(value);
+    }
+    if (PyErr_Occurred())
+        return NULL;
+
+    if (default_value == NULL)
+        return view_sentinel(missing_sentinel, key);
+
+    Py_INCREF(default_value);
+    return default_value;
+}
+
+static PyObject *view_get(PyObject *self, PyObject *args)
+{
+    PyObject *key;
+    PyObject *default_value = Py_None;
+
+    if (!PyArg_ParseTuple(args, "O|O:get", &key, &default_value))
+    {
+        return NULL;
+    }
+
+    PyObject *value = view_lookup(((MagiViewObject *)self)->data, key);
+    if (value != NULL)
+        return view_wrap(value);
+    if (PyErr_Occurred())
+        return NULL;
+    Py_INCREF(default_value);
+    return default_value;
+}
+
+static PyObject *view_keys(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return PyObject_CallMethod(((MagiViewObject *)self)->data, "keys", NULL);
+}
+
+/* values() and items() return lists since every value has to be wrapped */
+static PyObject *view_collect(PyObject *self, int with_keys)
+{
+    PyObject *data = ((MagiViewObject *)self)->data;
+    PyObject *items = PyMapping_Items(data);
+    if (items == NULL)
+        return NULL;
+
+    Py_ssize_t size = PyList_GET_SIZE(items);
+    PyObject *result = PyList_New(size);
+    if (result == NULL)
+    {
+        Py_DECREF(items);
+        return NULL;
+    }
+
+    for (Py_ssize_t i = 0; i < size; i++)
+    {
+        PyObject *pair = PyList_GET_ITEM(items, i);
+        if (!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2)
+        {
+            PyErr_SetString(PyExc_TypeError, "items() must return (key, value) pairs");
+            goto error;
+        }
+        PyObject *value = PyTuple_GET_ITEM(pair, 1);
+        Py_INCREF(value);
+        value = view_wrap(value);
+        if (value == NULL)
+            goto error;
+
+        if (with_keys)
+        {
+            PyObject *entry = PyTuple_Pack(2, PyTuple_GET_ITEM(pair, 0), value);
+            Py_DECREF(value);
+            if (entry == NULL)
+                goto error;
+            value = entry;
+        }
+        PyList_SET_ITEM(result, i, value);
+    }
+
+    Py_DECREF(items);
+    return result;
+
+error:
+    Py_DECREF(items);
+    Py_DECREF(result);
+    return NULL;
+}
+
+static PyObject *view_values(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return view_collect(self, 0);
+}
+
+static PyObject *view_items(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return view_collect(self, 1);
+}
+
+static PyObject *view_unwrap(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *data = ((MagiViewObject *)self)->data;
+    Py_INCREF(data);
+    return data;
+}
+
+static PyObject *view_tp_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"data", NULL};
+    PyObject *data;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:MagiView", kwlist, &data))
+    {
+        return NULL;
+    }
+
+    if (MagiView_Check(data))
+        data = ((MagiViewObject *)data)->data;
+
+    int is_mapping = view_is_mapping(data);
+    if (is_mapping < 0)
+        return NULL;
+    if (!is_mapping)
+    {
+        PyErr_Format(PyExc_TypeError, "MagiView expects a mapping, got %.100s", Py_TYPE(data)->tp_name);
+        return NULL;
+    }
+    return view_new_from(type, data);
+}
+
+static int view_traverse(PyObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(((MagiViewObject *)self)->data);
+    return 0;
+}
+
+static int view_tp_clear(PyObject *self)
+{
+    Py_CLEAR(((MagiViewObject *)self)->data);
+    return 0;
+}
+
+static void view_dealloc(PyObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    view_tp_clear(self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyMappingMethods view_as_mapping = {
+    .mp_length = view_length,
+    .mp_subscript = view_subscript,
+};
+
+static PySequenceMethods view_as_sequence = {
+    .sq_contains = view_contains,
+};
+
+static PyMethodDef view_methods[] = {
+    {"mget", (PyCFunction)(void (*)(void))view_mget, METH_VARARGS | METH_KEYWORDS,
+     "Safe get: returns an empty MagiDict for missing keys or None values"},
+    {"mg", (PyCFunction)(void (*)(void))view_mget, METH_VARARGS | METH_KEYWORDS,
+     "Shorthand for mget()"},
+    {"get", view_get, METH_VARARGS,
+     "V.get(k[,d]) -> V[k] if k in V, else d. d defaults to None."},
+    {"keys", view_keys, METH_NOARGS,
+     "Keys of the underlying mapping"},
+    {"values", view_values, METH_NOARGS,
+     "List of the (wrapped) values"},
+    {"items", view_items, METH_NOARGS,
+     "List of (key, wrapped value) pairs"},
+    {"unwrap", view_unwrap, METH_NOARGS,
+     "Return the underlying mapping"},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject MagiViewBase_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "magidict._magidict.MagiViewBase",
+    .tp_doc = "C base of MagiView: read-only MagiDict access over an existing mapping",
+    .tp_basicsize = sizeof(MagiViewObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    .tp_new = view_tp_new,
+    .tp_dealloc = view_dealloc,
+    .tp_traverse = view_traverse,
+    .tp_clear = view_tp_clear,
+    .tp_getattro = view_getattro,
+    .tp_setattro = PyObject_GenericSetAttr,
+    .tp_as_mapping = &view_as_mapping,
+    .tp_as_sequence = &view_as_sequence,
+    .tp_iter = view_iter,
+    .tp_richcompare = view_richcompare,
+    .tp_hash = PyObject_HashNotImplemented,
+    .tp_repr = view_repr,
+    .tp_methods = view_methods,
+};
+
+static PyObject *py_register_view(PyObject *self, PyObject *args)
+{
+    PyObject *cls;
+    PyObject *list_cls;
+    PyObject *lazy_list_cls = NULL;
+    PyObject *lazy_mapping_cls = NULL;
+
+    if (!PyArg_ParseTuple(args, "OO|OO", &cls, &list_cls, &lazy_list_cls, &lazy_mapping_cls))
+    {
+        return NULL;
+    }
+
+    if (!PyType_Check(cls) || !PyType_IsSubtype((PyTypeObject *)cls, &MagiViewBase_Type))
+    {
+        PyErr_SetString(PyExc_TypeError, "view_class must be a subclass of MagiViewBase");
+        return NULL;
+    }
+
+    REGISTER_LOCK();
+    int res = register_swap(&view_class, cls) < 0 || register_swap(&view_list_class, list_cls) < 0 ||
+              register_swap(&view_lazy_list_class, lazy_list_cls) < 0 ||
+              register_swap(&view_lazy_mapping_class, lazy_mapping_cls) < 0;
+    REGISTER_UNLOCK();
+    if (res)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* fast_unhook: iterative counterpart of MagiDict.disenchant. Containers are
+ * processed on an explicit stack of frames so deep trees cannot overflow the
+ * C stack. The conversion rules follow the Python implementation exactly:
+ * MagiDicts become plain dicts (keys kept as they are), other dicts have
+ * their keys and values converted, tuples and named tuples are rebuilt,
+ * other sequences become lists (or their own type when it accepts a list)
+ * and sets are rebuilt with the same type. */
+enum
+{
+    UNHOOK_MAGIDICT,
+    UNHOOK_DICT,
+    UNHOOK_LIST,
+    UNHOOK_TUPLE,
+    UNHOOK_SET
+};
+
+/* Dict frame phases */
+enum
+{
+    UNHOOK_NEXT_ENTRY,
+    UNHOOK_WANT_VALUE,
+    UNHOOK_GOT_VALUE_PENDING,
+    UNHOOK_WANT_KEY,
+    UNHOOK_GOT_KEY
+};
+
+typedef struct
+{
+    int kind;
+    int phase;
+    PyObject *src;
+    PyObject *result;
+    PyObject *items;
+    Py_ssize_t pos;
+    PyObject *cur_key;
+    PyObject *cur_value;
+    PyObject *new_key;
+} UnhookFrame;
+
+typedef struct
+{
+    UnhookFrame *frames;
+    Py_ssize_t len;
+    Py_ssize_t cap;
+    PtrMemo memo;
+} UnhookState;
+
+static void unhook_frame_clear(UnhookFrame *frame)
+{
+    Py_CLEAR(frame->src);
+    Py_CLEAR(frame->result);
+    Py_CLEAR(frame->items);
+    Py_CLEAR(frame->cur_key);
+    Py_CLEAR(frame->cur_value);
+    Py_CLEAR(frame->new_key);
+}
+
+static UnhookFrame *unhook_push(UnhookState *state, int kind, PyObject *src, PyObject *result, PyObject *items)
+{
+    if (state->len == state->cap)
+    {
+        Py_ssize_t cap = state->cap ? state->cap * 2 : 16;
+        UnhookFrame *frames = PyMem_Realloc(state->frames, cap * sizeof(UnhookFrame));
+        if (frames == NULL)
+        {
+            Py_DECREF(result);
+            Py_XDECREF(items);
+            PyErr_NoMemory();
+            return NULL;
+        }
+        state->frames = frames;
+        state->cap = cap;
+    }
+
+    UnhookFrame *frame = &state->frames[state->len++];
+    memset(frame, 0, sizeof(UnhookFrame));
+    frame->kind = kind;
+    Py_INCREF(src);
+    frame->src = src;
+    frame->result = result;
+    frame->items = items;
+    return frame;
+}
+
+/* Start converting item. Returns a new reference for values that are done
+ * right away (leaves and memo hits), or NULL with *pushed set when a frame
+ * was pushed. NULL without *pushed means an error. */
+static PyObject *unhook_begin(UnhookState *state, PyObject *item, int *pushed)
+{
+    *pushed = 0;
+
+    int kind;
+    if (MagiDict_Check(item))
+        kind = UNHOOK_MAGIDICT;
+    else if (PyDict_Check(item))
+        kind = UNHOOK_DICT;
+    else if (PyTuple_Check(item))
+        kind = UNHOOK_TUPLE;
+    else if (PyList_Check(item))
+        kind = UNHOOK_LIST;
+    else if (PyAnySet_Check(item))
+        kind = UNHOOK_SET;
+    else if (PyUnicode_Check(item) || PyBytes_Check(item) || PyLong_Check(item) ||
+             PyFloat_Check(item) || item == Py_None || abc_sequence == NULL)
+        kind = -1;
+    else
+    {
+        int is_sequence = PyObject_IsInstance(item, abc_sequence);
+        if (is_sequence < 0)
+            return NULL;
+        kind = is_sequence ? UNHOOK_LIST : -1;
+    }
+
+    if (kind < 0)
+    {
+        Py_INCREF(item);
+        return item;
+    }
+
+    if (kind != UNHOOK_TUPLE)
+    {
+        PyObject *cached = memo_get(&state->memo, item);
+        if (cached != NULL)
+        {
+            Py_INCREF(cached);
+            return cached;
+        }
+    }
+
+    PyObject *result;
+    PyObject *items = NULL;
+    switch (kind)
+    {
+    case UNHOOK_MAGIDICT:
+        result = PyDict_New();
+        break;
+    case UNHOOK_DICT:
+        result = PyDict_New();
+        if (result != NULL && !PyDict_CheckExact(item))
+        {
+            items = PyMapping_Items(item);
+            if (items == NULL)
+                Py_CLEAR(result);
+        }
+        break;
+    case UNHOOK_LIST:
+        result = PyList_New(0);
+        if (result != NULL && !PyList_CheckExact(item))
+        {
+            items = PySequence_List(item);
+            if (items == NULL)
+                Py_CLEAR(result);
+        }
+        break;
+    case UNHOOK_TUPLE:
+        result = PyList_New(0);
+        break;
+    default:
+        result = PyList_New(0);
+        if (result != NULL)
+        {
+            items = PySequence_List(item);
+            if (items == NULL)
+                Py_CLEAR(result);
+        }
+        break;
+    }
+    if (result == NULL)
+        return NULL;
+
+    /* dicts and lists are recorded before their children so cycles resolve */
+    if ((kind == UNHOOK_MAGIDICT || kind == UNHOOK_DICT || kind == UNHOOK_LIST) &&
+        memo_put(&state->memo, item, result) < 0)
+    {
+        Py_DECREF(result);
+        Py_XDECREF(items);
+        return NULL;
+    }
+
+    if (unhook_push(state, kind, item, result, items) == NULL)
+        return NULL;
+    *pushed = 1;
+    return NULL;
+}
+
+/* Next child of frame to convert (new reference), or NULL when the frame is
+ * complete (check PyErr_Occurred) */
+static PyObject *unhook_next_child(UnhookFrame *frame)
+{
+    if (frame->kind == UNHOOK_MAGIDICT || frame->kind == UNHOOK_DICT)
+    {
+        if (frame->phase == UNHOOK_GOT_KEY)
+        {
+            frame->phase = UNHOOK_WANT_VALUE;
+            Py_INCREF(frame->cur_value);
+            return frame->cur_value;
+        }
+
+        PyObject *key, *value;
+        if (frame->items != NULL)
+        {
+            if (frame->pos >= PyList_GET_SIZE(frame->items))
+                return NULL;
+            PyObject *pair = PyList_GET_ITEM(frame->items, frame->pos++);
+            if (!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2)
+            {
+                PyErr_SetString(PyExc_TypeError, "items() must return (key, value) pairs");
+                return NULL;
+            }
+            key = PyTuple_GET_ITEM(pair, 0);
+            value = PyTuple_GET_ITEM(pair, 1);
+        }
+        else if (!PyDict_Next(frame->src, &frame->pos, &key, &value))
+        {
+            return NULL;
+        }
+
+        Py_INCREF(key);
+        Py_XSETREF(frame->cur_key, key);
+        Py_INCREF(value);
+        Py_XSETREF(frame->cur_value, value);
+
+        if (frame->kind == UNHOOK_MAGIDICT)
+        {
+            Py_INCREF(key);
+            Py_XSETREF(frame->new_key, key);
+            frame->phase = UNHOOK_WANT_VALUE;
+            Py_INCREF(value);
+            return value;
+        }
+        frame->phase = UNHOOK_WANT_KEY;
+        Py_INCREF(key);
+        return key;
+    }
+
+    PyObject *seq = frame->items != NULL ? frame->items : frame->src;
+    if (PyTuple_Check(seq))
+    {
+        if (frame->pos >= PyTuple_GET_SIZE(seq))
+            return NULL;
+        PyObject *child = PyTuple_GET_ITEM(seq, frame->pos++);
+        Py_INCREF(child);
+        return child;
+    }
+    if (frame->pos >= PyList_GET_SIZE(seq))
+        return NULL;
+    PyObject *child = PyList_GET_ITEM(seq, frame->pos++);
+    Py_INCREF(child);
+    return child;
+}
+
+/* Store a converted child into frame. Steals value. */
+static int unhook_deliver(UnhookFrame *frame, PyObject *value)
+{
+    int res;
+    if (frame->kind == UNHOOK_MAGIDICT || frame->kind == UNHOOK_DICT)
+    {
+        if (frame->phase == UNHOOK_WANT_KEY)
+        {
+            Py_XSETREF(frame->new_key, value);
+            frame->phase = UNHOOK_GOT_KEY;
+            return 0;
+        }
+        res = PyDict_SetItem(frame->result, frame->new_key, value);
+        Py_DECREF(value);
+        Py_CLEAR(frame->new_key);
+        frame->phase = UNHOOK_NEXT_ENTRY;
+        return res;
+    }
+
+    res = PyList_Append(frame->result, value);
+    Py_DECREF(value);
+    return res;
+}
+
+/* Build the final object of a completed frame (new reference) */
+static PyObject *unhook_finish(UnhookState *state, UnhookFrame *frame)
+{
+    PyObject *src = frame->src;
+    PyObject *result = frame->result;
+
+    switch (frame->kind)
+    {
+    case UNHOOK_LIST:
+        if (PyList_Check(src))
+            break;
+        {
+            PyObject *rebuilt = PyObject_CallOneArg((PyObject *)Py_TYPE(src), result);
+            if (rebuilt != NULL)
+                return rebuilt;
+            if (!PyErr_ExceptionMatches(PyExc_TypeError))
+                return NULL;
+            PyErr_Clear();
+        }
+        break;
+    case UNHOOK_TUPLE:
+    {
+        PyObject *values = PyList_AsTuple(result);
+        if (values == NULL || PyTuple_CheckExact(src))
+            return values;
+        PyObject *fields = PyObject_GetAttrString(src, "_fields");
+        if (fields == NULL)
+        {
+            PyErr_Clear();
+            return values;
+        }
+        Py_DECREF(fields);
+        PyObject *rebuilt = PyObject_CallObject((PyObject *)Py_TYPE(src), values);
+        Py_DECREF(values);
+        return rebuilt;
+    }
+    case UNHOOK_SET:
+    {
+        PyObject *rebuilt;
+        if (Py_IS_TYPE(src, &PySet_Type))
+            rebuilt = PySet_New(result);
+        else if (PyFrozenSet_CheckExact(src))
+            rebuilt = PyFrozenSet_New(result);
+        else
+            rebuilt = PyObject_CallOneArg((PyObject *)Py_TYPE(src), result);
+        if (rebuilt != NULL && memo_put(&state->memo, src, rebuilt) < 0)
+            Py_CLEAR(rebuilt);
+        return rebuilt;
+    }
+    default:
+        break;
+    }
+
+    Py_INCREF(result);
+    return result;
+}
+
+static PyObject *fast_unhook(PyObject *self, PyObject *args)
+{
+    PyObject *item;
+
+    if (!PyArg_ParseTuple(args, "O", &item))
+    {
+        return NULL;
+    }
+
+    UnhookState state;
+    state.frames = NULL;
+    state.len = state.cap = 0;
+    memo_init(&state.memo, NULL, NULL);
+
+    int pushed;
+    PyObject *value = unhook_begin(&state, item, &pushed);
+
+    while (pushed || (value != NULL && state.len > 0))
+    {
+        pushed = 0;
+        UnhookFrame *top = &state.frames[state.len - 1];
+
+        if (value != NULL)
+        {
+            int res = unhook_deliver(top, value);
+            value = NULL;
+            if (res < 0)
+                break;
+        }
+
+        PyObject *child = unhook_next_child(top);
+        if (child == NULL)
+        {
+            if (PyErr_Occurred())
+                break;
+            value = unhook_finish(&state, top);
+            unhook_frame_clear(top);
+            state.len--;
+            if (value == NULL)
+                break;
+            continue;
+        }
+
+        value = unhook_begin(&state, child, &pushed);
+        Py_DECREF(child);
+        if (value == NULL && !pushed)
+            break;
+    }
+
+    for (Py_ssize_t i = 0; i < state.len; i++)
+        unhook_frame_clear(&state.frames[i]);
+    PyMem_Free(state.frames);
+    memo_free(&state.memo);
+
+    if (PyErr_Occurred())
+    {
+        Py_XDECREF(value);
+        return NULL;
+    }
+    return value;
+}
+
+/* search_key / search_keys over a tree of mappings and sequences, reading
+ * nested values in place with an explicit stack. Mirrors
+ * core._py_search_key_in/_py_search_keys_in: matches are found in pre-order;
+ * search_key only descends into mappings directly inside a sequence, and a
+ * None found below the top level is a miss for the rest of its mapping.
+ * Containers already on the stack are skipped so cycles terminate. */
+enum
+{
+    SEARCH_NONE,
+    SEARCH_MAPPING,
+    SEARCH_SEQUENCE
+};
+
+typedef struct
+{
+    PyObject *container;
+    PyObject *items; /* items list or fast sequence; NULL to walk a dict in place */
+    Py_ssize_t pos;
+    int is_mapping;
+} SearchFrame;
+
+typedef struct
+{
+    SearchFrame *frames;
+    Py_ssize_t len;
+    Py_ssize_t cap;
+} SearchStack;
+
+static int search_kind(PyObject *value)
+{
+    if (PyDict_Check(value))
+        return SEARCH_MAPPING;
+    if (PyList_Check(value) || PyTuple_Check(value))
+        return SEARCH_SEQUENCE;
+    if (PyUnicode_Check(value) || PyLong_Check(value) || PyFloat_Check(value) || value == Py_None ||
+        PyBytes_Check(value) || abc_mapping == NULL)
+        return SEARCH_NONE;
+
+    int r = PyObject_IsInstance(value, abc_mapping);
+    if (r != 0)
+        return r < 0 ? -1 : SEARCH_MAPPING;
+    r = PyObject_IsInstance(value, abc_sequence);
+    if (r != 0)
+        return r < 0 ? -1 : SEARCH_SEQUENCE;
+    return SEARCH_NONE;
+}
+
+static void search_pop(SearchStack *stack)
+{
+    SearchFrame *frame = &stack->frames[--stack->len];
+    Py_DECREF(frame->container);
+    Py_XDECREF(frame->items);
+}
+
+/* Push container unless it is already being searched; 1 if pushed */
+static int search_push(SearchStack *stack, PyObject *container, int is_mapping)
+{
+    for (Py_ssize_t i = 0; i < stack->len; i++)
+    {
+        if (stack->frames[i].container == container)
+            return 0;
+    }
+
+    PyObject *items = NULL;
+    if (is_mapping)
+    {
+        if (MagiDict_Check(container) && magidict_materialize_all(container) < 0)
+            return -1;
+        if (!PyDict_CheckExact(container) && !MagiDict_Check(container))
+        {
+            items = PyMapping_Items(container);
+            if (items == NULL)
+                return -1;
+        }
+    }
+    else
+    {
+        items = PySequence_Fast(container, "expected a sequence");
+        if (items == NULL)
+            return -1;
+    }
+
+    if (stack->len == stack->cap)
+    {
+        Py_ssize_t new_cap = stack->cap ? stack->cap * 2 : 16;
+        SearchFrame *frames = PyMem_Realloc(stack->frames, new_cap * sizeof(SearchFrame));
+        if (frames == NULL)
+        {
+            Py_XDECREF(items);
+            PyErr_NoMemory();
+            return -1;
+        }
+        stack->frames = frames;
+        stack->cap = new_cap;
+    }
+
+    SearchFrame *frame = &stack->frames[stack->len++];
+    Py_INCREF(container);
+    frame->container = container;
+    frame->items = items;
+    frame->pos = 0;
+    frame->is_mapping = is_mapping;
+    return 1;
+}
+
+/* With results, append every match and return a new reference to it;
+ * otherwise return the first match (search_key rules) or default. */
+static PyObject *search_tree(PyObject *root, PyObject *key, PyObject *results, PyObject *default_value)
+{
+    SearchStack stack = {NULL, 0, 0};
+    PyObject *found = NULL;
+
+    if (search_push(&stack, root, 1) < 0)
+        goto error;
+
+    while (stack.len > 0)
+    {
+        SearchFrame *frame = &stack.frames[stack.len - 1];
+        int in_mapping = frame->is_mapping;
+        PyObject *value;
+
+        if (in_mapping)
+        {
+            PyObject *k;
+            if (frame->items == NULL)
+            {
+                if (!PyDict_Next(frame->container, &frame->pos, &k, &value))
+                {
+                    search_pop(&stack);
+                    continue;
+                }
+            }
+            else
+            {
+                if (frame->pos >= PyList_GET_SIZE(frame->items))
+                {
+                    search_pop(&stack);
+                    continue;
+                }
+                PyObject *item = PyList_GET_ITEM(frame->items, frame->pos++);
+                if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2)
+                {
+                    PyErr_SetString(PyExc_ValueError, "items must return 2-tuples");
+                    goto error;
+                }
+                k = PyTuple_GET_ITEM(item, 0);
+                value = PyTuple_GET_ITEM(item, 1);
+            }
+
+            Py_INCREF(k);
+            Py_INCREF(value);
+            int eq = PyObject_RichCompareBool(k, key, Py_EQ);
+            Py_DECREF(k);
+            if (eq < 0)
+            {
+                Py_DECREF(value);
+                goto error;
+            }
+            if (eq)
+            {
+                if (results == NULL)
+                {
+                    if (stack.len == 1 || value != Py_None)
+                    {
+                        found = value;
+                        break;
+                    }
+                    Py_DECREF(value);
+                    search_pop(&stack);
+                    continue;
+                }
+                if (PyList_Append(results, value) < 0)
+                {
+                    Py_DECREF(value);
+                    goto error;
+                }
+            }
+        }
+        else
+        {
+            if (frame->pos >= PySequence_Fast_GET_SIZE(frame->items))
+            {
+                search_pop(&stack);
+                continue;
+            }
+            value = PySequence_Fast_GET_ITEM(frame->items, frame->pos++);
+            Py_INCREF(value);
+        }
+
+        int kind = search_kind(value);
+        if (kind == SEARCH_SEQUENCE && results == NULL && !in_mapping)
+            kind = SEARCH_NONE;
+        if (kind < 0 || (kind != SEARCH_NONE && search_push(&stack, value, kind == SEARCH_MAPPING) < 0))
+        {
+            Py_DECREF(value);
+            goto error;
+        }
+        Py_DECREF(value);
+    }
+
+    while (stack.len > 0)
+        search_pop(&stack);
+    PyMem_Free(stack.frames);
+
+    if (results != NULL)
+    {
+        Py_INCREF(results);
+        return results;
+    }
+    if (found == NULL)
+    {
+        Py_INCREF(default_value);
+        found = default_value;
+    }
+    return found;
+
+error:
+    while (stack.len > 0)
+        search_pop(&stack);
+    PyMem_Free(stack.frames);
+    return NULL;
+}
+
+static PyObject *py_search_key(PyObject *self, PyObject *args)
+{
+    PyObject *mapping, *key;
+    PyObject *default_value = Py_None;
+
+    if (!PyArg_ParseTuple(args, "OO|O", &mapping, &key, &default_value))
+    {
+        return NULL;
+    }
+    return search_tree(mapping, key, NULL, default_value);
+}
+
+static PyObject *py_search_keys(PyObject *self, PyObject *args)
+{
+    PyObject *mapping, *key;
+
+    if (!PyArg_ParseTuple(args, "OO", &mapping, &key))
+    {
+        return NULL;
+    }
+
+    PyObject *results = PyList_New(0);
+    if (results == NULL)
+        return NULL;
+    PyObject *res = search_tree(mapping, key, results, NULL);
+    Py_DECREF(results);
+    return res;
+}
+
+/* filter(): builds the filtered MagiDict tree directly, mirroring
+ * core._filter_mapping/_filter_sequence. With a batch predicate the tree is
+ * walked twice: first collecting every leaf (and its key or index), then,
+ * after a single predicate call, building the output from the returned flags
+ * in the same order. */
+typedef struct
+{
+    PyObject *function;
+    int num_args;
+    int drop_empty;
+    int collecting;
+    PyObject *keys;   /* batch leaf keys, collected when num_args == 2 */
+    PyObject *values; /* batch leaf values */
+    PyObject *flags;  /* batch predicate results as a fast sequence */
+    Py_ssize_t flag_pos;
+    PyTypeObject *fast_type;
+} FilterState;
+
+static PyObject *filter_mapping(FilterState *state, PyObject *mapping);
+static PyObject *filter_sequence(FilterState *state, PyObject *seq);
+
+/* 1 to keep the leaf, 0 to drop it (always while collecting), -1 on error */
+static int filter_test(FilterState *state, PyObject *key, PyObject *value)
+{
+    if (state->collecting)
+    {
+        if (state->keys != NULL && PyList_Append(state->keys, key) < 0)
+            return -1;
+        return PyList_Append(state->values, value) < 0 ? -1 : 0;
+    }
+
+    if (state->flags != NULL)
+    {
+        if (state->flag_pos >= PySequence_Fast_GET_SIZE(state->flags))
+        {
+            PyErr_SetString(PyExc_RuntimeError, "filter() input changed during a batch predicate call");
+            return -1;
+        }
+        return PyObject_IsTrue(PySequence_Fast_GET_ITEM(state->flags, state->flag_pos++));
+    }
+
+    PyObject *res = state->num_args == 2 ? PyObject_CallFunctionObjArgs(state->function, key, value, NULL)
+                                         : PyObject_CallOneArg(state->function, value);
+    if (res == NULL)
+        return -1;
+    int keep = PyObject_IsTrue(res);
+    Py_DECREF(res);
+    return keep;
+}
+
+/* type(seq)(items), falling back to items when the type rejects a list */
+static PyObject *filter_rebuild(PyObject *seq, PyObject *items)
+{
+    PyObject *rebuilt = PyObject_CallOneArg((PyObject *)Py_TYPE(seq), items);
+    if (rebuilt == NULL && PyErr_ExceptionMatches(PyExc_TypeError))
+    {
+        PyErr_Clear();
+        Py_INCREF(items);
+        return items;
+    }
+    return rebuilt;
+}
+
+/* Filter a child container; *keep says whether it belongs in the output */
+static PyObject *filter_child(FilterState *state, PyObject *value, int kind, int *keep)
+{
+    PyObject *filtered = kind == SEARCH_MAPPING ? filter_mapping(state, value) : filter_sequence(state, value);
+    if (filtered == NULL || state->collecting)
+    {
+        *keep = 0;
+        return filtered;
+    }
+    int truth = PyObject_IsTrue(filtered);
+    if (truth < 0)
+    {
+        Py_DECREF(filtered);
+        return NULL;
+    }
+    *keep = truth || !state->drop_empty;
+    return filtered;
+}
+
+static PyObject *filter_mapping(FilterState *state, PyObject *mapping)
+{
+    PyObject *result = NULL;
+    PyObject *items = NULL;
+
+    if (MagiDict_Check(mapping) && magidict_materialize_all(mapping) < 0)
+        return NULL;
+    if (!PyDict_CheckExact(mapping) && !MagiDict_Check(mapping))
+    {
+        items = PyMapping_Items(mapping);
+        if (items == NULL)
+            return NULL;
+    }
+    if (!state->collecting)
+    {
+        result = magidict_create(state->fast_type, magidict_class);
+        if (result == NULL)
+            goto error;
+    }
+    if (Py_EnterRecursiveCall(" while filtering a MagiDict"))
+        goto error;
+
+    Py_ssize_t pos = 0;
+    for (;;)
+    {
+        PyObject *key, *value;
+        if (items == NULL)
+        {
+            if (!PyDict_Next(mapping, &pos, &key, &value))
+                break;
+        }
+        else
+        {
+            if (pos >= PyList_GET_SIZE(items))
+                break;
+            PyObject *item = PyList_GET_ITEM(items, pos++);
+            if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2)
+            {
+                PyErr_SetString(PyExc_ValueError, "items must return 2-tuples");
+                goto error_leave;
+            }
+            key = PyTuple_GET_ITEM(item, 0);
+            value = PyTuple_GET_ITEM(item, 1);
+        }
+        Py_INCREF(key);
+        Py_INCREF(value);
+
+        int kind = search_kind(value);
+        int keep = 0;
+        PyObject *out = NULL;
+        if (kind > SEARCH_NONE)
+        {
+            PyObject *filtered = filter_child(state, value, kind, &keep);
+            if (filtered != NULL && keep && kind == SEARCH_SEQUENCE)
+            {
+                out = filter_rebuild(value, filtered);
+                Py_DECREF(filtered);
+            }
+            else
+                out = filtered;
+            if (filtered == NULL)
+                kind = -1;
+        }
+        else if (kind == SEARCH_NONE)
+        {
+            keep = filter_test(state, key, value);
+            if (keep < 0)
+                kind = -1;
+            else
+            {
+                Py_INCREF(value);
+                out = value;
+            }
+        }
+
+        int failed = kind < 0 || (keep && (out == NULL || PyDict_SetItem(result, key, out) < 0));
+        Py_XDECREF(out);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (failed)
+            goto error_leave;
+    }
+
+    Py_LeaveRecursiveCall();
+    Py_XDECREF(items);
+    if (state->collecting)
+        Py_RETURN_NONE;
+    return result;
+
+error_leave:
+    Py_LeaveRecursiveCall();
+error:
+    Py_XDECREF(items);
+    Py_XDECREF(result);
+    return NULL;
+}
+
+static PyObject *filter_sequence(FilterState *state, PyObject *seq)
+{
+    PyObject *fast = PySequence_Fast(seq, "expected a sequence");
+    if (fast == NULL)
+        return NULL;
+    PyObject *result = state->collecting ? NULL : PyList_New(0);
+    if (!state->collecting && result == NULL)
+    {
+        Py_DECREF(fast);
+        return NULL;
+    }
+    if (Py_EnterRecursiveCall(" while filtering a MagiDict"))
+        goto error;
+
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(fast); i++)
+    {
+        PyObject *item = PySequence_Fast_GET_ITEM(fast, i);
+        Py_INCREF(item);
+
+        int kind = search_kind(item);
+        int keep = 0;
+        PyObject *out = NULL;
+        if (kind > SEARCH_NONE)
+        {
+            out = filter_child(state, item, kind, &keep);
+            if (out == NULL)
+                kind = -1;
+        }
+        else if (kind == SEARCH_NONE)
+        {
+            PyObject *index = PyLong_FromSsize_t(i);
+            keep = index == NULL ? -1 : filter_test(state, index, item);
+            Py_XDECREF(index);
+            if (keep < 0)
+                kind = -1;
+            else
+            {
+                Py_INCREF(item);
+                out = item;
+            }
+        }
+
+        int failed = kind < 0 || (keep && PyList_Append(result, out) < 0);
+        Py_XDECREF(out);
+        Py_DECREF(item);
+        if (failed)
+        {
+            Py_LeaveRecursiveCall();
+            goto error;
+        }
+    }
+    Py_LeaveRecursiveCall();
+    Py_DECREF(fast);
+
+    if (state->collecting)
+        Py_RETURN_NONE;
+    if (PyList_GET_SIZE(result) > 0 || !state->drop_empty)
+    {
+        PyObject *rebuilt = filter_rebuild(seq, result);
+        Py_DECREF(result);
+        return rebuilt;
+    }
+    Py_DECREF(result);
+    Py_RETURN_NONE;
+
+error:
+    Py_DECREF(fast);
+    Py_XDECREF(result);
+    return NULL;
+}
+
+static PyObject *py_filter(PyObject *self, PyObject *args)
+{
+    PyObject *mapping, *function;
+    FilterState state;
+    int batch = 0;
+
+    memset(&state, 0, sizeof(state));
+    if (!PyArg_ParseTuple(args, "OOip|p", &mapping, &function, &state.num_args, &state.drop_empty, &batch))
+    {
+        return NULL;
+    }
+    if (magidict_class == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "MagiDict class not registered");
+        return NULL;
+    }
+    state.function = function;
+    state.fast_type = hook_fast_type(magidict_class);
+    if (!batch)
+        return filter_mapping(&state, mapping);
+
+    state.collecting = 1;
+    state.values = PyList_New(0);
+    if (state.values == NULL)
+        return NULL;
+    if (state.num_args == 2 && (state.keys = PyList_New(0)) == NULL)
+        goto done;
+
+    PyObject *collected = filter_mapping(&state, mapping);
+    if (collected == NULL)
+        goto done;
+    Py_DECREF(collected);
+
+    PyObject *flags = state.keys != NULL ? PyObject_CallFunctionObjArgs(function, state.keys, state.values, NULL)
+                                         : PyObject_CallOneArg(function, state.values);
+    if (flags == NULL)
+        goto done;
+    state.flags = PySequence_Fast(flags, "a batch filter predicate must return a sequence");
+    Py_DECREF(flags);
+    if (state.flags == NULL)
+        goto done;
+    if (PySequence_Fast_GET_SIZE(state.flags) != PyList_GET_SIZE(state.values))
+    {
+        PyErr_Format(PyExc_ValueError, "a batch filter predicate must return one result per value (%zd), got %zd",
+                     PyList_GET_SIZE(state.values), PySequence_Fast_GET_SIZE(state.flags));
+        goto done;
+    }
+
+    state.collecting = 0;
+    PyObject *result = filter_mapping(&state, mapping);
+    Py_XDECREF(state.keys);
+    Py_DECREF(state.values);
+    Py_DECREF(state.flags);
+    return result;
+
+done:
+    Py_XDECREF(state.keys);
+    Py_DECREF(state.values);
+    Py_XDECREF(state.flags);
+    return NULL;
+}
+
+static PyObject *py_register(PyObject *self, PyObject *args)
+{
+    PyObject *cls;
+    PyObject *compiler;
+    PyObject *none_md;
+    PyObject *missing_md;
+
+    if (!PyArg_ParseTuple(args, "OOOO", &cls, &compiler, &none_md, &missing_md))
+    {
+        return NULL;
+    }
+
+    if (!PyType_Check(cls) || !PyType_IsSubtype((PyTypeObject *)cls, &MagiDictBase_Type))
+    {
+        PyErr_SetString(PyExc_TypeError, "magidict_class must be a subclass of MagiDictBase");
+        return NULL;
+    }
+
+    PyObject *abc = PyImport_ImportModule("collections.abc");
+    if (abc == NULL)
+        return NULL;
+    PyObject *mapping = PyObject_GetAttrString(abc, "Mapping");
+    PyObject *sequence = PyObject_GetAttrString(abc, "Sequence");
+    Py_DECREF(abc);
+    if (mapping == NULL || sequence == NULL)
+    {
+        Py_XDECREF(mapping);
+        Py_XDECREF(sequence);
+        return NULL;
+    }
+
+    REGISTER_LOCK();
+    int res = register_swap(&abc_mapping, mapping) < 0 || register_swap(&abc_sequence, sequence) < 0 ||
+              register_swap(&magidict_class, cls) < 0 || register_swap(&path_compiler, compiler) < 0 ||
+              register_swap(&none_sentinel, none_md) < 0 || register_swap(&missing_sentinel, missing_md) < 0;
+    REGISTER_UNLOCK();
+    Py_DECREF(mapping);
+    Py_DECREF(sequence);
+    if (res)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Growable byte buffer shared by the JSON decoder and encoder */
+typedef struct
+{
+    char *data;
+    Py_ssize_t len;
+    Py_ssize_t cap;
+} ByteBuffer;
+
+static int buffer_reserve(ByteBuffer *buf, Py_ssize_t extra)
+{
+    if (buf->len + extra <= buf->cap)
+        return 0;
+
+    Py_ssize_t new_cap = buf->cap ? buf->cap : 64;
+    while (new_cap < buf->len + extra)
+    {
+        if (new_cap > PY_SSIZE_T_MAX / 2)
+        {
+            PyErr_NoMemory();
+            return -1;
+        }
+        new_cap *= 2;
+    }
+
+    char *data = PyMem_Realloc(buf->data, new_cap);
+    if (data == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    buf->data = data;
+    buf->cap = new_cap;
+    return 0;
+}
+
+static int buffer_append(ByteBuffer *buf, const char *src, Py_ssize_t n)
+{
+    /* An empty buffer has no data pointer, and memcpy must not see NULL */
+    if (n == 0)
+        return 0;
+    if (buffer_reserve(buf, n) < 0)
+        return -1;
+    memcpy(buf->data + buf->len, src, n);
+    buf->len += n;
+    return 0;
+}
+
+static void buffer_free(ByteBuffer *buf)
+{
+    PyMem_Free(buf->data);
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+}
+
+/* Single-pass JSON decoder producing MagiDicts for objects.
+ * Works on UTF-8 input; positions are byte offsets until an error is
+ * reported, at which point they are converted to character offsets to
+ * match json.JSONDecodeError. In partial mode (used for streaming) running
+ * out of input is not an error: truncated is set and NULL is returned
+ * without an exception so the caller can read more and retry. */
+typedef struct
+{
+    const char *buf;
+    Py_ssize_t len;
+    Py_ssize_t pos;
+    PyObject *doc;
+    PyObject *key_memo;
+    PyTypeObject *md_type;
+    ByteBuffer scratch;
+    int partial;
+    int truncated;
+    /* Objects and arrays open around the current position */
+    Py_ssize_t depth;
+} JsonDecoder;
+
+static PyObject *json_decode_value(JsonDecoder *dec);
+
+/* Scanner modes for skip_value(); mirrored by core._skip_value */
+enum
+{
+    SKIP_START,
+    SKIP_CONTAINER,
+    SKIP_STRING,
+    SKIP_ESCAPE,
+    SKIP_SCALAR,
+    SKIP_DONE
+};
+
+static void json_raise(JsonDecoder *dec, const char *msg, Py_ssize_t byte_pos)
+{
+    if (dec->partial && byte_pos >= dec->len)
+    {
+        dec->truncated = 1;
+        return;
+    }
+
+    PyObject *json_module = PyImport_ImportModule("json");
+    if (json_module == NULL)
+        return;
+    PyObject *error_type = PyObject_GetAttrString(json_module, "JSONDecodeError");
+    Py_DECREF(json_module);
+    if (error_type == NULL)
+        return;
+
+    Py_ssize_t char_pos = 0;
+    for (Py_ssize_t i = 0; i < byte_pos && i < dec->len; i++)
+    {
+        if (((unsigned char)dec->buf[i] & 0xC0) != 0x80)
+            char_pos++;
+    }
+
+    PyObject *doc;
+    if (PyUnicode_Check(dec->doc))
+    {
+        doc = dec->doc;
+        Py_INCREF(doc);
+    }
+    else
+    {
+        doc = PyUnicode_DecodeUTF8(dec->buf, dec->len, "replace");
+    }
+
+    if (doc != NULL)
+    {
+        PyObject *exc = PyObject_CallFunction(error_type, "sOn", msg, doc, char_pos);
+        Py_DECREF(doc);
+        if (exc != NULL)
+        {
+            PyErr_SetObject(error_type, exc);
+            Py_DECREF(exc);
+        }
+    }
+    Py_DECREF(error_type);
+}
+
+/* Error caused by the input ending inside a token */
+static void json_raise_truncated(JsonDecoder *dec, const char *msg, Py_ssize_t byte_pos)
+{
+    if (dec->partial)
+    {
+        dec->truncated = 1;
+        return;
+    }
+    json_raise(dec, msg, byte_pos);
+}
+
+static inline void json_skip_ws(JsonDecoder *dec)
+{
+    while (dec->pos < dec->len)
+    {
+        char c = dec->buf[dec->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+        dec->pos++;
+    }
+}
+
+static int json_match(JsonDecoder *dec, const char *literal, Py_ssize_t n)
+{
+    return dec->len - dec->pos >= n && memcmp(dec->buf + dec->pos, literal, n) == 0;
+}
+
+static int json_read_hex4(JsonDecoder *dec, Py_ssize_t at, Py_UCS4 *out)
+{
+    if (dec->len - at < 4)
+        return -1;
+
+    Py_UCS4 value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = dec->buf[at + i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+static int buffer_append_codepoint(ByteBuffer *buf, Py_UCS4 cp)
+{
+    char out[4];
+    Py_ssize_t n;
+
+    /* Lone surrogates are written as 3-byte sequences and decoded with surrogatepass */
+    if (cp < 0x80)
+    {
+        out[0] = (char)cp;
+        n = 1;
+    }
+    else if (cp < 0x800)
+    {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    }
+    else if (cp < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    }
+    else
+    {
+        out[0] = (char)(0xF0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    return buffer_append(buf, out, n);
+}
+
+static PyObject *json_decode_string(JsonDecoder *dec)
+{
+    Py_ssize_t begin = dec->pos;
+    Py_ssize_t i = begin + 1;
+    const char *buf = dec->buf;
+
+    /* Fast path: no escapes, decode the slice directly */
+    while (i < dec->len)
+    {
+        unsigned char c = (unsigned char)buf[i];
+        if (c == '"' || c == '\\')
+            break;
+        if (c < 0x20)
+        {
+            json_raise(dec, "Invalid control character at", i);
+            return NULL;
+        }
+        i++;
+    }
+    if (i >= dec->len)
+    {
+        json_raise_truncated(dec, "Unterminated string starting at", begin);
+        return NULL;
+    }
+    if (buf[i] == '"')
+    {
+        dec->pos = i + 1;
+        return PyUnicode_DecodeUTF8(buf + begin + 1, i - begin - 1, "surrogatepass");
+    }
+
+    ByteBuffer *out = &dec->scratch;
+    out->len = 0;
+    if (buffer_append(out, buf + begin + 1, i - begin - 1) < 0)
+        return NULL;
+
+    while (i < dec->len)
+    {
+        unsigned char c = (unsigned char)buf[i];
+        if (c == '"')
+        {
+            dec->pos = i + 1;
+            return PyUnicode_DecodeUTF8(out->data, out->len, "surrogatepass");
+        }
+        if (c < 0x20)
+        {
+            json_raise(dec, "Invalid control character at", i);
+            return NULL;
+        }
+        if (c != '\\')
+        {
+            Py_ssize_t run = i;
+            while (run < dec->len && buf[run] != '"' && buf[run] != '\\' &&
+                   (unsigned char)buf[run] >= 0x20)
+                run++;
+            if (buffer_append(out, buf + i, run - i) < 0)
+                return NULL;
+            i = run;
+            continue;
+        }
+
+        if (i + 1 >= dec->len)
+            break;
+
+        char esc = buf[i + 1];
+        char simple = 0;
+        switch (esc)
+        {
+        case '"':
+            simple = '"';
+            break;
+        case '\\':
+            simple = '\\';
+            break;
+        case '/':
+            simple = '/';
+            break;
+        case 'b':
+            simple = '\b';
+            break;
+        case 'f':
+            simple = '\f';
+            break;
+        case 'n':
+            simple = '\n';
+            break;
+        case 'r':
+            simple = '\r';
+            break;
+        case 't':
+            simple = '\t';
+            break;
+        case 'u':
+            break;
+        default:
+            json_raise(dec, "Invalid \\escape", i);
+            return NULL;
+        }
+
+        if (simple)
+        {
+            if (buffer_append(out, &simple, 1) < 0)
+                return NULL;
+            i += 2;
+            continue;
+        }
+
+        /* json.loads needs a character after a \u escape and reports one
+         * that ends the input as invalid, before checking its digits */
+        Py_UCS4 cp;
+        if (!dec->partial && i + 6 >= dec->len)
+        {
+            json_raise(dec, "Invalid \\uXXXX escape", i + 1);
+            return NULL;
+        }
+        if (json_read_hex4(dec, i + 2, &cp) < 0)
+        {
+            if (dec->len - (i + 2) < 4)
+                json_raise_truncated(dec, "Invalid \\uXXXX escape", i + 1);
+            else
+                json_raise(dec, "Invalid \\uXXXX escape", i + 1);
+            return NULL;
+        }
+        i += 6;
+
+        if (cp >= 0xD800 && cp <= 0xDBFF && dec->partial && dec->len - i < 6 &&
+            memcmp(buf + i, "\\u", dec->len - i < 2 ? dec->len - i : 2) == 0)
+        {
+            /* A low surrogate may follow in the next chunk */
+            json_raise_truncated(dec, "Unterminated string starting at", begin);
+            return NULL;
+        }
+
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < dec->len && buf[i] == '\\' && buf[i + 1] == 'u')
+        {
+            Py_UCS4 low;
+            if (!dec->partial && i + 6 >= dec->len)
+            {
+                json_raise(dec, "Invalid \\uXXXX escape", i + 1);
+                return NULL;
+            }
+            if (json_read_hex4(dec, i + 2, &low) < 0)
+            {
+                if (dec->len - (i + 2) < 4)
+                    json_raise_truncated(dec, "Invalid \\uXXXX escape", i + 1);
+                else
+                    json_raise(dec, "Invalid \\uXXXX escape", i + 1);
+                return NULL;
+            }
+            if (low >= 0xDC00 && low <= 0xDFFF)
+            {
+                cp = 0x10000 + (((cp - 0xD800) << 10) | (low - 0xDC00));
+                i += 6;
+            }
+        }
+
+        if (buffer_append_codepoint(out, cp) < 0)
+            return NULL;
+    }
+
+    json_raise_truncated(dec, "Unterminated string starting at", begin);
+    return NULL;
+}
+
+static PyObject *json_decode_number(JsonDecoder *dec)
+{
+    const char *buf = dec->buf;
+    Py_ssize_t start = dec->pos;
+    Py_ssize_t i = start;
+    int is_float = 0;
+
+    if (i < dec->len && buf[i] == '-')
+        i++;
+
+    if (i >= dec->len || buf[i] < '0' || buf[i] > '9')
+    {
+        if (json_match(dec, "-Infinity", 9))
+        {
+            dec->pos += 9;
+            return PyFloat_FromDouble(-Py_HUGE_VAL);
+        }
+        if (dec->len - start < 9 && memcmp(buf + start, "-Infinity", dec->len - start) == 0)
+            json_raise_truncated(dec, "Expecting value", start);
+        else
+            json_raise(dec, "Expecting value", start);
+        return NULL;
+    }
+
+    if (buf[i] == '0')
+        i++;
+    else
+        while (i < dec->len && buf[i] >= '0' && buf[i] <= '9')
+            i++;
+
+    if (i + 1 < dec->len && buf[i] == '.' && buf[i + 1] >= '0' && buf[i + 1] <= '9')
+    {
+        is_float = 1;
+        i += 2;
+        while (i < dec->len && buf[i] >= '0' && buf[i] <= '9')
+            i++;
+    }
+
+    if (i < dec->len && (buf[i] == 'e' || buf[i] == 'E'))
+    {
+        Py_ssize_t e = i + 1;
+        if (e < dec->len && (buf[e] == '+' || buf[e] == '-'))
+            e++;
+        if (e < dec->len && buf[e] >= '0' && buf[e] <= '9')
+        {
+            is_float = 1;
+            i = e;
+            while (i < dec->len && buf[i] >= '0' && buf[i] <= '9')
+                i++;
+        }
+    }
+
+    /* In partial mode a number touching the end of input may still continue */
+    if (dec->partial &&
+        (i == dec->len ||
+         (buf[i] == '.' && i + 1 == dec->len) ||
+         ((buf[i] == 'e' || buf[i] == 'E') &&
+          (i + 1 == dec->len || (i + 2 == dec->len && (buf[i + 1] == '+' || buf[i + 1] == '-'))))))
+    {
+        dec->truncated = 1;
+        return NULL;
+    }
+
+    dec->pos = i;
+    Py_ssize_t n = i - start;
+
+    if (!is_float && n <= 18)
+    {
+        long long value = 0;
+        Py_ssize_t j = start;
+        int negative = buf[j] == '-';
+        if (negative)
+            j++;
+        for (; j < i; j++)
+            value = value * 10 + (buf[j] - '0');
+        return PyLong_FromLongLong(negative ? -value : value);
+    }
+
+    char small[64];
+    char *text = n < (Py_ssize_t)sizeof(small) ? small : PyMem_Malloc(n + 1);
+    if (text == NULL)
+        return PyErr_NoMemory();
+    memcpy(text, buf + start, n);
+    text[n] = '\0';
+
+    PyObject *result;
+    if (is_float)
+    {
+        double d = PyOS_string_to_double(text, NULL, NULL);
+        result = (d == -1.0 && PyErr_Occurred()) ? NULL : PyFloat_FromDouble(d);
+    }
+    else
+    {
+        result = PyLong_FromString(text, NULL, 10);
+    }
+
+    if (text != small)
+        PyMem_Free(text);
+    return result;
+}
+
+#if PY_VERSION_HEX >= 0x030D0000
+/* Position of the comma before the whitespace ending at dec->pos */
+static Py_ssize_t json_comma_before(JsonDecoder *dec)
+{
+    Py_ssize_t pos = dec->pos - 1;
+    while (dec->buf[pos] != ',')
+        pos--;
+    return pos;
+}
+#endif
+
+static PyObject *json_decode_object(JsonDecoder *dec)
+{
+    PyObject *obj = magidict_new_empty(dec->md_type);
+    if (obj == NULL)
+        return NULL;
+
+    dec->pos++;
+    json_skip_ws(dec);
+    if (dec->pos < dec->len && dec->buf[dec->pos] == '}')
+    {
+        dec->pos++;
+        return obj;
+    }
+
+    for (;;)
+    {
+        if (dec->pos >= dec->len || dec->buf[dec->pos] != '"')
+        {
+            json_raise(dec, "Expecting property name enclosed in double quotes", dec->pos);
+            goto error;
+        }
+
+        PyObject *key = json_decode_string(dec);
+        if (key == NULL)
+            goto error;
+        PyObject *memo_key = PyDict_SetDefault(dec->key_memo, key, key);
+        if (memo_key == NULL)
+        {
+            Py_DECREF(key);
+            goto error;
+        }
+        Py_INCREF(memo_key);
+        Py_DECREF(key);
+        key = memo_key;
+
+        json_skip_ws(dec);
+        if (dec->pos >= dec->len || dec->buf[dec->pos] != ':')
+        {
+            Py_DECREF(key);
+            json_raise(dec, "Expecting ':' delimiter", dec->pos);
+            goto error;
+        }
+        dec->pos++;
+        json_skip_ws(dec);
+
+        PyObject *value = json_decode_value(dec);
+        if (value == NULL)
+        {
+            Py_DECREF(key);
+            goto error;
+        }
+
+        int res = PyDict_SetItem(obj, key, value);
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (res < 0)
+            goto error;
+
+        json_skip_ws(dec);
+        if (dec->pos < dec->len && dec->buf[dec->pos] == '}')
+        {
+            dec->pos++;
+            return obj;
+        }
+        if (dec->pos >= dec->len || dec->buf[dec->pos] != ',')
+        {
+            json_raise(dec, "Expecting ',' delimiter", dec->pos);
+            goto error;
+        }
+        dec->pos++;
+        json_skip_ws(dec);
+#if PY_VERSION_HEX >= 0x030D0000
+        /* json reports trailing commas by name since 3.13 */
+        if (dec->pos < dec->len && dec->buf[dec->pos] == '}')
+        {
+            json_raise(dec, "Illegal trailing comma before end of object", json_comma_before(dec));
+            goto error;
+        }
+#endif
+    }
+
+error:
+    Py_DECREF(obj);
+    return NULL;
+}
+
+static PyObject *json_decode_array(JsonDecoder *dec)
+{
+    PyObject *list = PyList_New(0);
+    if (list == NULL)
+        return NULL;
+
+    dec->pos++;
+    json_skip_ws(dec);
+    if (dec->pos < dec->len && dec->buf[dec->pos] == ']')
+    {
+        dec->pos++;
+        return list;
+    }
+
+    for (;;)
+    {
+        PyObject *value = json_decode_value(dec);
+        if (value == NULL)
+            goto error;
+
+        int res = PyList_Append(list, value);
+        Py_DECREF(value);
+        if (res < 0)
+            goto error;
+
+        json_skip_ws(dec);
+        if (dec->pos < dec->len && dec->buf[dec->pos] == ']')
+        {
+            dec->pos++;
+            return list;
+        }
+        if (dec->pos >= dec->len || dec->buf[dec->pos] != ',')
+        {
+            json_raise(dec, "Expecting ',' delimiter", dec->pos);
+            goto error;
+        }
+        dec->pos++;
+        json_skip_ws(dec);
+#if PY_VERSION_HEX >= 0x030D0000
+        /* json reports trailing commas by name since 3.13 */
+        if (dec->pos < dec->len && dec->buf[dec->pos] == ']')
+        {
+            json_raise(dec, "Illegal trailing comma before end of array", json_comma_before(dec));
+            goto error;
+        }
+#endif
+    }
+
+error:
+    Py_DECREF(list);
+    return NULL;
+}
+
+static PyObject *json_decode_value(JsonDecoder *dec)
+{
+    if (dec->pos >= dec->len)
+    {
+        json_raise(dec, "Expecting value", dec->pos);
+        return NULL;
+    }
+
+    PyObject *result;
+    switch (dec->buf[dec->pos])
+    {
+    case '"':
+        return json_decode_string(dec);
+    case '{':
+    case '[':
+        /* The same limit as the hook, which counts containers the same way */
+        if (hook_max_depth > 0 && dec->depth >= hook_max_depth)
+        {
+            PyErr_Format(PyExc_RecursionError, "maximum nesting depth of %zd exceeded while converting to MagiDict",
+                         hook_max_depth);
+            return NULL;
+        }
+        if (Py_EnterRecursiveCall(dec->buf[dec->pos] == '{' ? " while decoding a JSON object"
+                                                            : " while decoding a JSON array"))
+            return NULL;
+        dec->depth++;
+        result = dec->buf[dec->pos] == '{' ? json_decode_object(dec) : json_decode_array(dec);
+        dec->depth--;
+        Py_LeaveRecursiveCall();
+        return result;
+    case 't':
+        if (json_match(dec, "true", 4))
+        {
+            dec->pos += 4;
+            Py_RETURN_TRUE;
+        }
+        break;
+    case 'f':
+        if (json_match(dec, "false", 5))
+        {
+            dec->pos += 5;
+            Py_RETURN_FALSE;
+        }
+        break;
+    case 'n':
+        if (json_match(dec, "null", 4))
+        {
+            dec->pos += 4;
+            Py_RETURN_NONE;
+        }
+        break;
+    case 'N':
+        if (json_match(dec, "NaN", 3))
+        {
+            dec->pos += 3;
+            return PyFloat_FromDouble(Py_NAN);
+        }
+        break;
+    case 'I':
+        if (json_match(dec, "Infinity", 8))
+        {
+            dec->pos += 8;
+            return PyFloat_FromDouble(Py_HUGE_VAL);
+        }
+        break;
+    default:
+        if (dec->buf[dec->pos] == '-' || (dec->buf[dec->pos] >= '0' && dec->buf[dec->pos] <= '9'))
+            return json_decode_number(dec);
+        break;
+    }
+
+    if (dec->partial)
+    {
+        static const char *literals[] = {"true", "false", "null", "NaN", "Infinity"};
+        Py_ssize_t rest = dec->len - dec->pos;
+        for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++)
+        {
+            if (rest < (Py_ssize_t)strlen(literals[i]) &&
+                memcmp(dec->buf + dec->pos, literals[i], rest) == 0)
+            {
+                dec->truncated = 1;
+                return NULL;
+            }
+        }
+    }
+
+    json_raise(dec, "Expecting value", dec->pos);
+    return NULL;
+}
+
+/* Decode one complete JSON document held in buf/len */
+static PyObject *json_decode_document(PyObject *doc, const char *buf, Py_ssize_t len)
+{
+    JsonDecoder dec = {
+        .buf = buf,
+        .len = len,
+        .pos = 0,
+        .doc = doc,
+        .md_type = magidict_class != NULL ? (PyTypeObject *)magidict_class : &MagiDictBase_Type,
+    };
+
+    dec.key_memo = PyDict_New();
+    if (dec.key_memo == NULL)
+        return NULL;
+
+    json_skip_ws(&dec);
+    PyObject *result = json_decode_value(&dec);
+    if (result != NULL)
+    {
+        json_skip_ws(&dec);
+        if (dec.pos != dec.len)
+        {
+            json_raise(&dec, "Extra data", dec.pos);
+            Py_CLEAR(result);
+        }
+    }
+
+    Py_DECREF(dec.key_memo);
+    buffer_free(&dec.scratch);
+    return result;
+}
+
+static PyObject *py_raw_decode(PyObject *self, PyObject *args)
+{
+    Py_buffer view;
+    Py_ssize_t pos;
+    int final = 1;
+
+    if (!PyArg_ParseTuple(args, "y*n|p", &view, &pos, &final))
+    {
+        return NULL;
+    }
+
+    if (pos < 0 || pos > view.len)
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "pos out of range");
+        return NULL;
+    }
+
+    JsonDecoder dec = {
+        .buf = view.buf,
+        .len = view.len,
+        .pos = pos,
+        .doc = PyTuple_GET_ITEM(args, 0),
+        .md_type = magidict_class != NULL ? (PyTypeObject *)magidict_class : &MagiDictBase_Type,
+        .partial = !final,
+    };
+
+    PyObject *result = NULL;
+    dec.key_memo = PyDict_New();
+    if (dec.key_memo != NULL)
+    {
+        json_skip_ws(&dec);
+        PyObject *value = json_decode_value(&dec);
+        if (value != NULL)
+        {
+            result = Py_BuildValue("(Nn)", value, dec.pos);
+        }
+        else if (dec.truncated && !PyErr_Occurred())
+        {
+            result = Py_None;
+            Py_INCREF(result);
+        }
+        Py_DECREF(dec.key_memo);
+    }
+
+    buffer_free(&dec.scratch);
+    PyBuffer_Release(&view);
+    return result;
+}
+
+static PyObject *py_skip_value(PyObject *self, PyObject *args)
+{
+    Py_buffer view;
+    Py_ssize_t pos;
+    Py_ssize_t depth;
+    int mode;
+    int final = 1;
+
+    if (!PyArg_ParseTuple(args, "y*nni|p", &view, &pos, &depth, &mode, &final))
+    {
+        return NULL;
+    }
+
+    const char *buf = view.buf;
+    Py_ssize_t len = view.len;
+
+    while (pos < len && mode != SKIP_DONE)
+    {
+        char c = buf[pos];
+        switch (mode)
+        {
+        case SKIP_START:
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                pos++;
+            }
+            else if (c == '{' || c == '[')
+            {
+                depth = 1;
+                mode = SKIP_CONTAINER;
+                pos++;
+            }
+            else if (c == '"')
+            {
+                mode = SKIP_STRING;
+                pos++;
+            }
+            else
+            {
+                mode = SKIP_SCALAR;
+            }
+            break;
+        case SKIP_CONTAINER:
+            if (c == '"')
+            {
+                mode = SKIP_STRING;
+            }
+            else if (c == '{' || c == '[')
+            {
+                depth++;
+            }
+            else if ((c == '}' || c == ']') && --depth == 0)
+            {
+                mode = SKIP_DONE;
+            }
+            pos++;
+            break;
+        case SKIP_STRING:
+            if (c == '\\')
+                mode = SKIP_ESCAPE;
+            else if (c == '"')
+                mode = depth ? SKIP_CONTAINER : SKIP_DONE;
+            pos++;
+            break;
+        case SKIP_ESCAPE:
+            mode = SKIP_STRING;
+            pos++;
+            break;
+        default:
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' || c == ']' || c == '}')
+                mode = SKIP_DONE;
+            else
+                pos++;
+            break;
+        }
+    }
+
+    if (mode == SKIP_SCALAR && final)
+        mode = SKIP_DONE;
+
+    PyBuffer_Release(&view);
+    return Py_BuildValue("(nni)", pos, depth, mode);
+}
+
+static PyObject *py_loads(PyObject *self, PyObject *args)
+{
+    PyObject *s;
+
+    if (!PyArg_ParseTuple(args, "O", &s))
+    {
+        return NULL;
+    }
+
+    if (PyUnicode_Check(s))
+    {
+        Py_ssize_t len;
+        const char *buf = PyUnicode_AsUTF8AndSize(s, &len);
+        if (buf != NULL)
+            return json_decode_document(s, buf, len);
+
+        /* Lone surrogates cannot be encoded strictly; keep them via surrogatepass */
+        if (!PyErr_ExceptionMatches(PyExc_UnicodeEncodeError))
+            return NULL;
+        PyErr_Clear();
+        PyObject *encoded = PyUnicode_AsEncodedString(s, "utf-8", "surrogatepass");
+        if (encoded == NULL)
+            return NULL;
+        PyObject *result = json_decode_document(s, PyBytes_AS_STRING(encoded), PyBytes_GET_SIZE(encoded));
+        Py_DECREF(encoded);
+        return result;
+    }
+
+    if (PyObject_CheckBuffer(s))
+    {
+        Py_buffer view;
+        if (PyObject_GetBuffer(s, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+        PyObject *result = json_decode_document(s, view.buf, view.len);
+        PyBuffer_Release(&view);
+        return result;
+    }
+
+    PyErr_Format(PyExc_TypeError, "the JSON object must be str, bytes or bytearray, not %.100s",
+                 Py_TYPE(s)->tp_name);
+    return NULL;
+}
+
+/* JSON encoder writing MagiDict trees straight into a ByteBuffer, without the
+ * intermediate copy disenchant() would build. Output matches json.dumps for
+ * the supported options; the _from_none/_from_missing sentinels are written
+ * as null and values of lazy MagiDicts are encoded from the raw dicts. */
+typedef struct
+{
+    ByteBuffer out;
+    const char *indent;
+    Py_ssize_t indent_len;
+    Py_ssize_t level;
+    int sort_keys;
+    int ensure_ascii;
+    PyObject *default_fn;
+    PyObject **markers;
+    Py_ssize_t n_markers;
+    Py_ssize_t markers_cap;
+} JsonEncoder;
+
+static int json_encode_value(JsonEncoder *enc, PyObject *obj);
+
+/* Containers currently being written; few enough to scan linearly */
+static int json_enter(JsonEncoder *enc, PyObject *obj)
+{
+    for (Py_ssize_t i = 0; i < enc->n_markers; i++)
+    {
+        if (enc->markers[i] == obj)
+        {
+            PyErr_SetString(PyExc_ValueError, "Circular reference detected");
+            return -1;
+        }
+    }
+    if (enc->n_markers == enc->markers_cap)
+    {
+        Py_ssize_t new_cap = enc->markers_cap ? enc->markers_cap * 2 : 16;
+        PyObject **markers = PyMem_Realloc(enc->markers, new_cap * sizeof(PyObject *));
+        if (markers == NULL)
+        {
+            PyErr_NoMemory();
+            return -1;
+        }
+        enc->markers = markers;
+        enc->markers_cap = new_cap;
+    }
+    enc->markers[enc->n_markers++] = obj;
+    return 0;
+}
+
+static inline void json_leave(JsonEncoder *enc)
+{
+    enc->n_markers--;
+}
+
+static void json_hex4(char *dst, Py_UCS4 c)
+{
+    static const char hex[] = "0123456789abcdef";
+    dst[0] = '\\';
+    dst[1] = 'u';
+    dst[2] = hex[(c >> 12) & 0xF];
+    dst[3] = hex[(c >> 8) & 0xF];
+    dst[4] = hex[(c >> 4) & 0xF];
+    dst[5] = hex[c & 0xF];
+}
+
+static int json_write_escape(ByteBuffer *out, Py_UCS4 c)
+{
+    char esc[12];
+    Py_ssize_t n = 2;
+
+    esc[0] = '\\';
+    switch (c)
+    {
+    case '"':
+        esc[1] = '"';
+        break;
+    case '\\':
+        esc[1] = '\\';
+        break;
+    case '\n':
+        esc[1] = 'n';
+        break;
+    case '\r':
+        esc[1] = 'r';
+        break;
+    case '\t':
+        esc[1] = 't';
+        break;
+    case '\b':
+        esc[1] = 'b';
+        break;
+    case '\f':
+        esc[1] = 'f';
+        break;
+    default:
+        if (c >= 0x10000)
+        {
+            Py_UCS4 v = c - 0x10000;
+            json_hex4(esc, 0xD800 | (v >> 10));
+            json_hex4(esc + 6, 0xDC00 | (v & 0x3FF));
+            n = 12;
+        }
+        else
+        {
+            json_hex4(esc, c);
+            n = 6;
+        }
+    }
+    return buffer_append(out, esc, n);
+}
+
+static int json_encode_string(JsonEncoder *enc, PyObject *s)
+{
+    ByteBuffer *out = &enc->out;
+    Py_ssize_t len = PyUnicode_GET_LENGTH(s);
+
+    if (buffer_reserve(out, len + 2) < 0)
+        return -1;
+    out->data[out->len++] = '"';
+
+    if (PyUnicode_IS_ASCII(s))
+    {
+        /* Copy runs of plain characters; 0x7f is escaped only with ensure_ascii */
+        const char *p = (const char *)PyUnicode_1BYTE_DATA(s);
+        unsigned char limit = enc->ensure_ascii ? 0x7f : 0x80;
+        Py_ssize_t start = 0;
+        for (Py_ssize_t i = 0; i < len; i++)
+        {
+            unsigned char c = (unsigned char)p[i];
+            if (c >= ' ' && c < limit && c != '"' && c != '\\')
+                continue;
+            if (buffer_append(out, p + start, i - start) < 0 || json_write_escape(out, c) < 0)
+                return -1;
+            start = i + 1;
+        }
+        if (buffer_append(out, p + start, len - start) < 0)
+            return -1;
+    }
+    else
+    {
+        int kind = PyUnicode_KIND(s);
+        const void *data = PyUnicode_DATA(s);
+        for (Py_ssize_t i = 0; i < len; i++)
+        {
+            Py_UCS4 c = PyUnicode_READ(kind, data, i);
+            int r;
+            if (c >= ' ' && c < 0x7f && c != '"' && c != '\\')
+            {
+                if (buffer_reserve(out, 1) < 0)
+                    return -1;
+                out->data[out->len++] = (char)c;
+                continue;
+            }
+            if (c >= 0x7f && !enc->ensure_ascii)
+                r = buffer_append_codepoint(out, c);
+            else
+                r = json_write_escape(out, c);
+            if (r < 0)
+                return -1;
+        }
+    }
+    return buffer_append(out, "\"", 1);
+}
+
+static int json_encode_int(JsonEncoder *enc, PyObject *obj)
+{
+    int overflow;
+    long long v = PyLong_AsLongLongAndOverflow(obj, &overflow);
+    if (!overflow)
+    {
+        if (v == -1 && PyErr_Occurred())
+            return -1;
+        char tmp[24];
+        int n = snprintf(tmp, sizeof(tmp), "%lld", v);
+        return buffer_append(&enc->out, tmp, n);
+    }
+
+    /* int.__repr__ like json, so int subclasses are written as plain numbers */
+    PyObject *repr = PyLong_Type.tp_repr(obj);
+    if (repr == NULL)
+        return -1;
+    Py_ssize_t n;
+    const char *s = PyUnicode_AsUTF8AndSize(repr, &n);
+    int r = s == NULL ? -1 : buffer_append(&enc->out, s, n);
+    Py_DECREF(repr);
+    return r;
+}
+
+static int json_encode_float(JsonEncoder *enc, PyObject *obj)
+{
+    ByteBuffer *out = &enc->out;
+    double d = PyFloat_AS_DOUBLE(obj);
+
+    if (Py_IS_NAN(d))
+        return buffer_append(out, "NaN", 3);
+    if (Py_IS_INFINITY(d))
+        return d > 0 ? buffer_append(out, "Infinity", 8) : buffer_append(out, "-Infinity", 9);
+
+    char *repr = PyOS_double_to_string(d, 'r', 0, Py_DTSF_ADD_DOT_0, NULL);
+    if (repr == NULL)
+        return -1;
+    int r = buffer_append(out, repr, (Py_ssize_t)strlen(repr));
+    PyMem_Free(repr);
+    return r;
+}
+
+static int json_encode_key(JsonEncoder *enc, PyObject *key)
+{
+    ByteBuffer *out = &enc->out;
+    int r;
+
+    if (PyUnicode_Check(key))
+        return json_encode_string(enc, key);
+
+    if (buffer_append(out, "\"", 1) < 0)
+        return -1;
+    if (PyFloat_Check(key))
+        r = json_encode_float(enc, key);
+    else if (key == Py_True)
+        r = buffer_append(out, "true", 4);
+    else if (key == Py_False)
+        r = buffer_append(out, "false", 5);
+    else if (key == Py_None)
+        r = buffer_append(out, "null", 4);
+    else if (PyLong_Check(key))
+        r = json_encode_int(enc, key);
+    else
+    {
+        PyErr_Format(PyExc_TypeError, "keys must be str, int, float, bool or None, not %.100s",
+                     Py_TYPE(key)->tp_name);
+        return -1;
+    }
+    if (r < 0)
+        return -1;
+    return buffer_append(out, "\"", 1);
+}
+
+static int json_write_newline(JsonEncoder *enc)
+{
+    ByteBuffer *out = &enc->out;
+    if (buffer_reserve(out, 1 + enc->level * enc->indent_len) < 0)
+        return -1;
+    out->data[out->len++] = '\n';
+    for (Py_ssize_t i = 0; i < enc->level; i++)
+    {
+        memcpy(out->data + out->len, enc->indent, enc->indent_len);
+        out->len += enc->indent_len;
+    }
+    return 0;
+}
+
+/* Write the separator before an element: "," or ", " plus the indentation */
+static int json_write_item_start(JsonEncoder *enc, int first)
+{
+    if (enc->indent != NULL)
+    {
+        if (!first && buffer_append(&enc->out, ",", 1) < 0)
+            return -1;
+        return json_write_newline(enc);
+    }
+    return first ? 0 : buffer_append(&enc->out, ", ", 2);
+}
+
+static int json_encode_object(JsonEncoder *enc, PyObject *obj)
+{
+    ByteBuffer *out = &enc->out;
+    int is_dict = PyDict_CheckExact(obj) || MagiDict_Check(obj);
+    Py_ssize_t size = PyDict_Check(obj) ? PyDict_GET_SIZE(obj) : PyObject_Size(obj);
+
+    if (size < 0)
+        return -1;
+    if (size == 0)
+        return buffer_append(out, "{}", 2);
+    if (json_enter(enc, obj) < 0)
+        return -1;
+
+    /* Plain dicts and MagiDicts are walked in place; other mappings go
+     * through items() like json does, and sort_keys sorts the items list */
+    PyObject *items = NULL;
+    if (!is_dict || enc->sort_keys)
+    {
+        items = is_dict ? PyDict_Items(obj) : PyMapping_Items(obj);
+        if (items == NULL)
+            goto error;
+        if (enc->sort_keys && PyList_Sort(items) < 0)
+            goto error;
+    }
+
+    if (buffer_append(out, "{", 1) < 0)
+        goto error;
+    enc->level++;
+
+    Py_ssize_t pos = 0;
+    int first = 1;
+    for (;;)
     {
-        Py_UCS4 ch = PyUnicode_ReadChar(py_s, i);
-        /* toggle quote state when encountering a quote char */
-        if (ch == (Py_UCS4)'\'' || ch == (Py_UCS4)'"')
+        PyObject *key, *value;
+        if (items == NULL)
         {
-            if (quote == 0)
-            {
-                quote = ch;
-            }
-            else if (quote == ch)
+            if (!PyDict_Next(obj, &pos, &key, &value))
+                break;
+        }
+        else
+        {
+            if (pos >= PyList_GET_SIZE(items))
+                break;
+            PyObject *item = PyList_GET_ITEM(items, pos++);
+            if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2)
             {
-                quote = 0;
+                PyErr_SetString(PyExc_ValueError, "items must return 2-tuples");
+                goto error;
             }
-            /* continue; quote characters are part of the token */
+            key = PyTuple_GET_ITEM(item, 0);
+            value = PyTuple_GET_ITEM(item, 1);
         }
 
-        /* split on dot only when not inside quotes */
-        if (ch == (Py_UCS4)'.' && quote == 0)
+        Py_INCREF(key);
+        Py_INCREF(value);
+        int r = json_write_item_start(enc, first) < 0 || json_encode_key(enc, key) < 0 ||
+                buffer_append(out, ": ", 2) < 0 || json_encode_value(enc, value) < 0;
+        Py_DECREF(key);
+        Py_DECREF(value);
+        if (r)
+            goto error;
+        first = 0;
+    }
+
+    enc->level--;
+    if (enc->indent != NULL && json_write_newline(enc) < 0)
+        goto error;
+    if (buffer_append(out, "}", 1) < 0)
+        goto error;
+    json_leave(enc);
+    Py_XDECREF(items);
+    return 0;
+
+error:
+    json_leave(enc);
+    Py_XDECREF(items);
+    return -1;
+}
+
+static int json_encode_array(JsonEncoder *enc, PyObject *obj)
+{
+    ByteBuffer *out = &enc->out;
+    PyObject *seq = PySequence_Fast(obj, "expected a list or tuple");
+    if (seq == NULL)
+        return -1;
+    if (PySequence_Fast_GET_SIZE(seq) == 0)
+    {
+        Py_DECREF(seq);
+        return buffer_append(out, "[]", 2);
+    }
+    if (json_enter(enc, obj) < 0)
+    {
+        Py_DECREF(seq);
+        return -1;
+    }
+
+    if (buffer_append(out, "[", 1) < 0)
+        goto error;
+    enc->level++;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++)
+    {
+        PyObject *elem = PySequence_Fast_GET_ITEM(seq, i);
+        Py_INCREF(elem);
+        int r = json_write_item_start(enc, i == 0) < 0 || json_encode_value(enc, elem) < 0;
+        Py_DECREF(elem);
+        if (r)
+            goto error;
+    }
+    enc->level--;
+    if (enc->indent != NULL && json_write_newline(enc) < 0)
+        goto error;
+    if (buffer_append(out, "]", 1) < 0)
+        goto error;
+    json_leave(enc);
+    Py_DECREF(seq);
+    return 0;
+
+error:
+    json_leave(enc);
+    Py_DECREF(seq);
+    return -1;
+}
+
+/* Set once by core.py through register_records() */
+static PyObject *records_class = NULL;
+/* Optional view type of a single compact row, written like a dict */
+static PyObject *row_class = NULL;
+
+static PyObject *py_register_records(PyObject *self, PyObject *args)
+{
+    PyObject *cls;
+    PyObject *row_cls = NULL;
+
+    if (!PyArg_ParseTuple(args, "O|O:register_records", &cls, &row_cls))
+        return NULL;
+    if (!PyType_Check(cls) || (row_cls != NULL && !PyType_Check(row_cls)))
+    {
+        PyErr_SetString(PyExc_TypeError, "records_class must be a type");
+        return NULL;
+    }
+    REGISTER_LOCK();
+    int res = register_swap(&records_class, cls) < 0 || register_swap(&row_class, row_cls) < 0;
+    REGISTER_UNLOCK();
+    if (res)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* MagiRecords: compact rows are written from their key and value tuples
+ * through a temporary dict, so encoding does not turn them into MagiDicts */
+static int json_encode_records(JsonEncoder *enc, PyObject *obj)
+{
+    ByteBuffer *out = &enc->out;
+    PyObject *keys = NULL, *rows = NULL, *attr;
+    int r = -1;
+
+    /* Private copies, so default callbacks cannot resize them under us */
+    if ((attr = PyObject_GetAttrString(obj, "_keys")) == NULL)
+        return -1;
+    keys = PySequence_List(attr);
+    Py_DECREF(attr);
+    if (keys == NULL || (attr = PyObject_GetAttrString(obj, "_rows")) == NULL)
+        goto done;
+    rows = PySequence_List(attr);
+    Py_DECREF(attr);
+    if (rows == NULL)
+        goto done;
+    if (PyList_GET_SIZE(keys) != PyList_GET_SIZE(rows))
+    {
+        PyErr_SetString(PyExc_RuntimeError, "MagiRecords keys and rows differ in length");
+        goto done;
+    }
+    if (PyList_GET_SIZE(rows) == 0)
+    {
+        r = buffer_append(out, "[]", 2);
+        goto done;
+    }
+    if (json_enter(enc, obj) < 0)
+        goto done;
+
+    if (buffer_append(out, "[", 1) < 0)
+        goto leave;
+    enc->level++;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(rows); i++)
+    {
+        PyObject *row_keys = PyList_GET_ITEM(keys, i);
+        PyObject *row = PyList_GET_ITEM(rows, i);
+        if (json_write_item_start(enc, i == 0) < 0)
+            goto leave;
+        if (row_keys == Py_None)
         {
-            PyObject *part = PyUnicode_Substring(py_s, start, i);
-            if (part == NULL)
-            {
-                Py_DECREF(result);
-                return NULL;
-            }
-            if (PyList_Append(result, part) < 0)
+            if (json_encode_value(enc, row) < 0)
+                goto leave;
+            continue;
+        }
+        if (!PyTuple_Check(row_keys) || !PyTuple_Check(row) || PyTuple_GET_SIZE(row_keys) != PyTuple_GET_SIZE(row))
+        {
+            PyErr_SetString(PyExc_RuntimeError, "malformed MagiRecords row");
+            goto leave;
+        }
+        PyObject *plain = PyDict_New();
+        if (plain == NULL)
+            goto leave;
+        int failed = 0;
+        for (Py_ssize_t j = 0; j < PyTuple_GET_SIZE(row) && !failed; j++)
+            failed = PyDict_SetItem(plain, PyTuple_GET_ITEM(row_keys, j), PyTuple_GET_ITEM(row, j)) < 0;
+        failed = failed || json_encode_value(enc, plain) < 0;
+        Py_DECREF(plain);
+        if (failed)
+            goto leave;
+    }
+    enc->level--;
+    if (enc->indent != NULL && json_write_newline(enc) < 0)
+        goto leave;
+    if (buffer_append(out, "]", 1) < 0)
+        goto leave;
+    r = 0;
+
+leave:
+    json_leave(enc);
+done:
+    Py_XDECREF(keys);
+    Py_XDECREF(rows);
+    return r;
+}
+
+static int json_encode_default(JsonEncoder *enc, PyObject *obj)
+{
+    if (enc->default_fn == NULL)
+    {
+        PyErr_Format(PyExc_TypeError, "Object of type %.100s is not JSON serializable",
+                     Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    if (json_enter(enc, obj) < 0)
+        return -1;
+    PyObject *replacement = PyObject_CallOneArg(enc->default_fn, obj);
+    int r = replacement == NULL ? -1 : json_encode_value(enc, replacement);
+    Py_XDECREF(replacement);
+    json_leave(enc);
+    return r;
+}
+
+/* MagiRecords, their rows and the mappings and lists of an open snapshot
+ * are written like the data they hold; anything else goes to default, as
+ * with json */
+static int json_encode_container(JsonEncoder *enc, PyObject *obj)
+{
+    PyObject *type = (PyObject *)Py_TYPE(obj);
+    if (records_class != NULL && PyObject_TypeCheck(obj, (PyTypeObject *)records_class))
+        return json_encode_records(enc, obj);
+    if (row_class != NULL && type == row_class)
+        return json_encode_object(enc, obj);
+    if (view_lazy_mapping_class != NULL && type == view_lazy_mapping_class)
+        return json_encode_object(enc, obj);
+    if (view_lazy_list_class != NULL && type == view_lazy_list_class)
+        return json_encode_array(enc, obj);
+    return json_encode_default(enc, obj);
+}
+
+static int json_encode_value(JsonEncoder *enc, PyObject *obj)
+{
+    ByteBuffer *out = &enc->out;
+    int r;
+
+    if (obj == Py_None)
+        return buffer_append(out, "null", 4);
+    if (obj == Py_True)
+        return buffer_append(out, "true", 4);
+    if (obj == Py_False)
+        return buffer_append(out, "false", 5);
+    if (PyUnicode_Check(obj))
+        return json_encode_string(enc, obj);
+    if (PyLong_Check(obj))
+        return json_encode_int(enc, obj);
+    if (PyFloat_Check(obj))
+        return json_encode_float(enc, obj);
+
+    if (PyDict_Check(obj) && PyDict_GET_SIZE(obj) == 0 && MagiDict_Check(obj))
+    {
+        int sentinel = obj == none_sentinel || obj == missing_sentinel;
+        if (!sentinel && (sentinel = magidict_is_protected(obj)) < 0)
+            return -1;
+        if (sentinel)
+            return buffer_append(out, "null", 4);
+    }
+
+    if (Py_EnterRecursiveCall(" while encoding a JSON object"))
+        return -1;
+    if (PyDict_Check(obj))
+        r = json_encode_object(enc, obj);
+    else if (PyList_Check(obj) || PyTuple_Check(obj))
+        r = json_encode_array(enc, obj);
+    else if (MagiView_Check(obj))
+        r = json_encode_object(enc, ((MagiViewObject *)obj)->data);
+    else if (view_list_class != NULL && PyObject_TypeCheck(obj, (PyTypeObject *)view_list_class))
+    {
+        PyObject *data = PyObject_CallMethod(obj, "unwrap", NULL);
+        r = data == NULL ? -1 : json_encode_value(enc, data);
+        Py_XDECREF(data);
+    }
+    else
+        r = json_encode_container(enc, obj);
+    Py_LeaveRecursiveCall();
+    return r;
+}
+
+static PyObject *py_dumps(PyObject *self, PyObject *args)
+{
+    PyObject *obj;
+    PyObject *indent = Py_None;
+    int sort_keys = 0;
+    int ensure_ascii = 1;
+    PyObject *default_fn = Py_None;
+
+    if (!PyArg_ParseTuple(args, "O|OppO", &obj, &indent, &sort_keys, &ensure_ascii, &default_fn))
+    {
+        return NULL;
+    }
+
+    JsonEncoder enc;
+    memset(&enc, 0, sizeof(enc));
+    enc.sort_keys = sort_keys;
+    enc.ensure_ascii = ensure_ascii;
+    enc.default_fn = default_fn == Py_None ? NULL : default_fn;
+    if (indent != Py_None)
+    {
+        if (!PyUnicode_Check(indent))
+        {
+            PyErr_Format(PyExc_TypeError, "indent must be str or None, not %.100s", Py_TYPE(indent)->tp_name);
+            return NULL;
+        }
+        enc.indent = PyUnicode_AsUTF8AndSize(indent, &enc.indent_len);
+        if (enc.indent == NULL)
+            return NULL;
+    }
+
+    PyObject *result = NULL;
+    if (json_encode_value(&enc, obj) == 0)
+        result = PyUnicode_DecodeUTF8(enc.out.data, enc.out.len, "surrogatepass");
+    buffer_free(&enc.out);
+    PyMem_Free(enc.markers);
+    return result;
+}
+
+static PyObject *py_cow_copy(PyObject *self, PyObject *args)
+{
+    PyObject *md;
+    if (!PyArg_ParseTuple(args, "O!:cow_copy", &MagiDictBase_Type, &md))
+        return NULL;
+
+    PyObject *group = cow_group_new();
+    if (group == NULL)
+        return NULL;
+    PyObject *fork = cow_fork(md, group);
+    if (fork == NULL || fork == md)
+    {
+        Py_DECREF(group);
+        return fork;
+    }
+    /* The root keeps the group, even when it borrows nothing itself, and
+     * the group watches the source for changes below the borrowed children */
+    PyObject *ref = PyWeakref_NewRef(group, NULL);
+    Py_XSETREF(((MagiDictObject *)fork)->cow_group, group);
+    if (ref == NULL)
+    {
+        Py_DECREF(fork);
+        return NULL;
+    }
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    int res = 0;
+    while (res == 0 && PyDict_Next(md, &pos, &key, &value))
+        res = cow_watch_tree(value, ref);
+    Py_DECREF(ref);
+    if (res < 0)
+        Py_CLEAR(fork);
+    return fork;
+}
+
+enum
+{
+    MERGE_REPLACE,
+    MERGE_APPEND,
+    MERGE_KEEP
+};
+
+/* New reference to value with the lists, tuples and plain dicts in it
+ * copied, so deep_merge never stores a container other still holds; the
+ * hook would otherwise convert them in place. MagiDicts and other values
+ * are kept. *memo maps copied containers to their copy. */
+static PyObject *merge_copy_value(PyObject *value, PyObject **memo)
+{
+    int is_dict = PyDict_Check(value) && !MagiDict_Check(value);
+    int is_list = PyList_CheckExact(value);
+    if (!is_dict && !is_list && !PyTuple_Check(value))
+    {
+        Py_INCREF(value);
+        return value;
+    }
+
+    PyObject *cached = cow_group_get(*memo, value);
+    if (cached != NULL)
+        return cached;
+    if (PyErr_Occurred())
+        return NULL;
+    if (*memo == NULL && (*memo = PyDict_New()) == NULL)
+        return NULL;
+
+    Py_ssize_t size = is_dict ? 0 : Py_SIZE(value);
+    PyObject *copy = is_dict ? PyDict_New() : is_list ? PyList_New(size) : PyTuple_New(size);
+    if (copy == NULL)
+        return NULL;
+    if (Py_EnterRecursiveCall(" while merging into a MagiDict"))
+    {
+        Py_DECREF(copy);
+        return NULL;
+    }
+    if (!PyTuple_Check(value) && cow_group_put(*memo, value, copy, 0) < 0)
+        goto error;
+
+    if (is_dict)
+    {
+        Py_ssize_t pos = 0;
+        PyObject *key, *element;
+        while (PyDict_Next(value, &pos, &key, &element))
+        {
+            Py_INCREF(key);
+            PyObject *copied = merge_copy_value(element, memo);
+            int res = copied != NULL ? PyDict_SetItem(copy, key, copied) : -1;
+            Py_XDECREF(copied);
+            Py_DECREF(key);
+            if (res < 0)
+                goto error;
+        }
+        Py_LeaveRecursiveCall();
+        return copy;
+    }
+
+    int changed = is_list;
+    for (Py_ssize_t i = 0; i < size; i++)
+    {
+        PyObject *element = is_list ? PyList_GET_ITEM(value, i) : PyTuple_GET_ITEM(value, i);
+        PyObject *copied = merge_copy_value(element, memo);
+        if (copied == NULL)
+            goto error;
+        changed |= copied != element;
+        if (is_list)
+            PyList_SET_ITEM(copy, i, copied);
+        else
+            PyTuple_SET_ITEM(copy, i, copied);
+    }
+    Py_LeaveRecursiveCall();
+
+    if (is_list)
+        return copy;
+    if (!changed)
+    {
+        Py_DECREF(copy);
+        Py_INCREF(value);
+        return value;
+    }
+    copy = tuple_rebuild(value, copy);
+    if (copy != NULL && cow_group_put(*memo, value, copy, 0) < 0)
+        Py_CLEAR(copy);
+    return copy;
+
+error:
+    Py_LeaveRecursiveCall();
+    Py_DECREF(copy);
+    return NULL;
+}
+
+/* Merges the items of other into md. Mappings are merged key by key into
+ * the MagiDicts md already holds, or into a new MagiDict for keys it lacks,
+ * so the MagiDicts of other are never shared with md. Other values replace
+ * the current ones, as copies down to their lists and tuples, except that MERGE_APPEND extends lists and MERGE_KEEP
+ * only fills in missing keys. active maps id() of the mappings of other
+ * being merged to their target, so a mapping reached again through a cycle
+ * points the key back at that target instead of merging forever. */
+static int deep_merge_into(PyObject *md, PyObject *other, int strategy, PyObject *active)
+{
+    if (magidict_raise_if_protected(md) < 0)
+        return -1;
+    PyObject *items = update_items(other, NULL);
+    if (items == NULL)
+        return -1;
+    PyObject *id = PyLong_FromVoidPtr(other);
+    if (id == NULL || PyDict_SetItem(active, id, md) < 0)
+    {
+        Py_XDECREF(id);
+        Py_DECREF(items);
+        return -1;
+    }
+    if (Py_EnterRecursiveCall(" while merging into a MagiDict"))
+    {
+        Py_DECREF(id);
+        Py_DECREF(items);
+        return -1;
+    }
+
+    PyObject *cls = (PyObject *)Py_TYPE(md);
+    int res = 0;
+    if (((MagiDictObject *)md)->watchers != NULL)
+        res = magidict_notify_watchers(md);
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    while (res == 0 && PyDict_Next(items, &pos, &key, &value))
+    {
+        PyObject *current = PyDict_GetItemWithError(md, key);
+        if (current == NULL && PyErr_Occurred())
+        {
+            res = -1;
+            break;
+        }
+        if (current != NULL && (current = lazy_materialize(md, key, current)) == NULL)
+        {
+            res = -1;
+            break;
+        }
+
+        int is_mapping = view_is_mapping(value);
+        PyObject *target = NULL;
+        if (is_mapping > 0)
+        {
+            PyObject *value_id = PyLong_FromVoidPtr(value);
+            target = value_id != NULL ? PyDict_GetItemWithError(active, value_id) : NULL;
+            Py_XDECREF(value_id);
+            if (target == NULL && PyErr_Occurred())
+                is_mapping = -1;
+        }
+        if (is_mapping < 0)
+        {
+            res = -1;
+        }
+        else if (target != NULL)
+        {
+            if (current == NULL || strategy != MERGE_KEEP)
+                res = magidict_store(md, key, target);
+        }
+        else if (is_mapping && (current == NULL || PyDict_Check(current) || strategy != MERGE_KEEP))
+        {
+            /* A plain dict stored with dict methods is converted first */
+            PyObject *child = current != NULL && PyDict_Check(current) ? current : NULL;
+            if (child != NULL && !MagiDict_Check(child))
+                child = fast_hook_with_memo(child, NULL, cls);
+            else if (child == NULL)
+                child = magidict_create(hook_fast_type(cls), cls);
+            else
+                Py_INCREF(child);
+            res = child != NULL ? deep_merge_into(child, value, strategy, active) : -1;
+            if (res == 0 && child != current)
+                res = magidict_store(md, key, child);
+            Py_XDECREF(child);
+        }
+        else if (current == NULL || strategy != MERGE_KEEP)
+        {
+            PyObject *memo = NULL;
+            PyObject *copied = merge_copy_value(value, &memo);
+            Py_XDECREF(memo);
+            PyObject *hooked = copied != NULL ? fast_hook_with_memo(copied, NULL, cls) : NULL;
+            Py_XDECREF(copied);
+            if (hooked != NULL && strategy == MERGE_APPEND && current != NULL && PyList_Check(current) &&
+                (PyList_Check(hooked) || PyTuple_Check(hooked)))
             {
-                Py_DECREF(part);
-                Py_DECREF(result);
-                return NULL;
+                PyObject *joined = PySequence_List(current);
+                if (joined != NULL)
+                    Py_SETREF(joined, PySequence_InPlaceConcat(joined, hooked));
+                Py_SETREF(hooked, joined);
             }
-            Py_DECREF(part);
-            start = i + 1;
+            res = hooked != NULL ? magidict_store(md, key, hooked) : -1;
+            Py_XDECREF(hooked);
         }
+        Py_XDECREF(current);
     }
 
-    /* append last part (from start to end) */
-    PyObject *last = PyUnicode_Substring(py_s, start, length);
-    if (last == NULL)
+    Py_LeaveRecursiveCall();
+    if (PyDict_DelItem(active, id) < 0)
+        res = -1;
+    Py_DECREF(id);
+    Py_DECREF(items);
+    return res;
+}
+
+static PyObject *py_deep_merge(PyObject *self, PyObject *args)
+{
+    PyObject *md;
+    PyObject *other;
+    const char *name = "replace";
+    if (!PyArg_ParseTuple(args, "O!O|s:deep_merge", &MagiDictBase_Type, &md, &other, &name))
+        return NULL;
+
+    int strategy;
+    if (strcmp(name, "replace") == 0)
+        strategy = MERGE_REPLACE;
+    else if (strcmp(name, "append") == 0)
+        strategy = MERGE_APPEND;
+    else if (strcmp(name, "keep") == 0)
+        strategy = MERGE_KEEP;
+    else
     {
-        Py_DECREF(result);
+        PyErr_Format(PyExc_ValueError, "strategy must be 'replace', 'append' or 'keep', not '%s'", name);
         return NULL;
     }
-    if (PyList_Append(result, last) < 0)
+    int is_mapping = view_is_mapping(other);
+    if (is_mapping <= 0)
     {
-        Py_DECREF(last);
-        Py_DECREF(result);
+        if (is_mapping == 0)
+            PyErr_Format(PyExc_TypeError, "deep_merge expects a mapping, got %.100s", Py_TYPE(other)->tp_name);
         return NULL;
     }
-    Py_DECREF(last);
+    PyObject *active = PyDict_New();
+    if (active == NULL)
+        return NULL;
+    int res = deep_merge_into(md, other, strategy, active);
+    Py_DECREF(active);
+    if (res < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
 
-    return result;
+static PyObject *py_stats(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return Py_BuildValue(
+        "{sOsKsKsKsKsKsKsKsKsKsKsKsKsK}",
+        "enabled", stats_enabled ? Py_True : Py_False,
+        "hook_dicts", stats.hook_dicts,
+        "hook_lists", stats.hook_lists,
+        "hook_tuples", stats.hook_tuples,
+        "hook_scalars", stats.hook_scalars,
+        "hook_magidicts", stats.hook_magidicts,
+        "memo_hits", stats.memo_hits,
+        "magidicts_created", stats.magidicts_created,
+        "key_hits", stats.key_hits,
+        "key_misses", stats.key_misses,
+        "dotted_lookups", stats.dotted_lookups,
+        "none_sentinels", stats.none_sentinels,
+        "missing_sentinels", stats.missing_sentinels,
+        "python_fallbacks", stats.python_fallbacks);
+}
+
+static PyObject *py_reset_stats(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    memset(&stats, 0, sizeof(stats));
+    Py_RETURN_NONE;
+}
+
+/* set_stats(enabled): turn the counters on or off; returns the previous setting */
+static PyObject *py_set_stats(PyObject *self, PyObject *args)
+{
+    int enabled;
+    if (!PyArg_ParseTuple(args, "p:set_stats", &enabled))
+        return NULL;
+    int previous = stats_enabled;
+    stats_enabled = enabled;
+    return PyBool_FromLong(previous);
+}
+
+static PyObject *py_notify_watchers(PyObject *self, PyObject *args)
+{
+    PyObject *md;
+    if (!PyArg_ParseTuple(args, "O!:notify_watchers", &MagiDictBase_Type, &md))
+        return NULL;
+    if (((MagiDictObject *)md)->watchers != NULL && magidict_notify_watchers(md) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* The object slot of md that core.py reads and writes as name, along with
+ * the type it must hold, or NULL for names kept in the instance dict.
+ * Neither is reachable through attribute lookup, so keys of the same name
+ * are never shadowed. */
+static PyObject **magidict_state_slot(PyObject *md, PyObject *name, PyTypeObject **expected)
+{
+    MagiDictObject *self = (MagiDictObject *)md;
+    if (PyUnicode_Compare(name, str_watchers) == 0)
+    {
+        *expected = &PyList_Type;
+        return &self->watchers;
+    }
+    if (PyUnicode_Compare(name, str_cow_pending) == 0)
+    {
+        *expected = &PyDict_Type;
+        return &self->cow_pending;
+    }
+    if (PyUnicode_Compare(name, str_cow_group) == 0)
+    {
+        *expected = &CowGroup_Type;
+        return &self->cow_group;
+    }
+    return NULL;
+}
+
+static PyObject *py_get_state(PyObject *self, PyObject *args)
+{
+    PyObject *md, *name;
+    if (!PyArg_ParseTuple(args, "O!U:get_state", &MagiDictBase_Type, &md, &name))
+        return NULL;
+    PyTypeObject *expected;
+    PyObject **slot = magidict_state_slot(md, name, &expected);
+    PyObject *value = NULL;
+    if (slot != NULL)
+        value = *slot;
+    else if (((MagiDictObject *)md)->inst_dict != NULL)
+    {
+        value = PyDict_GetItemWithError(((MagiDictObject *)md)->inst_dict, name);
+        if (value == NULL && PyErr_Occurred())
+            return NULL;
+    }
+    if (value == NULL)
+        Py_RETURN_NONE;
+    Py_INCREF(value);
+    return value;
+}
+
+static PyObject *py_set_state(PyObject *self, PyObject *args)
+{
+    PyObject *md, *name, *value;
+    if (!PyArg_ParseTuple(args, "O!UO:set_state", &MagiDictBase_Type, &md, &name, &value))
+        return NULL;
+    PyTypeObject *expected;
+    PyObject **slot = magidict_state_slot(md, name, &expected);
+    if (slot == NULL)
+    {
+        PyObject *inst_dict = ((MagiDictObject *)md)->inst_dict;
+        if (value != Py_None)
+        {
+            if (PyObject_GenericSetAttr(md, name, value) < 0)
+                return NULL;
+        }
+        else if (inst_dict != NULL)
+        {
+            int found = PyDict_Contains(inst_dict, name);
+            if (found < 0 || (found && PyDict_DelItem(inst_dict, name) < 0))
+                return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+    if (value != Py_None && !PyObject_TypeCheck(value, expected))
+    {
+        PyErr_Format(PyExc_TypeError, "expected %s or None", expected->tp_name);
+        return NULL;
+    }
+    if (value == Py_None)
+        value = NULL;
+    Py_XINCREF(value);
+    Py_XSETREF(*slot, value);
+    Py_RETURN_NONE;
 }
 
 static PyMethodDef module_methods[] = {
@@ -283,20 +6279,189 @@ static PyMethodDef module_methods[] = {
      "Fast recursive conversion of dicts to MagiDicts (creates own memo)"},
     {"fast_hook_with_memo", py_fast_hook_with_memo, METH_VARARGS,
      "Fast recursive conversion of dicts to MagiDicts (uses provided memo)"},
+    {"hook_into", py_hook_into, METH_VARARGS,
+     "Hook all values of source into target: hook_into(target, source, cls)"},
+    {"set_max_depth", py_set_max_depth, METH_VARARGS,
+     "Limit the nesting depth accepted by the hook (0 for none); returns the previous limit"},
+    {"hook_many", py_hook_many, METH_VARARGS,
+     "Convert a list of dicts with one shared memo: "
+     "hook_many(records, cls, intern_keys=False, compact=False, memo=None, start=0, stop=len); "
+     "intern_keys may be the dict to intern keys into; memo receives the containers other records could share"},
+    {"hook_range", py_hook_range, METH_VARARGS,
+     "Convert list[start:stop] in place: hook_range(list, start, stop, cls, memo)"},
+    {"fast_unhook", fast_unhook, METH_VARARGS,
+     "Iterative conversion of MagiDicts back to plain dicts (disenchant)"},
     {"split_dotted", py_split_dotted, METH_VARARGS,
      "Split on dots outside quotes: split_dotted(s: str) -> list[str]"},
+    {"register", py_register, METH_VARARGS,
+     "Register the Python MagiDict class, dotted-path parser and shared sentinels: "
+     "register(cls, compile_dotted, none_md, missing_md)"},
+    {"register_view", py_register_view, METH_VARARGS,
+     "Register the Python MagiView and MagiViewList classes: register_view(cls, list_cls, lazy_list_cls=None)"},
+    {"register_records", py_register_records, METH_VARARGS,
+     "Register the Python MagiRecords class and its row view so dumps can encode compact rows"},
+    {"get_path", py_get_path, METH_VARARGS,
+     "get_path(obj, path_or_parts, default=None) -> value at the path, or default on a miss"},
+    {"extract", py_extract, METH_VARARGS,
+     "extract(records, paths, arrays=False) -> {path: column of values at path}"},
+    {"search_key", py_search_key, METH_VARARGS,
+     "search_key(mapping, key, default=None) -> first value for key in the nested structure"},
+    {"search_keys", py_search_keys, METH_VARARGS,
+     "search_keys(mapping, key) -> list of all values for key in the nested structure"},
+    {"filter", py_filter, METH_VARARGS,
+     "filter(mapping, function, num_args, drop_empty, batch=False) -> filtered MagiDict"},
+    {"stats", py_stats, METH_NOARGS,
+     "stats() -> dict of the hot-path counters"},
+    {"reset_stats", py_reset_stats, METH_NOARGS,
+     "reset_stats() -> None: zero the hot-path counters"},
+    {"set_stats", py_set_stats, METH_VARARGS,
+     "set_stats(enabled) -> previous setting: turn the hot-path counters on or off"},
+    {"deep_merge", py_deep_merge, METH_VARARGS,
+     "deep_merge(md, other, strategy='replace') -> None: merge other into md key by key"},
+    {"cow_copy", py_cow_copy, METH_VARARGS,
+     "cow_copy(md) -> copy-on-write fork of md sharing its unchanged subtrees"},
+    {"notify_watchers", py_notify_watchers, METH_VARARGS,
+     "notify_watchers(md): clear key indexes covering md and complete the forks reaching it"},
+    {"get_state", py_get_state, METH_VARARGS,
+     "get_state(md, name) -> bookkeeping value of md stored as name, or None"},
+    {"set_state", py_set_state, METH_VARARGS,
+     "set_state(md, name, value): store bookkeeping on md as name; None removes it"},
+    {"loads", py_loads, METH_VARARGS,
+     "Decode a JSON str or UTF-8 bytes object, building MagiDicts directly"},
+    {"dumps", py_dumps, METH_VARARGS,
+     "dumps(obj, indent=None, sort_keys=False, ensure_ascii=True, default=None) -> str"},
+    {"raw_decode", py_raw_decode, METH_VARARGS,
+     "raw_decode(buf, pos, final=True) -> (value, end) or None if buf ends mid-value"},
+    {"skip_value", py_skip_value, METH_VARARGS,
+     "skip_value(buf, pos, depth, mode, final=True) -> (pos, depth, mode); resumable"},
     {NULL, NULL, 0, NULL}};
 
+/* The types are static and what core.py registers is process wide, so only
+ * the first interpreter to import the module gets it. Others get an
+ * ImportError and core.py falls back to the pure Python classes. */
+static PyInterpreterState *owner_interp = NULL;
+
+static int magidict_exec(PyObject *module)
+{
+    PyInterpreterState *interp = PyInterpreterState_Get();
+    if (owner_interp != NULL && owner_interp != interp)
+    {
+        PyErr_SetString(PyExc_ImportError, "magidict._magidict cannot be loaded in more than one interpreter");
+        return -1;
+    }
+    if (owner_interp == NULL)
+    {
+        str_from_none = PyUnicode_InternFromString("_from_none");
+        if (str_from_none == NULL)
+            return -1;
+        str_from_missing = PyUnicode_InternFromString("_from_missing");
+        if (str_from_missing == NULL)
+            return -1;
+        str_missing = PyUnicode_InternFromString("__missing__");
+        if (str_missing == NULL)
+            return -1;
+        str_keys = PyUnicode_InternFromString("keys");
+        if (str_keys == NULL)
+            return -1;
+        str_update = PyUnicode_InternFromString("update");
+        if (str_update == NULL)
+            return -1;
+        str_lazy_memo = PyUnicode_InternFromString("_MagiDict__lazy_memo");
+        if (str_lazy_memo == NULL)
+            return -1;
+        str_watchers = PyUnicode_InternFromString("_MagiDict__watchers");
+        if (str_watchers == NULL)
+            return -1;
+        str_cow_pending = PyUnicode_InternFromString("_MagiDict__cow_pending");
+        if (str_cow_pending == NULL)
+            return -1;
+        str_cow_group = PyUnicode_InternFromString("_MagiDict__cow_group");
+        if (str_cow_group == NULL)
+            return -1;
+        str_key_index = PyUnicode_InternFromString("_MagiDict__key_index");
+        if (str_key_index == NULL)
+            return -1;
+        str_dir_keys = PyUnicode_InternFromString("_MagiDict__dir_keys");
+        if (str_dir_keys == NULL)
+            return -1;
+        empty_tuple = PyTuple_New(0);
+        if (empty_tuple == NULL)
+            return -1;
+        sequence_misses = PyTuple_Pack(3, PyExc_IndexError, PyExc_ValueError, PyExc_TypeError);
+        if (sequence_misses == NULL)
+            return -1;
+
+        PyObject *copyreg = PyImport_ImportModule("copyreg");
+        if (copyreg == NULL)
+            return -1;
+        copyreg_newobj = PyObject_GetAttrString(copyreg, "__newobj__");
+        Py_DECREF(copyreg);
+        if (copyreg_newobj == NULL)
+            return -1;
+
+        dict_values = PyObject_GetAttrString((PyObject *)&PyDict_Type, "values");
+        if (dict_values == NULL)
+            return -1;
+        dict_items = PyObject_GetAttrString((PyObject *)&PyDict_Type, "items");
+        if (dict_items == NULL)
+            return -1;
+
+        MagiDictBase_Type.tp_base = &PyDict_Type;
+        if (PyType_Ready(&MagiDictBase_Type) < 0)
+            return -1;
+        if (PyType_Ready(&CowGroup_Type) < 0)
+            return -1;
+        if (PyType_Ready(&KeyAttr_Type) < 0)
+            return -1;
+        if (PyType_Ready(&MagiViewBase_Type) < 0)
+            return -1;
+        owner_interp = interp;
+    }
+
+    Py_INCREF(&MagiDictBase_Type);
+    if (PyModule_AddObject(module, "MagiDictBase", (PyObject *)&MagiDictBase_Type) < 0)
+    {
+        Py_DECREF(&MagiDictBase_Type);
+        return -1;
+    }
+
+    Py_INCREF(&KeyAttr_Type);
+    if (PyModule_AddObject(module, "KeyAttr", (PyObject *)&KeyAttr_Type) < 0)
+    {
+        Py_DECREF(&KeyAttr_Type);
+        return -1;
+    }
+
+    Py_INCREF(&MagiViewBase_Type);
+    if (PyModule_AddObject(module, "MagiViewBase", (PyObject *)&MagiViewBase_Type) < 0)
+    {
+        Py_DECREF(&MagiViewBase_Type);
+        return -1;
+    }
+
+    return 0;
+}
+
+static PyModuleDef_Slot module_slots[] = {
+    {Py_mod_exec, magidict_exec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_NOT_SUPPORTED},
+#endif
+    /* No Py_mod_gil slot: search, filter, dumps and the copy-on-write
+     * bookkeeping read borrowed references from containers other threads
+     * may change, so free-threaded builds keep the GIL on for this module. */
+    {0, NULL}};
+
 static PyModuleDef magidictmodule = {
     PyModuleDef_HEAD_INIT,
     .m_name = "magidict._magidict",
     .m_doc = "Fast C implementation of MagiDict hook function",
-    .m_size = -1,
+    .m_size = 0,
     .m_methods = module_methods,
+    .m_slots = module_slots,
 };
 
-
 PyMODINIT_FUNC PyInit__magidict(void)
 {
-    return PyModule_Create(&magidictmodule);
-}
\ No newline at end of file
+    return PyModuleDef_Init(&magidictmodule);
+}
@@ -1,12 +1,17 @@
 """Type stubs for magidict module."""
 
+from array import array
+from os import PathLike
 from typing import (
     Any,
     Callable,
     Dict,
     Iterable,
+    Iterator,
     List,
+    Literal,
     Mapping,
+    MutableSequence,
     Optional,
     Sequence,
     SupportsIndex,
@@ -23,6 +28,21 @@ _T = TypeVar("_T")
 _K = TypeVar("_K")
 _V = TypeVar("_V")
 
+class MagiPath:
+    """A pre-parsed dotted key path, as returned by MagiDict.compile_path."""
+
+    path: str
+    parts: Tuple[Any, ...]
+
+    def __init__(self, path: str) -> None: ...
+    def get(self, obj: Any, default: Any = None) -> Any:
+        """Resolves the path against obj, returning default on a miss."""
+        ...
+
+    def __call__(self, obj: Any, default: Any = None) -> Any: ...
+    def __eq__(self, other: object) -> bool: ...
+    def __hash__(self) -> int: ...
+
 class MagiDict(Dict[_KT, _VT]):
     """A dictionary that supports attribute-style access and recursive conversion
     of nested dictionaries into MagiDicts."""
@@ -44,11 +64,37 @@ class MagiDict(Dict[_KT, _VT]):
         ...
 
     @classmethod
-    def _hook_with_memo(cls, item: Any, memo: Dict[int, Any]) -> Any:
+    def _hook_with_memo(
+        cls,
+        item: Any,
+        memo: Dict[int, Any],
+        keys: Optional[Dict[str, str]] = None,
+        depth: int = 0,
+    ) -> Any:
         """Recursively converts dictionaries in collections to MagiDicts.
         Uses a memoization dict to handle circular references."""
         ...
 
+    @classmethod
+    def from_records(
+        cls,
+        records: Iterable[Dict[Any, Any]],
+        intern_keys: bool = False,
+        compact: bool = False,
+        workers: Optional[int] = None,
+    ) -> Union[List[Self], MagiRecords]:
+        """Convert a batch of dictionaries in one call, sharing one memo and,
+        with intern_keys, one string object per distinct str key. With
+        compact, return a MagiRecords instead of a list. With workers, convert
+        slices of the records on that many threads."""
+        ...
+
+    @classmethod
+    def specialize(cls, sample_or_schema: Union[Mapping[Any, Any], Iterable[str]]) -> type[Self]:
+        """Return a cached subclass with a direct attribute descriptor for
+        each key of a sample record (nested keys included) or key list."""
+        ...
+
     @overload
     def __getitem__(self, key: _KT) -> _VT: ...
     @overload
@@ -70,8 +116,21 @@ class MagiDict(Dict[_KT, _VT]):
         """Recursively convert nested dicts into MagiDicts on update."""
         ...
 
-    def copy(self) -> Self:
-        """Return a shallow copy of the MagiDict, preserving special flags."""
+    def deep_merge(self, other: Mapping[Any, Any], strategy: Literal["replace", "append", "keep"] = "replace") -> None:
+        """Merges another mapping into this one in place, key by key; nested
+        mappings are merged into the MagiDicts already here.
+
+        Parameters:
+            other: The mapping to merge in.
+            strategy: "replace" overwrites other values, "append" also extends
+                lists, "keep" only fills in missing keys.
+        """
+        ...
+
+    def copy(self, cow: bool = False) -> Self:
+        """Return a copy of the MagiDict, preserving special flags. With cow=True
+        it is a copy-on-write fork that shares nested MagiDicts with the
+        original until they are reached through the fork or modified."""
         ...
 
     def setdefault(self, key: _KT, default: _VT = ...) -> _VT:
@@ -124,6 +183,55 @@ class MagiDict(Dict[_KT, _VT]):
         """Shorthand for strict_get() method."""
         ...
 
+    @staticmethod
+    def compile_path(path: str) -> MagiPath:
+        """Parses a dotted key path once so it can be applied to many objects.
+
+        Parameters:
+            path: A dot-separated key path using the same rules as md["a.0.b"].
+
+        Returns:
+            A MagiPath; call it (or its get() method) with a mapping to resolve it.
+        """
+        ...
+
+    @staticmethod
+    def extract(records: Iterable[Any], paths: Iterable[Union[str, Tuple[Any, ...]]], arrays: bool = False) -> Dict[Any, Union[List[Any], array]]:
+        """Pulls the same paths out of many records at once, column by column.
+
+        Parameters:
+            records: Mappings (MagiDicts or plain dicts) to read from.
+            paths: Keys or dotted paths such as "user.id" or "items.0.sku",
+                resolved like md[path]; a tuple is taken as already split keys.
+            arrays: If True, columns holding only ints become array('q') and
+                columns of floats (or floats and ints) become array('d').
+
+        Returns:
+            A dict mapping each path to a list with one value per record,
+            None where the path is missing.
+        """
+        ...
+
+    def save_snapshot(self, path: Union[str, PathLike[str]]) -> None:
+        """Writes the tree to a binary snapshot file that open_snapshot can map into memory.
+
+        Parameters:
+            path: The file to write.
+        """
+        ...
+
+    @staticmethod
+    def open_snapshot(path: Union[str, PathLike[str]]) -> MagiSnapshot:
+        """Opens a file written by save_snapshot without reading it in.
+
+        Parameters:
+            path: The snapshot file.
+
+        Returns:
+            A read-only MagiSnapshot; values are decoded as they are accessed.
+        """
+        ...
+
     def disenchant(self) -> Dict[Any, Any]:
         """Convert MagiDict and all nested MagiDicts back into standard dicts,
         handling circular references gracefully."""
@@ -158,8 +266,18 @@ class MagiDict(Dict[_KT, _VT]):
         """
         ...
 
+    def build_index(self) -> None:
+        """Index every key in the MagiDict and its nested structures so that
+        search_key() and search_keys() become dictionary lookups. The index is
+        dropped on any MagiDict mutation in the tree and rebuilt on the next search.
+        """
+        ...
+
     def filter(
-        self, function: Optional[Callable[..., bool]] = None, drop_empty: bool = False
+        self,
+        function: Optional[Callable[..., Any]] = None,
+        drop_empty: bool = False,
+        batch: bool = False,
     ) -> Self:
         """Returns a new MagiDict containing only the items for which the function
         returns True. Supports nested dicts and sequences.
@@ -170,13 +288,103 @@ class MagiDict(Dict[_KT, _VT]):
                      None values.
             drop_empty: If True, empty MagiDicts and sequences are omitted from
                        the result.
+            batch: If True, function is called once with the list of all leaf
+                  values (preceded by their keys for two arguments) and returns
+                  one result per value.
 
         Returns:
             A new MagiDict with filtered items.
         """
         ...
 
-def magi_loads(s: str, **kwargs: Any) -> MagiDict[Any, Any]:
+class MagiView(Mapping[Any, Any]):
+    """A read-only MagiDict interface over an existing mapping. Wrapping is
+    O(1): nothing is copied, converted or modified."""
+
+    def __init__(self, data: Mapping[Any, Any]) -> None: ...
+    def __getattr__(self, name: str) -> Any: ...
+    def __getitem__(self, key: Any) -> Any: ...
+    def __len__(self) -> int: ...
+    def __iter__(self) -> Iterator[Any]: ...
+    def mget(self, key: Any, default: Any = ...) -> Any: ...
+    def mg(self, key: Any, default: Any = ...) -> Any: ...
+    def get(self, key: Any, default: Any = None) -> Any: ...
+    def values(self) -> List[Any]: ...  # type: ignore[override]
+    def items(self) -> List[Tuple[Any, Any]]: ...  # type: ignore[override]
+    def unwrap(self) -> Mapping[Any, Any]:
+        """Returns the underlying mapping."""
+        ...
+
+    def search_key(self, key: Any, default: Any = None) -> Any: ...
+    def search_keys(self, key: Any) -> List[Any]: ...
+    def filter(
+        self,
+        function: Optional[Callable[..., Any]],
+        drop_empty: bool = False,
+        batch: bool = False,
+    ) -> MagiDict[Any, Any]: ...
+    def disenchant(self) -> Dict[Any, Any]: ...
+
+class MagiViewList(Sequence[Any]):
+    """Read-only sequence returned by MagiView for lists and tuples."""
+
+    def __init__(self, data: Sequence[Any]) -> None: ...
+    @overload
+    def __getitem__(self, index: int) -> Any: ...
+    @overload
+    def __getitem__(self, index: slice) -> MagiViewList: ...
+    def __len__(self) -> int: ...
+    def unwrap(self) -> Sequence[Any]: ...
+
+class MagiSnapshot(MagiView):
+    """A read-only MagiView over a memory-mapped snapshot written by
+    MagiDict.save_snapshot; values are decoded as they are accessed."""
+
+    def __enter__(self) -> Self: ...
+    def __exit__(self, *exc_info: Any) -> None: ...
+    def close(self) -> None:
+        """Unmaps the file; values already read stay valid, further reads raise ValueError."""
+        ...
+
+class MagiRow(Mapping[Any, Any]):
+    """Read-only view of a compact MagiRecords row with MagiDict item and
+    attribute access; a structural change turns the record into a MagiDict."""
+
+    def __getitem__(self, key: Any) -> Any: ...
+    def __getattr__(self, name: str) -> Any: ...
+    def __iter__(self) -> Iterator[Any]: ...
+    def __len__(self) -> int: ...
+    def __setitem__(self, key: Any, value: Any) -> None: ...
+    def __delitem__(self, key: Any) -> None: ...
+    def mget(self, key: Any, default: Any = ...) -> Any: ...
+    def mg(self, key: Any, default: Any = ...) -> Any: ...
+    def update(self, *args: Any, **kwargs: Any) -> None: ...
+    def setdefault(self, key: Any, default: Any = ...) -> Any: ...
+    def pop(self, key: Any, *args: Any) -> Any: ...
+    def popitem(self) -> Tuple[Any, Any]: ...
+    def clear(self) -> None: ...
+
+class MagiRecords(MutableSequence[MagiDict[Any, Any]]):
+    """List of MagiDicts storing plain records as value tuples against shared
+    key tuples, read as MagiRow views until a record is changed."""
+
+    def __init__(self, records: Iterable[Dict[Any, Any]] = ..., cls: type = ...) -> None: ...
+    @overload
+    def __getitem__(self, index: int) -> Union[MagiDict[Any, Any], MagiRow]: ...
+    @overload
+    def __getitem__(self, index: slice) -> List[Union[MagiDict[Any, Any], MagiRow]]: ...
+    @overload
+    def __setitem__(self, index: int, value: Dict[Any, Any]) -> None: ...
+    @overload
+    def __setitem__(self, index: slice, value: Iterable[Dict[Any, Any]]) -> None: ...
+    def __delitem__(self, index: Union[int, slice]) -> None: ...
+    def __len__(self) -> int: ...
+    def insert(self, index: int, value: Dict[Any, Any]) -> None: ...
+    def compacted(self) -> int:
+        """Returns the number of records still stored as value tuples."""
+        ...
+
+def magi_loads(s: Union[str, bytes, bytearray], **kwargs: Any) -> MagiDict[Any, Any]:
     """Deserialize a JSON string into a MagiDict instead of a dict.
 
     Parameters:
@@ -200,20 +408,157 @@ def magi_load(fp: Any, **kwargs: Any) -> MagiDict[Any, Any]:
     """
     ...
 
-def enchant(d: Dict[Any, Any]) -> MagiDict[Any, Any]:
+async def amagi_loads(
+    s: Union[str, bytes, bytearray], budget_us: int = 1000, **kwargs: Any
+) -> MagiDict[Any, Any]:
+    """Deserialize a JSON string into a MagiDict, decoding in slices that
+    yield to the event loop. With keyword arguments, parses with json.loads
+    in one step and converts in slices.
+
+    Parameters:
+        s: The JSON string to deserialize.
+        budget_us: The time in microseconds to decode before yielding.
+        **kwargs: Additional keyword arguments to pass to json.loads.
+
+    Returns:
+        A MagiDict representing the deserialized JSON data.
+
+    Raises:
+        ValueError: If budget_us is not positive.
+    """
+    ...
+
+def magi_dumps(
+    obj: Any,
+    *,
+    indent: Union[int, str, None] = None,
+    sort_keys: bool = False,
+    ensure_ascii: bool = True,
+    default: Optional[Callable[[Any], Any]] = None,
+    **kwargs: Any,
+) -> str:
+    """Serialize a MagiDict (or any JSON-compatible object) to a JSON string.
+
+    Parameters:
+        obj: The object to serialize.
+        indent: Number of spaces or string used to indent nested levels.
+        sort_keys: Whether to write object keys in sorted order.
+        ensure_ascii: Whether to escape all non-ASCII characters.
+        default: Called with objects that cannot otherwise be serialized.
+        **kwargs: Additional keyword arguments to pass to json.dumps.
+
+    Returns:
+        The JSON document as a str.
+    """
+    ...
+
+def magi_dump(obj: Any, fp: Any, **kwargs: Any) -> None:
+    """Serialize a MagiDict (or any JSON-compatible object) to a file-like object.
+
+    Parameters:
+        obj: The object to serialize.
+        fp: The file-like object to write the JSON document to.
+        **kwargs: Keyword arguments accepted by magi_dumps.
+    """
+    ...
+
+def magi_iter(
+    fp: Any, path: Optional[str] = None, chunk_size: int = ...
+) -> Iterator[Any]:
+    """Lazily deserialize JSON from a file-like object, reading it in chunks.
+
+    Parameters:
+        fp: A text or binary file-like object with a read(size) method.
+        path: Optional dotted path to an array inside a single JSON document.
+        chunk_size: Number of characters or bytes to read at a time.
+
+    Returns:
+        An iterator over top-level values, or over the elements of the array
+        at path.
+    """
+    ...
+
+def enchant(d: Dict[Any, Any], lazy: bool = False, workers: Optional[int] = None) -> MagiDict[Any, Any]:
     """Convert a standard dictionary into a MagiDict.
 
     Parameters:
         d: The standard dictionary to convert.
+        lazy: If True, nested dicts are converted only when first accessed.
+        workers: If more than 1, convert the top-level values, and the
+                 elements of top-level lists, on that many threads.
+
+    Returns:
+        A MagiDict representing the input dictionary.
+
+    Raises:
+        TypeError: If the input is not a dictionary.
+        ValueError: If workers is not a positive integer or is combined with lazy.
+    """
+    ...
+
+def enchant_many(
+    records: Iterable[Dict[Any, Any]],
+    intern_keys: bool = False,
+    compact: bool = False,
+    workers: Optional[int] = None,
+) -> Union[List[MagiDict[Any, Any]], MagiRecords]:
+    """Convert a batch of standard dictionaries into MagiDicts in one call.
+
+    Parameters:
+        records: An iterable of dicts.
+        intern_keys: If True, equal str keys across the batch share one string object.
+        compact: If True, return a MagiRecords storing plain records as value tuples.
+        workers: If more than 1, convert slices of the records on that many threads.
+
+    Returns:
+        A list with one MagiDict per record, or a MagiRecords with compact=True.
+    """
+    ...
+
+async def aenchant(d: Dict[Any, Any], budget_us: int = 1000) -> MagiDict[Any, Any]:
+    """Convert a standard dictionary into a MagiDict from a coroutine,
+    yielding to the event loop about every budget_us microseconds.
+
+    Parameters:
+        d: The standard dictionary to convert.
+        budget_us: The time in microseconds to convert before yielding.
 
     Returns:
         A MagiDict representing the input dictionary.
 
     Raises:
         TypeError: If the input is not a dictionary.
+        ValueError: If budget_us is not positive.
+    """
+    ...
+
+def set_max_depth(depth: Optional[int]) -> Optional[int]:
+    """Limit the nesting depth of values converted into MagiDicts.
+
+    Parameters:
+        depth: The maximum number of nested dicts, lists and tuples in one
+               converted value, or None for no limit.
+
+    Returns:
+        The previous limit.
+
+    Raises:
+        ValueError: If depth is not a positive integer or None.
     """
     ...
 
+def set_stats(enabled: bool) -> bool:
+    """Turn the hot-path counters reported by stats() on or off; returns the previous setting."""
+    ...
+
+def stats() -> Dict[str, Union[bool, int]]:
+    """Report which implementation is in use and the hot-path counters since the last reset_stats()."""
+    ...
+
+def reset_stats() -> None:
+    """Zero the counters reported by stats()."""
+    ...
+
 def none(obj: Any) -> Any:
     """Convert an empty MagiDict that was created from a None or missing key into None.
 
@@ -1,11 +1,25 @@
 """Core implementation of MagiDict, a recursive dictionary with safe attribute access
 and automatic conversion of nested dictionaries into MagiDicts."""
 
+from array import array as _array
 from ast import literal_eval
+import copyreg as _copyreg
 import json
+from mmap import ACCESS_READ as _ACCESS_READ, mmap as _mmap
+from os import chmod as _chmod, fspath, fsync as _fsync, replace as _replace, stat as _stat, umask as _umask
+from os import unlink as _unlink
+from os.path import abspath as _abspath, dirname as _dirname
 from copy import deepcopy
-from typing import Any, Iterable, List, Mapping, Sequence, Union
-from inspect import signature
+from functools import lru_cache
+from typing import Any, Iterable, List, Mapping, MutableSequence, Sequence, Union
+from inspect import CO_VARARGS, CO_VARKEYWORDS, signature
+from struct import Struct
+from sys import byteorder as _byteorder
+from tempfile import NamedTemporaryFile as _NamedTemporaryFile
+from types import FunctionType, coroutine
+from threading import Thread
+from time import perf_counter
+from weakref import ref as _weakref
 
 
 _MISSING = object()
@@ -13,86 +27,457 @@ _MISSING = object()
 try:
     from ._magidict import fast_hook as _c_fast_hook
     from ._magidict import fast_hook_with_memo as _c_fast_hook_with_memo
+    from ._magidict import hook_into as _c_hook_into
+    from ._magidict import hook_many as _c_hook_many
+    from ._magidict import hook_range as _c_hook_range
+    from ._magidict import set_max_depth as _c_set_max_depth
+    from ._magidict import set_stats as _c_set_stats
+    from ._magidict import stats as _c_stats
+    from ._magidict import reset_stats as _c_reset_stats
     from ._magidict import split_dotted as _c_split_dotted
 
     _has_c_hook = True
 except ImportError:
     _has_c_hook = False
 
+try:
+    from ._magidict import MagiDictBase as _CMagiDictBase
+    from ._magidict import register as _c_register
+    from ._magidict import loads as _c_loads
+    from ._magidict import dumps as _c_dumps
+    from ._magidict import raw_decode as _c_raw_decode
+    from ._magidict import skip_value as _c_skip_value
+    from ._magidict import get_path as _c_get_path
+    from ._magidict import extract as _c_extract
+    from ._magidict import search_key as _c_search_key
+    from ._magidict import search_keys as _c_search_keys
+    from ._magidict import filter as _c_filter
+    from ._magidict import cow_copy as _c_cow_copy
+    from ._magidict import deep_merge as _c_deep_merge
+    from ._magidict import notify_watchers as _c_notify_watchers
+    from ._magidict import get_state as _c_get_state
+    from ._magidict import set_state as _c_set_state
+    from ._magidict import KeyAttr as _CKeyAttr
+    from ._magidict import MagiViewBase as _CMagiViewBase
+    from ._magidict import register_view as _c_register_view
+    from ._magidict import register_records as _c_register_records
+    from ._magidict import fast_unhook as _c_fast_unhook
+
+    _has_c_type = True
+except ImportError:
+    _has_c_type = False
 
-class MagiDict(dict):
-    """A dictionary that supports attribute-style access and recursive conversion
-    of nested dictionaries into MagiDicts. It also supports safe access to missing
-    keys and keys with None values by returning empty MagiDicts, allowing for
-    safe chaining of attribute accesses."""
 
-    def __init__(self, *args: Union[dict, Mapping], **kwargs: Any) -> None:
-        """Initialize the MagiDict, recursively converting nested dicts.
-        Supports initialization with a single dict, mapping, or standard dict args/kwargs.
-        """
-        super().__init__()
-        memo = {}
-        if len(args) == 1 and not kwargs and isinstance(args[0], dict):
-            input_dict = args[0]
-        else:
-            input_dict = dict(*args, **kwargs)
-        memo[id(input_dict)] = self
-        for k, v in input_dict.items():
-            super().__setitem__(k, self._hook_with_memo(v, memo))
+# Nesting depth limit of the hook (see set_max_depth); None for no limit
+_max_depth: Union[int, None] = None
 
-    @classmethod
-    def _hook(cls, item: Any) -> Any:
-        """Recursively converts dictionaries in collections to MagiDicts."""
-        if _has_c_hook:
-            return _c_fast_hook(item, cls)
-        return cls._hook_with_memo(item, {})
 
-    @classmethod
-    def _hook_with_memo(cls, item: Any, memo: dict[int, Any]) -> Any:
-        """Recursively converts dictionaries in collections to MagiDicts.
-        Uses a memoization dict to handle circular references."""
+def _check_depth(depth: int) -> None:
+    """Raises RecursionError when a container at depth exceeds _max_depth."""
+    if _max_depth is not None and depth >= _max_depth:
+        raise RecursionError(f"maximum nesting depth of {_max_depth} exceeded while converting to MagiDict")
 
-        if _has_c_hook:
-            return _c_fast_hook_with_memo(item, memo, cls)
 
-        item_id = id(item)
-        if item_id in memo:
-            return memo[item_id]
+def _check_loaded_depth(item: Any, depth: int = 0) -> None:
+    """Applies _max_depth to a document json.loads decoded into MagiDicts,
+    as the C decoder does while parsing; depth is that of item itself."""
+    stack = [(item, depth)]
+    while stack:
+        item, depth = stack.pop()
+        if isinstance(item, (dict, list)):
+            _check_depth(depth)
+            values = dict.values(item) if isinstance(item, dict) else item
+            stack.extend((value, depth + 1) for value in values)
 
-        if isinstance(item, MagiDict):
-            memo[item_id] = item
-            return item
 
-        if isinstance(item, dict):
-            new_dict = cls()
-            memo[item_id] = new_dict
-            for k, v in item.items():
-                new_dict[k] = cls._hook_with_memo(v, memo)
-            return new_dict
+def _check_workers(workers: Any) -> None:
+    """Raises ValueError unless workers is None or a positive integer."""
+    if workers is not None and (not isinstance(workers, int) or isinstance(workers, bool) or workers < 1):
+        raise ValueError("workers must be a positive integer or None")
 
-        if isinstance(item, list):
-            memo[item_id] = item
-            for i, elem in enumerate(item):
-                item[i] = cls._hook_with_memo(elem, memo)
-            return item
 
-        if isinstance(item, tuple):
-            if hasattr(item, "_fields"):
-                hooked_values = tuple(cls._hook_with_memo(elem, memo) for elem in item)
-                return type(item)(*hooked_values)
-            return type(item)(cls._hook_with_memo(elem, memo) for elem in item)
+def _run_in_threads(function: Any, chunks: List[Any]) -> List[Any]:
+    """Calls function on each chunk, the first in the calling thread and the
+    rest in threads of their own, and returns the results in order. The
+    first exception a chunk raised is re-raised once all have finished."""
+    results: List[Any] = [None] * len(chunks)
+    errors: List[BaseException] = []
 
-        if isinstance(item, Sequence) and not isinstance(item, (str, bytes)):
+    def run(i: int) -> None:
+        try:
+            results[i] = function(chunks[i])
+        except BaseException as e:
+            errors.append(e)
+
+    threads = [Thread(target=run, args=(i,)) for i in range(1, len(chunks))]
+    for thread in threads:
+        thread.start()
+    if chunks:
+        run(0)
+    for thread in threads:
+        thread.join()
+    if errors:
+        raise errors[0]
+    return results
+
+
+def _swap_copies(value: Any, copies: dict) -> Any:
+    """value with the duplicate conversions in copies replaced, rebuilding
+    tuples that hold one."""
+    if isinstance(value, tuple):
+        items = [_swap_copies(elem, copies) for elem in value]
+        if all(new is old for new, old in zip(items, value)):
+            return value
+        if type(value) is tuple:
+            return tuple(items)
+        if hasattr(value, "_fields"):
+            return type(value)(*items)
+        return type(value)(items)
+    return copies.get(id(value), value)
+
+
+def _reconcile_memos(memos: List[dict], seed: dict, roots: List[Any]) -> None:
+    """Merges the memos of a conversion split across threads. A source dict
+    reached from more than one slice was converted once per memo; the first
+    copy is kept and, walking the result from roots, references to the
+    others are pointed at it. seed holds the entries every memo started with.
+    The walk only happens when the memos overlap beyond seed."""
+    total = sum(len(memo) for memo in memos) - len(seed) * (len(memos) - 1)
+    if len(set().union(*memos)) == total:
+        return
+
+    first: dict = {}
+    copies: dict = {}
+    for memo in memos:
+        for key, value in memo.items():
+            kept = first.setdefault(key, value)
+            if kept is not value:
+                copies[id(value)] = kept
+    if not copies:
+        return
+
+    seen = set()
+    pending = list(roots)
+    while pending:
+        container = pending.pop()
+        if not isinstance(container, (dict, list, tuple)) or id(container) in seen:
+            continue
+        seen.add(id(container))
+        if isinstance(container, tuple):
+            pending.extend(container)
+            continue
+        is_dict = isinstance(container, dict)
+        for key, value in list(dict.items(container) if is_dict else enumerate(container)):
+            new = _swap_copies(value, copies)
+            if new is not value:
+                if is_dict:
+                    dict.__setitem__(container, key, new)
+                else:
+                    container[key] = new
+            pending.append(new)
+
+
+def _enchant_in_threads(cls: type, d: dict, workers: int) -> Any:
+    """enchant(d, workers=N): the top-level values of d, with the elements of
+    top-level lists counted one by one, are split into workers slices of
+    about equal size that are converted on separate threads, each with its
+    own memo. Lists that are split are converted in place slice by slice."""
+    result = cls()
+    seed = {id(d): result}
+    root_keys = []
+    jobs: List[tuple] = []
+    for key, value in d.items():
+        if type(value) is list and len(value) >= workers:
+            seed[id(value)] = value
+            jobs.append((value, range(len(value))))
+        else:
+            root_keys.append(key)
+    jobs.insert(0, (d, root_keys))
+
+    size = -(-sum(len(keys) for _, keys in jobs) // workers) or 1
+    chunks: List[list] = [[]]
+    room = size
+    for container, keys in jobs:
+        while keys:
+            part, keys = keys[:room], keys[room:]
+            chunks[-1].append((container, part))
+            room -= len(part)
+            if room == 0:
+                chunks.append([])
+                room = size
+
+    def convert(chunk: list) -> tuple:
+        memo = dict(seed)
+        converted = []
+        for container, keys in chunk:
+            if container is not d:
+                if _has_c_hook:
+                    _c_hook_range(container, keys.start, keys.stop, cls, memo)
+                else:
+                    for i in keys:
+                        container[i] = cls._hook_with_memo(container[i], memo)
+            elif _has_c_hook:
+                converted.extend((key, _c_fast_hook_with_memo(d[key], memo, cls)) for key in keys)
+            else:
+                converted.extend((key, cls._hook_with_memo(d[key], memo)) for key in keys)
+        return memo, converted
+
+    results = _run_in_threads(convert, [chunk for chunk in chunks if chunk])
+    converted = {key: value for _, pairs in results for key, value in pairs}
+    for key, value in d.items():
+        dict.__setitem__(result, key, converted[key] if key in converted else value)
+    _reconcile_memos([memo for memo, _ in results], seed, [result])
+    return result
+
+
+def _split_dotted(keys: str) -> List[Any]:
+    """Splits a dotted string into parts, respecting quoted segments."""
+    parts = []
+    current = []
+    quote = None
+    for ch in keys:
+        if ch in ("'", '"'):
+            if quote is None:
+                quote = ch
+            elif quote == ch:
+                quote = None
+        if ch == "." and quote is None:
+            parts.append("".join(current))
+            current = []
+        else:
+            current.append(ch)
+    parts.append("".join(current))
+    return parts
+
+
+def _parse_segment(key: str) -> Any:
+    """Infers the key type of a single dotted-path segment."""
+    if (
+        len(key) > 1 and (key[0] == "'" or key[0] == '"') and key[-1] == key[0]
+    ):  # Quoted string check
+        return key[1:-1]
+    if key.isdigit() or key.removeprefix("-").isdigit():  # Integer checks
+        return int(key)
+    if key == "True":
+        return True
+    if key == "False":
+        return False
+    if key == "None":
+        return None
+    if len(key) > 1 and (
+        (key[0] == "(" and key[-1] == ")")
+    ):  # Data structure checks
+        try:
+            return literal_eval(key)
+        except Exception:
+            return key
+    if (
+        len(key) > 1
+        and ("," in key or "." in key)
+        and all(c.isdigit() or c in "-,." for c in key)
+        and sum(ch in ",." for ch in key) == 1
+        and sum(ch == "-" for ch in key) <= 1
+        and key[1:] != "-"
+        and key[-1] not in ",."
+    ):  # Float checks
+        try:
+            return float(key.replace(",", "."))
+        except (ValueError, TypeError):
+            return key
+    return key
+
+
+@lru_cache(maxsize=1024)
+def _compile_dotted(keys: str) -> tuple:
+    """Splits a dotted key path and parses its segments.
+    Results are cached since the same paths tend to be applied to many records."""
+    if '"' in keys or "'" in keys:
+        if keys.count("'") % 2 == 0 or keys.count('"') % 2 == 0:
+            if _has_c_hook:
+                parts = _c_split_dotted(keys)
+            else:
+                parts = _split_dotted(keys)
+        else:
+            parts = keys.split(".")
+    else:
+        parts = keys.split(".")
+    return tuple(_parse_segment(key) for key in parts)
+
+
+def _py_walk_path(obj: Any, parts: Iterable[Any], missing: Any = None) -> Any:
+    """Follows already parsed path segments starting at obj.
+    Returns missing as soon as a segment cannot be resolved."""
+    for key in parts:
+        if isinstance(obj, _MagiDictBase):
+            # dict's own lookup, so a segment with a dot is not walked again
             try:
-                memo[item_id] = item
-                for i, elem in enumerate(item):
-                    item[i] = cls._hook_with_memo(elem, memo)  # type: ignore[index]
-                return item
-            except TypeError:
-                return type(item)(cls._hook_with_memo(elem, memo) for elem in item)  # type: ignore[call-arg]
+                obj = dict.__getitem__(obj, key)
+            except KeyError:
+                return missing
+        elif isinstance(obj, dict) or isinstance(obj, Mapping):
+            try:
+                obj = obj[key]
+            except KeyError:
+                return missing
+        elif isinstance(obj, (list, tuple)) or (
+            isinstance(obj, Sequence) and not isinstance(obj, (str, bytes))
+        ):
+            if key is not True and key is not False:
+                try:
+                    obj = obj[key]
+                except (IndexError, ValueError, TypeError):
+                    return missing
+            else:
+                return missing
+        else:
+            return missing
+    return obj
+
+
+def _resolve_dotted(obj: Any, keys: str) -> Any:
+    """Walks a dotted key path such as 'a.0.b' starting at obj.
+    Returns None as soon as a segment cannot be resolved."""
+    return _walk_path(obj, _compile_dotted(keys))
+
+
+_walk_path = _c_get_path if _has_c_type else _py_walk_path
+
+
+class MagiPath:
+    """A pre-parsed dotted key path, as returned by MagiDict.compile_path.
+
+    Applying a MagiPath behaves like a nested dotted lookup (md["a.0.b"])
+    without splitting and parsing the string again on every call."""
+
+    __slots__ = ("path", "parts")
+
+    def __init__(self, path: str) -> None:
+        self.path = path
+        self.parts = _compile_dotted(path)
+
+    def get(self, obj: Any, default: Any = None) -> Any:
+        """Resolves the path against obj.
 
+        Parameters:
+            obj: The mapping or sequence to start from.
+            default: Value returned when any segment cannot be resolved.
+
+        Returns:
+            The value at the end of the path, or default.
+        """
+        return _walk_path(obj, self.parts, default)
+
+    __call__ = get
+
+    def __repr__(self) -> str:
+        return f"MagiPath({self.path!r})"
+
+    def __eq__(self, other: object) -> bool:
+        if isinstance(other, MagiPath):
+            return self.path == other.path
+        return NotImplemented
+
+    def __hash__(self) -> int:
+        return hash(self.path)
+
+
+# Bookkeeping of a MagiDict, read and written with _get_state/_set_state. The
+# C type keeps the watchers and copy-on-write state in its object struct; the
+# rest lives in the instance __dict__ under mangled names. Nothing is a class
+# attribute, so keys of the same name stay reachable as attributes.
+# Shared memo of a lazy tree (see enchant)
+_LAZY_MEMO = "_MagiDict__lazy_memo"
+# Token of the key index built by build_index()
+_KEY_INDEX = "_MagiDict__key_index"
+# Token holding the sorted string keys listed by __dir__
+_DIR_KEYS = "_MagiDict__dir_keys"
+# Key index and __dir__ tokens and weak references to copy-on-write fork
+# groups that must hear about mutations of the MagiDict (see build_index and copy)
+_WATCHERS = "_MagiDict__watchers"
+# Set on copy-on-write forks: keys whose value is still borrowed from the
+# source, and the _CowGroup shared by the nodes of the fork
+_COW_PENDING = "_MagiDict__cow_pending"
+_COW_GROUP = "_MagiDict__cow_group"
+_STATE_NAMES = frozenset((_LAZY_MEMO, _KEY_INDEX, _DIR_KEYS, _WATCHERS, _COW_PENDING, _COW_GROUP))
+# Bookkeeping that does not keep a MagiDict from pickling as its bare items
+_CACHE_NAMES = frozenset((_KEY_INDEX, _DIR_KEYS, _WATCHERS))
+
+
+def _py_get_state(md: Any, name: str) -> Any:
+    """Pure Python counterpart of the C get_state: the bookkeeping value of
+    md stored as name, or None."""
+    return object.__getattribute__(md, "__dict__").get(name)
+
+
+def _py_set_state(md: Any, name: str, value: Any) -> None:
+    """Pure Python counterpart of the C set_state; None removes the value."""
+    attrs = object.__getattribute__(md, "__dict__")
+    if value is None:
+        attrs.pop(name, None)
+    else:
+        attrs[name] = value
+
+
+_get_state = _c_get_state if _has_c_type else _py_get_state
+_set_state = _c_set_state if _has_c_type else _py_set_state
+
+
+def _py_lazy_hook(cls: type, item: Any, memo: dict) -> Any:
+    """Converts item one level deep for a lazy MagiDict tree.
+    Dicts become shallow MagiDict copies sharing the tree's memo, lists are
+    converted in place and tuples rebuilt; nothing below that is touched."""
+    if isinstance(item, tuple):
+        values = tuple(_py_lazy_hook(cls, elem, memo) for elem in item)
+        if type(item) is tuple:
+            return values
+        if hasattr(item, "_fields"):
+            return type(item)(*values)
+        return type(item)(values)
+    if not isinstance(item, (dict, list)) or isinstance(item, _MagiDictBase):
         return item
 
+    entry = memo.get(id(item))
+    if entry is not None and entry[0] is item:
+        return entry[1]
+    if isinstance(item, dict):
+        result = cls()
+        dict.update(result, item)
+        _set_state(result, _LAZY_MEMO, memo)
+    else:
+        result = item
+    memo[id(item)] = (item, result)
+
+    if isinstance(item, list):
+        for i, elem in enumerate(item):
+            item[i] = _py_lazy_hook(cls, elem, memo)
+    return result
+
+
+def _py_lazy_materialize(md: dict, key: Any, value: Any) -> Any:
+    """Converts md[key] if md belongs to a lazy tree, storing the result back.
+    In a copy-on-write fork, a child still borrowed from the source is forked."""
+    if isinstance(value, _MagiDictBase):
+        if _get_state(md, _COW_PENDING) is not None:
+            return _py_cow_resolve(md, key, value)
+        return value
+    if not isinstance(value, (dict, list, tuple)):
+        return value
+    memo = _get_state(md, _LAZY_MEMO)
+    if memo is None:
+        return value
+    hooked = _py_lazy_hook(type(md), value, memo)
+    if hooked is not value and key is not _MISSING:
+        dict.__setitem__(md, key, hooked)
+    if _get_state(md, _WATCHERS):
+        _py_share_watchers(md, hooked)
+    return hooked
+
+
+class _PyMagiDictBase(dict):
+    """Pure Python counterpart of the C MagiDictBase type. Holds the hot-path
+    methods (item and attribute access, mget) so MagiDict can inherit them from
+    whichever implementation is available."""
+
     def __getitem__(self, keys: Union[Any, Iterable[Any]]) -> Any:
         """
         - Supports standard dict key access.
@@ -111,97 +496,12 @@ class MagiDict(dict):
             The value associated with the key(s) or None for missing nested keys.
         """
         try:
-            return super().__getitem__(keys)
+            value = super().__getitem__(keys)
         except KeyError:
             if isinstance(keys, str) and "." in keys:
-                if '"' in keys or "'" in keys:
-                    if keys.count("'") % 2 == 0 or keys.count('"') % 2 == 0:
-                        if _has_c_hook:
-                            keys = _c_split_dotted(keys)
-                        else:
-                            keys = self._split_dotted(keys)
-                        obj = self
-                    else:
-                        keys = keys.split(".")
-                        obj = self
-                else:
-                    keys = keys.split(".")
-                    obj = self
-                for key in keys:
-                    if (
-                        len(key) > 1
-                        and (key[0] == "'" or key[0] == '"')
-                        and key[-1] == key[0]
-                    ):  # Quoted string check
-                        key = key[1:-1]
-                    elif (
-                        key.isdigit() or key.removeprefix("-").isdigit()
-                    ):  # Integer checks
-                        key = int(key)
-                    elif key == "True":
-                        key = True
-                    elif key == "False":
-                        key = False
-                    elif key == "None":
-                        key = None
-                    elif len(key) > 1 and (
-                        (key[0] == "(" and key[-1] == ")")
-                    ):  # Data structure checks
-                        try:
-                            key = literal_eval(key)
-                        except Exception:
-                            pass
-                    elif (
-                        len(key) > 1
-                        and ("," in key or "." in key)
-                        and all(c.isdigit() or c in "-,." for c in key)
-                        and sum(ch in ",." for ch in key) == 1
-                        and sum(ch == "-" for ch in key) <= 1
-                        and key[1:] != "-"
-                        and key[-1] not in ",."
-                    ):  # Float checks
-                        try:
-                            key = float(key.replace(",", "."))
-                        except (ValueError, TypeError):
-                            pass
-                    if isinstance(obj, Mapping):
-                        try:
-                            obj = obj[key]
-                        except KeyError:
-                            return None
-                    elif isinstance(obj, Sequence) and not isinstance(
-                        obj, (str, bytes)
-                    ):
-                        if key is not True and key is not False:
-                            try:
-                                obj = obj[key]
-                            except (IndexError, ValueError, TypeError):
-                                return None
-                        else:
-                            return None
-                    else:
-                        return None
-                return obj
+                return _py_lazy_materialize(self, _MISSING, _resolve_dotted(self, keys))
             raise
-
-    def _split_dotted(self, keys: str) -> List[Any]:
-        """Splits a dotted string into parts, respecting quoted segments."""
-        parts = []
-        current = []
-        quote = None
-        for ch in keys:
-            if ch in ("'", '"'):
-                if quote is None:
-                    quote = ch
-                elif quote == ch:
-                    quote = None
-            if ch == "." and quote is None:
-                parts.append("".join(current))
-                current = []
-            else:
-                current.append(ch)
-        parts.append("".join(current))
-        return parts
+        return _py_lazy_materialize(self, keys, value)
 
     def __getattr__(self, name: str) -> Any:
         """
@@ -223,9 +523,7 @@ class MagiDict(dict):
         if super().__contains__(name):
             value = self[name]
             if value is None:
-                md = MagiDict()
-                object.__setattr__(md, "_from_none", True)
-                return md
+                return _NONE_MAGIDICT
             if isinstance(value, dict) and not isinstance(value, MagiDict):
                 value = MagiDict(value)
                 self[name] = value
@@ -233,121 +531,85 @@ class MagiDict(dict):
         try:
             return super().__getattribute__(name)
         except AttributeError:
-            md = MagiDict()
-            object.__setattr__(md, "_from_missing", True)
-            return md
-
-    def __setitem__(self, key, value):
-        """Hook values to convert nested dicts into MagiDicts.
-        Prevent setting values on MagiDicts created from missing or None keys."""
-        self._raise_if_protected()
-        super().__setitem__(key, self._hook(value))
-
-    def __delitem__(self, key):
-        """Prevent deleting items on MagiDicts created from missing or None keys."""
-        self._raise_if_protected()
-        super().__delitem__(key)
-
-    def __dir__(self):
-        """Provides keys as attributes for auto-completion in interactive environments."""
-        key_attrs = sorted(k for k in self.keys() if isinstance(k, str))
-        class_attrs = sorted(self.__class__.__dict__)
-        instance_attrs = sorted(self.__dict__)
-        dict_attrs = sorted(dir(dict))
-
-        ordered = []
-        for group in (key_attrs, class_attrs, instance_attrs, dict_attrs):
-            for attr in group:
-                if attr not in ordered:
-                    ordered.append(attr)
-        return ordered
-
-    def __deepcopy__(self, memo: dict[int, Any]) -> "MagiDict":
-        """Support deep copy of MagiDict, handling circular references."""
-        copied = MagiDict()
-        memo[id(self)] = copied
-        if object.__getattribute__(self, "__dict__").get("_from_none", False):
-            object.__setattr__(copied, "_from_none", True)
-        if object.__getattribute__(self, "__dict__").get("_from_missing", False):
-            object.__setattr__(copied, "_from_missing", True)
-        for k, v in self.items():
-            dict.__setitem__(copied, k, deepcopy(v, memo))
-        return copied
-
-    def __repr__(self):
-        return f"{self.__class__.__name__}({super().__repr__()})"
+            return _MISSING_MAGIDICT
 
-    def __getstate__(self):
+    def __reduce_ex__(self, protocol):
         """
-        Return the state to be pickled. Include both the dict contents and special flags.
+        Custom pickling support. A plain MagiDict is pickled as an empty
+        instance and a copy of its items, restored without running __init__
+        or re-hooking the children, which are MagiDicts already. Plain means
+        the class overrides neither __new__ nor __init__ and the instance holds
+        no attributes besides the key index and __dir__ caches. Anything else
+        calls the class and goes through __getstate__ to keep its flags and
+        instance attributes.
         """
-        state = {
-            "data": dict(self),
-            "_from_none": getattr(self, "_from_none", False),
-            "_from_missing": getattr(self, "_from_missing", False),
-        }
-
-        return state
-
-    def __reduce_ex__(self, protocol):
-        """Custom pickling support to preserve flags across pickle/unpickle."""
-
-        return (self.__class__, (), self.__getstate__(), None, None)
+        cls = type(self)
+        if (
+            cls.__new__ is MagiDict.__new__
+            and cls.__init__ is MagiDict.__init__
+            and object.__getattribute__(self, "__dict__").keys() <= _CACHE_NAMES
+        ):
+            return (_copyreg.__newobj__, (cls,), (dict.copy(self),), None, None)
+        return (cls, (), self.__getstate__(), None, None)
 
     def __setstate__(self, state):
         """
         Restore the state from the unpickled state, preserving special flags.
+        A one-tuple holds the items of a plain MagiDict, stored as they are.
         """
+        if type(state) is tuple:
+            dict.update(self, state[0])
+            return
         if state.get("_from_none", False):
             object.__setattr__(self, "_from_none", True)
         if state.get("_from_missing", False):
             object.__setattr__(self, "_from_missing", True)
+        object.__getattribute__(self, "__dict__").update(state.get("attrs", ()))
         for k, v in state.get("data", {}).items():
             dict.__setitem__(self, k, self._hook(v))
 
-    def update(self, *args, **kwargs):
-        """Recursively convert nested dicts into MagiDicts on update."""
-        self._raise_if_protected()
-        for k, v in dict(*args, **kwargs).items():
-            self[k] = v
-
-    def copy(self):
-        """Return a shallow copy of the MagiDict, preserving special flags."""
-        new_copy = MagiDict(super().copy())
-        if getattr(self, "_from_none", False):
-            object.__setattr__(new_copy, "_from_none", True)
-        if getattr(self, "_from_missing", False):
-            object.__setattr__(new_copy, "_from_missing", True)
-
-        return new_copy
-
-    def setdefault(self, key: Any, default: Any = None) -> Any:
-        """Overrides dict.setdefault to ensure the default value is hooked."""
+    def __setitem__(self, key, value):
+        """Hook values to convert nested dicts into MagiDicts.
+        Prevent setting values on MagiDicts created from missing or None keys."""
         self._raise_if_protected()
-        return super().setdefault(key, self._hook(default))
-
-    @classmethod
-    def fromkeys(cls, seq, value=None):
-        """Overrides dict.fromkeys to ensure the value is hooked."""
-        d = {}
-        for key in seq:
-            d[key] = cls._hook(value)
-        return cls(d)
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        super().__setitem__(key, self._hook(value))  # type: ignore[attr-defined]
+        pending = _get_state(self, _COW_PENDING)
+        if pending is not None:
+            pending.pop(key, None)
 
-    def pop(self, key: Any, *args: Any) -> Any:
-        """Prevent popping items on MagiDicts created from missing or None keys."""
+    def __delitem__(self, key):
+        """Prevent deleting items on MagiDicts created from missing or None keys."""
         self._raise_if_protected()
-        return super().pop(key, *args)
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        super().__delitem__(key)
+        pending = _get_state(self, _COW_PENDING)
+        if pending is not None:
+            pending.pop(key, None)
 
-    def popitem(self):
-        """Prevent popping items on MagiDicts created from missing or None keys."""
+    def update(self, *args, **kwargs):
+        """Recursively convert nested dicts into MagiDicts on update."""
         self._raise_if_protected()
-        return super().popitem()
+        items = dict(*args, **kwargs).items()
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        if type(self).__setitem__ is not _PyMagiDictBase.__setitem__:
+            # Overridden __setitem__ sees every item, as with self[k] = v
+            for k, v in items:
+                self[k] = v
+            return
+        pending = _get_state(self, _COW_PENDING)
+        for k, v in items:
+            dict.__setitem__(self, k, self._hook(v))
+            if pending is not None:
+                pending.pop(k, None)
 
-    def clear(self):
-        """Prevent clearing items on MagiDicts created from missing or None keys."""
-        self._raise_if_protected()
-        super().clear()
+    def __ior__(self, other: Any) -> Any:
+        """self |= other goes through update(), converting the new values."""
+        self.update(other)
+        return self
 
     def mget(self, key: Any, default: Any = _MISSING) -> Any:
         """
@@ -365,18 +627,36 @@ class MagiDict(dict):
             or its value is None.
         """
         if default is _MISSING:
-            md = MagiDict()
-            object.__setattr__(md, "_from_missing", True)
-            default = md
+            default = _MISSING_MAGIDICT
         if super().__contains__(key):
             value = self[key]
             if value is None and default is not None:
-                md = MagiDict()
-                object.__setattr__(md, "_from_none", True)
-                return md
+                return _NONE_MAGIDICT
             return value
         return default
 
+    def get(self, key: Any, default: Any = None) -> Any:
+        """Overrides dict.get so lazy MagiDicts convert the value they return."""
+        if dict.__contains__(self, key):
+            return _py_lazy_materialize(self, key, dict.__getitem__(self, key))
+        return default
+
+    def _materialize_all(self) -> None:
+        """Converts every direct value of a lazy MagiDict or copy-on-write fork."""
+        if _get_state(self, _LAZY_MEMO) is not None or _get_state(self, _COW_PENDING) is not None:
+            for key in list(dict.keys(self)):
+                _py_lazy_materialize(self, key, dict.__getitem__(self, key))
+
+    def values(self):  # type: ignore[override]
+        """Overrides dict.values so lazy MagiDicts convert their values first."""
+        self._materialize_all()
+        return super().values()
+
+    def items(self):  # type: ignore[override]
+        """Overrides dict.items so lazy MagiDicts convert their values first."""
+        self._materialize_all()
+        return super().items()
+
     def _raise_if_protected(self):
         """Raises TypeError if this MagiDict was created from a None or missing key,
         preventing modifications to. It can however be bypassed with dict methods."""
@@ -389,243 +669,2211 @@ class MagiDict(dict):
         """
         return self.mget(key, default)
 
-    def strict_get(self, key: Any) -> Any:
-        """
-        Strict get method that mimics standard dict access.
 
-        Parameters:
-            key: The key to retrieve.
+_MagiDictBase: type = _CMagiDictBase if _has_c_type else _PyMagiDictBase
 
-        Returns:
-            The value associated with the key.
-        """
-        return super().__getitem__(key)
 
-    def sget(self, key: Any) -> Any:
-        """
-        Shorthand for strict_get() method.
-        """
-        return self.strict_get(key)
+class _PyKeyAttr:
+    """Pure Python counterpart of the C KeyAttr descriptor: reads one key of
+    a specialized MagiDict without going through __getattr__."""
 
-    def sg(self, key: Any) -> Any:
-        """
-        Shorthand for strict_get() method.
-        """
-        return self.strict_get(key)
+    __slots__ = ("key",)
 
-    def disenchant(self: "MagiDict") -> dict:
-        """
-        Convert MagiDict and all nested MagiDicts back into standard dicts,
-        handling circular references gracefully.
+    def __init__(self, key: str) -> None:
+        self.key = key
 
-        Returns:
-            A standard dict representing the MagiDict and its nested structures.
-        """
-        memo: dict[int, Any] = {}
+    def __get__(self, obj: Any, owner: Any = None) -> Any:
+        if obj is None:
+            return self
+        value = dict.get(obj, self.key, _MISSING)
+        if value is _MISSING:
+            return _MISSING_MAGIDICT
+        if (
+            value is None
+            or type(value) is dict
+            or _get_state(obj, _LAZY_MEMO) is not None
+            or _get_state(obj, _COW_PENDING) is not None
+        ):
+            return obj.__getattr__(self.key)
+        return value
 
-        def _disenchant_recursive(item: Any) -> Any:
-            item_id = id(item)
-            if item_id in memo:
-                return memo[item_id]
 
-            if isinstance(item, MagiDict):
-                new_dict: dict = {}
-                memo[item_id] = new_dict
-                for k, v in item.items():
-                    new_dict[k] = _disenchant_recursive(v)
-                return new_dict
+_KeyAttr: type = _CKeyAttr if _has_c_type else _PyKeyAttr
 
-            elif isinstance(item, dict):
-                new_dict = {}
-                memo[item_id] = new_dict
-                for k, v in item.items():
-                    new_dict[_disenchant_recursive(k)] = _disenchant_recursive(v)
-                return new_dict
+# Classes made by MagiDict.specialize(), by (base class, attribute names)
+_specialized: dict = {}
 
-            elif isinstance(item, tuple):
-                if hasattr(item, "_fields"):
-                    disenchanted_values = tuple(
-                        _disenchant_recursive(elem) for elem in item
-                    )
-                    return type(item)(*disenchanted_values)
-                return tuple(_disenchant_recursive(elem) for elem in item)
 
-            elif isinstance(item, Sequence) and not isinstance(item, (str, bytes)):
-                new_list: list = []
-                memo[item_id] = new_list
-                for elem in item:
-                    new_list.append(_disenchant_recursive(elem))  # type: ignore[index]
+def _schema_keys(schema: Any) -> set:
+    """Collects the str keys of a sample record, nested mappings and
+    sequences included, or the names of an iterable of keys."""
+    if isinstance(schema, str):
+        raise TypeError("schema must be a mapping or an iterable of keys, not str")
+    if not isinstance(schema, Mapping):
+        return {k for k in schema if isinstance(k, str)}
+    keys = set()
+    seen = set()
+    stack = [schema]
+    while stack:
+        item = stack.pop()
+        if id(item) in seen:
+            continue
+        seen.add(id(item))
+        if isinstance(item, Mapping):
+            keys.update(k for k in item if isinstance(k, str))
+            stack.extend(item.values())
+        elif isinstance(item, (list, tuple)):
+            stack.extend(item)
+    return keys
 
-                if not isinstance(item, list):
-                    try:
-                        return type(item)(new_list)  # type: ignore[call-arg]
-                    except TypeError:
-                        return new_list
-                return new_list
 
-            elif isinstance(item, (set, frozenset)):
+def _new_specialized(base: type, names: tuple) -> Any:
+    """Unpickling helper: an empty instance of base.specialize(names)."""
+    spec = base.specialize(names)
+    return spec.__new__(spec)
 
-                new_set = type(item)(_disenchant_recursive(e) for e in item)
-                memo[item_id] = new_set
-                return new_set
 
-            return item
+def _specialized_reduce_ex(self: Any, protocol: int) -> tuple:
+    cls = type(self)
+    reduced = _MagiDictBase.__reduce_ex__(self, protocol)
+    return (_new_specialized, (cls._specialized_base, cls._specialized_keys)) + reduced[2:]
 
-        return _disenchant_recursive(self)
 
-    def search_key(self, key: Any, default=None) -> Union[Any, None]:
-        """
-        Recursively search for a key in the MagiDict and its nested structures.
-        Returns the value if found, otherwise returns None or the specified default.
+class MagiDict(_MagiDictBase):  # type: ignore[valid-type,misc]
+    """A dictionary that supports attribute-style access and recursive conversion
+    of nested dictionaries into MagiDicts. It also supports safe access to missing
+    keys and keys with None values by returning empty MagiDicts, allowing for
+    safe chaining of attribute accesses."""
 
-        Parameters:
-            key: The key to search for.
+    def __init__(self, *args: Union[dict, Mapping], **kwargs: Any) -> None:
+        """Initialize the MagiDict, recursively converting nested dicts.
+        Supports initialization with a single dict, mapping, or standard dict args/kwargs.
+        """
+        self._raise_if_protected()
+        super().__init__()
+        if len(args) == 1 and not kwargs and isinstance(args[0], dict):
+            input_dict = args[0]
+        else:
+            input_dict = dict(*args, **kwargs)
+        if _has_c_hook and type(input_dict) is dict:
+            _c_hook_into(self, input_dict, type(self))
+            return
+        memo = {id(input_dict): self}
+        for k, v in input_dict.items():
+            dict.__setitem__(self, k, self._hook_with_memo(v, memo))
+
+    @classmethod
+    def _hook(cls, item: Any) -> Any:
+        """Recursively converts dictionaries in collections to MagiDicts."""
+        if _has_c_hook:
+            return _c_fast_hook(item, cls)
+        return cls._hook_with_memo(item, {})
+
+    @classmethod
+    def _hook_with_memo(
+        cls, item: Any, memo: dict[int, Any], keys: Union[dict, None] = None, depth: int = 0
+    ) -> Any:
+        """Recursively converts dictionaries in collections to MagiDicts.
+        Uses a memoization dict to handle circular references. If keys is
+        given, str keys are replaced by the equal string already in it.
+        depth is the number of containers enclosing item (see set_max_depth)."""
+
+        if _has_c_hook:
+            return _c_fast_hook_with_memo(item, memo, cls)
+
+        item_id = id(item)
+        if item_id in memo:
+            return memo[item_id]
+
+        if isinstance(item, MagiDict):
+            memo[item_id] = item
+            return item
+
+        if isinstance(item, dict):
+            _check_depth(depth)
+            new_dict = cls()
+            memo[item_id] = new_dict
+            for k, v in item.items():
+                if keys is not None and type(k) is str:
+                    k = keys.setdefault(k, k)
+                dict.__setitem__(new_dict, k, cls._hook_with_memo(v, memo, keys, depth + 1))
+            return new_dict
+
+        if isinstance(item, list):
+            _check_depth(depth)
+            memo[item_id] = item
+            for i, elem in enumerate(item):
+                item[i] = cls._hook_with_memo(elem, memo, keys, depth + 1)
+            return item
+
+        if isinstance(item, tuple):
+            _check_depth(depth)
+            if hasattr(item, "_fields"):
+                hooked_values = tuple(cls._hook_with_memo(elem, memo, keys, depth + 1) for elem in item)
+                return type(item)(*hooked_values)
+            return type(item)(cls._hook_with_memo(elem, memo, keys, depth + 1) for elem in item)
+
+        if isinstance(item, (MagiViewList, _SnapshotList)):
+            # Read-only views already wrap their items, as in the C hook
+            return item
+
+        if isinstance(item, Sequence) and not isinstance(item, (str, bytes)):
+            _check_depth(depth)
+            try:
+                memo[item_id] = item
+                for i, elem in enumerate(item):
+                    item[i] = cls._hook_with_memo(elem, memo, keys, depth + 1)  # type: ignore[index]
+                return item
+            except TypeError:
+                return type(item)(
+                    cls._hook_with_memo(elem, memo, keys, depth + 1) for elem in item  # type: ignore[call-arg]
+                )
+
+        return item
+
+    @classmethod
+    def from_records(
+        cls,
+        records: Iterable[dict],
+        intern_keys: bool = False,
+        compact: bool = False,
+        workers: Union[int, None] = None,
+    ) -> Union[List["MagiDict"], "MagiRecords"]:
+        """
+        Convert a batch of dictionaries in one call. All records share one
+        memo, so objects shared between records keep their identity.
+
+        Parameters:
+            records: An iterable of dicts.
+            intern_keys: If True, equal str keys across the batch share one
+                         string object, saving memory on homogeneous records.
+            compact: If True, return a MagiRecords that keeps each plain dict
+                     record as a tuple of values against a key tuple shared by
+                     all records with the same keys, read through MagiRow
+                     views until it is changed.
+            workers: If more than 1, split the records into that many
+                     contiguous slices converted on separate threads. They
+                     only run in parallel when the GIL is disabled, which the
+                     C extension does not allow.
+
+        Returns:
+            A list with one MagiDict per record; instances of cls are kept as
+            they are. With compact=True, a MagiRecords holding the same records.
+        """
+        _check_workers(workers)
+        if workers is None or workers == 1:
+            converted = cls._convert_records(records, intern_keys, compact, None)
+        else:
+            records = records if isinstance(records, list) else list(records)
+            size = -(-len(records) // workers) or 1
+            starts = list(range(0, len(records), size))
+            interned = {} if intern_keys else False
+            memos: List[dict] = [{} for _ in starts]
+            parts = _run_in_threads(
+                lambda i: cls._convert_records(records, interned, compact, memos[i], starts[i], starts[i] + size),
+                list(range(len(starts))),
+            )
+            if compact:
+                converted = ([k for part in parts for k in part[0]], [r for part in parts for r in part[1]])
+                _reconcile_memos(memos, {}, [converted[1]])
+            else:
+                converted = [r for part in parts for r in part]
+                _reconcile_memos(memos, {}, [converted])
+        if compact:
+            keys, rows = converted
+            return MagiRecords._from_rows(cls, keys, rows)
+        return converted
+
+    @classmethod
+    def _convert_records(
+        cls,
+        records: Iterable[dict],
+        intern_keys: Union[bool, dict],
+        compact: bool,
+        memo: Union[dict, None],
+        start: int = 0,
+        stop: Union[int, None] = None,
+    ) -> Any:
+        """from_records for records[start:stop] (a list) or all of records,
+        using memo (None for a private one). intern_keys may be the dict to
+        intern keys into. Returns the list of records, or (keys, rows) with
+        compact=True."""
+        if _has_c_hook:
+            if stop is None:
+                return _c_hook_many(records, cls, intern_keys, compact, memo)
+            return _c_hook_many(records, cls, intern_keys, compact, memo, start, stop)
+        if stop is not None:
+            records = records[start:stop]  # type: ignore[index]
+        memo = {} if memo is None else memo
+        interned: Union[dict, None] = (
+            intern_keys if isinstance(intern_keys, dict) else ({} if intern_keys else None)
+        )
+        schemas: dict = {}
+        keys = []
+        result = []
+        for record in records:
+            if not isinstance(record, dict):
+                raise TypeError(f"Expected dict, got {type(record).__name__}")
+            if compact and type(record) is dict and id(record) not in memo:
+                ks = tuple(
+                    interned.setdefault(k, k) if interned is not None and type(k) is str else k
+                    for k in record
+                )
+                values = tuple(cls._hook_with_memo(v, memo, interned) for v in record.values())
+                if id(record) not in memo:
+                    keys.append(schemas.setdefault(ks, ks))
+                    result.append(values)
+                    continue
+            keys.append(None)
+            result.append(cls._hook_with_memo(record, memo, interned))
+        if compact:
+            return keys, result
+        return result
+
+    @classmethod
+    def specialize(cls, sample_or_schema: Union[Mapping, Iterable[str]]) -> type:
+        """
+        Return a subclass of cls with an attribute descriptor for each key of
+        the schema, so reading a known key as an attribute is a direct lookup
+        instead of a trip through __getattr__. Nested dicts of an instance are
+        instances of the same subclass, so the keys of nested records count
+        too. Unknown keys behave as in cls. Classes are cached per schema.
+
+        Parameters:
+            sample_or_schema: A sample record, whose keys and nested keys are
+                              used, or an iterable of key names.
+
+        Returns:
+            The specialized subclass.
+        """
+        names = tuple(
+            sorted(
+                k
+                for k in _schema_keys(sample_or_schema)
+                if k.isidentifier()
+                and k not in ("_from_none", "_from_missing")
+                and not any(k in vars(klass) for klass in cls.__mro__)
+            )
+        )
+        spec = _specialized.get((cls, names))
+        if spec is None:
+            namespace = {name: _KeyAttr(name) for name in names}
+            namespace.update(
+                __module__=cls.__module__,
+                __qualname__=cls.__qualname__,
+                __reduce_ex__=_specialized_reduce_ex,
+                _specialized_base=cls,
+                _specialized_keys=names,
+            )
+            spec = type(cls.__name__, (cls,), namespace)
+            _specialized[(cls, names)] = spec
+        return spec
+
+    def __dir__(self):
+        """Provides keys as attributes for auto-completion in interactive environments.
+        The sorted keys are cached like the key index of build_index(), so they are
+        only listed again after the MagiDict is modified."""
+        token = _get_state(self, _DIR_KEYS)
+        if not token:
+            token = [sorted(k for k in dict.keys(self) if isinstance(k, str))]
+            _set_state(self, _DIR_KEYS, token)
+            if self is not _NONE_MAGIDICT and self is not _MISSING_MAGIDICT:
+                _add_watcher(self, token)
+        key_attrs = token[0]
+        class_attrs = sorted(
+            {
+                attr
+                for klass in type(self).__mro__
+                if klass not in (dict, object)
+                for attr in vars(klass)
+            }
+        )
+        instance_attrs = sorted(name for name in self.__dict__ if name not in _STATE_NAMES)
+        dict_attrs = sorted(dir(dict))
+
+        ordered = list(key_attrs)
+        seen = set(key_attrs)
+        for group in (class_attrs, instance_attrs, dict_attrs):
+            for attr in group:
+                if attr not in seen:
+                    seen.add(attr)
+                    ordered.append(attr)
+        return ordered
+
+    def __deepcopy__(self, memo: dict[int, Any]) -> "MagiDict":
+        """Support deep copy of MagiDict, handling circular references."""
+        copied = MagiDict()
+        memo[id(self)] = copied
+        if object.__getattribute__(self, "__dict__").get("_from_none", False):
+            object.__setattr__(copied, "_from_none", True)
+        if object.__getattribute__(self, "__dict__").get("_from_missing", False):
+            object.__setattr__(copied, "_from_missing", True)
+        for k, v in self.items():
+            dict.__setitem__(copied, k, deepcopy(v, memo))
+        return copied
+
+    def __repr__(self):
+        return f"{self.__class__.__name__}({super().__repr__()})"
+
+    def __getstate__(self):
+        """
+        Return the state to be pickled. Include the dict contents, special flags
+        and any instance attributes, leaving out MagiDict's own bookkeeping.
+        """
+        state = {
+            "data": dict(self),
+            "_from_none": getattr(self, "_from_none", False),
+            "_from_missing": getattr(self, "_from_missing", False),
+        }
+        attrs = {
+            name: value
+            for name, value in object.__getattribute__(self, "__dict__").items()
+            if name not in _STATE_NAMES and name not in ("_from_none", "_from_missing")
+        }
+        if attrs:
+            state["attrs"] = attrs
+        return state
+
+    def deep_merge(self, other: Mapping, strategy: str = "replace") -> None:
+        """
+        Merges another mapping into this one in place, key by key. Nested
+        mappings are merged into the MagiDicts already here (or into a new
+        MagiDict for keys that are missing), so only the keys present in
+        other are visited and no MagiDict of other ends up shared with this
+        one. Lists and tuples taken from other are stored as copies. To layer overlays over a base without changing it, merge them
+        into base.copy(cow=True).
+
+        Parameters:
+            other: The mapping to merge in.
+            strategy: What happens to values that are not both mappings:
+                "replace" (default) overwrites them with the value from other,
+                "append" does the same except that a list is extended by a
+                list or tuple from other, and "keep" leaves existing values
+                alone, only filling in missing keys.
+
+        A mapping of other that is reached again through a cycle is not
+        merged a second time: its key is pointed back at the MagiDict that
+        mapping is being merged into, so the result keeps the cycle.
+        """
+        if _has_c_type:
+            return _c_deep_merge(self, other, strategy)
+        if strategy not in _MERGE_STRATEGIES:
+            raise ValueError(f"strategy must be 'replace', 'append' or 'keep', not {strategy!r}")
+        if not isinstance(other, Mapping):
+            raise TypeError(f"deep_merge expects a mapping, got {type(other).__name__}")
+        _py_deep_merge(self, other, strategy, {})
+
+    def copy(self, cow: bool = False) -> "MagiDict":
+        """
+        Return a copy of the MagiDict, preserving special flags.
+
+        Parameters:
+            cow: If False, the copy is shallow. If True, it is a copy-on-write
+                 fork: it behaves like a deep copy, but nested MagiDicts stay
+                 shared with the original until they are reached through the
+                 fork or modified through item assignment, deletion, update(),
+                 pop(), popitem(), setdefault() or clear() in either tree.
+                 Lists, tuples and sets are copied along with the MagiDict
+                 holding them; other values are shared.
+
+        Returns:
+            The new MagiDict.
+        """
+        if cow:
+            return _cow_copy(self)
+        if _get_state(self, _COW_PENDING) is not None:
+            self._materialize_all()
+        new_copy = MagiDict()
+        dict.update(new_copy, self)
+        if getattr(self, "_from_none", False):
+            object.__setattr__(new_copy, "_from_none", True)
+        if getattr(self, "_from_missing", False):
+            object.__setattr__(new_copy, "_from_missing", True)
+        memo = _get_state(self, _LAZY_MEMO)
+        if memo is not None:
+            _set_state(new_copy, _LAZY_MEMO, memo)
+        return new_copy
+
+    def __setattr__(self, name: str, value: Any) -> None:
+        """Prevent setting attributes on the shared MagiDicts returned for
+        missing or None keys."""
+        self._raise_if_protected()
+        object.__setattr__(self, name, value)
+
+    def __delattr__(self, name: str) -> None:
+        """Prevent deleting attributes on MagiDicts created from missing or None keys."""
+        self._raise_if_protected()
+        object.__delattr__(self, name)
+
+    def _is_lazy(self) -> bool:
+        """Whether some values are only converted when first reached: the
+        MagiDict belongs to a tree created with enchant(d, lazy=True) or is a
+        copy-on-write fork still borrowing children."""
+        return _get_state(self, _LAZY_MEMO) is not None or _get_state(self, _COW_PENDING) is not None
+
+    def setdefault(self, key: Any, default: Any = None) -> Any:
+        """Overrides dict.setdefault to ensure the default value is hooked."""
+        self._raise_if_protected()
+        if self._is_lazy() and dict.__contains__(self, key):
+            return self[key]
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        return super().setdefault(key, self._hook(default))
+
+    @classmethod
+    def fromkeys(cls, seq, value=None):
+        """Overrides dict.fromkeys to ensure the value is hooked."""
+        d = {}
+        for key in seq:
+            d[key] = cls._hook(value)
+        return cls(d)
+
+    def pop(self, key: Any, *args: Any) -> Any:
+        """Prevent popping items on MagiDicts created from missing or None keys."""
+        self._raise_if_protected()
+        if self._is_lazy() and dict.__contains__(self, key):
+            self[key]
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        return super().pop(key, *args)
+
+    def popitem(self):
+        """Prevent popping items on MagiDicts created from missing or None keys."""
+        self._raise_if_protected()
+        if self._is_lazy():
+            self._materialize_all()
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        return super().popitem()
+
+    def clear(self):
+        """Prevent clearing items on MagiDicts created from missing or None keys."""
+        self._raise_if_protected()
+        if _get_state(self, _WATCHERS):
+            _notify_watchers(self)
+        super().clear()
+        _set_state(self, _COW_PENDING, None)
+
+    def strict_get(self, key: Any) -> Any:
+        """
+        Strict get method that mimics standard dict access.
+
+        Parameters:
+            key: The key to retrieve.
+
+        Returns:
+            The value associated with the key.
+        """
+        value = dict.__getitem__(self, key)
+        if self._is_lazy():
+            return self.get(key)
+        return value
+
+    def sget(self, key: Any) -> Any:
+        """
+        Shorthand for strict_get() method.
+        """
+        return self.strict_get(key)
+
+    def sg(self, key: Any) -> Any:
+        """
+        Shorthand for strict_get() method.
+        """
+        return self.strict_get(key)
+
+    @staticmethod
+    def compile_path(path: str) -> MagiPath:
+        """
+        Parses a dotted key path once so it can be applied to many objects.
+
+        Parameters:
+            path: A dot-separated key path using the same rules as md["a.0.b"].
+
+        Returns:
+            A MagiPath; call it (or its get() method) with a mapping to resolve it.
+        """
+        return MagiPath(path)
+
+    @staticmethod
+    def extract(records: Iterable[Any], paths: Iterable[Any], arrays: bool = False) -> dict:
+        """
+        Pulls the same paths out of many records at once, column by column.
+
+        Parameters:
+            records: Mappings (MagiDicts or plain dicts) to read from.
+            paths: Keys or dotted paths such as "user.id" or "items.0.sku",
+                resolved like md[path]; a tuple is taken as already split keys.
+            arrays: If True, columns holding only ints become array('q') and
+                columns holding only floats become array('d'); columns mixing
+                ints and floats stay lists so large ints keep their value.
+
+        Returns:
+            A dict mapping each path to a list with one value per record,
+            None where the path is missing.
+        """
+        if _has_c_type:
+            return _c_extract(records, paths, arrays)
+        if isinstance(paths, str):
+            raise TypeError("paths must be a list of paths, not a string")
+        rows = list(records)
+        result = {}
+        for path in paths:
+            if isinstance(path, tuple):
+                parts = path
+            elif isinstance(path, str):
+                parts = _compile_dotted(path) if "." in path else (path,)
+            else:
+                raise TypeError(f"paths must be str or tuples of keys, not {type(path).__name__}")
+            column = [_py_extract_value(record, path, parts) for record in rows]
+            result[path] = _extract_array(column) if arrays else column
+        return result
+
+    def save_snapshot(self, path: Any) -> None:
+        """
+        Writes the tree to a binary snapshot file that MagiDict.open_snapshot
+        can map into memory. Only dicts, lists, tuples, str, bytes, int,
+        float, bool and None can be stored; values shared in the tree are
+        stored once. The snapshot is written to a temporary file next to path,
+        synced to disk and then moved over path atomically, so processes that
+        have the old snapshot open keep reading it and a failed write leaves
+        nothing behind. The file keeps the permissions of the snapshot it
+        replaces; a new one gets those open() would give it.
+
+        Parameters:
+            path: The file to write.
+        """
+        path = fspath(path)
+        file = _NamedTemporaryFile("wb", dir=_dirname(_abspath(path)), delete=False)
+        try:
+            with file:
+                _SnapshotWriter(file).write(self)
+                file.flush()
+                _fsync(file.fileno())
+            _chmod(file.name, _snapshot_mode(path))
+            _replace(file.name, path)
+        except BaseException:
+            _unlink(file.name)
+            raise
+
+    @staticmethod
+    def open_snapshot(path: Any) -> "MagiSnapshot":
+        """
+        Opens a file written by save_snapshot without reading it in.
+
+        Parameters:
+            path: The snapshot file.
+
+        Returns:
+            A read-only MagiSnapshot; values are decoded as they are accessed.
+        """
+        return MagiSnapshot(_Snapshot(path).root())
+
+    def disenchant(self: "MagiDict") -> dict:
+        """
+        Convert MagiDict and all nested MagiDicts back into standard dicts,
+        handling circular references gracefully.
+
+        Returns:
+            A standard dict representing the MagiDict and its nested structures.
+        """
+        if _has_c_type:
+            return _c_fast_unhook(self)
+        memo: dict[int, Any] = {}
+
+        def _disenchant_recursive(item: Any) -> Any:
+            item_id = id(item)
+            if item_id in memo:
+                return memo[item_id]
+
+            if isinstance(item, MagiDict):
+                new_dict: dict = {}
+                memo[item_id] = new_dict
+                for k, v in dict.items(item):
+                    new_dict[k] = _disenchant_recursive(v)
+                return new_dict
+
+            elif isinstance(item, dict):
+                new_dict = {}
+                memo[item_id] = new_dict
+                for k, v in item.items():
+                    new_dict[_disenchant_recursive(k)] = _disenchant_recursive(v)
+                return new_dict
+
+            elif isinstance(item, tuple):
+                if hasattr(item, "_fields"):
+                    disenchanted_values = tuple(
+                        _disenchant_recursive(elem) for elem in item
+                    )
+                    return type(item)(*disenchanted_values)
+                return tuple(_disenchant_recursive(elem) for elem in item)
+
+            elif isinstance(item, Sequence) and not isinstance(item, (str, bytes)):
+                new_list: list = []
+                memo[item_id] = new_list
+                for elem in item:
+                    new_list.append(_disenchant_recursive(elem))  # type: ignore[index]
+
+                if not isinstance(item, list):
+                    try:
+                        return type(item)(new_list)  # type: ignore[call-arg]
+                    except TypeError:
+                        return new_list
+                return new_list
+
+            elif isinstance(item, (set, frozenset)):
+
+                new_set = type(item)(_disenchant_recursive(e) for e in item)
+                memo[item_id] = new_set
+                return new_set
+
+            return item
+
+        return _disenchant_recursive(self)
+
+    def search_key(self, key: Any, default=None) -> Union[Any, None]:
+        """
+        Recursively search for a key in the MagiDict and its nested structures.
+        Returns the value if found, otherwise returns None or the specified default.
+        Uses the key index when build_index() has been called.
+
+        Parameters:
+            key: The key to search for.
             default: The value to return if the key is not found.
 
-        Returns:
-            The value associated with the specified key, or None/default if not found.
-        """
-        for k, v in self.items():
-            if k == key:
-                return v
+        Returns:
+            The value associated with the specified key, or None/default if not found.
+        """
+        entries = self._index_entries(key)
+        if entries is None:
+            return _search_key_in(self, key, default)
+        return _indexed_search_key(entries, default)
+
+    def search_keys(self, key: Any) -> List[Any]:
+        """
+        Recursively search for all occurrences of a key in the MagiDict and its nested structures.
+        Returns a list of all found values. Uses the key index when build_index() has been called.
+
+        Parameters:
+            key: The key to search for.
+
+        Returns:
+            A list of all values associated with the specified key.
+        """
+        entries = self._index_entries(key)
+        if entries is None:
+            return _search_keys_in(self, key)
+        return [value for _, value, _ in entries]
+
+    def build_index(self) -> None:
+        """
+        Index every key in the MagiDict and its nested structures, so that
+        search_key() and search_keys() become dictionary lookups. The index is
+        dropped when any MagiDict in the tree is modified through item
+        assignment, deletion, update(), |=, pop(), popitem(), setdefault() or
+        clear(), and rebuilt on the next search. Changes made to nested lists
+        or via plain dict methods are not tracked; call build_index() again
+        after them.
+        """
+        token: List[Any] = []
+        token.append(_build_key_index(self, token))
+        _set_state(self, _KEY_INDEX, token)
+
+    def _index_entries(self, key: Any) -> Union[List[Any], None]:
+        """(path, value, reachable) occurrences of key from the key index, or
+        None when no index was built or key cannot be looked up in it."""
+        token = _get_state(self, _KEY_INDEX)
+        if token is None:
+            return None
+        if not token:
+            self.build_index()
+            token = _get_state(self, _KEY_INDEX)
+        try:
+            return token[0].get(key, [])
+        except TypeError:
+            return None
+
+    def filter(self, function: Any, drop_empty=False, batch=False) -> "MagiDict":
+        """
+        Returns a new MagiDict containing only the items for which the function(value) or function(key, value)
+        returns True. Supports nested dicts and sequences. If drop_empty is True, empty MagiDicts and sequences
+        are omitted from the result.
+
+        Parameters:
+            function: A function that takes one argument (value) or two arguments (key, value) and returns True or False.
+                      If None, filters out items with value None.
+            drop_empty: If True, empty MagiDicts and data structures are omitted from the result.
+            batch: If True, function is called once with the list of all leaf values (and, for two
+                   arguments, first the list of their keys or indices) and must return one result per value.
+
+        Returns:
+            A new MagiDict with filtered items.
+        """
+        return _filter_in(self, function, drop_empty, batch)
+
+
+def _py_extract_value(record: Any, path: Any, parts: tuple) -> Any:
+    """record[path] with the semantics of MagiDict.__getitem__ for dotted
+    paths, or None when the path is missing."""
+    if isinstance(record, MagiDict) and isinstance(path, str):
+        try:
+            return record[path]
+        except KeyError:
+            return None
+    if isinstance(record, dict) and isinstance(path, str) and path in record:
+        return record[path]
+    value = _py_walk_path(record, parts)
+    if isinstance(record, MagiDict):
+        return _py_lazy_materialize(record, _MISSING, value)
+    return value
+
+
+def _extract_array(column: list) -> Any:
+    """column as array('q') or array('d') when it is all ints or all floats."""
+    if not column:
+        return column
+    if all(type(value) is int for value in column):
+        try:
+            return _array("q", column)
+        except OverflowError:
+            return column
+    if all(type(value) is float for value in column):
+        return _array("d", column)
+    return column
+
+
+def _is_not_none(value: Any) -> bool:
+    """Default filter() predicate."""
+    return value is not None
+
+
+def _are_not_none(values: List[Any]) -> List[bool]:
+    """Default batch filter() predicate."""
+    return [value is not None for value in values]
+
+
+def _arity(function: Any) -> int:
+    """Number of parameters inspect.signature reports for function, read
+    straight from the code object for plain functions."""
+    code = getattr(function, "__code__", None)
+    if (
+        type(function) is FunctionType
+        and not hasattr(function, "__wrapped__")
+        and not hasattr(function, "__signature__")
+    ):
+        return (
+            code.co_argcount  # type: ignore[union-attr]
+            + code.co_kwonlyargcount  # type: ignore[union-attr]
+            + bool(code.co_flags & CO_VARARGS)  # type: ignore[union-attr]
+            + bool(code.co_flags & CO_VARKEYWORDS)  # type: ignore[union-attr]
+        )
+    return len(signature(function).parameters)
+
+
+def _filter_in(mapping: Mapping, function: Any, drop_empty: bool, batch: bool) -> MagiDict:
+    """Shared implementation of MagiDict.filter and MagiView.filter."""
+    if function is None:
+        function = _are_not_none if batch else _is_not_none
+    num_args = _arity(function)
+    if _has_c_type:
+        return _c_filter(mapping, function, num_args, drop_empty, batch)
+    if not batch:
+        return _filter_mapping(mapping, function, num_args, drop_empty)
+
+    # Collect every leaf in traversal order, then replay the results
+    keys: List[Any] = []
+    values: List[Any] = []
+
+    def collect(key: Any, value: Any) -> bool:
+        keys.append(key)
+        values.append(value)
+        return False
+
+    _filter_mapping(mapping, collect, 2, drop_empty)
+    flags = list(function(keys, values) if num_args == 2 else function(values))
+    if len(flags) != len(values):
+        raise ValueError(
+            f"a batch filter predicate must return one result per value ({len(values)}), got {len(flags)}"
+        )
+    replay = iter(flags)
+    return _filter_mapping(mapping, lambda key, value: next(replay), 2, drop_empty)
+
+
+def _filter_sequence(
+    seq: Sequence, function: Any, num_args: int, drop_empty: bool
+) -> Union[List[Any], None]:
+    """Recursively filter nested sequences while preserving structure."""
+    new_seq: List[Any] = []
+    for i, item in enumerate(seq):
+        if isinstance(item, Mapping):
+            nested = _filter_mapping(item, function, num_args, drop_empty)
+            if nested or not drop_empty:
+                new_seq.append(nested)
+        elif isinstance(item, Sequence) and not isinstance(item, (str, bytes)):
+            nested = _filter_sequence(item, function, num_args, drop_empty)  # type: ignore[assignment]
+            if nested or not drop_empty:
+                new_seq.append(nested)
+        else:
+            if num_args == 2:
+                if function(i, item):
+                    new_seq.append(item)
+            else:
+                if function(item):
+                    new_seq.append(item)
+    if new_seq or not drop_empty:
+        try:
+            return type(seq)(new_seq)  # type: ignore
+        except TypeError:
+            return new_seq
+    return None
+
+
+def _filter_mapping(
+    mapping: Mapping, function: Any, num_args: int, drop_empty: bool
+) -> MagiDict:
+    """Builds the filtered MagiDict for MagiDict.filter and MagiView.filter.
+    Nested mappings are read in place, without converting them first, and
+    results are stored without hooking them again."""
+    filtered: MagiDict = MagiDict()
+
+    for k, v in mapping.items():
+        if isinstance(v, Mapping):
+            nested = _filter_mapping(v, function, num_args, drop_empty)
+            if nested or not drop_empty:
+                dict.__setitem__(filtered, k, nested)
+        elif isinstance(v, Sequence) and not isinstance(v, (str, bytes)):
+            new_seq: Union[List[Any], Sequence[Any]] = _filter_sequence(
+                v, function, num_args, drop_empty  # type: ignore[assignment]
+            )
+            if new_seq or not drop_empty:
+                try:
+                    dict.__setitem__(filtered, k, type(v)(new_seq))  # type: ignore[call-arg]
+                except TypeError:
+                    dict.__setitem__(filtered, k, new_seq)
+        else:
+            if num_args == 2:
+                if function(k, v):
+                    dict.__setitem__(filtered, k, v)
+            else:
+                if function(v):
+                    dict.__setitem__(filtered, k, v)
+
+    return filtered
+
+
+def _py_search_key_in(
+    mapping: Mapping, key: Any, default: Any = None, active: Union[set, None] = None
+) -> Any:
+    """search_key over any mapping tree, reading nested values in place.
+    Mappings already being searched are skipped so cycles terminate."""
+    if active is None:
+        active = set()
+    active.add(id(mapping))
+    try:
+        for k, v in mapping.items():
+            if k == key:
+                return v
+            if isinstance(v, Mapping):
+                if id(v) not in active:
+                    result = _py_search_key_in(v, key, None, active)
+                    if result is not None:
+                        return result
+            elif isinstance(v, Sequence) and not isinstance(v, (str, bytes)):
+                for item in v:
+                    if isinstance(item, Mapping) and id(item) not in active:
+                        result = _py_search_key_in(item, key, None, active)
+                        if result is not None:
+                            return result
+        return default
+    finally:
+        active.discard(id(mapping))
+
+
+def _py_search_keys_in(mapping: Mapping, key: Any) -> List[Any]:
+    """search_keys over any mapping tree, reading nested values in place.
+    Containers already being searched are skipped so cycles terminate."""
+    results: List[Any] = []
+    active: set = set()
+
+    def recurse(value: Any) -> None:
+        if isinstance(value, Mapping):
+            is_mapping = True
+        elif isinstance(value, Sequence) and not isinstance(value, (str, bytes)):
+            is_mapping = False
+        else:
+            return
+        if id(value) in active:
+            return
+        active.add(id(value))
+        if is_mapping:
+            for k, v in value.items():
+                if k == key:
+                    results.append(v)
+                recurse(v)
+        else:
+            for item in value:
+                recurse(item)
+        active.discard(id(value))
+
+    recurse(mapping)
+    return results
+
+
+_search_key_in = _c_search_key if _has_c_type else _py_search_key_in
+_search_keys_in = _c_search_keys if _has_c_type else _py_search_keys_in
+
+
+class _CowGroup:
+    """State shared by the nodes of a copy-on-write fork. memo maps id(source)
+    to a (source, weakref to fork) pair so shared references and cycles keep
+    their identity. Only the fork's nodes hold the group, so a dropped fork
+    is freed right away."""
+
+    __slots__ = ("memo", "__weakref__")
+
+    def __init__(self) -> None:
+        self.memo: Union[dict, None] = {}
+
+
+def _watcher_is_stale(watcher: Any) -> bool:
+    """Whether a key index token or fork group reference no longer needs notifying."""
+    if isinstance(watcher, _weakref):
+        group = watcher()
+        return group is None or group.memo is None
+    return not watcher
+
+
+def _add_watcher(md: Any, watcher: Any) -> None:
+    """Record a key index token or a weak reference to a fork group in the
+    watchers of md. Stale entries are dropped whenever the list reaches a
+    power of two, keeping appends amortized O(1)."""
+    watchers = _get_state(md, _WATCHERS)
+    if watchers is None:
+        _set_state(md, _WATCHERS, [watcher])
+        return
+    size = len(watchers)
+    if size & (size - 1) == 0:
+        watchers[:] = [w for w in watchers if not _watcher_is_stale(w)]
+    watchers.append(watcher)
+
+
+def _py_notify_watchers(md: Any) -> None:
+    """Called before md is mutated: clear the key index tokens covering it
+    (an empty token is stale) and let forks reaching it complete their copy."""
+    watchers = _get_state(md, _WATCHERS)
+    _set_state(md, _WATCHERS, None)
+    for watcher in watchers:
+        if not isinstance(watcher, _weakref):
+            watcher.clear()
+        elif not _watcher_is_stale(watcher):
+            _py_cow_complete(watcher())
+
+
+def _py_share_watchers(md: Any, child: Any) -> None:
+    """Lazy trees create MagiDicts as they are reached; the forks watching
+    md must watch the new child as well."""
+    for watcher in list(_get_state(md, _WATCHERS)):
+        if isinstance(watcher, _weakref) and not _watcher_is_stale(watcher):
+            _cow_watch_tree(child, watcher)
+
+
+def _cow_watch_tree(root: Any, ref: Any) -> None:
+    """Record ref in the watchers of every MagiDict reachable from root through
+    MagiDicts, lists and tuples. A MagiDict whose last watcher already is ref
+    has been visited; lists are tracked by id (a tuple cannot hold itself)."""
+    stack = [root]
+    seen: set = set()
+    while stack:
+        item = stack.pop()
+        if isinstance(item, _MagiDictBase):
+            if item is _NONE_MAGIDICT or item is _MISSING_MAGIDICT:
+                continue
+            watchers = _get_state(item, _WATCHERS)
+            if watchers and watchers[-1] is ref:
+                continue
+            _add_watcher(item, ref)
+            values: Iterable[Any] = dict.values(item)
+        elif type(item) is list:
+            if id(item) in seen:
+                continue
+            seen.add(id(item))
+            values = item
+        elif isinstance(item, tuple):
+            values = item
+        else:
+            continue
+        stack.extend(v for v in values if isinstance(v, (_MagiDictBase, tuple)) or type(v) is list)
+
+
+def _cow_memo_get(memo: dict, src: Any) -> Any:
+    """The fork or copy of src recorded in memo, or None."""
+    entry = memo.get(id(src))
+    if entry is None or entry[0] is not src:
+        return None
+    return entry[1]() if isinstance(entry[1], _weakref) else entry[1]
+
+
+def _py_cow_copy_value(value: Any, group: _CowGroup, seqs: dict, cls: type) -> Any:
+    """Copies a value stored in a node being forked. MagiDicts inside lists
+    and tuples are forked eagerly, raw dicts of lazy trees are hooked and
+    other leaves are shared. seqs memoizes the lists and tuples copied for
+    the node."""
+    if isinstance(value, _MagiDictBase):
+        return _py_cow_fork(value, group)
+    if isinstance(value, dict):
+        return cls._hook(value)  # type: ignore[attr-defined]
+    if type(value) is set:
+        return set(value)
+    if type(value) is not list and not isinstance(value, tuple):
+        return value
+
+    cached = _cow_memo_get(seqs, value)
+    if cached is not None:
+        return cached
+    if type(value) is list:
+        copied: List[Any] = []
+        seqs[id(value)] = (value, copied)
+        copied.extend(_py_cow_copy_value(elem, group, seqs, cls) for elem in value)
+        return copied
+
+    values = tuple(_py_cow_copy_value(elem, group, seqs, cls) for elem in value)
+    if all(new is old for new, old in zip(values, value)):
+        return value
+    if type(value) is tuple:
+        rebuilt = values
+    elif hasattr(value, "_fields"):
+        rebuilt = type(value)(*values)
+    else:
+        rebuilt = type(value)(values)
+    seqs[id(value)] = (value, rebuilt)
+    return rebuilt
+
+
+def _py_cow_fork(src: Any, group: _CowGroup) -> Any:
+    """The fork of src within group, created if needed. Nested MagiDicts are
+    borrowed: recorded in the fork's _cow_pending until they are reached."""
+    memo = group.memo
+    fork = _cow_memo_get(memo, src)  # type: ignore[arg-type]
+    if fork is not None:
+        return fork
+    if getattr(src, "_from_none", False) or getattr(src, "_from_missing", False):
+        return src
+    if _get_state(src, _LAZY_MEMO) is not None:
+        src._materialize_all()
+
+    cls = type(src)
+    fork = cls()
+    memo[id(src)] = (src, _weakref(fork))  # type: ignore[index]
+    pending = None
+    seqs: dict = {}
+    for key, value in dict.items(src):
+        if isinstance(value, _MagiDictBase) and value is not _NONE_MAGIDICT and value is not _MISSING_MAGIDICT:
+            forked = _cow_memo_get(memo, value)  # type: ignore[arg-type]
+            if forked is not None:
+                value = forked
+            else:
+                if pending is None:
+                    pending = {}
+                pending[key] = value
+        else:
+            value = _py_cow_copy_value(value, group, seqs, cls)
+        dict.__setitem__(fork, key, value)
+    if pending is not None:
+        _set_state(fork, _COW_PENDING, pending)
+        _set_state(fork, _COW_GROUP, group)
+    return fork
+
+
+def _py_cow_resolve(md: Any, key: Any, value: Any) -> Any:
+    """md[key] with a child still borrowed from the source replaced by its fork."""
+    pending = _get_state(md, _COW_PENDING)
+    group = _get_state(md, _COW_GROUP)
+    if pending.get(key) is not value or group is None or group.memo is None:
+        return value
+    fork = _py_cow_fork(value, group)
+    dict.__setitem__(md, key, fork)
+    del pending[key]
+    if not pending:
+        _set_state(md, _COW_PENDING, None)
+    return fork
+
+
+def _py_cow_complete(group: _CowGroup) -> None:
+    """Copy everything the fork still borrows, then release the group so the
+    fork no longer depends on its source."""
+    memo = group.memo
+    if memo is None:
+        return
+    progress = True
+    while progress:
+        progress = False
+        forks = [fork for fork in (ref() for _, ref in list(memo.values())) if fork is not None]
+        for fork in forks:
+            if _get_state(fork, _COW_PENDING) is not None:
+                progress = True
+                fork._materialize_all()
+                # Whatever is left was replaced through plain dict methods
+                _set_state(fork, _COW_PENDING, None)
+    group.memo = None
+    for fork in forks:
+        _set_state(fork, _COW_GROUP, None)
+
+
+def _py_cow_copy(md: Any) -> Any:
+    """Copy-on-write fork of md (see MagiDict.copy). The group watches every
+    MagiDict of md the fork can reach, since a change anywhere below a
+    borrowed child cannot be traced back to the node borrowing it."""
+    group = _CowGroup()
+    fork = _py_cow_fork(md, group)
+    if fork is md:
+        return fork
+    # The root keeps the group even when it borrows nothing itself
+    _set_state(fork, _COW_GROUP, group)
+    ref = _weakref(group)
+    for value in dict.values(md):
+        _cow_watch_tree(value, ref)
+    return fork
+
+
+_cow_copy = _c_cow_copy if _has_c_type else _py_cow_copy
+_notify_watchers = _c_notify_watchers if _has_c_type else _py_notify_watchers
+
+
+_MERGE_STRATEGIES = ("replace", "append", "keep")
+
+
+def _merge_copy_value(value: Any, memo: dict) -> Any:
+    """Copies the lists, tuples and plain dicts in value so deep_merge never
+    stores a container other still holds; the hook would otherwise convert
+    them in place. MagiDicts and other values are kept. memo maps id() of
+    copied containers to (source, copy)."""
+    is_dict = isinstance(value, dict) and not isinstance(value, MagiDict)
+    if not is_dict and type(value) is not list and not isinstance(value, tuple):
+        return value
+    cached = _cow_memo_get(memo, value)
+    if cached is not None:
+        return cached
+    if is_dict:
+        copied_dict: dict = {}
+        memo[id(value)] = (value, copied_dict)
+        for k, v in value.items():
+            copied_dict[k] = _merge_copy_value(v, memo)
+        return copied_dict
+    if type(value) is list:
+        copied: List[Any] = []
+        memo[id(value)] = (value, copied)
+        copied.extend(_merge_copy_value(elem, memo) for elem in value)
+        return copied
+
+    values = tuple(_merge_copy_value(elem, memo) for elem in value)
+    if all(new is old for new, old in zip(values, value)):
+        return value
+    if type(value) is tuple:
+        rebuilt = values
+    elif hasattr(value, "_fields"):
+        rebuilt = type(value)(*values)
+    else:
+        rebuilt = type(value)(values)
+    memo[id(value)] = (value, rebuilt)
+    return rebuilt
+
+
+def _py_deep_merge(md: Any, other: Mapping, strategy: str, active: dict) -> None:
+    """Pure Python counterpart of the C deep_merge; see MagiDict.deep_merge.
+    active maps id() of the mappings of other being merged to their target."""
+    md._raise_if_protected()
+    items = list(other.items())
+    if _get_state(md, _WATCHERS):
+        _notify_watchers(md)
+    active[id(other)] = md
+    cls = type(md)
+    pending = _get_state(md, _COW_PENDING)
+    for key, value in items:
+        if dict.__contains__(md, key):
+            current = _py_lazy_materialize(md, key, dict.__getitem__(md, key))
+        else:
+            current = _MISSING
+        target = active.get(id(value)) if isinstance(value, Mapping) else None
+        if target is not None:
+            # Reached again through a cycle: point back at its target
+            if current is not _MISSING and strategy == "keep":
+                continue
+            child = target
+        elif isinstance(value, Mapping) and (
+            current is _MISSING or isinstance(current, dict) or strategy != "keep"
+        ):
+            if isinstance(current, MagiDict):
+                _py_deep_merge(current, value, strategy, active)
+                continue
+            child = cls._hook(current) if isinstance(current, dict) else cls()
+            _py_deep_merge(child, value, strategy, active)
+        elif current is _MISSING or strategy != "keep":
+            child = cls._hook(_merge_copy_value(value, {}))
+            if strategy == "append" and isinstance(current, list) and isinstance(child, (list, tuple)):
+                child = list(current) + list(child)
+        else:
+            continue
+        dict.__setitem__(md, key, child)
+        if pending is not None:
+            pending.pop(key, None)
+    del active[id(other)]
+
+
+def _build_key_index(root: Mapping, token: List[Any]) -> dict:
+    """Map each key in the tree to its (path, value, reachable) occurrences in
+    the order search_keys visits them. reachable is False below a sequence
+    nested directly in a sequence, which search_key does not descend into.
+    Containers already on the current path are skipped so cycles terminate.
+    Every MagiDict reached records token so that mutating it clears the index."""
+    entries: dict = {}
+    active: set = set()
+
+    def visit_mapping(mapping: Mapping, path: tuple, reachable: bool) -> None:
+        if isinstance(mapping, MagiDict) and none(mapping) is not None:
+            _add_watcher(mapping, token)
+        for k, v in mapping.items():
+            entry_path = path + (k,)
+            entries.setdefault(k, []).append((entry_path, v, reachable))
+            visit(v, entry_path, reachable, False)
+
+    def visit(value: Any, path: tuple, reachable: bool, in_sequence: bool) -> None:
+        if id(value) in active:
+            return
+        if isinstance(value, Mapping):
+            active.add(id(value))
+            visit_mapping(value, path, reachable)
+            active.discard(id(value))
+        elif isinstance(value, Sequence) and not isinstance(value, (str, bytes)):
+            active.add(id(value))
+            reachable = reachable and not in_sequence
+            for i, item in enumerate(value):
+                visit(item, path + (i,), reachable, True)
+            active.discard(id(value))
+
+    visit(root, (), True, False)
+    return entries
+
+
+def _indexed_search_key(entries: List[Any], default: Any) -> Any:
+    """search_key over indexed occurrences. Like the recursive search, a None
+    found below the top level counts as a miss for the whole mapping holding it."""
+    skipped = None
+    for path, value, reachable in entries:
+        if not reachable:
+            continue
+        if skipped is not None and path[: len(skipped)] == skipped:
+            continue
+        if len(path) == 1 or value is not None:
+            return value
+        skipped = path[:-1]
+    return default
+
+
+def _wrap_view(value: Any) -> Any:
+    """Wraps a value returned from a MagiView: mappings become MagiViews and
+    lists (and plain tuples) MagiViewLists. MagiDicts are returned as they are."""
+    if isinstance(value, (_MagiDictBase, _MagiViewBase)):
+        return value
+    if isinstance(value, (list, _SnapshotList)) or type(value) is tuple:
+        return MagiViewList(value)
+    if isinstance(value, Mapping):
+        return MagiView(value)
+    return value
+
+
+class _PyMagiViewBase:
+    """Pure Python counterpart of the C MagiViewBase type."""
+
+    __slots__ = ("_data",)
+
+    def __new__(cls, data: Mapping) -> Any:
+        if isinstance(data, _PyMagiViewBase):
+            data = data.unwrap()
+        if not isinstance(data, Mapping):
+            raise TypeError(f"MagiView expects a mapping, got {type(data).__name__}")
+        view = object.__new__(cls)
+        object.__setattr__(view, "_data", data)
+        return view
+
+    def __getattr__(self, name: str) -> Any:
+        if name in ("_from_none", "_from_missing"):
+            return False
+        try:
+            value = self._data[name]
+        except KeyError:
+            # Protocol lookups (__deepcopy__, __reduce_ex__, ...) must not get a sentinel
+            if name[:2] == "__" and name[-2:] == "__" and len(name) > 4:
+                raise AttributeError(f"{type(self).__name__!r} object has no attribute {name!r}") from None
+            return _MISSING_MAGIDICT
+        if value is None:
+            return _NONE_MAGIDICT
+        return _wrap_view(value)
+
+    def __getitem__(self, key: Any) -> Any:
+        try:
+            return _wrap_view(self._data[key])
+        except KeyError:
+            if isinstance(key, str) and "." in key:
+                return _wrap_view(_py_walk_path(self._data, _compile_dotted(key)))
+            raise
+
+    def __len__(self) -> int:
+        return len(self._data)
 
-            def recurse(value):
-                if isinstance(value, MagiDict):
-                    return value.search_key(key)
-                if isinstance(value, Mapping):
-                    return MagiDict(value).search_key(key)
-                return default
+    def __contains__(self, key: Any) -> bool:
+        return key in self._data
 
-            if isinstance(v, Mapping):
-                result = recurse(v)
-                if result is not None:
-                    return result
+    def __iter__(self):
+        return iter(self._data)
 
-            if isinstance(v, Sequence) and not isinstance(v, (str, bytes)):
-                for item in v:
-                    if isinstance(item, Mapping):
-                        result = recurse(item)
-                        if result is not None:
-                            return result
+    def __eq__(self, other: object) -> bool:
+        if isinstance(other, _PyMagiViewBase):
+            other = other.unwrap()
+        return self._data == other
 
+    def __ne__(self, other: object) -> bool:
+        return not self == other
+
+    __hash__ = None  # type: ignore[assignment]
+
+    def __repr__(self) -> str:
+        return f"{type(self).__name__}({self._data!r})"
+
+    def mget(self, key: Any, default: Any = _MISSING) -> Any:
+        if key in self._data:
+            value = self._data[key]
+            if value is None and default is not None:
+                return _NONE_MAGIDICT
+            return _wrap_view(value)
+        return _MISSING_MAGIDICT if default is _MISSING else default
+
+    mg = mget
+
+    def get(self, key: Any, default: Any = None) -> Any:
+        if key in self._data:
+            return _wrap_view(self._data[key])
         return default
 
-    def search_keys(self, key: Any) -> List[Any]:
+    def keys(self):
+        return self._data.keys()
+
+    def values(self) -> List[Any]:
+        return [_wrap_view(v) for v in self._data.values()]
+
+    def items(self) -> List[Any]:
+        return [(k, _wrap_view(v)) for k, v in self._data.items()]
+
+    def unwrap(self) -> Mapping:
+        return self._data
+
+
+_MagiViewBase: type = _CMagiViewBase if _has_c_type else _PyMagiViewBase
+
+
+class MagiView(_MagiViewBase):  # type: ignore[valid-type,misc]
+    """A read-only MagiDict interface over an existing mapping.
+
+    Wrapping is O(1): nothing is copied, converted or modified. Attribute
+    access, dotted keys, mget, search_key(s) and filter work as they do on a
+    MagiDict; nested mappings and lists are wrapped on the way out."""
+
+    __slots__ = ()
+
+    def __dir__(self):
+        """Provides keys as attributes for auto-completion in interactive environments."""
+        key_attrs = sorted(k for k in self.keys() if isinstance(k, str))
+        seen = set(key_attrs)
+        return key_attrs + [attr for attr in dir(type(self)) if attr not in seen]
+
+    def __reduce__(self):
+        return (type(self), (self.unwrap(),))
+
+    def __deepcopy__(self, memo: dict[int, Any]) -> "MagiView":
+        """A view over a deep copy of the underlying mapping."""
+        return type(self)(deepcopy(self.unwrap(), memo))
+
+    def search_key(self, key: Any, default=None) -> Any:
         """
-        Recursively search for all occurrences of a key in the MagiDict and its nested structures.
-        Returns a list of all found values.
+        Recursively search for a key in the underlying mapping and its nested structures.
 
         Parameters:
             key: The key to search for.
+            default: The value to return if the key is not found.
 
         Returns:
-            A list of all values associated with the specified key.
+            The (wrapped) value associated with the key, or None/default if not found.
         """
-        results = []
-
-        def recurse(value):
-            if isinstance(value, MagiDict):
-                results.extend(value.search_keys(key))
-            elif isinstance(value, Mapping):
-                results.extend(MagiDict(value).search_keys(key))
-            elif isinstance(value, Sequence) and not isinstance(value, (str, bytes)):
-                for item in value:
-                    recurse(item)
-
-        for k, v in self.items():
-            if k == key:
-                results.append(v)
-            recurse(v)
-
-        return results
+        return _wrap_view(_search_key_in(self.unwrap(), key, default))
 
-    def filter(self, function: Any, drop_empty=False) -> "MagiDict":
+    def search_keys(self, key: Any) -> List[Any]:
         """
-        Returns a new MagiDict containing only the items for which the function(key) or function(key, value)
-        returns True. Supports nested dicts and sequences. If drop_empty is True, empty MagiDicts and sequences
-        are omitted from the result.
+        Recursively search for all occurrences of a key in the underlying mapping.
 
         Parameters:
-            function: A function that takes one argument (value) or two arguments (key, value) and returns True or False.
-                      If None, filters out items with value None.
-            drop_empty: If True, empty MagiDicts and data structures are omitted from the result.
+            key: The key to search for.
 
         Returns:
-            A new MagiDict with filtered items.
+            A list of all (wrapped) values associated with the key.
         """
+        return [_wrap_view(v) for v in _search_keys_in(self.unwrap(), key)]
 
-        if function is None:
-            return self.filter(lambda x: x is not None, drop_empty=drop_empty)
-
-        num_args = len(signature(function).parameters)
-
-        def filter_nested_seq(
-            seq: Sequence, function: Any, num_args: int, drop_empty: bool
-        ) -> Union[List[Any], None]:
-            """Recursively filter nested sequences while preserving structure."""
-            new_seq: List[Any] = []
-            for i, item in enumerate(seq):
-                if isinstance(item, MagiDict):
-                    nested = item.filter(function, drop_empty=drop_empty)
-                    if nested or not drop_empty:
-                        new_seq.append(nested)
-                elif isinstance(item, Mapping):
-                    nested = MagiDict(item).filter(function, drop_empty=drop_empty)
-                    if nested or not drop_empty:
-                        new_seq.append(nested)
-                elif isinstance(item, Sequence) and not isinstance(item, (str, bytes)):
-                    nested = filter_nested_seq(item, function, num_args, drop_empty)  # type: ignore[assignment]
-                    if nested or not drop_empty:
-                        new_seq.append(nested)
-                else:
-                    if num_args == 2:
-                        if function(i, item):
-                            new_seq.append(item)
-                    else:
-                        if function(item):
-                            new_seq.append(item)
-            if new_seq or not drop_empty:
-                try:
-                    return type(seq)(new_seq)  # type: ignore
-                except TypeError:
-                    return new_seq
+    def filter(self, function: Any, drop_empty=False, batch=False) -> MagiDict:
+        """
+        Same as MagiDict.filter, reading the underlying mapping in place.
+
+        Returns:
+            A new MagiDict with the filtered items.
+        """
+        return _filter_in(self.unwrap(), function, drop_empty, batch)
+
+    def disenchant(self) -> dict:
+        """Returns a standard dict copy of the underlying mapping tree."""
+        return MagiDict.disenchant(self.unwrap())  # type: ignore[arg-type]
+
+
+class MagiViewList(Sequence):
+    """Read-only sequence returned by MagiView for lists and tuples; wraps
+    nested mappings and lists as they are indexed or iterated."""
+
+    __slots__ = ("_data",)
+
+    def __init__(self, data: Sequence) -> None:
+        self._data = data
+
+    def __getitem__(self, index: Any) -> Any:
+        if isinstance(index, slice):
+            return MagiViewList(self._data[index])
+        return _wrap_view(self._data[index])
+
+    def __len__(self) -> int:
+        return len(self._data)
+
+    def __eq__(self, other: object) -> bool:
+        if isinstance(other, MagiViewList):
+            other = other._data
+        return self._data == other
+
+    __hash__ = None  # type: ignore[assignment]
+
+    def __repr__(self) -> str:
+        return f"MagiViewList({self._data!r})"
+
+    def unwrap(self) -> Sequence:
+        """Returns the underlying list or tuple."""
+        return self._data
+
+
+# Snapshot layout (little-endian): an 8 byte magic and the offset of the root
+# record, then one record per value. A record starts with a tag byte; strings,
+# bytes and big ints carry a u32 length, mappings a u32 count followed by
+# count (key offset, value offset) u64 pairs, lists and tuples a u32 count
+# followed by count u64 value offsets. Children are written before their
+# container, keys and short strings once per snapshot.
+_SNAP_MAGIC = b"MAGISNP1"
+_SNAP_HEADER = Struct("<8sQ")
+_SNAP_COUNT = Struct("<BI")
+_SNAP_OFFSET = Struct("<Q")
+_SNAP_INT = Struct("<Bq")
+_SNAP_FLOAT = Struct("<Bd")
+_SNAP_SHARED_STR = 32
+(_TAG_NONE, _TAG_TRUE, _TAG_FALSE, _TAG_INT, _TAG_BIGINT, _TAG_FLOAT, _TAG_STR, _TAG_BYTES) = b"NTFiIdsb"
+_TAG_MAP, _TAG_LIST, _TAG_TUPLE = b"mlt"
+
+
+def _snapshot_offsets(offsets: List[int]) -> bytes:
+    """The u64 little-endian encoding of an offset table."""
+    table = _array("Q", offsets)
+    if _byteorder == "big":
+        table.byteswap()
+    return table.tobytes()
+
+
+def _snapshot_mode(path: str) -> int:
+    """Permission bits for a snapshot written to path: those of the file it
+    replaces, or 0o666 less the umask, as open() would create it."""
+    try:
+        return _stat(path).st_mode & 0o7777
+    except FileNotFoundError:
+        umask = _umask(0)
+        _umask(umask)
+        return 0o666 & ~umask
+
+
+class _SnapshotWriter:
+    """Writes a tree of mappings, lists and scalars as a snapshot file."""
+
+    __slots__ = ("_file", "_pos", "_scalars", "_containers", "_active")
+
+    def __init__(self, file: Any) -> None:
+        self._file = file
+        self._pos = _SNAP_HEADER.size
+        self._scalars: dict = {}
+        self._containers: dict = {}
+        self._active: set = set()
+
+    def _emit(self, data: bytes) -> int:
+        offset = self._pos
+        self._file.write(data)
+        self._pos += len(data)
+        return offset
+
+    def write(self, root: Any) -> None:
+        self._file.write(_SNAP_HEADER.pack(_SNAP_MAGIC, 0))
+        offset = self._value(root, False)
+        self._file.seek(0)
+        self._file.write(_SNAP_HEADER.pack(_SNAP_MAGIC, offset))
+
+    def _value(self, value: Any, is_key: bool) -> int:
+        encoded = _encode_scalar(value)
+        if encoded is None:
+            return self._container(value, is_key)
+        # 1, 1.0 and True are equal keys, so the type is part of the memo key
+        if is_key or value is None or type(value) is bool or (
+            type(value) is str and len(value) <= _SNAP_SHARED_STR
+        ):
+            memo_key = (type(value), value)
+            offset = self._scalars.get(memo_key)
+            if offset is None:
+                offset = self._scalars[memo_key] = self._emit(encoded)
+            return offset
+        return self._emit(encoded)
+
+    def _container(self, value: Any, is_key: bool) -> int:
+        value_id = id(value)
+        offset = self._containers.get(value_id)
+        if offset is not None:
+            return offset
+        if value_id in self._active:
+            raise ValueError("Cannot snapshot a circular reference")
+        if isinstance(value, tuple):
+            tag = _TAG_TUPLE
+        elif is_key:
+            raise TypeError(f"Cannot snapshot keys of type {type(value).__name__}")
+        elif isinstance(value, dict) or isinstance(value, Mapping):
+            tag = _TAG_MAP
+        elif isinstance(value, list):
+            tag = _TAG_LIST
+        else:
+            raise TypeError(f"Cannot snapshot values of type {type(value).__name__}")
+
+        self._active.add(value_id)
+        if tag == _TAG_MAP:
+            offsets = []
+            for k, v in dict.items(value) if isinstance(value, dict) else value.items():
+                offsets.append(self._value(k, True))
+                offsets.append(self._value(v, False))
+            count = len(offsets) // 2
+        else:
+            offsets = [self._value(item, is_key) for item in value]
+            count = len(offsets)
+        self._active.discard(value_id)
+        offset = self._emit(_SNAP_COUNT.pack(tag, count) + _snapshot_offsets(offsets))
+        self._containers[value_id] = offset
+        return offset
+
+
+def _encode_scalar(value: Any) -> Union[bytes, None]:
+    """Snapshot record of a scalar value, or None for anything else."""
+    kind = type(value)
+    if kind is str:
+        data = value.encode("utf-8", "surrogatepass")
+        return _SNAP_COUNT.pack(_TAG_STR, len(data)) + data
+    if kind is int and -(2**63) <= value < 2**63:
+        return _SNAP_INT.pack(_TAG_INT, value)
+    if kind is float:
+        return _SNAP_FLOAT.pack(_TAG_FLOAT, value)
+    if kind is dict or kind is list:
+        return None
+    if value is None:
+        return b"N"
+    if value is True:
+        return b"T"
+    if value is False:
+        return b"F"
+    if isinstance(value, int):
+        if -(2**63) <= value < 2**63:
+            return _SNAP_INT.pack(_TAG_INT, value)
+        data = int(value).to_bytes(value.bit_length() // 8 + 1, "little", signed=True)
+        return _SNAP_COUNT.pack(_TAG_BIGINT, len(data)) + data
+    if isinstance(value, float):
+        return _SNAP_FLOAT.pack(_TAG_FLOAT, value)
+    if isinstance(value, str):
+        data = value.encode("utf-8", "surrogatepass")
+        return _SNAP_COUNT.pack(_TAG_STR, len(data)) + data
+    if isinstance(value, (bytes, bytearray)):
+        return _SNAP_COUNT.pack(_TAG_BYTES, len(value)) + bytes(value)
+    return None
+
+
+class _Snapshot:
+    """A memory-mapped snapshot file. Containers are decoded into
+    _SnapshotMapping and _SnapshotList nodes, cached per record, and
+    scalars each time they are read."""
+
+    __slots__ = ("path", "buffer", "keys", "nodes")
+
+    def __init__(self, path: Any) -> None:
+        with open(path, "rb") as file:
+            try:
+                buffer = _mmap(file.fileno(), 0, access=_ACCESS_READ)
+            except ValueError:
+                buffer = None
+        if buffer is None or len(buffer) < _SNAP_HEADER.size or buffer[:8] != _SNAP_MAGIC:
+            if buffer is not None:
+                buffer.close()
+            raise ValueError(f"{path!r} is not a MagiDict snapshot")
+        self.path = path
+        self.buffer = buffer
+        self.keys: dict = {}
+        self.nodes: dict = {}
+
+    def root(self) -> Any:
+        return self.value(_SNAP_HEADER.unpack_from(self.buffer, 0)[1])
+
+    def check(self, offset: int, size: int) -> int:
+        """Returns offset if the size bytes there lie within the records of
+        the file, so truncated or corrupt files raise ValueError."""
+        if offset < _SNAP_HEADER.size or offset + size > len(self.buffer):
+            raise ValueError(f"Corrupt snapshot record at offset {offset}")
+        return offset
+
+    def count(self, offset: int) -> int:
+        return _SNAP_COUNT.unpack_from(self.buffer, self.check(offset, _SNAP_COUNT.size))[1]
+
+    def table_size(self, offset: int) -> int:
+        """The size in bytes of the offset table of the container at offset,
+        checked against the file."""
+        size = 8 * self.count(offset) * (2 if self.buffer[offset] == _TAG_MAP else 1)
+        self.check(offset + _SNAP_COUNT.size, size)
+        return size
+
+    def table(self, offset: int) -> Any:
+        """The offset table of the container record at offset."""
+        start = offset + _SNAP_COUNT.size
+        size = self.table_size(offset)
+        table = _array("Q")
+        table.frombytes(self.buffer[start : start + size])
+        if _byteorder == "big":
+            table.byteswap()
+        return table
+
+    def key(self, offset: int) -> Any:
+        key = self.keys.get(offset, _MISSING)
+        if key is _MISSING:
+            key = self.keys[offset] = self.plain(offset, {})
+        return key
+
+    def value(self, offset: int) -> Any:
+        tag = self.buffer[self.check(offset, 1)]
+        if tag == _TAG_MAP or tag == _TAG_LIST or tag == _TAG_TUPLE:
+            node = self.nodes.get(offset)
+            if node is None:
+                self.table_size(offset)
+                node_type = _SnapshotMapping if tag == _TAG_MAP else _SnapshotList
+                node = self.nodes[offset] = node_type(self, offset)
+            return node
+        return self.scalar(tag, offset)
+
+    def scalar(self, tag: int, offset: int) -> Any:
+        buffer = self.buffer
+        if tag == _TAG_STR:
+            start = offset + _SNAP_COUNT.size
+            size = self.count(offset)
+            return str(buffer[self.check(start, size) : start + size], "utf-8", "surrogatepass")
+        if tag == _TAG_INT:
+            return _SNAP_INT.unpack_from(buffer, self.check(offset, _SNAP_INT.size))[1]
+        if tag == _TAG_FLOAT:
+            return _SNAP_FLOAT.unpack_from(buffer, self.check(offset, _SNAP_FLOAT.size))[1]
+        if tag == _TAG_NONE:
             return None
+        if tag == _TAG_TRUE:
+            return True
+        if tag == _TAG_FALSE:
+            return False
+        start = offset + _SNAP_COUNT.size
+        size = self.count(offset)
+        data = buffer[self.check(start, size) : start + size]
+        if tag == _TAG_BIGINT:
+            return int.from_bytes(data, "little", signed=True)
+        if tag == _TAG_BYTES:
+            return data
+        raise ValueError(f"Corrupt snapshot record at offset {offset}")
+
+    def plain(self, offset: int, memo: dict) -> Any:
+        """Decodes the whole record at offset into dicts, lists and tuples."""
+        tag = self.buffer[self.check(offset, 1)]
+        if tag != _TAG_MAP and tag != _TAG_LIST and tag != _TAG_TUPLE:
+            return self.scalar(tag, offset)
+        if offset in memo:
+            return memo[offset]
+        table = self.table(offset)
+        if tag == _TAG_TUPLE:
+            result: Any = tuple([self.plain(item, memo) for item in table])
+        elif tag == _TAG_LIST:
+            result = memo[offset] = []
+            result.extend(self.plain(item, memo) for item in table)
+        else:
+            result = memo[offset] = {}
+            for i in range(0, len(table), 2):
+                result[self.key(table[i])] = self.plain(table[i + 1], memo)
+        memo[offset] = result
+        return result
 
-        filtered: MagiDict = MagiDict()
 
-        for k, v in self.items():
-            if isinstance(v, MagiDict):
-                nested = v.filter(function, drop_empty=drop_empty)
-                if nested or not drop_empty:
-                    filtered[k] = nested
-            elif isinstance(v, Mapping):
-                nested = MagiDict(v).filter(function, drop_empty=drop_empty)
-                if nested or not drop_empty:
-                    filtered[k] = nested
-            elif isinstance(v, Sequence) and not isinstance(v, (str, bytes)):
-                new_seq: Union[List[Any], Sequence[Any]] = filter_nested_seq(
-                    v, function, num_args, drop_empty  # type: ignore[assignment]
-                )
-                if new_seq or not drop_empty:
-                    try:
-                        filtered[k] = type(v)(new_seq)  # type: ignore[call-arg]
-                    except TypeError:
-                        filtered[k] = new_seq
-            else:
-                if num_args == 2:
-                    if function(k, v):
-                        filtered[k] = v
-                else:
-                    if function(v):
-                        filtered[k] = v
+class _SnapshotMapping(Mapping):
+    """Read-only mapping over a mapping record of a snapshot. The key table
+    is read the first time a key is looked up."""
+
+    __slots__ = ("_snapshot", "_offset", "_index")
+
+    def __init__(self, snapshot: _Snapshot, offset: int) -> None:
+        self._snapshot = snapshot
+        self._offset = offset
+        self._index: Union[dict, None] = None
+
+    def _load_index(self) -> dict:
+        table = self._snapshot.table(self._offset)
+        key = self._snapshot.key
+        index = self._index = dict(zip([key(k) for k in table[0::2]], table[1::2]))
+        return index
+
+    def __getitem__(self, key: Any) -> Any:
+        index = self._index if self._index is not None else self._load_index()
+        return self._snapshot.value(index[key])
+
+    def __contains__(self, key: Any) -> bool:
+        index = self._index if self._index is not None else self._load_index()
+        return key in index
+
+    def __iter__(self):
+        index = self._index if self._index is not None else self._load_index()
+        return iter(index)
+
+    def __len__(self) -> int:
+        return self._snapshot.count(self._offset)
+
+    def __repr__(self) -> str:
+        return f"<snapshot mapping of {len(self)} keys>"
+
+
+class _SnapshotList(Sequence):
+    """Read-only sequence over a list or tuple record of a snapshot."""
+
+    __slots__ = ("_snapshot", "_offset", "_len")
+
+    def __init__(self, snapshot: _Snapshot, offset: int) -> None:
+        self._snapshot = snapshot
+        self._offset = offset
+        self._len = snapshot.count(offset)
+
+    def __getitem__(self, index: Any) -> Any:
+        if isinstance(index, slice):
+            return [self[i] for i in range(*index.indices(self._len))]
+        if index < 0:
+            index += self._len
+        if not 0 <= index < self._len:
+            raise IndexError("snapshot list index out of range")
+        position = self._offset + _SNAP_COUNT.size + 8 * index
+        return self._snapshot.value(_SNAP_OFFSET.unpack_from(self._snapshot.buffer, position)[0])
+
+    def __iter__(self):
+        value = self._snapshot.value
+        return (value(offset) for offset in self._snapshot.table(self._offset))
+
+    def __len__(self) -> int:
+        return self._len
+
+    def __eq__(self, other: object) -> bool:
+        if isinstance(other, (list, tuple, _SnapshotList)):
+            return len(other) == self._len and all(a == b for a, b in zip(self, other))
+        return NotImplemented
+
+    __hash__ = None  # type: ignore[assignment]
+
+    def __repr__(self) -> str:
+        return f"<snapshot list of {self._len} items>"
+
+    def __deepcopy__(self, memo: dict) -> Any:
+        return self._snapshot.plain(self._offset, {})
+
+
+class MagiSnapshot(MagiView):
+    """A read-only MagiView over a snapshot written by MagiDict.save_snapshot.
+
+    The file is memory-mapped, so processes opening the same snapshot share
+    one copy of it in the page cache. Mappings and lists are decoded as they
+    are reached and kept for later lookups; scalars are read from the file
+    on every access."""
+
+    __slots__ = ()
+
+    def __repr__(self) -> str:
+        return f"MagiSnapshot({self.unwrap()._snapshot.path!r})"
+
+    def __reduce__(self):
+        return (MagiDict.open_snapshot, (self.unwrap()._snapshot.path,))
+
+    def __deepcopy__(self, memo: dict[int, Any]) -> MagiView:
+        """A MagiView over the decoded snapshot, independent of the file."""
+        return MagiView(self.disenchant())
+
+    def __enter__(self) -> "MagiSnapshot":
+        return self
+
+    def __exit__(self, *exc_info: Any) -> None:
+        self.close()
+
+    def close(self) -> None:
+        """Unmaps the file; values already read stay valid, further reads raise ValueError."""
+        self.unwrap()._snapshot.buffer.close()
+
+    def disenchant(self) -> dict:
+        """Decodes the whole snapshot into standard dicts, lists and tuples."""
+        data = self.unwrap()
+        return data._snapshot.plain(data._offset, {})
+
+
+class MagiRow(Mapping):
+    """A compact record of a MagiRecords, read in place from its key and
+    value tuples. It answers item and attribute access like a MagiDict,
+    missing keys and None values included, and calls other MagiDict methods
+    on a temporary MagiDict. A structural change (item assignment, del,
+    update(), |=, pop(), ...) replaces the record in its MagiRecords with a
+    regular MagiDict, which the row then forwards everything to; rows of the
+    same record read before that keep showing the old values."""
+
+    __slots__ = ("_records", "_index", "_keys", "_values", "_md")
+
+    _from_none = False
+    _from_missing = False
+
+    def __init__(self, records: "MagiRecords", index: int, keys: tuple, values: tuple) -> None:
+        self._records = records
+        self._index = index
+        self._keys = keys
+        self._values = values
+        self._md: Any = None
+
+    def _build(self) -> Any:
+        """A new MagiDict holding the items of the row."""
+        md = self._records._cls()
+        dict.update(md, zip(self._keys, self._values))
+        return md
+
+    def _promote(self) -> Any:
+        """The MagiDict that replaced the record, building it on first use."""
+        if self._md is None:
+            self._md = self._records._promote(self._index, self._values, self._build())
+        return self._md
+
+    def __getitem__(self, key: Any) -> Any:
+        if self._md is not None:
+            return self._md[key]
+        try:
+            return self._values[self._keys.index(key)]
+        except ValueError:
+            pass
+        if isinstance(key, str) and "." in key:
+            return self._build()[key]
+        raise KeyError(key)
+
+    def __getattr__(self, name: str) -> Any:
+        if name.startswith("__"):
+            raise AttributeError(name)
+        if self._md is not None:
+            return getattr(self._md, name)
+        cls = self._records._cls
+        if hasattr(cls, name):
+            return getattr(self._build(), name)
+        try:
+            value = self._values[self._keys.index(name)]
+        except ValueError:
+            return _MISSING_MAGIDICT
+        return _NONE_MAGIDICT if value is None else value
+
+    def __iter__(self) -> Any:
+        return iter(self._keys if self._md is None else self._md)
+
+    def __len__(self) -> int:
+        return len(self._keys if self._md is None else self._md)
+
+    def __contains__(self, key: Any) -> bool:
+        return key in (self._keys if self._md is None else self._md)
+
+    def get(self, key: Any, default: Any = None) -> Any:
+        if self._md is not None:
+            return self._md.get(key, default)
+        try:
+            return self._values[self._keys.index(key)]
+        except ValueError:
+            return default
+
+    def mget(self, key: Any, default: Any = _MISSING) -> Any:
+        if self._md is not None:
+            return self._md.mget(key) if default is _MISSING else self._md.mget(key, default)
+        if key in self._keys:
+            value = self[key]
+            return _NONE_MAGIDICT if value is None and default is not None else value
+        return _MISSING_MAGIDICT if default is _MISSING else default
+
+    mg = mget
+
+    def __setitem__(self, key: Any, value: Any) -> None:
+        self._promote()[key] = value
 
-        return filtered
+    def __delitem__(self, key: Any) -> None:
+        del self._promote()[key]
 
+    def update(self, *args: Any, **kwargs: Any) -> None:
+        self._promote().update(*args, **kwargs)
 
-def magi_loads(s: str, **kwargs: Any) -> MagiDict:
+    def __ior__(self, other: Any) -> "MagiRow":
+        self._promote().update(other)
+        return self
+
+    def setdefault(self, key: Any, default: Any = None) -> Any:
+        return self._promote().setdefault(key, default)
+
+    def pop(self, key: Any, *args: Any) -> Any:
+        return self._promote().pop(key, *args)
+
+    def popitem(self) -> tuple:
+        return self._promote().popitem()
+
+    def clear(self) -> None:
+        self._promote().clear()
+
+    def deep_merge(self, *args: Any, **kwargs: Any) -> Any:
+        return self._promote().deep_merge(*args, **kwargs)
+
+    __hash__ = None  # type: ignore[assignment]
+
+    def __eq__(self, other: object) -> bool:
+        return (self._build() if self._md is None else self._md) == other
+
+    def __repr__(self) -> str:
+        return repr(self._build() if self._md is None else self._md)
+
+    def __dir__(self) -> List[str]:
+        return dir(self._build() if self._md is None else self._md)
+
+    def __copy__(self) -> Any:
+        return self._build() if self._md is None else self._md.copy()
+
+    def __deepcopy__(self, memo: dict) -> Any:
+        return deepcopy(self._build() if self._md is None else self._md, memo)
+
+    def __reduce__(self) -> tuple:
+        # Unpickled as the MagiDict the row stands for
+        return (_unpickle_row, (self._build() if self._md is None else self._md,))
+
+
+def _unpickle_row(md: Any) -> Any:
+    return md
+
+
+class MagiRecords(MutableSequence):
+    """List of MagiDicts built by MagiDict.from_records(compact=True). Plain
+    dict records are stored as a tuple of values against a key tuple shared
+    by every record with the same keys, and are read as MagiRow views over
+    those tuples. A record becomes a regular MagiDict, stored in place, only
+    when it is changed through its row."""
+
+    __slots__ = ("_cls", "_keys", "_rows")
+
+    def __init__(self, records: Iterable[dict] = (), cls: type = MagiDict) -> None:
+        built = cls.from_records(records, compact=True)
+        self._cls = cls
+        self._keys: List[Any] = built._keys
+        self._rows: List[Any] = built._rows
+
+    @classmethod
+    def _from_rows(cls, magidict_class: type, keys: List[Any], rows: List[Any]) -> "MagiRecords":
+        records = cls.__new__(cls)
+        records._cls = magidict_class
+        records._keys = keys
+        records._rows = rows
+        return records
+
+    def _build(self, index: int) -> Any:
+        keys = self._keys[index]
+        if keys is None:
+            return self._rows[index]
+        md = self._cls()
+        dict.update(md, zip(keys, self._rows[index]))
+        return md
+
+    def _row(self, index: int) -> Any:
+        keys = self._keys[index]
+        if keys is None:
+            return self._rows[index]
+        if index < 0:
+            index += len(self._rows)
+        return MagiRow(self, index, keys, self._rows[index])
+
+    def _promote(self, index: int, values: tuple, md: Any) -> Any:
+        """Stores md in place of the record whose value tuple is values,
+        looked for at index first as records may have moved since it was
+        read. Returns md, also when the record is gone."""
+        rows = self._rows
+        if not (index < len(rows) and rows[index] is values):
+            index = next((i for i, row in enumerate(rows) if row is values), -1)
+        if index >= 0:
+            rows[index] = md
+            self._keys[index] = None
+        return md
+
+    def _convert(self, value: Any) -> Any:
+        if not isinstance(value, dict):
+            raise TypeError(f"Expected dict, got {type(value).__name__}")
+        return self._cls._hook_with_memo(value, {})
+
+    def __getitem__(self, index: Any) -> Any:
+        if isinstance(index, slice):
+            return [self._row(i) for i in range(*index.indices(len(self._rows)))]
+        return self._row(index)
+
+    def __setitem__(self, index: Any, value: Any) -> None:
+        if isinstance(index, slice):
+            values = [self._convert(v) for v in value]
+            self._rows[index] = values
+            self._keys[index] = [None] * len(values)
+            return
+        self._rows[index] = self._convert(value)
+        self._keys[index] = None
+
+    def __delitem__(self, index: Any) -> None:
+        del self._rows[index]
+        del self._keys[index]
+
+    def __len__(self) -> int:
+        return len(self._rows)
+
+    def __iter__(self) -> Any:
+        for i in range(len(self._rows)):
+            yield self._row(i)
+
+    def insert(self, index: int, value: Any) -> None:
+        self._rows.insert(index, self._convert(value))
+        self._keys.insert(index, None)
+
+    def compacted(self) -> int:
+        """Returns the number of records still stored as value tuples."""
+        return sum(1 for keys in self._keys if keys is not None)
+
+    def __eq__(self, other: object) -> bool:
+        if isinstance(other, MagiRecords):
+            other = [other._build(i) for i in range(len(other))]
+        if not isinstance(other, list):
+            return NotImplemented
+        return len(other) == len(self) and all(
+            self._build(i) == o for i, o in enumerate(other)
+        )
+
+    __hash__ = None  # type: ignore[assignment]
+
+    def __repr__(self) -> str:
+        return f"MagiRecords({[self._build(i) for i in range(len(self))]!r})"
+
+    def __reduce__(self) -> tuple:
+        return (MagiRecords._from_rows, (self._cls, list(self._keys), list(self._rows)))
+
+
+# Values holding at most this many items in total are converted in one hook
+# call by _hook_slices; larger dicts, lists and tuples are walked item by item
+_SLICE_ITEMS = 64
+_SLICE_SCALARS = frozenset((str, int, float, bool, type(None)))
+_SLICE_WALKED = frozenset((dict, list, tuple))
+
+
+def _slice_is_small(item: Any) -> bool:
+    """True if the dicts, lists and tuples in item hold at most _SLICE_ITEMS
+    items together, so it can be converted without yielding."""
+    budget = _SLICE_ITEMS
+    pending = [item]
+    while pending:
+        node = pending.pop()
+        budget -= len(node)
+        if budget < 0:
+            return False
+        for elem in node.values() if type(node) is dict else node:
+            if type(elem) in _SLICE_WALKED:
+                pending.append(elem)
+    return True
+
+
+def _hook_slices(cls: type, item: Any, memo: dict, budget: float) -> Any:
+    """Generator form of _hook_with_memo used by aenchant. Large dicts, lists
+    and tuples are walked on an explicit stack while small children are
+    converted in one hook call each, and the generator yields whenever budget
+    seconds have passed since it was last resumed. Its return value is the
+    converted item."""
+    if type(item) not in _SLICE_WALKED or _slice_is_small(item):
+        return cls._hook_with_memo(item, memo)
+
+    # Frames are [source, result, child iterator, key in the parent frame]
+    stack: List[list] = []
+
+    def push(src: Any, key: Any) -> None:
+        _check_depth(len(stack))
+        if type(src) is dict:
+            result = cls()
+            memo[id(src)] = result
+            stack.append([src, result, iter(src.items()), key])
+        elif type(src) is list:
+            memo[id(src)] = src
+            stack.append([src, src, enumerate(src), key])
+        else:
+            stack.append([src, [], enumerate(src), key])
+
+    def deliver(frame: list, key: Any, value: Any) -> None:
+        src, result = frame[0], frame[1]
+        if type(src) is dict:
+            dict.__setitem__(result, key, value)
+        elif type(src) is list:
+            if value is not src[key]:
+                src[key] = value
+        else:
+            result.append(value)
+
+    push(item, None)
+    deadline = perf_counter() + budget
+    while True:
+        frame = stack[-1]
+        for key, child in frame[2]:
+            if type(child) in _SLICE_SCALARS:
+                deliver(frame, key, child)
+                continue
+            if type(child) in _SLICE_WALKED and id(child) not in memo and not _slice_is_small(child):
+                push(child, key)
+                break
+            deliver(frame, key, cls._hook_with_memo(child, memo))
+            if perf_counter() >= deadline:
+                yield
+                deadline = perf_counter() + budget
+        else:
+            stack.pop()
+            src, result = frame[0], frame[1]
+            if type(src) is tuple:
+                result = tuple(result)
+            if not stack:
+                return result
+            deliver(stack[-1], frame[3], result)
+
+
+@coroutine
+def _yield_to_loop() -> Any:
+    """Suspends the awaiting coroutine for one event loop iteration, the way
+    asyncio.sleep(0) does."""
+    yield
+
+
+def magi_loads(s: Union[str, bytes, bytearray], **kwargs: Any) -> MagiDict:
     """
     Deserialize a JSON string into a MagiDict instead of a dict.
 
+    Without keyword arguments the C decoder is used when available, building
+    MagiDicts directly instead of converting the dicts json.loads produces.
+
     Parameters:
         s: The JSON string to deserialize.
         **kwargs: Additional keyword arguments to pass to json.loads.
@@ -633,7 +2881,20 @@ def magi_loads(s: str, **kwargs: Any) -> MagiDict:
     Returns:
         A MagiDict representing the deserialized JSON data.
     """
-    return json.loads(s, object_hook=MagiDict, **kwargs)
+    if _has_c_type and not kwargs:
+        if isinstance(s, (bytes, bytearray)):
+            encoding = json.detect_encoding(s)
+            if encoding == "utf-8-sig":
+                return _c_loads(memoryview(s)[3:])
+            if encoding != "utf-8":
+                return _c_loads(s.decode(encoding, "surrogatepass"))
+        elif isinstance(s, str) and s.startswith("\ufeff"):
+            raise json.JSONDecodeError("Unexpected UTF-8 BOM (decode using utf-8-sig)", s, 0)
+        return _c_loads(s)
+    result = json.loads(s, object_hook=MagiDict, **kwargs)
+    if _max_depth is not None:
+        _check_loaded_depth(result)
+    return result
 
 
 def magi_load(fp: Any, **kwargs: Any) -> MagiDict:
@@ -647,15 +2908,560 @@ def magi_load(fp: Any, **kwargs: Any) -> MagiDict:
     Returns:
         A MagiDict representing the deserialized JSON data.
     """
-    return json.load(fp, object_hook=MagiDict, **kwargs)
+    return magi_loads(fp.read(), **kwargs)
+
+
+async def amagi_loads(s: Union[str, bytes, bytearray], budget_us: int = 1000, **kwargs: Any) -> MagiDict:
+    """
+    Deserialize a JSON string into a MagiDict without blocking the event loop
+    for the whole parse. Without keyword arguments the document is decoded
+    in slices of about budget_us microseconds, yielding to the event loop
+    between slices: objects and arrays spanning more than a few kilobytes
+    are walked one member at a time, smaller values are decoded in one step
+    by the same decoder as magi_loads. With keyword arguments the document is
+    parsed with json.loads in one step and then converted in slices (see
+    aenchant).
+
+    Parameters:
+        s: The JSON string to deserialize.
+        budget_us: The time in microseconds to decode before yielding.
+        **kwargs: Additional keyword arguments to pass to json.loads.
+
+    Returns:
+        A MagiDict representing the deserialized JSON data.
+    """
+    if budget_us <= 0:
+        raise ValueError("budget_us must be positive")
+    if kwargs:
+        data = json.loads(s, **kwargs)
+        await _yield_to_loop()
+        return await _aenchant_value(MagiDict, data, budget_us)
+
+    if isinstance(s, str):
+        if s.startswith("\ufeff"):
+            raise json.JSONDecodeError("Unexpected UTF-8 BOM (decode using utf-8-sig)", s, 0)
+        buf = s.encode("utf-8", "surrogatepass")
+    elif isinstance(s, (bytes, bytearray)):
+        encoding = json.detect_encoding(s)
+        if encoding == "utf-8-sig":
+            buf = bytes(s[3:])
+        elif encoding != "utf-8":
+            buf = s.decode(encoding, "surrogatepass").encode("utf-8", "surrogatepass")
+        else:
+            buf = bytes(s)
+    else:
+        raise TypeError(f"the JSON object must be str, bytes or bytearray, not {type(s).__name__}")
+    try:
+        return await _run_slices(_decode_slices(buf, budget_us / 1e6))
+    except (json.JSONDecodeError, UnicodeDecodeError):
+        # Report the error exactly as magi_loads does
+        return magi_loads(s)
+
+
+def _py_json_ready(item: Any, active: set) -> Any:
+    """Copy item for json.dumps, replacing the None/missing sentinel MagiDicts
+    with None, unwrapping views and turning MagiRecords, their rows and the
+    mappings and lists of a snapshot into lists and dicts; used when the C encoder is
+    unavailable. Other objects are left for json.dumps and its default."""
+    if item is None or isinstance(item, (str, int, float)):
+        return item
+    is_view = isinstance(item, MagiView)
+    if is_view or isinstance(item, MagiViewList):
+        item = item.unwrap()
+    elif isinstance(item, MagiRecords):
+        # Compact rows are read from their tuples, not built as MagiDicts
+        item = [row if keys is None else dict(zip(keys, row)) for keys, row in zip(item._keys, item._rows)]
+    is_mapping = is_view or isinstance(item, (dict, _SnapshotMapping, MagiRow))
+    if is_mapping or isinstance(item, (list, tuple, _SnapshotList)):
+        if isinstance(item, MagiDict) and none(item) is None:
+            return None
+        if id(item) in active:
+            raise ValueError("Circular reference detected")
+        active.add(id(item))
+        if is_mapping:
+            items = dict.items(item) if isinstance(item, MagiDict) else item.items()
+            result: Any = {k: _py_json_ready(v, active) for k, v in items}
+        else:
+            result = [_py_json_ready(v, active) for v in item]
+        active.discard(id(item))
+        return result
+    return item
+
+
+def magi_dumps(
+    obj: Any,
+    *,
+    indent: Union[int, str, None] = None,
+    sort_keys: bool = False,
+    ensure_ascii: bool = True,
+    default: Any = None,
+    **kwargs: Any,
+) -> str:
+    """
+    Serialize a MagiDict (or any JSON-compatible object) to a JSON string.
+
+    Without extra keyword arguments the C encoder writes the tree directly,
+    with no disenchant() copy in between. The empty MagiDicts returned for
+    None values and missing keys are written as null.
+
+    Parameters:
+        obj: The object to serialize.
+        indent: Number of spaces or string used to indent nested levels.
+        sort_keys: Whether to write object keys in sorted order.
+        ensure_ascii: Whether to escape all non-ASCII characters.
+        default: Called with objects that cannot otherwise be serialized.
+        **kwargs: Additional keyword arguments to pass to json.dumps.
+
+    Returns:
+        The JSON document as a str.
+    """
+    if isinstance(indent, int):
+        indent = " " * indent
+    if _has_c_type and not kwargs:
+        return _c_dumps(obj, indent, sort_keys, ensure_ascii, default)
+
+    hook = None
+    if default is not None:
+        hook = lambda o: _py_json_ready(default(o), set())
+    return json.dumps(
+        _py_json_ready(obj, set()),
+        indent=indent,
+        sort_keys=sort_keys,
+        ensure_ascii=ensure_ascii,
+        default=hook,
+        **kwargs,
+    )
+
+
+def magi_dump(obj: Any, fp: Any, **kwargs: Any) -> None:
+    """
+    Serialize a MagiDict (or any JSON-compatible object) to a file-like object.
+
+    Parameters:
+        obj: The object to serialize.
+        fp: The file-like object to write the JSON document to.
+        **kwargs: Keyword arguments accepted by magi_dumps.
+    """
+    fp.write(magi_dumps(obj, **kwargs))
+
+
+_SKIP_START, _SKIP_CONTAINER, _SKIP_STRING, _SKIP_ESCAPE, _SKIP_SCALAR, _SKIP_DONE = range(6)
+_JSON_WS = b" \t\n\r"
+_JSON_DELIMITERS = (b" ", b"\t", b"\n", b"\r", b",", b"]", b"}")
+_JSON_DELIMITERS_STR = tuple(d.decode() for d in _JSON_DELIMITERS)
+
+
+def _py_raw_decode(buf: bytes, pos: int, final: bool = True) -> Any:
+    """Pure Python counterpart of the C raw_decode used by magi_iter.
+    Returns (value, end) or None when buf ends before the value does.
+    Decodes a growing window so each attempt costs O(record), not O(buffer)."""
+    window = 4096
+    while True:
+        last = pos + window >= len(buf)
+        try:
+            text = str(buf[pos : pos + window], "utf-8", "surrogatepass")
+            value, end = _py_stream_decoder.raw_decode(text)
+        except (UnicodeDecodeError, json.JSONDecodeError):
+            if not last:
+                window *= 2
+                continue
+            if final:
+                raise
+            return None
+        if not last and isinstance(value, (int, float)) and text[end : end + 1] not in _JSON_DELIMITERS_STR:
+            window *= 2
+            continue
+        return value, pos + len(text[:end].encode("utf-8", "surrogatepass"))
+
+
+def _py_skip_value(buf: bytes, pos: int, depth: int, mode: int, final: bool = True):
+    """Pure Python counterpart of the C skip_value scanner. Advances past one
+    JSON value without building it and can be resumed on the next chunk."""
+    size = len(buf)
+    while pos < size and mode != _SKIP_DONE:
+        c = buf[pos]
+        if mode == _SKIP_START:
+            if c in _JSON_WS:
+                pos += 1
+            elif c in b"{[":
+                depth, mode = 1, _SKIP_CONTAINER
+                pos += 1
+            elif c == 0x22:
+                mode = _SKIP_STRING
+                pos += 1
+            else:
+                mode = _SKIP_SCALAR
+        elif mode == _SKIP_CONTAINER:
+            if c == 0x22:
+                mode = _SKIP_STRING
+            elif c in b"{[":
+                depth += 1
+            elif c in b"}]":
+                depth -= 1
+                if depth == 0:
+                    mode = _SKIP_DONE
+            pos += 1
+        elif mode == _SKIP_STRING:
+            if c == 0x5C:
+                mode = _SKIP_ESCAPE
+            elif c == 0x22:
+                mode = _SKIP_CONTAINER if depth else _SKIP_DONE
+            pos += 1
+        elif mode == _SKIP_ESCAPE:
+            mode = _SKIP_STRING
+            pos += 1
+        elif c in _JSON_WS or c in b",]}":
+            mode = _SKIP_DONE
+        else:
+            pos += 1
+    if mode == _SKIP_SCALAR and final:
+        mode = _SKIP_DONE
+    return pos, depth, mode
+
+
+class _JsonStream:
+    """Chunked reader over a text or binary JSON stream. Holds only the
+    unconsumed tail of the input, so memory is bounded by the largest
+    value decoded at once rather than by the size of the stream."""
+
+    def __init__(self, fp: Any, chunk_size: int) -> None:
+        self.fp = fp
+        self.chunk_size = chunk_size
+        self.buf = b""
+        self.pos = 0
+        self.eof = False
+
+    def _fill(self, size: int) -> bool:
+        """Read up to size more bytes, dropping consumed input. False at EOF."""
+        chunk = self.fp.read(size)
+        if isinstance(chunk, str):
+            chunk = chunk.encode("utf-8", "surrogatepass")
+        if not chunk:
+            self.eof = True
+            return False
+        self.buf = self.buf[self.pos :] + chunk
+        self.pos = 0
+        return True
+
+    def peek(self) -> int:
+        """Skip whitespace and return the next byte, or -1 at end of input."""
+        while True:
+            buf, pos, size = self.buf, self.pos, len(self.buf)
+            while pos < size and buf[pos] in _JSON_WS:
+                pos += 1
+            self.pos = pos
+            if pos < size:
+                return buf[pos]
+            if self.eof or not self._fill(self.chunk_size):
+                return -1
+
+    def expect(self, chars: bytes) -> int:
+        """Consume one of the given structural characters."""
+        c = self.peek()
+        if c < 0 or c not in chars:
+            raise json.JSONDecodeError(
+                f"Expecting one of {chars.decode()!r}", self.buf.decode("utf-8", "replace"), self.pos
+            )
+        self.pos += 1
+        return c
+
+    def decode(self) -> Any:
+        """Decode the next complete value, reading more input as needed."""
+        read_size = self.chunk_size
+        while True:
+            self.peek()
+            result = _stream_raw_decode(self.buf, self.pos, self.eof)
+            if result is not None:
+                value, end = result
+                # A top-level number is only complete once a delimiter follows it
+                if self.eof or not isinstance(value, (int, float)) or self.buf[end : end + 1] in _JSON_DELIMITERS:
+                    self.pos = end
+                    return value
+            if not self._fill(read_size):
+                continue
+            read_size *= 2
+
+    def skip(self) -> None:
+        """Skip the next value without building it."""
+        depth, mode = 0, _SKIP_START
+        while True:
+            self.pos, depth, mode = _stream_skip_value(self.buf, self.pos, depth, mode, self.eof)
+            if mode == _SKIP_DONE:
+                return
+            if not self._fill(self.chunk_size) and mode != _SKIP_SCALAR:
+                raise json.JSONDecodeError("Unterminated value", "", self.pos)
+
+    def records(self) -> Iterable[Any]:
+        """Yield consecutive top-level values (JSON Lines / concatenated JSON)."""
+        while self.peek() >= 0:
+            yield self.decode()
+
+    def elements(self, parts: List[Any]) -> Iterable[Any]:
+        """Descend along parts and yield the elements of the array found there."""
+        for part in parts:
+            c = self.peek()
+            if c == 0x7B:  # {
+                self.pos += 1
+                while True:
+                    if self.peek() == 0x7D:  # }
+                        return
+                    key = self.decode()
+                    self.expect(b":")
+                    if key == part or (isinstance(part, int) and key == str(part)):
+                        break
+                    self.skip()
+                    if self.expect(b",}") == 0x7D:
+                        return
+            elif c == 0x5B and isinstance(part, int):  # [
+                self.pos += 1
+                for _ in range(part):
+                    if self.peek() == 0x5D:  # ]
+                        return
+                    self.skip()
+                    if self.expect(b",]") == 0x5D:
+                        return
+                if self.peek() == 0x5D:
+                    return
+            else:
+                return
+
+        if self.peek() != 0x5B:
+            if self.peek() >= 0:
+                yield self.decode()
+            return
+        self.pos += 1
+        if self.peek() == 0x5D:
+            return
+        while True:
+            yield self.decode()
+            if self.expect(b",]") == 0x5D:
+                return
+
+
+def magi_iter(fp: Any, path: Union[str, None] = None, chunk_size: int = 1 << 16) -> Iterable[Any]:
+    """
+    Lazily deserialize JSON from a file-like object, reading it in chunks.
+
+    Without a path, yields each top-level value in turn, which covers
+    NDJSON/JSON Lines as well as concatenated JSON documents. With a dotted
+    path such as "data.items", yields the elements of the array at that path
+    one at a time; everything outside the path is skipped without being built.
+    Memory stays bounded by the largest single record.
+
+    Parameters:
+        fp: A text or binary file-like object with a read(size) method.
+        path: Optional dotted path to an array inside a single JSON document.
+              Segments follow the same quoting rules as dotted keys; unquoted
+              integer segments index into arrays.
+        chunk_size: Number of characters or bytes to read at a time.
+
+    Returns:
+        An iterator of MagiDicts (or other JSON values).
+    """
+    stream = _JsonStream(fp, chunk_size)
+    if path is None:
+        yield from stream.records()
+        return
+
+    parts: List[Any] = []
+    splitter = _c_split_dotted if _has_c_hook else _split_dotted
+    for part in splitter(path) if path else []:
+        if len(part) > 1 and part[0] in "'\"" and part[-1] == part[0]:
+            parts.append(part[1:-1])
+        elif part.isdigit():
+            parts.append(int(part))
+        else:
+            parts.append(part)
+    yield from stream.elements(parts)
 
 
-def enchant(d: dict) -> MagiDict:
+def enchant(d: dict, lazy: bool = False, workers: Union[int, None] = None) -> MagiDict:
     """
     Convert a standard dictionary into a MagiDict.
 
     Parameters:
         d: The standard dictionary to convert.
+        lazy: If True, only the top level is copied up front. Nested dicts are
+              converted when first reached through attribute access, item access
+              or iteration, and cached in place after that.
+        workers: If more than 1, split the top-level values of d, and the
+                 elements of top-level lists, across that many threads. They
+                 only run in parallel when the GIL is disabled, which the C
+                 extension does not allow.
+
+    Returns:
+        A MagiDict representing the input dictionary.
+    """
+    if isinstance(d, MagiDict):
+        return d
+    if not isinstance(d, dict):
+        raise TypeError(f"Expected dict, got {type(d).__name__}")
+    _check_workers(workers)
+    if workers is not None and workers > 1:
+        if lazy:
+            raise ValueError("workers cannot be combined with lazy=True")
+        return _enchant_in_threads(MagiDict, d, workers)
+    if not lazy:
+        return MagiDict(d)
+    md = MagiDict()
+    dict.update(md, d)
+    _set_state(md, _LAZY_MEMO, {id(d): (d, md)})
+    return md
+
+
+def enchant_many(
+    records: Iterable[dict], intern_keys: bool = False, compact: bool = False, workers: Union[int, None] = None
+) -> Union[List[MagiDict], "MagiRecords"]:
+    """
+    Convert a batch of standard dictionaries into MagiDicts in one call
+    (see MagiDict.from_records).
+
+    Parameters:
+        records: An iterable of dicts.
+        intern_keys: If True, equal str keys across the batch share one string object.
+        compact: If True, return a MagiRecords storing plain records as value tuples.
+        workers: If more than 1, convert slices of the records on that many threads.
+
+    Returns:
+        A list with one MagiDict per record, or a MagiRecords with compact=True.
+    """
+    return MagiDict.from_records(records, intern_keys, compact, workers)
+
+
+async def _run_slices(slices: Any) -> Any:
+    """Runs a generator such as _hook_slices, yielding to the event loop
+    whenever it yields, and returns its return value."""
+    while True:
+        try:
+            next(slices)
+        except StopIteration as done:
+            return done.value
+        await _yield_to_loop()
+
+
+async def _aenchant_value(cls: type, item: Any, budget_us: int) -> Any:
+    """Runs _hook_slices on item, yielding to the event loop between slices."""
+    return await _run_slices(_hook_slices(cls, item, {}, budget_us / 1e6))
+
+
+# Objects and arrays amagi_loads finds to span more than this many bytes are
+# walked member by member; smaller values are decoded in one raw_decode call
+_DECODE_SLICE_BYTES = 1 << 16 if _has_c_type else 1 << 12
+
+
+def _decode_slices(buf: bytes, budget: float) -> Any:
+    """Generator behind amagi_loads: decodes the UTF-8 JSON document in buf,
+    yielding whenever budget seconds have passed since it was last resumed.
+    Each value is first decoded with raw_decode from a window of
+    _DECODE_SLICE_BYTES; objects and arrays that do not fit are walked on an
+    explicit stack instead. Its return value is the decoded document;
+    malformed input raises JSONDecodeError."""
+    size = len(buf)
+    window = memoryview(buf)
+    pos = 0
+    # Frames are [container, pending key]; the key is unused for arrays
+    stack: List[list] = []
+    deadline = perf_counter() + budget
+
+    def skip_ws(pos: int) -> int:
+        while pos < size and buf[pos] in _JSON_WS:
+            pos += 1
+        return pos
+
+    def fail(message: str, pos: int) -> None:
+        raise json.JSONDecodeError(message, buf.decode("utf-8", "replace"), pos)
+
+    def expect(chars: bytes, pos: int) -> tuple:
+        pos = skip_ws(pos)
+        if pos >= size or buf[pos] not in chars:
+            fail(f"Expecting one of {chars.decode()!r}", pos)
+        return buf[pos], pos + 1
+
+    def decode_small(pos: int) -> Any:
+        """Returns (value, end), or None for an object or array that
+        outgrows the window."""
+        end = pos + _DECODE_SLICE_BYTES
+        if end < size:
+            done = _stream_raw_decode(window[pos:end], 0, False)
+            if done is not None and done[1] < _DECODE_SLICE_BYTES:
+                return done[0], pos + done[1]
+            if buf[pos] in b"{[":
+                return None
+        # Scalars, which cannot be split, and values ending at the window edge
+        return _stream_raw_decode(buf, pos)
+
+    def open_key(frame: list, pos: int) -> int:
+        """Reads the key and colon of the next member of an object."""
+        pos = skip_ws(pos)
+        if pos >= size or buf[pos] != 0x22:
+            fail("Expecting property name enclosed in double quotes", pos)
+        frame[1], pos = _stream_raw_decode(buf, pos)
+        return expect(b":", pos)[1]
+
+    while True:
+        # pos is at the start of a value
+        pos = skip_ws(pos)
+        if pos >= size:
+            fail("Expecting value", pos)
+        done = decode_small(pos)
+        if done is None:
+            c = buf[pos]
+            if _max_depth is not None:
+                _check_depth(len(stack))
+            frame = [MagiDict() if c == 0x7B else [], None]
+            stack.append(frame)
+            pos = skip_ws(pos + 1)
+            if pos < size and buf[pos] == (0x7D if c == 0x7B else 0x5D):
+                value = frame[0]
+                stack.pop()
+                pos += 1
+            elif c == 0x7B:
+                pos = open_key(frame, pos)
+                continue
+            else:
+                continue
+        else:
+            value, pos = done
+            if _max_depth is not None:
+                _check_loaded_depth(value, len(stack))
+
+        # Deliver value to the innermost open container and close finished ones
+        while True:
+            if not stack:
+                if skip_ws(pos) != size:
+                    fail("Extra data", skip_ws(pos))
+                return value
+            frame = stack[-1]
+            container = frame[0]
+            if type(container) is list:
+                container.append(value)
+                c, pos = expect(b",]", pos)
+            else:
+                dict.__setitem__(container, frame[1], value)
+                c, pos = expect(b",}", pos)
+            if c == 0x2C:
+                if type(container) is not list:
+                    pos = open_key(frame, pos)
+                break
+            value = container
+            stack.pop()
+
+        if perf_counter() >= deadline:
+            yield
+            deadline = perf_counter() + budget
+
+
+async def aenchant(d: dict, budget_us: int = 1000) -> MagiDict:
+    """
+    Convert a standard dictionary into a MagiDict from a coroutine, yielding
+    to the event loop whenever the conversion has run for about budget_us
+    microseconds. Large dicts, lists and tuples are walked one item at a
+    time; nested values holding up to 64 items are converted in one step, so
+    a slice can overrun the budget by the time one of those takes.
+
+    Parameters:
+        d: The standard dictionary to convert.
+        budget_us: The time in microseconds to convert before yielding.
 
     Returns:
         A MagiDict representing the input dictionary.
@@ -664,7 +3470,95 @@ def enchant(d: dict) -> MagiDict:
         return d
     if not isinstance(d, dict):
         raise TypeError(f"Expected dict, got {type(d).__name__}")
-    return MagiDict(d)
+    if budget_us <= 0:
+        raise ValueError("budget_us must be positive")
+    return await _aenchant_value(MagiDict, d, budget_us)
+
+
+def set_max_depth(depth: Union[int, None]) -> Union[int, None]:
+    """
+    Limit the nesting depth of values converted into MagiDicts, including
+    documents decoded by magi_loads. Deeper input raises RecursionError
+    instead of being converted. The C extension converts
+    on an explicit stack, so without a limit only memory bounds the depth.
+
+    Parameters:
+        depth: The maximum number of nested dicts, lists and tuples in one
+               converted value, or None for no limit.
+
+    Returns:
+        The previous limit.
+    """
+    global _max_depth
+    if depth is not None and (not isinstance(depth, int) or isinstance(depth, bool) or depth < 1):
+        raise ValueError("depth must be a positive integer or None")
+    previous = _max_depth
+    _max_depth = depth
+    if _has_c_hook:
+        _c_set_max_depth(depth or 0)
+    return previous
+
+
+# Whether set_stats turned counting on, and the path cache counters at the
+# last reset_stats
+_stats_enabled = False
+_path_cache_base = (0, 0)
+
+
+def set_stats(enabled: bool) -> bool:
+    """
+    Turn the hot-path counters reported by stats() on or off. They are off by
+    default; while off, counting costs one branch per event in the C code.
+
+    Parameters:
+        enabled: True to start counting, False to stop.
+
+    Returns:
+        The previous setting.
+    """
+    global _stats_enabled
+    previous = _stats_enabled
+    _stats_enabled = bool(enabled)
+    if _has_c_hook:
+        _c_set_stats(_stats_enabled)
+    return previous
+
+
+def stats() -> dict:
+    """
+    Report which implementation is in use and what the hot paths have done
+    since the last reset_stats().
+
+    Returns:
+        A dict with "c_hook" and "c_type" (whether the C hook and the C
+        MagiDict type are loaded), "enabled", "path_cache_hits" and
+        "path_cache_misses" (parsed dotted paths, always counted) and, when
+        the C extension is loaded, its counters: nodes visited by the hook
+        per type, memo hits, MagiDicts created, key hits and misses, dotted
+        lookups, None/missing sentinels handed out and python_fallbacks
+        (calls to a MagiDict class or to the collections.abc checks instead
+        of the direct C path).
+    """
+    info = _compile_dotted.cache_info()
+    result = {
+        "c_hook": _has_c_hook,
+        "c_type": _has_c_type,
+        "enabled": _stats_enabled,
+        "path_cache_hits": info.hits - _path_cache_base[0],
+        "path_cache_misses": info.misses - _path_cache_base[1],
+    }
+    if _has_c_hook:
+        result.update(_c_stats())
+    return result
+
+
+def reset_stats() -> None:
+    """Zero the counters reported by stats()."""
+    global _path_cache_base
+    info = _compile_dotted.cache_info()
+    _path_cache_base = (info.hits, info.misses)
+    if _has_c_hook:
+        _c_reset_stats()
 
 
 def none(obj: Any) -> Any:
@@ -683,3 +3577,19 @@ def none(obj: Any) -> Any:
     ):
         return None
     return obj
+
+
+# Shared, protected empty MagiDicts returned for None values and missing keys
+_NONE_MAGIDICT = MagiDict()
+object.__setattr__(_NONE_MAGIDICT, "_from_none", True)
+_MISSING_MAGIDICT = MagiDict()
+object.__setattr__(_MISSING_MAGIDICT, "_from_missing", True)
+
+if _has_c_type:
+    _c_register(MagiDict, _compile_dotted, _NONE_MAGIDICT, _MISSING_MAGIDICT)
+    _c_register_view(MagiView, MagiViewList, _SnapshotList, _SnapshotMapping)
+    _c_register_records(MagiRecords, MagiRow)
+
+_py_stream_decoder = json.JSONDecoder(object_hook=MagiDict)
+_stream_raw_decode = _c_raw_decode if _has_c_type else _py_raw_decode
+_stream_skip_value = _c_skip_value if _has_c_type else _py_skip_value
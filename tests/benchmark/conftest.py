@@ -0,0 +1,11 @@
+"""Benchmark configuration.
+
+Set MAGIDICT_PURE=1 to benchmark the pure Python implementation: the C
+extension is hidden before magidict is first imported, exactly as if it
+had not been built."""
+
+import os
+import sys
+
+if os.environ.get("MAGIDICT_PURE") == "1":
+    sys.modules["magidict._magidict"] = None  # type: ignore[assignment]
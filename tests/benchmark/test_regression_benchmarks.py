@@ -0,0 +1,204 @@
+"""Benchmarks that track MagiDict against itself from release to release.
+
+Unlike test_benchmarks.py, which compares against other libraries, these
+measure how MagiDict scales: conversion with the C hook and with the Python
+fallback over tree size and shape, magi_loads throughput, dotted-path
+latency by segment count, and disenchant/search_keys/filter over size.
+Conversion and loading also record their peak memory (tracemalloc) in
+extra_info.
+
+Results are machine-readable through pytest-benchmark, and a run can be
+checked against a saved baseline:
+
+    pytest tests/benchmark/test_regression_benchmarks.py --benchmark-only \\
+        --benchmark-json=results.json --benchmark-autosave
+    pytest tests/benchmark/test_regression_benchmarks.py --benchmark-only \\
+        --benchmark-compare --benchmark-compare-fail=mean:15%
+
+Sizes run from 10**3 nodes up to MAGIDICT_BENCH_MAX_NODES (default 10**5;
+set it to 10**7 for the full curves). MAGIDICT_PURE=1 runs everything
+without the C extension (see conftest.py).
+"""
+
+import json
+import marshal
+import os
+import tracemalloc
+from collections import deque
+
+import pytest
+
+import magidict.core as core
+from magidict import MagiDict, magi_loads
+
+MAX_NODES = int(os.environ.get("MAGIDICT_BENCH_MAX_NODES", 10**5))
+SIZES = [n for n in (10**3, 10**4, 10**5, 10**6, 10**7) if n <= MAX_NODES]
+# Children per dict: "deep" trees are binary, "wide" ones nearly flat
+FANOUTS = {"deep": 2, "medium": 10, "wide": 1000}
+DEPTHS = [10, 100, 500]
+SEGMENTS = [1, 2, 4, 8, 16]
+
+
+# --- Inputs ---
+def build_tree(nodes, fanout):
+    """A tree of about `nodes` dicts, lists and scalars, filled breadth first
+    with `fanout` children per dict. Every fourth child is a small list."""
+    root = {}
+    queue = deque([root])
+    count = 1
+    while count < nodes:
+        parent = queue.popleft()
+        for k in range(fanout):
+            if count >= nodes:
+                break
+            if count % 4 == 3:
+                child = [count, str(count)]
+            else:
+                child = {"id": count, "name": f"n{count}"}
+                queue.append(child)
+            parent[f"k{k}"] = child
+            count += 3
+    return root
+
+
+def build_chain(depth):
+    """depth dicts nested in one another under the keys l0, l1, ..."""
+    root = node = {}
+    for i in range(depth):
+        node[f"l{i}"] = node = {"value": i}
+    return root
+
+
+def rounds_for(nodes):
+    """Fewer rounds for bigger inputs, so every case takes similar time."""
+    return max(3, min(50, 10**6 // nodes))
+
+
+def convert_fresh(benchmark, function, blob, nodes):
+    """Benchmark function on a new copy of the marshalled input each round;
+    conversion changes lists in place, so inputs cannot be reused."""
+    return benchmark.pedantic(
+        function, setup=lambda: ((marshal.loads(blob),), {}), rounds=rounds_for(nodes), iterations=1
+    )
+
+
+def peak_memory(function, data):
+    """Peak bytes allocated while function(data) runs, result included."""
+    tracemalloc.start()
+    try:
+        result = function(data)
+        peak = tracemalloc.get_traced_memory()[1]
+    finally:
+        tracemalloc.stop()
+    del result
+    return peak
+
+
+def record_throughput(benchmark, size):
+    """Adds MB/s, from the mean time, to the results of a finished benchmark."""
+    stats = getattr(benchmark, "stats", None)
+    if stats is not None and stats.stats.mean > 0:
+        benchmark.extra_info["mb_per_s"] = size / stats.stats.mean / 1e6
+
+
+@pytest.fixture(params=["c", "python"])
+def hook(request, monkeypatch):
+    """Runs a benchmark with the C hook and again with the Python fallback."""
+    if request.param == "c" and not core._has_c_hook:
+        pytest.skip("C extension not available")
+    if request.param == "python":
+        monkeypatch.setattr(core, "_has_c_hook", False)
+    return request.param
+
+
+# --- Conversion ---
+@pytest.mark.parametrize("nodes", SIZES)
+@pytest.mark.parametrize("shape", sorted(FANOUTS))
+def test_convert_scaling(benchmark, hook, shape, nodes):
+    blob = marshal.dumps(build_tree(nodes, FANOUTS[shape]))
+    benchmark.extra_info.update(nodes=nodes, peak_bytes=peak_memory(MagiDict, marshal.loads(blob)))
+    convert_fresh(benchmark, MagiDict, blob, nodes)
+
+
+@pytest.mark.parametrize("depth", DEPTHS)
+def test_convert_depth(benchmark, hook, depth):
+    blob = marshal.dumps([build_chain(depth) for _ in range(100)])
+    benchmark.extra_info["depth"] = depth
+    convert_fresh(benchmark, lambda chains: MagiDict(chains=chains), blob, 200 * depth)
+
+
+# --- Loading ---
+@pytest.mark.parametrize("nodes", SIZES)
+def test_magi_loads_throughput(benchmark, nodes):
+    text = json.dumps(build_tree(nodes, FANOUTS["medium"]))
+    benchmark.extra_info.update(nodes=nodes, bytes=len(text), peak_bytes=peak_memory(magi_loads, text))
+    benchmark.pedantic(magi_loads, args=(text,), rounds=rounds_for(nodes), iterations=1)
+    record_throughput(benchmark, len(text))
+
+
+@pytest.mark.parametrize("nodes", SIZES)
+def test_json_loads_baseline(benchmark, nodes):
+    """json.loads on the same input, the floor magi_loads is measured against."""
+    text = json.dumps(build_tree(nodes, FANOUTS["medium"]))
+    benchmark.extra_info.update(nodes=nodes, bytes=len(text))
+    benchmark.pedantic(json.loads, args=(text,), rounds=rounds_for(nodes), iterations=1)
+    record_throughput(benchmark, len(text))
+
+
+# --- Access ---
+@pytest.mark.parametrize("segments", SEGMENTS)
+def test_dotted_path_latency(benchmark, segments):
+    md = MagiDict(build_chain(segments))
+    path = ".".join(f"l{i}" for i in range(segments))
+    benchmark.extra_info["segments"] = segments
+    assert benchmark(md.__getitem__, path) is not None
+
+
+@pytest.mark.parametrize("segments", SEGMENTS)
+def test_compiled_path_latency(benchmark, segments):
+    md = MagiDict(build_chain(segments))
+    path = MagiDict.compile_path(".".join(f"l{i}" for i in range(segments)))
+    benchmark.extra_info["segments"] = segments
+    assert benchmark(path, md) is not None
+
+
+@pytest.mark.parametrize("segments", SEGMENTS)
+def test_attribute_chain_latency(benchmark, segments):
+    md = MagiDict(build_chain(segments))
+    names = [f"l{i}" for i in range(segments)]
+
+    def walk():
+        node = md
+        for name in names:
+            node = getattr(node, name)
+        return node
+
+    benchmark.extra_info["segments"] = segments
+    benchmark(walk)
+
+
+# --- Whole-tree operations ---
+@pytest.fixture(scope="module", params=SIZES)
+def magi_tree(request):
+    return request.param, MagiDict(build_tree(request.param, FANOUTS["medium"]))
+
+
+def test_disenchant_scaling(benchmark, magi_tree):
+    nodes, md = magi_tree
+    benchmark.extra_info["nodes"] = nodes
+    benchmark.pedantic(md.disenchant, rounds=rounds_for(nodes), iterations=1)
+
+
+def test_search_keys_scaling(benchmark, magi_tree):
+    nodes, md = magi_tree
+    benchmark.extra_info["nodes"] = nodes
+    found = benchmark.pedantic(md.search_keys, args=("name",), rounds=rounds_for(nodes), iterations=1)
+    assert found
+
+
+def test_filter_scaling(benchmark, magi_tree):
+    nodes, md = magi_tree
+    benchmark.extra_info["nodes"] = nodes
+    benchmark.pedantic(
+        md.filter, args=(lambda value: not isinstance(value, str),), rounds=rounds_for(nodes), iterations=1
+    )
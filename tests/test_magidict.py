@@ -1,7 +1,10 @@
 from collections import UserList, namedtuple
+import asyncio
 import gc
 import io
+import os
 import sys
+import tempfile
 import threading
 from typing import OrderedDict
 from unittest import TestCase, main
@@ -11,7 +14,29 @@ import pickle
 from types import MappingProxyType
 import json
 import weakref
-from magidict import MagiDict, enchant, magi_load, magi_loads, none
+from magidict import (
+    MagiDict,
+    MagiRecords,
+    MagiRow,
+    MagiSnapshot,
+    MagiView,
+    MagiViewList,
+    aenchant,
+    amagi_loads,
+    enchant,
+    enchant_many,
+    magi_dump,
+    magi_dumps,
+    magi_iter,
+    magi_load,
+    magi_loads,
+    none,
+    reset_stats,
+    set_max_depth,
+    set_stats,
+    stats,
+)
+from magidict.core import _DIR_KEYS, _WATCHERS, _get_state, _has_c_hook, _has_c_type
 
 
 md = MagiDict(
@@ -1010,6 +1035,24 @@ class TestMagiDict(TestCase):
         smd = SubMagiDict({"a": {"b": 1}})
         self.assertIsInstance(smd.a, MagiDict)
         self.assertEqual(smd.a.b, 1)
+        self.assertIs(type(smd.a), SubMagiDict)
+
+    def test_subclass_init_runs_for_nested_dicts(self):
+        """A subclass overriding __init__ still has it called for nested dicts."""
+
+        class CountingMagiDict(MagiDict):
+            """A subclass that records every construction."""
+
+            created = 0
+
+            def __init__(self, *args, **kwargs):
+                type(self).created += 1
+                super().__init__(*args, **kwargs)
+
+        cmd = CountingMagiDict({"a": {"b": {"c": 1}}, "d": [{"e": 2}]})
+        self.assertEqual(CountingMagiDict.created, 4)
+        self.assertIs(type(cmd.a.b), CountingMagiDict)
+        self.assertEqual(cmd.d[0].e, 2)
 
     def test_chained_access_with_callable(self):
         """Accessing attributes on a callable value should raise AttributeError."""
@@ -2256,6 +2299,183 @@ class TestEnchantDisenchat(TestCase):
         self.assertEqual(result, self.standard_dict)
 
 
+class TestLazyEnchant(TestCase):
+    """Test enchant(d, lazy=True)"""
+
+    def setUp(self):
+        self.data = {
+            "user": {"name": "Alice", "tags": [{"t": 1}, [{"t": 2}]]},
+            "pair": ({"p": 1}, 2),
+            "plain": 1,
+            "empty": None,
+        }
+
+    def test_nested_values_stay_plain_until_accessed(self):
+        md = enchant(self.data, lazy=True)
+        self.assertIsInstance(md, MagiDict)
+        self.assertIs(type(dict.__getitem__(md, "user")), dict)
+        user = md.user
+        self.assertIsInstance(user, MagiDict)
+        self.assertIs(dict.__getitem__(md, "user"), user)
+        self.assertIs(type(dict.__getitem__(user, "tags")[0]), dict)
+
+    def test_access_paths_convert_values(self):
+        md = enchant(self.data, lazy=True)
+        self.assertEqual(md.user.tags[0].t, 1)
+        self.assertEqual(md["user"]["tags"][1][0].t, 2)
+        self.assertEqual(md.pair[0].p, 1)
+        self.assertIsInstance(md.get("user"), MagiDict)
+        self.assertIsInstance(md.mget("user"), MagiDict)
+        self.assertEqual(md["user.tags.0.t"], 1)
+        self.assertIsInstance(md["user.tags.0"], MagiDict)
+        self.assertIs(md["user.tags.0"], md.user.tags[0])
+        self.assertTrue(md.empty._from_none)
+        self.assertTrue(md.missing._from_missing)
+
+    def test_iteration_converts_values(self):
+        md = enchant(self.data, lazy=True)
+        self.assertTrue(all(type(v) is not dict for v in md.values()))
+        for key, value in md.items():
+            if key == "user":
+                self.assertIsInstance(value, MagiDict)
+
+    def test_shared_references_and_cycles_keep_identity(self):
+        shared = {"x": 1}
+        data = {"a": shared, "b": [shared]}
+        data["self"] = data
+        md = enchant(data, lazy=True)
+        self.assertIs(md.a, md.b[0])
+        self.assertIs(md.self, md)
+        self.assertIs(md.self.a, md.a)
+
+    def test_lazy_result_matches_eager(self):
+        lazy = enchant(deepcopy(self.data), lazy=True)
+        eager = enchant(deepcopy(self.data))
+        self.assertEqual(lazy, eager)
+        self.assertEqual(lazy.disenchant(), eager.disenchant())
+        self.assertEqual(deepcopy(lazy), eager)
+        self.assertEqual(pickle.loads(pickle.dumps(lazy)), eager)
+
+    def test_mutation_and_pop(self):
+        md = enchant(self.data, lazy=True)
+        md["new"] = {"deep": {"er": 1}}
+        self.assertIsInstance(dict.__getitem__(md["new"], "deep"), MagiDict)
+        self.assertIsInstance(md.pop("user"), MagiDict)
+        self.assertIsInstance(md.setdefault("pair"), tuple)
+
+    def test_disenchant_does_not_convert(self):
+        md = enchant(self.data, lazy=True)
+        result = md.disenchant()
+        self.assertEqual(result, self.data)
+        self.assertIs(type(dict.__getitem__(md, "user")), dict)
+
+
+class TestMagiView(TestCase):
+    """Test the read-only MagiView wrapper"""
+
+    def setUp(self):
+        self.data = {
+            "user": {"name": "Alice", "tags": [{"t": 1}, [{"t": 2}]], "nick": None},
+            "pair": ({"p": 1}, 2),
+            "dotted.key": 5,
+        }
+        self.snapshot = deepcopy(self.data)
+
+    def test_read_api(self):
+        view = MagiView(self.data)
+        self.assertEqual(view.user.name, "Alice")
+        self.assertEqual(view.user.tags[0].t, 1)
+        self.assertEqual(view.user.tags[1][0].t, 2)
+        self.assertEqual(view.pair[0].p, 1)
+        self.assertEqual(view["user"]["name"], "Alice")
+        self.assertEqual(view["user.tags.1.0.t"], 2)
+        self.assertEqual(view["dotted.key"], 5)
+        self.assertIsNone(view["user.missing.x"])
+        self.assertIsNone(view["user"]["nick"])
+        self.assertEqual(view.get("nope", 3), 3)
+        self.assertEqual(len(view), 3)
+        self.assertIn("user", view)
+        self.assertEqual(list(view), list(self.data))
+        self.assertEqual(view, self.data)
+        with self.assertRaises(KeyError):
+            _ = view["nope"]
+
+    def test_missing_and_none_chain_safely(self):
+        view = MagiView(self.data)
+        self.assertIsNone(none(view.user.nick))
+        self.assertIsNone(none(view.missing.deeper))
+        self.assertTrue(view.missing._from_missing)
+        self.assertTrue(view.mget("user").mget("nick")._from_none)
+        self.assertEqual(view.mget("nope", "d"), "d")
+
+    def test_source_is_never_modified(self):
+        view = MagiView(self.data)
+        _ = view.user.tags[0].t, view.values(), view.items(), view["user.tags.1.0"]
+        _ = view.search_keys("t"), view.filter(lambda v: v != 1)
+        self.assertEqual(self.data, self.snapshot)
+        self.assertIs(type(self.data["user"]["tags"][0]), dict)
+        self.assertIs(view.unwrap(), self.data)
+        self.assertIs(view.user.unwrap(), self.data["user"])
+
+    def test_is_read_only(self):
+        view = MagiView(self.data)
+        with self.assertRaises(TypeError):
+            view["user"] = 1
+        with self.assertRaises(AttributeError):
+            view.user = 1
+        with self.assertRaises(TypeError):
+            view.user.tags[0] = 1
+
+    def test_view_list_stored_in_magidict(self):
+        view = MagiView(self.data)
+        tags = view.user.tags
+        md = MagiDict(x=tags, y=[tags])
+        self.assertIs(md.x, tags)
+        self.assertEqual(md.x[0].t, 1)
+        self.assertEqual(md.y[0][1][0].t, 2)
+        self.assertEqual(self.data, self.snapshot)
+
+    def test_search_and_filter(self):
+        view = MagiView(self.data)
+        self.assertEqual(view.search_key("name"), "Alice")
+        self.assertEqual(view.search_keys("t"), [1, 2])
+        self.assertIsInstance(view.search_key("user"), MagiView)
+        filtered = view.filter(lambda v: v != 1)
+        self.assertIsInstance(filtered, MagiDict)
+        self.assertEqual(filtered.user.name, "Alice")
+        self.assertEqual(filtered.disenchant(), MagiDict(self.snapshot).filter(lambda v: v != 1).disenchant())
+
+    def test_only_mappings_are_accepted(self):
+        with self.assertRaises(TypeError):
+            MagiView([1, 2])
+        self.assertEqual(MagiView(MagiView(self.data)).unwrap(), self.data)
+
+    def test_pickle_roundtrip(self):
+        view = MagiView(self.data)
+        restored = pickle.loads(pickle.dumps(view))
+        self.assertIsInstance(restored, MagiView)
+        self.assertEqual(restored, view)
+
+    def test_missing_dunder_raises_attribute_error(self):
+        view = MagiView(self.data)
+        with self.assertRaises(AttributeError):
+            view.__deepcopy_missing__
+        self.assertEqual(view.missing_key, {})
+        self.assertEqual(MagiView({"__x__": 1}).__x__, 1)
+
+    def test_deepcopy(self):
+        view = MagiView(self.data)
+        copied = deepcopy(view)
+        self.assertIsInstance(copied, MagiView)
+        self.assertEqual(copied, view)
+        self.assertIsNot(copied.unwrap(), self.data)
+        md = MagiDict(view=view)
+        copied = deepcopy(md)
+        self.assertIsInstance(copied.view, MagiView)
+        self.assertEqual(copied.view, view)
+        self.assertEqual(copy.copy(view), view)
+
+
 class TestMagiDictBasicFunctionality(TestCase):
     """Test basic MagiDict features"""
 
@@ -2354,6 +2574,34 @@ class TestMagiDictCircularReferences(TestCase):
         data["a"]["loop"] = data["a"]
         md = MagiDict(data)
 
+    def test_shared_reference_converted_once(self):
+        """A dict referenced from several places becomes a single MagiDict"""
+        shared = {"x": 1}
+        nested = [shared, (shared,)]
+        md = MagiDict({"a": shared, "b": shared, "c": {"d": shared}, "e": nested})
+        self.assertIs(md["a"], md["b"])
+        self.assertIs(md["a"], md["c"]["d"])
+        self.assertIs(md["e"][0], md["a"])
+        self.assertIs(md["e"][1][0], md["a"])
+
+    def test_cycle_back_to_root_on_init(self):
+        """A cycle back to the input dict points at the new MagiDict"""
+        data = {"child": {}}
+        data["child"]["root"] = data
+        md = MagiDict(data)
+        self.assertIs(md.child.root, md)
+
+    def test_hook_with_user_memo(self):
+        """A caller-supplied memo is consulted and filled in"""
+        shared = {"x": 1}
+        existing = MagiDict({"x": 2})
+        memo = {id(shared): existing}
+        result = MagiDict._hook_with_memo([shared, {"y": {}}], memo)
+        self.assertIs(result[0], existing)
+        self.assertIsInstance(result[1], MagiDict)
+        self.assertIn(id(result), memo)
+        self.assertIn(result[1], memo.values())
+
     def test_disenchant_list_circular_reference(self):
         """disenchant() handles circular refs in lists"""
         md = MagiDict({"items": [{"name": "item1"}]})
@@ -2413,6 +2661,308 @@ class TestMagiDictDotNotationEdgeCases(TestCase):
         result = md["user.email.address"]
         self.assertIsNone(result)
 
+    def test_compile_path_matches_dotted_lookup(self):
+        """A compiled path resolves exactly like the dotted string"""
+        md = MagiDict({"a": [{"b": {"1": "str", 1: "int", (1, 2): "tuple"}}]})
+        for path in ("a.0.b.'1'", "a.0.b.1", "a.0.b.(1, 2)", "a.5.b", "a.0.x"):
+            compiled = MagiDict.compile_path(path)
+            self.assertEqual(compiled(md), md[path])
+            self.assertEqual(compiled.get(md), md[path])
+
+    def test_compile_path_reuse_and_default(self):
+        """A compiled path can be applied to many objects and plain dicts"""
+        path = MagiDict.compile_path("user.name")
+        self.assertEqual(path.parts, ("user", "name"))
+        records = [{"user": {"name": n}} for n in ("a", "b")]
+        self.assertEqual([path(r) for r in records], ["a", "b"])
+        self.assertEqual(path.get({"user": {}}, "anon"), "anon")
+        self.assertIsNone(path.get({"user": {"name": None}}, "anon"))
+        self.assertEqual(path, MagiDict.compile_path("user.name"))
+        self.assertEqual(repr(path), "MagiPath('user.name')")
+
+    def test_dot_notation_through_other_containers(self):
+        """Dotted paths walk any Mapping or Sequence, not just dicts and lists"""
+        from collections import OrderedDict, UserList
+
+        md = MagiDict(
+            {"a": OrderedDict(b=UserList([10, (20, 30)])), "t": (1, 2), "s": "text"}
+        )
+        self.assertEqual(md["a.b.0"], 10)
+        self.assertEqual(md["a.b.1.-1"], 30)
+        self.assertEqual(md["t.1"], 2)
+        self.assertIsNone(md["t.5"])
+        self.assertIsNone(md["t.True"])
+        self.assertIsNone(md["s.0"])
+        self.assertIsNone(md["a.missing.0"])
+
+    def test_dot_notation_with_unbalanced_quote(self):
+        """A dotted key starting with a lone quote is a miss, not a recursion"""
+        md = MagiDict({"a": {"b": 1}, "x": MagiDict({"a.b": 2})})
+        self.assertIsNone(md['"a.b'])
+        self.assertIsNone(md["'a.b"])
+        self.assertIsNone(MagiDict.compile_path('"a.b')(md))
+        self.assertEqual(md["x.'a.b'"], 2)
+        self.assertIsNone(md["x.'a.c'"])
+
+
+class TestMagiDictExtract(TestCase):
+    """Test MagiDict.extract column extraction"""
+
+    def setUp(self):
+        self.rows = [
+            {"user": {"id": 1}, "meta": {"ts": 1.5}, "items": [{"sku": "a"}]},
+            {"user": {"id": 2}, "meta": {"ts": 2}, "items": []},
+            {"user": {}, "meta": {"ts": 3.25}},
+        ]
+
+    def test_columns_match_dotted_lookup(self):
+        """Each column holds md[path] for every record, None when missing"""
+        records = [MagiDict(row) for row in self.rows]
+        paths = ["user.id", "meta.ts", "items.0.sku", "nothing.here"]
+        columns = MagiDict.extract(records, paths)
+        self.assertEqual(list(columns), paths)
+        for path in paths:
+            self.assertEqual(columns[path], [md[path] for md in records])
+        self.assertEqual(columns["items.0.sku"], ["a", None, None])
+
+    def test_plain_dicts_and_generators(self):
+        """Plain dict records and any iterable of records are accepted"""
+        columns = MagiDict.extract(iter(self.rows), ("user.id", "meta"))
+        self.assertEqual(columns["user.id"], [1, 2, None])
+        self.assertIs(columns["meta"][0], self.rows[0]["meta"])
+        self.assertEqual(MagiDict.extract([], ["a.b"]), {"a.b": []})
+
+    def test_literal_dotted_key_wins(self):
+        """A key equal to the whole dotted path is preferred, as in md[path]"""
+        rows = [{"a.b": 1, "a": {"b": 2}}, {"a": {"b": 3}}]
+        self.assertEqual(MagiDict.extract(rows, ["a.b"])["a.b"], [1, 3])
+        records = [MagiDict(row) for row in rows]
+        self.assertEqual(MagiDict.extract(records, ["a.b"])["a.b"], [1, 3])
+
+    def test_tuple_paths(self):
+        """A tuple path is taken as already split keys"""
+        rows = [{"a": {"1": "str", 1: "int"}}]
+        columns = MagiDict.extract(rows, [("a", "1"), ("a", 1), ("a", 2)])
+        self.assertEqual(columns, {("a", "1"): ["str"], ("a", 1): ["int"], ("a", 2): [None]})
+
+    def test_nested_values_are_magidicts(self):
+        """Nested dicts reached through MagiDict records come back converted"""
+        records = [enchant(row, lazy=True) for row in self.rows] + [MagiDict(self.rows[0])]
+        column = MagiDict.extract(records, ["items.0"])["items.0"]
+        self.assertIsInstance(column[0], MagiDict)
+        self.assertEqual(column[0].sku, "a")
+        self.assertIsInstance(column[3], MagiDict)
+
+    def test_arrays(self):
+        """Numeric columns become arrays; anything else stays a list"""
+        from array import array
+
+        columns = MagiDict.extract(self.rows, ["meta.ts", "items.0.sku"], arrays=True)
+        self.assertEqual(columns["meta.ts"], [1.5, 2, 3.25])
+        self.assertIs(type(columns["meta.ts"][1]), int)
+        floats = MagiDict.extract([{"x": 1.5}, {"x": 2.0}], ["x"], arrays=True)["x"]
+        self.assertEqual(floats, array("d", [1.5, 2.0]))
+        self.assertEqual(columns["items.0.sku"], ["a", None, None])
+        ids = MagiDict.extract(self.rows[:2], ["user.id"], arrays=True)["user.id"]
+        self.assertEqual(ids, array("q", [1, 2]))
+        self.assertEqual(memoryview(ids).format, "q")
+        self.assertEqual(MagiDict.extract(self.rows, ["user.id"], arrays=True)["user.id"], [1, 2, None])
+        big = MagiDict.extract([{"n": 2**70}, {"n": 1}], ["n"], arrays=True)["n"]
+        self.assertEqual(big, [2**70, 1])
+        mixed = MagiDict.extract([{"n": 0.5}, {"n": 2**53 + 1}], ["n"], arrays=True)["n"]
+        self.assertIs(type(mixed), list)
+        self.assertEqual(mixed[1], 2**53 + 1)
+        flags = MagiDict.extract([{"f": True}], ["f"], arrays=True)["f"]
+        self.assertEqual(flags, [True])
+        self.assertEqual(MagiDict.extract([], ["n"], arrays=True)["n"], [])
+
+    def test_bad_paths(self):
+        """Paths must be a collection of strings or tuples"""
+        with self.assertRaises(TypeError):
+            MagiDict.extract(self.rows, "user.id")
+        with self.assertRaises(TypeError):
+            MagiDict.extract(self.rows, [1])
+
+
+class TestMagiDictSnapshot(TestCase):
+    """Test save_snapshot / open_snapshot"""
+
+    def setUp(self):
+        directory = tempfile.TemporaryDirectory()
+        self.addCleanup(directory.cleanup)
+        self.path = os.path.join(directory.name, "data.snap")
+        self.data = {
+            "users": [{"id": 1, "name": "Alice", "tags": ("a", 1)}, {"id": 2, "name": "Bob"}],
+            "meta": {"none": None, "flag": True, "ratio": 0.5, "big": 2**80, "neg": -(2**70)},
+            "raw": b"\x00\xff",
+            "a.b": "literal",
+            (1, "x"): "tuple key",
+            1: "int key",
+            "text": "h\u00e9llo \U0001f600",
+        }
+        MagiDict(self.data).save_snapshot(self.path)
+
+    def open(self):
+        snapshot = MagiDict.open_snapshot(self.path)
+        self.addCleanup(snapshot.close)
+        return snapshot
+
+    def test_roundtrip(self):
+        """disenchant() decodes the whole snapshot back into plain values"""
+        snapshot = self.open()
+        self.assertIsInstance(snapshot, MagiSnapshot)
+        self.assertIsInstance(snapshot, MagiView)
+        plain = snapshot.disenchant()
+        self.assertEqual(plain, self.data)
+        self.assertIs(type(plain["users"]), list)
+        self.assertIs(type(plain["users"][0]["tags"]), tuple)
+        self.assertEqual(snapshot, self.data)
+
+    def test_magidict_access(self):
+        """Attribute, dotted-key and mget access work as on a MagiDict"""
+        snapshot = self.open()
+        self.assertEqual(snapshot.users[0].name, "Alice")
+        self.assertEqual(snapshot["users.1.id"], 2)
+        self.assertEqual(snapshot["a.b"], "literal")
+        self.assertEqual(snapshot[(1, "x")], "tuple key")
+        self.assertEqual(snapshot[1], "int key")
+        self.assertEqual(snapshot.meta.big, 2**80)
+        self.assertEqual(snapshot.meta.neg, -(2**70))
+        self.assertIs(snapshot.meta.flag, True)
+        self.assertEqual(snapshot.raw, b"\x00\xff")
+        self.assertIsInstance(snapshot.meta.none, MagiDict)
+        self.assertIsInstance(snapshot.missing.deeper, MagiDict)
+        self.assertIsNone(snapshot["users.5.id"])
+        self.assertEqual(snapshot.mget("text"), self.data["text"])
+        self.assertIsInstance(snapshot.users, MagiViewList)
+        self.assertEqual(snapshot.users[-1].name, "Bob")
+        self.assertEqual([u.id for u in snapshot.users], [1, 2])
+        self.assertEqual(snapshot.users[0].tags, ("a", 1))
+        self.assertEqual(snapshot.search_key("name"), "Alice")
+        self.assertEqual(len(snapshot), len(self.data))
+        self.assertIn("meta", snapshot)
+        with self.assertRaises(KeyError):
+            snapshot["nope"]
+        with self.assertRaises(IndexError):
+            snapshot.users[2]
+
+    def test_read_only(self):
+        """A snapshot cannot be modified"""
+        snapshot = self.open()
+        with self.assertRaises(TypeError):
+            snapshot["x"] = 1
+        with self.assertRaises((AttributeError, TypeError)):
+            snapshot.x = 1
+
+    def test_shared_values_and_cycles(self):
+        """Shared containers are stored once; circular references are rejected"""
+        shared = {"x": [1, 2]}
+        MagiDict({"a": shared, "b": shared}).save_snapshot(self.path)
+        plain = self.open().disenchant()
+        self.assertIs(plain["a"], plain["b"])
+        md = MagiDict({"a": 1})
+        md["self"] = md
+        with self.assertRaises(ValueError):
+            md.save_snapshot(self.path)
+
+    def test_unsupported_values(self):
+        """Values without a snapshot encoding raise TypeError"""
+        with self.assertRaises(TypeError):
+            MagiDict({"s": {1, 2}}).save_snapshot(self.path)
+        with self.assertRaises(TypeError):
+            MagiDict({("a", (1, [2])): 1}).save_snapshot(self.path)
+
+    def test_failed_save_leaves_no_files(self):
+        """A failed save removes its temporary file and keeps the old snapshot"""
+        md = MagiDict({"a": 1})
+        md["self"] = md
+        with self.assertRaises(ValueError):
+            md.save_snapshot(self.path)
+        with self.assertRaises(TypeError):
+            MagiDict({"s": {1, 2}}).save_snapshot(self.path)
+        self.assertEqual(os.listdir(os.path.dirname(self.path)), ["data.snap"])
+        self.assertEqual(self.open().users[0].name, "Alice")
+
+    def test_file_mode(self):
+        """A new snapshot gets the umask's mode and a replaced one keeps its own"""
+        if os.name != "posix":
+            self.skipTest("POSIX permission bits")
+        umask = os.umask(0o022)
+        os.umask(umask)
+        self.assertEqual(os.stat(self.path).st_mode & 0o777, 0o666 & ~umask)
+        os.chmod(self.path, 0o640)
+        MagiDict({"a": 1}).save_snapshot(self.path)
+        self.assertEqual(os.stat(self.path).st_mode & 0o777, 0o640)
+        self.assertEqual(self.open().a, 1)
+
+    def test_magi_dumps(self):
+        """magi_dumps encodes snapshots and their lists like the plain data"""
+        data = {"users": [{"id": 1, "tags": ["a", 1]}, {"id": 2}], "meta": {"none": None, "ratio": 0.5}}
+        MagiDict(data).save_snapshot(self.path)
+        snapshot = self.open()
+        self.assertEqual(json.loads(magi_dumps(snapshot)), data)
+        self.assertEqual(json.loads(magi_dumps(snapshot.users)), data["users"])
+        self.assertEqual(json.loads(magi_dumps({"rows": snapshot.users})), {"rows": data["users"]})
+
+    def test_saving_lazy_tree(self):
+        """Lazily converted trees are written without being materialized"""
+        md = enchant({"a": {"b": [{"c": 1}]}}, lazy=True)
+        md.save_snapshot(self.path)
+        self.assertEqual(self.open()["a.b.0.c"], 1)
+
+    def test_replace_while_open(self):
+        """Saving over an open snapshot leaves the open one readable"""
+        snapshot = self.open()
+        MagiDict({"users": []}).save_snapshot(self.path)
+        self.assertEqual(snapshot.users[1].name, "Bob")
+        self.assertEqual(len(self.open().users), 0)
+
+    def test_pickle_and_close(self):
+        """Snapshots pickle by path and raise ValueError once closed"""
+        snapshot = self.open()
+        copy = pickle.loads(pickle.dumps(snapshot))
+        self.addCleanup(copy.close)
+        self.assertEqual(copy.users[0].name, "Alice")
+        self.assertEqual(repr(snapshot), f"MagiSnapshot({self.path!r})")
+        with MagiDict.open_snapshot(self.path) as other:
+            users = other.users
+        with self.assertRaises(ValueError):
+            users[0]
+
+    def test_deepcopy(self):
+        """deepcopy decodes the snapshot into a MagiView that outlives the file"""
+        with self.open() as snapshot:
+            copied = deepcopy(snapshot)
+            users = deepcopy(snapshot.users)
+        self.assertIs(type(copied), MagiView)
+        self.assertEqual(copied.disenchant(), self.data)
+        self.assertEqual(users[1].name, "Bob")
+
+    def test_invalid_file(self):
+        """Files that are not snapshots are rejected"""
+        for content in (b"", b"{}", b"MAGISNP0" + bytes(8)):
+            with open(self.path, "wb") as file:
+                file.write(content)
+            with self.assertRaises(ValueError):
+                MagiDict.open_snapshot(self.path)
+
+    def test_truncated_or_corrupt_file(self):
+        """Offsets past the end of the file raise ValueError, not IndexError"""
+        with open(self.path, "rb") as file:
+            content = file.read()
+        for size in range(16, len(content), 7):
+            with open(self.path, "wb") as file:
+                file.write(content[:size])
+            with self.subTest(size=size), self.assertRaises(ValueError):
+                MagiDict.open_snapshot(self.path)
+        root = int.from_bytes(content[8:16], "little")
+        for corrupt in (content[:8] + (len(content) + 5).to_bytes(8, "little") + content[16:],
+                        content[: root + 5] + (2**40).to_bytes(8, "little") + content[root + 13 :]):
+            with open(self.path, "wb") as file:
+                file.write(corrupt)
+            with self.assertRaises(ValueError):
+                MagiDict.open_snapshot(self.path).disenchant()
+
 
 class TestMagiDictThreadSafety(TestCase):
     """Test thread safety (or lack thereof)"""
@@ -2466,6 +3016,67 @@ class TestMagiDictThreadSafety(TestCase):
         if results["errors"]:
             print(f"Warning: {len(results['errors'])} thread safety issues detected")
 
+    def test_concurrent_hooks_on_shared_lists(self):
+        """Threads converting and mutating the same lists do not corrupt them"""
+        shared = [{"i": i, "items": [{"x": i}]} for i in range(500)]
+        errors = []
+
+        def convert():
+            try:
+                for _ in range(20):
+                    MagiDict({"shared": shared})
+            except Exception as e:
+                errors.append(e)
+
+        def mutate():
+            try:
+                for n in range(2000):
+                    shared[n % len(shared)] = {"i": n, "items": [{"x": n}]}
+                    shared.append({"extra": n})
+                    shared.pop()
+            except Exception as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target=convert) for _ in range(4)]
+        threads.append(threading.Thread(target=mutate))
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        self.assertEqual(errors, [])
+        md = MagiDict({"shared": shared})
+        self.assertTrue(all(isinstance(item, MagiDict) for item in md.shared))
+        self.assertTrue(all(isinstance(item["items"][0], MagiDict) for item in shared))
+
+    def test_subinterpreter_uses_pure_python(self):
+        """Subinterpreters get the pure Python classes instead of the extension"""
+        try:
+            import _testcapi
+        except ImportError:
+            self.skipTest("_testcapi is not available")
+        if not _has_c_type:
+            self.skipTest("C extension not available")
+        import os
+
+        root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        read_fd, write_fd = os.pipe()
+        code = (
+            f"import os, sys\n"
+            f"sys.path.insert(0, {root!r})\n"
+            f"import magidict.core as core\n"
+            f"md = core.MagiDict({{'a': {{'b': [{{'c': 1}}]}}}})\n"
+            f"ok = not core._has_c_type and md.a.b[0].c == 1\n"
+            f"os.write({write_fd}, b'1' if ok else b'0')\n"
+        )
+        try:
+            self.assertEqual(_testcapi.run_in_subinterp(code), 0)
+            self.assertEqual(os.read(read_fd, 1), b"1")
+        finally:
+            os.close(read_fd)
+            os.close(write_fd)
+        self.assertEqual(MagiDict({"a": {"b": 1}}).a.b, 1)
+
 
 class TestMagiDictProtectionBypass(TestCase):
     """Test protection mechanisms on temporary MagiDicts"""
@@ -2502,6 +3113,37 @@ class TestMagiDictProtectionBypass(TestCase):
         with self.assertRaises(TypeError):
             temp.setdefault("key", "value")
 
+    def test_missing_and_none_results_are_shared(self):
+        """Missing keys and None values reuse one protected MagiDict each"""
+        md = MagiDict({"a": None, "b": None})
+        self.assertIs(md.x, md.y)
+        self.assertIs(md.x, md.mget("z"))
+        self.assertIs(md.a, md.b)
+        self.assertIs(md.a, md.mget("a"))
+        self.assertIsNot(md.a, md.x)
+        self.assertTrue(md.x._from_missing)
+        self.assertFalse(md.x._from_none)
+        self.assertTrue(md.a._from_none)
+        self.assertIsNone(none(md.x.y.z))
+
+    def test_cannot_set_attributes_on_shared_results(self):
+        """Attribute assignment on missing/None results raises TypeError"""
+        md = MagiDict({"a": None})
+        with self.assertRaises(TypeError):
+            md.missing.flag = 1
+        with self.assertRaises(TypeError):
+            md.a.flag = 1
+        with self.assertRaises(TypeError):
+            del md.missing._from_missing
+        self.assertNotIn("flag", md.other.__dict__)
+
+    def test_copy_of_shared_result_is_independent(self):
+        """Copies of the shared results are new protected MagiDicts"""
+        md = MagiDict()
+        copied = md.missing.copy()
+        self.assertIsNot(copied, md.missing)
+        self.assertTrue(copied._from_missing)
+
     def test_bypass_via_dict_methods(self):
         """KNOWN ISSUE: Protection can be bypassed with dict methods"""
         md = MagiDict({"user": {"name": "Alice"}})
@@ -2660,6 +3302,1061 @@ class TestMagiDictDeepCopy(TestCase):
         self.assertIsNot(copied, md)
 
 
+def _run_counting_yields(coro):
+    """Runs coro on a new event loop, returning its result and how many
+    times another task got to run while it was converting."""
+
+    async def runner():
+        ticks = 0
+        done = False
+
+        async def ticker():
+            nonlocal ticks
+            while not done:
+                await asyncio.sleep(0)
+                ticks += 1
+
+        task = asyncio.ensure_future(ticker())
+        await asyncio.sleep(0)
+        try:
+            result = await coro
+        finally:
+            done = True
+            await task
+        return result, ticks
+
+    return asyncio.run(runner())
+
+
+class TestMagiDictAsync(TestCase):
+    def setUp(self):
+        self.records = [{"id": i, "tags": ["a", {"b": i}], "meta": {"x": 1.5, "y": None}} for i in range(3000)]
+        self.data = {"data": {"items": self.records}, "count": len(self.records)}
+
+    def test_aenchant_matches_enchant(self):
+        expected = enchant(deepcopy(self.data))
+        result, _ = _run_counting_yields(aenchant(self.data))
+        self.assertEqual(result, expected)
+        self.assertIsInstance(result, MagiDict)
+        item = result.data["items"][10]
+        self.assertIsInstance(item, MagiDict)
+        self.assertIsInstance(item.tags[1], MagiDict)
+        self.assertEqual(item.tags[1].b, 10)
+        self.assertIsNone(none(item.meta.y))
+
+    def test_aenchant_yields_to_loop(self):
+        _, ticks = _run_counting_yields(aenchant(self.data, budget_us=1))
+        self.assertGreater(ticks, 10)
+
+    def test_shared_references_and_cycles(self):
+        shared = {"s": 1}
+        big = [shared] * 200 + [(shared, 2)]
+        data = {"big": big}
+        big.append(data)
+        result, _ = _run_counting_yields(aenchant(data, budget_us=1))
+        self.assertIs(result.big[0], result.big[199])
+        self.assertIs(result.big[200][0], result.big[0])
+        self.assertIs(result.big[-1], result)
+
+    def test_tuples_and_named_tuples(self):
+        Point = namedtuple("Point", "x y")
+        data = {"points": tuple(Point({"v": i}, i) for i in range(100)), "pairs": [({"k": i},) for i in range(100)]}
+        result, _ = _run_counting_yields(aenchant(data, budget_us=1))
+        self.assertIsInstance(result.points, tuple)
+        self.assertIsInstance(result.points[5], Point)
+        self.assertEqual(result.points[5].x.v, 5)
+        self.assertEqual(result.pairs[7][0].k, 7)
+
+    def test_aenchant_arguments(self):
+        md = MagiDict(a=1)
+        self.assertIs(asyncio.run(aenchant(md)), md)
+        with self.assertRaises(TypeError):
+            asyncio.run(aenchant([1, 2]))
+        with self.assertRaises(ValueError):
+            asyncio.run(aenchant({}, budget_us=0))
+
+    def test_aenchant_honours_max_depth(self):
+        set_max_depth(3)
+        try:
+            with self.assertRaises(RecursionError):
+                asyncio.run(aenchant({"a": [[[[list(range(100))]]]]}))
+        finally:
+            set_max_depth(None)
+
+    def test_amagi_loads(self):
+        s = json.dumps(self.data)
+        result, ticks = _run_counting_yields(amagi_loads(s, budget_us=1))
+        self.assertEqual(result, magi_loads(s))
+        self.assertIsInstance(result.data["items"][0].meta, MagiDict)
+        self.assertGreater(ticks, 1)
+        listed = asyncio.run(amagi_loads("[{\"a\": 1}, 2]"))
+        self.assertIsInstance(listed[0], MagiDict)
+        self.assertEqual(asyncio.run(amagi_loads("3")), 3)
+
+    def test_amagi_loads_walks_large_containers(self):
+        import magidict.core as core
+
+        s = json.dumps({"a": [{"b": [1, 2.5, "x"]}, [], {}, [[3]], None], "c": {"d": "é" * 50}}, indent=2)
+        expected = magi_loads(s)
+        saved = core._DECODE_SLICE_BYTES
+        core._DECODE_SLICE_BYTES = 8
+        try:
+            for doc in (s, s.encode(), s.encode("utf-8-sig"), s.encode("utf-16")):
+                result, ticks = _run_counting_yields(amagi_loads(doc, budget_us=1))
+                self.assertEqual(result, expected)
+                self.assertIsInstance(result.a[0], MagiDict)
+                self.assertEqual(result.a[3], [[3]])
+                self.assertGreater(ticks, 1)
+        finally:
+            core._DECODE_SLICE_BYTES = saved
+
+    def test_amagi_loads_errors_match_magi_loads(self):
+        for s in ("", "[1, 2", '{"a": 1,}', '{"a" 1}', "[1 2]", '{"a": 1} x', "\ufeff{}", "[" + "1," * 5000 + "]"):
+            with self.assertRaises(json.JSONDecodeError) as sync:
+                magi_loads(s)
+            with self.assertRaises(json.JSONDecodeError) as cm:
+                asyncio.run(amagi_loads(s))
+            self.assertEqual((cm.exception.msg, cm.exception.pos), (sync.exception.msg, sync.exception.pos))
+
+    def test_amagi_loads_honours_max_depth(self):
+        s = json.dumps({"a": [[[[list(range(3000))]]]]})
+        set_max_depth(3)
+        try:
+            with self.assertRaises(RecursionError):
+                asyncio.run(amagi_loads(s))
+        finally:
+            set_max_depth(None)
+
+    def test_amagi_loads_kwargs(self):
+        from decimal import Decimal
+
+        result = asyncio.run(amagi_loads(b'{"a": {"b": 1.5}}', parse_float=Decimal))
+        self.assertEqual(result.a.b, Decimal("1.5"))
+
+
+def _nest(depth, make):
+    """Builds a value nested depth levels deep with make(inner)."""
+    value = {"leaf": 1}
+    for _ in range(depth):
+        value = make(value)
+    return value
+
+
+class TestMagiDictMaxDepth(TestCase):
+    def tearDown(self):
+        set_max_depth(None)
+
+    def test_default_is_unlimited_and_previous_returned(self):
+        self.assertIsNone(set_max_depth(10))
+        self.assertEqual(set_max_depth(None), 10)
+
+    def test_deep_nesting_converts(self):
+        depth = 100_000 if _has_c_type else 200
+        md = MagiDict(_nest(depth, lambda inner: {"a": [inner]}))
+        node = md
+        for _ in range(depth):
+            node = node.a[0]
+            self.assertIsInstance(node, MagiDict)
+        self.assertEqual(node.leaf, 1)
+
+    def test_deep_tuples_convert(self):
+        depth = 50_000 if _has_c_type else 200
+        md = MagiDict({"t": _nest(depth, lambda inner: (inner,))})
+        node = md.t
+        for _ in range(depth):
+            self.assertIsInstance(node, tuple)
+            node = node[0]
+        self.assertIsInstance(node, MagiDict)
+
+    def test_limit_raises(self):
+        set_max_depth(5)
+        MagiDict(_nest(2, lambda inner: {"a": [inner]}))
+        with self.assertRaises(RecursionError):
+            MagiDict(_nest(3, lambda inner: {"a": [inner]}))
+        with self.assertRaises(RecursionError):
+            enchant(_nest(10, lambda inner: {"a": inner}))
+        set_max_depth(None)
+        MagiDict(_nest(10, lambda inner: {"a": inner}))
+
+    def test_limit_applies_to_magi_loads(self):
+        set_max_depth(5)
+        fits = json.dumps(_nest(2, lambda inner: {"a": [inner]}))
+        self.assertEqual(magi_loads(fits), json.loads(fits))
+        self.assertEqual(magi_loads(fits.encode()), json.loads(fits))
+        too_deep = json.dumps(_nest(3, lambda inner: {"a": [inner]}))
+        with self.assertRaises(RecursionError):
+            magi_loads(too_deep)
+        with self.assertRaises(RecursionError):
+            magi_loads(too_deep.encode())
+        with self.assertRaises(RecursionError):
+            magi_loads("[[[[[[1]]]]]]")
+        set_max_depth(None)
+        self.assertEqual(magi_loads(too_deep), json.loads(too_deep))
+
+    def test_limit_applies_to_assignment(self):
+        set_max_depth(3)
+        md = MagiDict()
+        with self.assertRaises(RecursionError):
+            md["x"] = _nest(5, lambda inner: [inner])
+        self.assertNotIn("x", md)
+
+    def test_cycles_unaffected(self):
+        set_max_depth(4)
+        data = {"a": [1]}
+        data["a"].append(data)
+        md = MagiDict(data)
+        self.assertIs(md.a[1], md)
+
+    def test_invalid_depth(self):
+        for bad in (0, -1, 1.5, "3", True):
+            with self.assertRaises(ValueError):
+                set_max_depth(bad)
+        self.assertIsNone(set_max_depth(None))
+
+
+class TestMagiDictStats(TestCase):
+    """Test set_stats / stats / reset_stats"""
+
+    def setUp(self):
+        previous = set_stats(True)
+        self.addCleanup(set_stats, previous)
+        self.addCleanup(reset_stats)
+        reset_stats()
+
+    def test_implementation_info(self):
+        """stats() says which implementation is loaded"""
+        info = stats()
+        self.assertEqual(info["c_hook"], _has_c_hook)
+        self.assertEqual(info["c_type"], _has_c_type)
+        self.assertIs(info["enabled"], True)
+        self.assertIs(set_stats(False), True)
+        self.assertIs(stats()["enabled"], False)
+        self.assertIs(set_stats(True), False)
+
+    def test_built_extension_loads(self):
+        """A compiled extension for this Python imports instead of silently
+        falling back to the pure Python classes"""
+        from importlib.machinery import EXTENSION_SUFFIXES
+        import magidict
+
+        package = os.path.dirname(magidict.__file__)
+        built = [s for s in EXTENSION_SUFFIXES if os.path.exists(os.path.join(package, "_magidict" + s))]
+        if not built:
+            self.skipTest("the C extension is not built")
+        import magidict._magidict  # noqa: F401
+
+        self.assertTrue(_has_c_hook)
+        self.assertTrue(_has_c_type)
+
+    def test_path_cache_counters(self):
+        """Dotted-path cache hits and misses are counted from the last reset"""
+        md = MagiDict({"a": {"b": 1}})
+        md["a.b"]
+        md["a.b"]
+        info = stats()
+        self.assertGreaterEqual(info["path_cache_hits"], 1)
+        self.assertGreaterEqual(info["path_cache_hits"] + info["path_cache_misses"], 2)
+        reset_stats()
+        self.assertEqual(stats()["path_cache_hits"], 0)
+
+    def test_hook_counters(self):
+        """The hook counts nodes per type, memo hits and created MagiDicts"""
+        if not _has_c_hook:
+            self.skipTest("requires the C extension")
+        shared = {"x": 1}
+        md = MagiDict({"a": shared, "b": shared, "l": [1, (2, 3)], "m": MagiDict()})
+        info = stats()
+        self.assertEqual(info["hook_dicts"], 1)
+        self.assertEqual(info["hook_lists"], 1)
+        self.assertEqual(info["hook_tuples"], 1)
+        self.assertEqual(info["hook_magidicts"], 1)
+        self.assertEqual(info["memo_hits"], 1)
+        self.assertGreaterEqual(info["hook_scalars"], 4)
+        self.assertGreaterEqual(info["magidicts_created"], 1)
+        self.assertIsInstance(md.a, MagiDict)
+
+    def test_access_counters(self):
+        """Lookups, sentinels and ABC fallbacks are counted; nothing while disabled"""
+        if not _has_c_type:
+            self.skipTest("requires the C extension")
+        md = MagiDict({"a": {"b": None}, "o": MappingProxyType({"k": 1})})
+        reset_stats()
+        md["a"]
+        md.a.b
+        md.nope
+        md["a.b"]
+        md["o.k"]
+        with self.assertRaises(KeyError):
+            md["missing"]
+        info = stats()
+        self.assertEqual(info["dotted_lookups"], 2)
+        self.assertEqual(info["none_sentinels"], 1)
+        self.assertEqual(info["missing_sentinels"], 1)
+        self.assertGreaterEqual(info["key_hits"], 3)
+        self.assertGreaterEqual(info["key_misses"], 2)
+        self.assertGreaterEqual(info["python_fallbacks"], 1)
+        set_stats(False)
+        reset_stats()
+        md["a"]
+        MagiDict({"x": {"y": [1]}})
+        counters = {k: v for k, v in stats().items() if k not in ("c_hook", "c_type", "enabled")}
+        self.assertEqual(set(counters.values()), {0})
+
+
+class TestMagiDictBookkeepingKeys(TestCase):
+    """Test that keys named like MagiDict's internal state stay reachable as attributes"""
+
+    NAMES = ["_lazy_memo", "_key_index", "_dir_keys", "_watchers", "_cow_pending", "_cow_group"]
+
+    def test_plain(self):
+        md = MagiDict({name: i for i, name in enumerate(self.NAMES)})
+        for i, name in enumerate(self.NAMES):
+            self.assertEqual(getattr(md, name), i)
+
+    def test_after_index_dir_and_cow_copy(self):
+        md = MagiDict({name: i for i, name in enumerate(self.NAMES)}, nested={"x": 1})
+        md.build_index()
+        md.search_keys("x")
+        dir(md)
+        fork = md.copy(cow=True)
+        for i, name in enumerate(self.NAMES):
+            self.assertEqual(getattr(md, name), i)
+            self.assertEqual(getattr(fork, name), i)
+
+    def test_lazy(self):
+        md = enchant({"inner": {name: name for name in self.NAMES}}, lazy=True)
+        for name in self.NAMES:
+            self.assertEqual(getattr(md.inner, name), name)
+
+class TestMagiDictDirCache(TestCase):
+    """Test the cached key listing of __dir__"""
+
+    def test_keys_listed_once_until_mutation(self):
+        md = MagiDict({"b": 1, "a": 2, 3: "x"})
+        first = dir(md)
+        self.assertEqual(_get_state(md, _DIR_KEYS), [["a", "b"]])
+        token = _get_state(md, _DIR_KEYS)
+        self.assertEqual(dir(md), first)
+        self.assertIs(_get_state(md, _DIR_KEYS), token)
+        first.append("zzz")
+        self.assertNotIn("zzz", dir(md))
+
+    def test_structural_mutations_invalidate(self):
+        md = MagiDict({"a": 1, "b": 2})
+        mutations = [
+            (lambda: md.__setitem__("c", 3), "c", True),
+            (lambda: md.__delitem__("c"), "c", False),
+            (lambda: md.update(d=4), "d", True),
+            (lambda: md.pop("d"), "d", False),
+            (lambda: md.setdefault("e", 5), "e", True),
+            (lambda: md.deep_merge({"f": 6}), "f", True),
+            (lambda: md.__ior__({"g": 7}), "g", True),
+            (md.clear, "a", False),
+        ]
+        for mutate, key, present in mutations:
+            dir(md)
+            mutate()
+            self.assertEqual(key in dir(md), present, key)
+
+    def test_nested_mutation_only_invalidates_nested(self):
+        md = MagiDict({"outer": {"inner": 1}})
+        dir(md)
+        dir(md.outer)
+        token = _get_state(md, _DIR_KEYS)
+        md.outer["added"] = 2
+        self.assertIn("added", dir(md.outer))
+        self.assertIs(_get_state(md, _DIR_KEYS), token)
+
+    def test_inplace_or_invalidates(self):
+        md = MagiDict({"a": 1})
+        dir(md)
+        md |= {"added": 2}
+        self.assertIn("added", dir(md))
+
+    def test_wide_dict(self):
+        md = MagiDict({f"k{i}": i for i in range(20000)})
+        listing = dir(md)
+        self.assertEqual(len(listing), len(set(listing)))
+        self.assertTrue(set(md) <= set(listing))
+        self.assertIn("items", listing)
+
+
+class _TrackedMagiDict(MagiDict):
+    """Subclass with its own __init__, defined at module level so it pickles"""
+
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.inited = True
+
+
+class TestMagiDictPickleFastPath(TestCase):
+    def test_identity_and_cycles_all_protocols(self):
+        md = MagiDict({"a": {"b": [1, {"c": 2}]}})
+        md["self"] = md
+        md["alias"] = md.a
+        for proto in range(pickle.HIGHEST_PROTOCOL + 1):
+            restored = pickle.loads(pickle.dumps(md, proto))
+            self.assertIs(restored["self"], restored)
+            self.assertIs(restored.alias, restored.a)
+            self.assertIsInstance(restored.a.b[1], MagiDict)
+            self.assertEqual(restored.a.b[1].c, 2)
+
+    def test_restored_without_init(self):
+        data = pickle.dumps(MagiDict({"a": {"b": 1}}))
+        calls = []
+        original = MagiDict.__init__
+
+        def counting_init(self, *args, **kwargs):
+            calls.append(1)
+            original(self, *args, **kwargs)
+
+        MagiDict.__init__ = counting_init
+        try:
+            restored = pickle.loads(data)
+        finally:
+            MagiDict.__init__ = original
+        self.assertEqual(calls, [])
+        self.assertIsInstance(restored.a, MagiDict)
+        self.assertEqual(restored.a.b, 1)
+
+    def test_flagged_nodes_keep_flags(self):
+        md = MagiDict({"n": None})
+        self.assertTrue(pickle.loads(pickle.dumps(md.n))._from_none)
+        self.assertTrue(pickle.loads(pickle.dumps(md.missing))._from_missing)
+
+    def test_subclass_with_init_keeps_instance_attributes(self):
+        md = _TrackedMagiDict({"a": {"b": 1}})
+        md.extra = [1, 2]
+        md["self"] = md
+        for proto in range(pickle.HIGHEST_PROTOCOL + 1):
+            restored = pickle.loads(pickle.dumps(md, proto))
+            self.assertIs(type(restored), _TrackedMagiDict)
+            self.assertIs(restored.inited, True)
+            self.assertEqual(restored.extra, [1, 2])
+            self.assertIs(restored["self"], restored)
+            self.assertEqual(restored.a.b, 1)
+
+    def test_instance_attributes_on_plain_magidict(self):
+        md = MagiDict({"a": 1})
+        object.__setattr__(md, "note", "kept")
+        restored = pickle.loads(pickle.dumps(md))
+        self.assertEqual(restored.note, "kept")
+        self.assertEqual(restored, {"a": 1})
+
+    def test_caches_are_not_pickled(self):
+        md = MagiDict({"a": {"b": 1}})
+        dir(md)
+        md.build_index()
+        md.search_keys("b")
+        self.assertEqual(pickle.loads(pickle.dumps(md)).__dict__, {})
+
+    def test_lazy_tree(self):
+        md = enchant({"x": {"y": {"z": 1}}}, lazy=True)
+        restored = pickle.loads(pickle.dumps(md))
+        self.assertIsInstance(dict.__getitem__(restored, "x"), MagiDict)
+        self.assertEqual(restored.x.y.z, 1)
+
+    def test_legacy_state_dict(self):
+        md = MagiDict.__new__(MagiDict)
+        md.__setstate__({"data": {"k": {"v": 1}}, "_from_none": False, "_from_missing": False})
+        self.assertIsInstance(dict.__getitem__(md, "k"), MagiDict)
+        self.assertEqual(md.k.v, 1)
+
+    def test_tuple_state(self):
+        child = MagiDict({"v": 1})
+        md = MagiDict.__new__(MagiDict)
+        md.__setstate__(({"k": child},))
+        self.assertIs(md.k, child)
+
+
+class TestEnchantMany(TestCase):
+    def test_converts_each_record(self):
+        out = enchant_many([{"a": {"b": 1}}, {"c": [{"d": 2}]}])
+        self.assertEqual(len(out), 2)
+        self.assertIsInstance(out[0], MagiDict)
+        self.assertEqual(out[0].a.b, 1)
+        self.assertIsInstance(out[1].c[0], MagiDict)
+        self.assertEqual(out[1].c[0].d, 2)
+
+    def test_empty_batch(self):
+        self.assertEqual(enchant_many([]), [])
+
+    def test_shared_objects_keep_identity_across_records(self):
+        shared = {"x": 1}
+        out = enchant_many([{"s": shared}, {"t": shared}])
+        self.assertIs(out[0].s, out[1].t)
+
+    def test_intern_keys(self):
+        k1 = "".join(["na", "me"])
+        k2 = "".join(["na", "me"])
+        self.assertIsNot(k1, k2)
+        out = enchant_many([{k1: 1}, {k2: {k2: 2}}], intern_keys=True)
+        keys = [next(iter(out[0])), next(iter(out[1])), next(iter(out[1].name))]
+        self.assertIs(keys[0], keys[1])
+        self.assertIs(keys[1], keys[2])
+        self.assertEqual(out[1].name.name, 2)
+
+    def test_without_intern_keys_original_keys_kept(self):
+        k1 = "".join(["na", "me"])
+        k2 = "".join(["na", "me"])
+        out = enchant_many([{k1: 1}, {k2: 2}])
+        self.assertIs(next(iter(out[1])), k2)
+
+    def test_non_dict_record_raises(self):
+        with self.assertRaises(TypeError):
+            enchant_many([{"a": 1}, [1, 2]])
+
+    def test_magidict_record_kept(self):
+        m = MagiDict({"a": 1})
+        out = enchant_many([m])
+        self.assertIs(out[0], m)
+
+    def test_from_records_subclass(self):
+        class Sub(MagiDict):
+            pass
+
+        out = Sub.from_records(({"a": {"b": 1}} for _ in range(2)))
+        self.assertIsInstance(out[0], Sub)
+        self.assertIsInstance(out[1].a, Sub)
+
+
+class TestParallelConversion(TestCase):
+    def setUp(self):
+        self.records = [{"id": i, "tags": ["a", {"n": i}], "meta": {"x": (i, {"y": i})}} for i in range(200)]
+
+    def test_enchant_matches_sequential(self):
+        data = {"records": self.records, "count": 200, "nested": {"a": [1, {"b": 2}]}}
+        expected = enchant(deepcopy(data))
+        result = enchant(data, workers=4)
+        self.assertEqual(result, expected)
+        self.assertEqual(list(result), list(expected))
+        self.assertIsInstance(result.records[150].meta.x[1], MagiDict)
+        self.assertIsInstance(result.nested.a[1], MagiDict)
+        self.assertIs(result.records, data["records"])
+
+    def test_enchant_many_matches_sequential(self):
+        expected = enchant_many(deepcopy(self.records))
+        result = enchant_many(iter(self.records), workers=3)
+        self.assertEqual(result, expected)
+        self.assertTrue(all(isinstance(r.tags[1], MagiDict) for r in result))
+
+    def test_shared_objects_across_slices(self):
+        shared = {"s": 1}
+        records = [{"i": i, "shared": shared, "pair": (shared, i)} for i in range(100)]
+        result = enchant_many(records, workers=4)
+        self.assertTrue(all(r.shared is result[0].shared for r in result))
+        self.assertTrue(all(r.pair[0] is result[0].shared for r in result))
+        data = {"items": records, "also": shared}
+        md = enchant(data, workers=4)
+        self.assertTrue(all(r.shared is md.also for r in md["items"]))
+
+    def test_shared_object_behind_list_converted_in_place(self):
+        """Sharing is kept even when the only other parent is freed mid-walk"""
+        e = {}
+        data = {"r1": [[{"k3": e}]], "r2": ({"k2": {"k1": {"k0": e}}},), "lst": []}
+        md = enchant(data, workers=2)
+        self.assertIs(md.r1[0][0].k3, md.r2[0].k2.k1.k0)
+
+    def test_cycles_across_slices(self):
+        first, last = {"name": "first"}, {"name": "last"}
+        first["peer"], last["peer"] = last, first
+        records = [first] + [{"i": i} for i in range(50)] + [last]
+        result = enchant_many(records, workers=4)
+        self.assertIs(result[0].peer, result[-1])
+        self.assertIs(result[-1].peer, result[0])
+        again = [{"i": 0}]
+        records = again * 10
+        result = enchant_many(records, workers=5)
+        self.assertTrue(all(r is result[0] for r in result))
+
+    def test_cycle_to_root(self):
+        data = {"items": [{"i": i} for i in range(20)]}
+        data["items"].append(data)
+        data["self"] = data
+        md = enchant(data, workers=4)
+        self.assertIs(md.self, md)
+        self.assertIs(md["items"][-1], md)
+
+    def test_compact_and_intern_keys(self):
+        records = [{"key_%d" % (i % 3): i, "v": {"w": i}} for i in range(90)]
+        result = enchant_many(records, intern_keys=True, compact=True, workers=4)
+        self.assertIsInstance(result, MagiRecords)
+        self.assertEqual(len(result), 90)
+        self.assertEqual(result[89].v.w, 89)
+        names = {}
+        for record in enchant_many(records, intern_keys=True, workers=4):
+            for key in record:
+                self.assertIs(names.setdefault(key, key), key)
+
+    def test_worker_errors(self):
+        with self.assertRaises(ValueError):
+            enchant({"a": 1}, workers=0)
+        with self.assertRaises(ValueError):
+            enchant({"a": 1}, lazy=True, workers=2)
+        with self.assertRaises(ValueError):
+            enchant_many([{}], workers="2")
+        for flag in (True, False):
+            with self.assertRaises(ValueError):
+                enchant({"a": 1}, workers=flag)
+            with self.assertRaises(ValueError):
+                enchant_many([{}], workers=flag)
+        with self.assertRaises(TypeError):
+            enchant_many([{}] * 10 + [1], workers=3)
+        self.assertEqual(enchant_many([], workers=4), [])
+        self.assertEqual(enchant({}, workers=4), {})
+
+
+class TestMagiRecords(TestCase):
+    def test_compact_records_share_key_tuple(self):
+        recs = enchant_many([{"a": 1, "b": {"c": 2}}, {"a": 3, "b": {"c": 4}}], compact=True)
+        self.assertIsInstance(recs, MagiRecords)
+        self.assertEqual(len(recs), 2)
+        self.assertEqual(recs.compacted(), 2)
+        self.assertIs(recs._keys[0], recs._keys[1])
+
+    def test_reads_stay_compact(self):
+        recs = enchant_many([{"a": 1, "b": {"c": 2}, "n": None}, {"a": 3}], compact=True)
+        first = recs[0]
+        self.assertIsInstance(first, MagiRow)
+        self.assertIsInstance(first.b, MagiDict)
+        self.assertEqual(first.b.c, 2)
+        self.assertEqual((first["a"], first["b.c"], first.get("x", 0), first.mget("n")), (1, 2, 0, {}))
+        self.assertTrue(first.n._from_none)
+        self.assertTrue(first.missing._from_missing)
+        self.assertEqual(first.disenchant(), {"a": 1, "b": {"c": 2}, "n": None})
+        self.assertEqual(first, {"a": 1, "b": {"c": 2}, "n": None})
+        self.assertEqual(list(first.items())[0], ("a", 1))
+        self.assertNotIn("b.c", first)
+        with self.assertRaises(KeyError):
+            first["x"]
+        nested = first.b
+        nested["c"] = 5
+        self.assertEqual(recs[0].b.c, 5)
+        self.assertEqual([r.a for r in recs], [1, 3])
+        self.assertEqual(recs.compacted(), 2)
+
+    def test_change_through_row_stores_magidict(self):
+        recs = enchant_many([{"a": 1}, {"a": 2}, {"a": 3}], compact=True)
+        first, last = recs[0], recs[-1]
+        first["a"] = 10
+        self.assertEqual(first.a, 10)
+        self.assertIsInstance(recs[0], MagiDict)
+        self.assertEqual(recs[0], {"a": 10})
+        self.assertEqual(recs.compacted(), 2)
+        recs.insert(0, {"z": 0})
+        last |= {"b": {"c": 1}}
+        self.assertIs(last.b, recs[3].b)
+        self.assertIsInstance(recs[3].b, MagiDict)
+        self.assertEqual(recs.compacted(), 1)
+        recs[1].pop("a")
+        self.assertEqual(recs[1], {})
+
+    def test_equality_and_repr_do_not_materialize(self):
+        data = [{"a": 1}, {"b": [{"c": 2}]}]
+        recs = enchant_many(data, compact=True)
+        self.assertEqual(recs, [{"a": 1}, {"b": [{"c": 2}]}])
+        self.assertIn("MagiRecords([MagiDict({'a': 1})", repr(recs))
+        self.assertEqual(recs.compacted(), 2)
+
+    def test_magi_dumps_roundtrip(self):
+        data = [{"a": 1, "b": {"c": [2, None]}}, {"a": 3, "b": {"c": []}}, {"d": "x"}]
+        recs = enchant_many(data, compact=True)
+        recs[2]["d"] = "x"
+        self.assertEqual(recs.compacted(), 2)
+        self.assertEqual(json.loads(magi_dumps(recs)), data)
+        self.assertEqual(json.loads(magi_dumps({"row": recs[0]})), {"row": data[0]})
+        self.assertEqual(magi_loads(magi_dumps({"rows": recs}, indent=2)), {"rows": data})
+        self.assertEqual(magi_dumps(recs, sort_keys=True), json.dumps(data, sort_keys=True))
+        self.assertEqual(magi_dumps(enchant_many([], compact=True)), "[]")
+        self.assertEqual(recs.compacted(), 2)
+
+    def test_mixed_records_and_shared_objects(self):
+        shared = {"x": 1}
+        m = MagiDict({"y": 2})
+        recs = enchant_many([{"s": shared}, m, {"t": shared}], compact=True)
+        self.assertIs(recs[1], m)
+        self.assertIs(recs[0].s, recs[2].t)
+
+    def test_self_referencing_record_falls_back(self):
+        rec = {"a": 1}
+        rec["self"] = rec
+        recs = enchant_many([rec], compact=True)
+        self.assertEqual(recs.compacted(), 0)
+        self.assertIs(recs[0].self, recs[0])
+
+    def test_mutation(self):
+        recs = MagiRecords([{"a": 1}, {"a": 2}])
+        recs.append({"a": 3, "b": {"c": 4}})
+        self.assertIsInstance(recs[-1].b, MagiDict)
+        recs[0] = {"z": 0}
+        self.assertEqual(recs[0].z, 0)
+        del recs[1]
+        self.assertEqual([r.get("a") for r in recs], [None, 3])
+        with self.assertRaises(TypeError):
+            recs.append([1])
+
+    def test_intern_keys_with_compact(self):
+        k1 = "".join(["na", "me"])
+        k2 = "".join(["na", "me"])
+        recs = enchant_many([{k1: 1}, {k2: 2, "x": 0}], intern_keys=True, compact=True)
+        self.assertIs(recs._keys[0][0], recs._keys[1][0])
+
+    def test_slice_and_iteration(self):
+        recs = enchant_many([{"i": i} for i in range(5)], compact=True)
+        self.assertEqual([r.i for r in recs[1:3]], [1, 2])
+        self.assertEqual([r.i for r in recs], list(range(5)))
+        self.assertEqual(recs.compacted(), 5)
+
+    def test_pickle_round_trip(self):
+        recs = enchant_many([{"a": {"b": 1}}, {"a": {"b": 2}}], compact=True)
+        row = pickle.loads(pickle.dumps(recs[1]))
+        self.assertIs(type(row), MagiDict)
+        self.assertEqual(row.a.b, 2)
+        recs[0].update(c=1)
+        restored = pickle.loads(pickle.dumps(recs))
+        self.assertIsInstance(restored, MagiRecords)
+        self.assertEqual(restored, recs)
+        self.assertEqual(restored.compacted(), 1)
+
+    def test_subclass_records(self):
+        class Sub(MagiDict):
+            pass
+
+        recs = Sub.from_records([{"a": {"b": 1}}], compact=True)
+        self.assertIsInstance(recs[0].a, Sub)
+        self.assertIsInstance(copy.copy(recs[0]), Sub)
+        recs[0]["x"] = 1
+        self.assertIsInstance(recs[0], Sub)
+
+
+class TestMagiDictSpecialize(TestCase):
+    sample = {"user": {"profile": {"name": "x"}}, "tags": [{"label": "a"}], "items": 1}
+
+    def test_subclass_and_cache(self):
+        spec = MagiDict.specialize(self.sample)
+        self.assertTrue(issubclass(spec, MagiDict))
+        self.assertEqual(spec.__name__, "MagiDict")
+        self.assertIs(MagiDict.specialize(["user", "profile", "name", "tags", "label"]), spec)
+        self.assertEqual(spec._specialized_keys, ("label", "name", "profile", "tags", "user"))
+
+    def test_known_and_unknown_keys(self):
+        spec = MagiDict.specialize(self.sample)
+        obj = spec({"user": {"profile": {"name": "bob"}}, "tags": [{"label": "b"}], "other": {"z": 1}})
+        self.assertEqual(obj.user.profile.name, "bob")
+        self.assertIsInstance(obj.user, spec)
+        self.assertEqual(obj.tags[0].label, "b")
+        self.assertEqual(obj.other.z, 1)
+        self.assertEqual(obj.user.profile.missing, MagiDict())
+        self.assertTrue(obj.user.nope._from_missing)
+
+    def test_missing_and_none_known_keys(self):
+        spec = MagiDict.specialize(["user", "name"])
+        obj = spec({"user": None})
+        self.assertTrue(obj.user._from_none)
+        self.assertTrue(obj.name._from_missing)
+        self.assertEqual(obj.user.name, MagiDict())
+
+    def test_methods_are_not_shadowed(self):
+        spec = MagiDict.specialize(self.sample)
+        obj = spec({"items": 5, "keys": 6})
+        self.assertEqual(list(obj.items()), [("items", 5), ("keys", 6)])
+        self.assertEqual(obj["items"], 5)
+
+    def test_assigned_values_are_seen(self):
+        spec = MagiDict.specialize(["user", "name"])
+        obj = spec()
+        obj["user"] = {"name": "a"}
+        self.assertIsInstance(obj.user, spec)
+        self.assertEqual(obj.user.name, "a")
+        del obj["user"]
+        self.assertTrue(obj.user._from_missing)
+
+    def test_pickle(self):
+        spec = MagiDict.specialize(self.sample)
+        obj = spec({"user": {"profile": {"name": "bob"}}})
+        restored = pickle.loads(pickle.dumps(obj))
+        self.assertIs(type(restored), spec)
+        self.assertIs(type(restored.user), spec)
+        self.assertEqual(restored, obj)
+
+    def test_copy_on_write_fork(self):
+        spec = MagiDict.specialize(self.sample)
+        obj = spec({"user": {"profile": {"name": "bob"}}})
+        fork = obj.copy(cow=True)
+        fork.user.profile["name"] = "eve"
+        self.assertEqual(obj.user.profile.name, "bob")
+        self.assertEqual(fork.user.profile.name, "eve")
+
+    def test_lazy_enchant_subclass(self):
+        spec = MagiDict.specialize(["a", "b"])
+        raw = {"a": {"b": {"c": 1}}}
+        obj = spec(raw)
+        self.assertEqual(obj.a.b.c, 1)
+
+    def test_str_schema_rejected(self):
+        with self.assertRaises(TypeError):
+            MagiDict.specialize("user")
+
+
+class TestMagiDictCopyOnWrite(TestCase):
+    """Test copy(cow=True) forks"""
+
+    def setUp(self):
+        self.base = MagiDict(
+            {"db": {"host": "h", "ports": [1, 2], "opts": {"ssl": True}}, "name": "x", "t": ({"q": 1},)}
+        )
+
+    def test_fork_shares_until_reached(self):
+        """Nested MagiDicts stay shared until reached through the fork"""
+        fork = self.base.copy(cow=True)
+        self.assertEqual(fork, self.base)
+        self.assertIs(dict.__getitem__(fork, "db"), self.base["db"])
+        self.assertIsNot(fork.db, self.base.db)
+        self.assertIsInstance(fork.db, MagiDict)
+
+    def test_fork_changes_do_not_reach_original(self):
+        """Mutating a fork, including nested lists and tuples, leaves the original intact"""
+        fork = self.base.copy(cow=True)
+        fork.db.opts["ssl"] = False
+        fork.db.ports.append(3)
+        fork.t[0]["q"] = 5
+        fork.update({"name": "y"})
+        self.assertEqual(self.base.db.opts.ssl, True)
+        self.assertEqual(self.base.db.ports, [1, 2])
+        self.assertEqual(self.base.t[0].q, 1)
+        self.assertEqual(self.base.name, "x")
+        self.assertEqual(fork.db.opts.ssl, False)
+
+    def test_original_changes_do_not_reach_fork(self):
+        """Mutating a shared node in the original detaches it from its forks first"""
+        fork = self.base.copy(cow=True)
+        self.base["db"]["opts"]["ssl"] = False
+        self.base.db.pop("host")
+        self.assertEqual(fork.db.opts.ssl, True)
+        self.assertEqual(fork.db.host, "h")
+
+    def test_inplace_or_respects_forks(self):
+        """|= detaches shared nodes like update() does, on either side"""
+        fork = self.base.copy(cow=True)
+        opts = self.base.db.opts
+        opts |= {"extra": {"n": 1}}
+        self.assertNotIn("extra", fork.db.opts)
+        self.assertIsInstance(self.base.db.opts.extra, MagiDict)
+        fork_opts = fork.db.opts
+        fork_opts |= {"ssl": False}
+        self.assertIs(self.base.db.opts.ssl, True)
+        self.assertIs(fork.db.opts.ssl, False)
+
+    def test_popped_values_are_forked(self):
+        """pop() and popitem() never hand out the original's nodes"""
+        fork = self.base.copy(cow=True)
+        fork.pop("db")["host"] = "popped"
+        fork2 = MagiDict({"only": self.base.db}).copy(cow=True)
+        fork2.popitem()[1]["host"] = "popped"
+        self.assertEqual(self.base.db.host, "h")
+
+    def test_shared_references_and_cycles(self):
+        """Shared subtrees and cycles keep their identity in the fork"""
+        md = MagiDict({"a": {"v": 1}})
+        md["b"] = md["a"]
+        md["self"] = md
+        fork = md.copy(cow=True)
+        self.assertIs(fork.a, fork.b)
+        self.assertIs(fork["self"], fork)
+        fork.a["v"] = 2
+        self.assertEqual(md.a.v, 1)
+        self.assertEqual(fork.b.v, 2)
+
+    def test_fork_of_fork_and_shallow_copy(self):
+        """Forks can be forked again; a shallow copy of a fork shares its children"""
+        fork = self.base.copy(cow=True)
+        nested = fork.copy(cow=True)
+        nested.db["host"] = "nested"
+        self.assertEqual(fork.db.host, "h")
+        shallow = fork.copy()
+        self.assertIs(shallow.db, fork.db)
+        shallow.db["host"] = "shallow"
+        self.assertEqual(fork.db.host, "shallow")
+        self.assertEqual(self.base.db.host, "h")
+
+    def test_lazy_tree_fork(self):
+        """Lazy trees can be forked"""
+        lazy = enchant({"a": {"b": {"c": 1}}, "l": [{"x": 1}]}, lazy=True)
+        fork = lazy.copy(cow=True)
+        fork.a.b["c"] = 9
+        fork.l[0]["x"] = 2
+        self.assertEqual(lazy.a.b.c, 1)
+        self.assertEqual(lazy.l[0].x, 1)
+        self.assertIsInstance(fork.l[0], MagiDict)
+
+    def test_dropped_forks_are_released(self):
+        """Forks that are dropped do not keep growing the original's watchers"""
+        for i in range(100):
+            fork = self.base.copy(cow=True)
+            fork["name"] = i
+        del fork
+        gc.collect()
+        self.base.copy(cow=True)
+        watchers = _get_state(self.base["db"], _WATCHERS)
+        self.assertLess(sum(1 for w in watchers if w() is not None), 3)
+
+
+class TestMagiDictDeepMerge(TestCase):
+    """Test update() and deep_merge()"""
+
+    def setUp(self):
+        self.base = MagiDict(
+            {"db": {"host": "h", "port": 1, "opts": {"ssl": True}}, "tags": ["a"], "name": "x"}
+        )
+
+    def test_update_forms(self):
+        """update accepts a mapping, pairs and keywords and converts values"""
+        md = MagiDict()
+        md.update({"a": {"b": 1}}, c={"d": 2})
+        md.update([("e", [{"f": 3}])])
+        self.assertIsInstance(md.a, MagiDict)
+        self.assertIsInstance(md.c, MagiDict)
+        self.assertIsInstance(md.e[0], MagiDict)
+        shared = MagiDict({"x": 1})
+        md.update(s=shared)
+        self.assertIs(md.s, shared)
+        with self.assertRaises(TypeError):
+            md.update({}, {})
+        with self.assertRaises(ValueError):
+            md.update(["ab", "cde"])
+        with self.assertRaises(TypeError):
+            md.missing.update(a=1)
+
+    def test_update_goes_through_overridden_setitem(self):
+        """A subclass overriding __setitem__ sees every item update stores"""
+
+        class Wrapping(MagiDict):
+            def __setitem__(self, key, value):
+                super().__setitem__(key, ("wrapped", value))
+
+        md = Wrapping()
+        md.update({"a": 1}, b=2)
+        md.update([("c", 3)])
+        self.assertEqual(dict(md), {"a": ("wrapped", 1), "b": ("wrapped", 2), "c": ("wrapped", 3)})
+
+    def test_update_clears_index(self):
+        """A single update drops the key index once for all its keys"""
+        self.base.build_index()
+        self.assertEqual(self.base.search_key("port"), 1)
+        self.base.db.update({"port": 2, "user": "u"})
+        self.assertEqual(self.base.search_key("port"), 2)
+        self.assertEqual(self.base.search_key("user"), "u")
+
+    def test_merge_nested(self):
+        """Nested mappings are merged key by key instead of replaced"""
+        db = self.base.db
+        self.base.deep_merge({"db": {"port": 2, "opts": {"timeout": 5}}, "new": {"k": {"v": 1}}})
+        self.assertIs(self.base.db, db)
+        self.assertEqual(
+            self.base.disenchant(),
+            {
+                "db": {"host": "h", "port": 2, "opts": {"ssl": True, "timeout": 5}},
+                "tags": ["a"],
+                "name": "x",
+                "new": {"k": {"v": 1}},
+            },
+        )
+        self.assertIsInstance(self.base.new.k, MagiDict)
+
+    def test_merge_does_not_share_nodes_of_other(self):
+        """Mappings merged under new keys are copied, so later merges leave other alone"""
+        layer = MagiDict({"cache": {"size": 1}})
+        self.base.deep_merge(layer)
+        self.assertIsNot(self.base.cache, layer.cache)
+        self.base.deep_merge({"cache": {"size": 2}})
+        self.assertEqual(layer.cache.size, 1)
+        self.assertEqual(self.base.cache.size, 2)
+
+    def test_merge_copies_lists_of_other(self):
+        """Lists and tuples from other are copied, so forks merged with the same overlay stay apart"""
+        overlay = {"a": {"l": [1, [2], {"d": [3]}], "t": ([4],)}}
+        f1 = self.base.copy(cow=True)
+        f2 = self.base.copy(cow=True)
+        f1.deep_merge(overlay)
+        f2.deep_merge(overlay)
+        f1.a.l.append(100)
+        f1.a.l[1].append(5)
+        f1.a.l[2].d.append(6)
+        f1.a.t[0].append(7)
+        self.assertEqual(f2.a.l, [1, [2], {"d": [3]}])
+        self.assertEqual(f2.a.t, ([4],))
+        self.assertEqual(overlay, {"a": {"l": [1, [2], {"d": [3]}], "t": ([4],)}})
+        self.assertIsInstance(overlay["a"]["l"][2], dict)
+        self.assertNotIsInstance(overlay["a"]["l"][2], MagiDict)
+        cyclic = [1]
+        cyclic.append(cyclic)
+        self.base.deep_merge({"c": cyclic})
+        self.assertIsNot(self.base.c, cyclic)
+        self.assertIs(self.base.c[1], self.base.c)
+
+    def test_strategies(self):
+        """replace overwrites, append extends lists, keep only fills gaps"""
+        overlay = {"tags": ["b"], "name": "y", "db": {"port": 2, "extra": 1}}
+        replaced = self.base.copy(cow=True)
+        replaced.deep_merge(overlay)
+        self.assertEqual((replaced.tags, replaced.name, replaced.db.port), (["b"], "y", 2))
+        appended = self.base.copy(cow=True)
+        appended.deep_merge(overlay, strategy="append")
+        self.assertEqual((appended.tags, appended.name), (["a", "b"], "y"))
+        kept = self.base.copy(cow=True)
+        kept.deep_merge(overlay, strategy="keep")
+        self.assertEqual((kept.tags, kept.name, kept.db.port, kept.db.extra), (["a"], "x", 1, 1))
+        kept.deep_merge({"name": {"first": "z"}}, strategy="keep")
+        self.assertEqual(kept.name, "x")
+        self.assertEqual(self.base.tags, ["a"])
+        with self.assertRaises(ValueError):
+            self.base.deep_merge({}, strategy="deep")
+        with self.assertRaises(TypeError):
+            self.base.deep_merge([("a", 1)])
+
+    def test_layering_over_cow_copy(self):
+        """Merging layers into a copy-on-write fork leaves the base untouched"""
+        layers = [{"db": {"port": n, "opts": {"ssl": n % 2 == 0}}} for n in range(5)]
+        config = self.base.copy(cow=True)
+        for layer in layers:
+            config.deep_merge(layer)
+        self.assertEqual((config.db.port, config.db.opts.ssl, config.db.host), (4, True, "h"))
+        self.assertEqual((self.base.db.port, self.base.db.opts.ssl), (1, True))
+
+    def test_merge_cyclic_other(self):
+        """A mapping reached again through a cycle points back at its target"""
+        other = {"name": "o", "child": {"x": 1}}
+        other["self"] = other
+        other["child"]["parent"] = other
+        for strategy in ("replace", "append", "keep"):
+            md = MagiDict({"name": "m"})
+            md.deep_merge(other, strategy=strategy)
+            self.assertIs(md.self, md)
+            self.assertIs(md.child.parent, md)
+            self.assertEqual(md.child.x, 1)
+            self.assertEqual(md.name, "m" if strategy == "keep" else "o")
+        md.deep_merge(other)
+        self.assertIs(md.self, md)
+        shared = {"v": 1}
+        md = MagiDict()
+        md.deep_merge({"a": shared, "b": shared})
+        self.assertIsNot(md.a, md.b)
+
+    def test_merge_into_lazy_and_protected(self):
+        """Lazy trees are converted as they are merged into; protected ones raise"""
+        md = enchant({"a": {"b": {"c": 1}}, "l": [{"x": 1}]}, lazy=True)
+        md.deep_merge({"a": {"b": {"d": 2}}, "l": [{"y": 2}]}, strategy="append")
+        self.assertEqual(md.a.b.disenchant(), {"c": 1, "d": 2})
+        self.assertEqual([type(v) for v in md.l], [MagiDict, MagiDict])
+        mixed = MagiDict()
+        dict.__setitem__(mixed, "plain", {"p": 1})
+        mixed.deep_merge({"plain": {"q": 2}})
+        self.assertIsInstance(mixed.plain, MagiDict)
+        self.assertEqual(mixed.plain.disenchant(), {"p": 1, "q": 2})
+        with self.assertRaises(TypeError):
+            self.base.missing.deep_merge({"a": 1})
+
+
 class TestMagiDictDisenchant(TestCase):
     """Test disenchant() method"""
 
@@ -2685,6 +4382,51 @@ class TestMagiDictDisenchant(TestCase):
         self.assertIsInstance(result["items"][0], dict)
         self.assertNotIsInstance(result["items"][0], MagiDict)
 
+    def test_disenchant_preserves_container_types(self):
+        """disenchant() rebuilds tuples, named tuples and sets with their own type"""
+        Point = namedtuple("Point", "x y")
+        md = MagiDict(
+            {
+                "p": Point({"a": 1}, 2),
+                "t": ({"b": 2},),
+                "s": {1, 2},
+                "f": frozenset({3}),
+                "u": UserList([{"c": 3}]),
+            }
+        )
+        result = md.disenchant()
+        self.assertIs(type(result["p"]), Point)
+        self.assertIs(type(result["p"].x), dict)
+        self.assertIs(type(result["t"][0]), dict)
+        self.assertEqual(result["s"], {1, 2})
+        self.assertIs(type(result["f"]), frozenset)
+        self.assertIs(type(result["u"]), UserList)
+        self.assertIs(type(result["u"][0]), dict)
+
+    def test_disenchant_shared_references(self):
+        """disenchant() maps a shared MagiDict to a single dict"""
+        shared = MagiDict({"x": 1})
+        md = MagiDict({"a": shared, "b": [shared]})
+        result = md.disenchant()
+        self.assertIs(result["a"], result["b"][0])
+
+    def test_disenchant_very_deep_structure(self):
+        """disenchant() does not recurse on the C stack for deep trees"""
+        if not _has_c_type:
+            self.skipTest("requires the C extension")
+        root = MagiDict()
+        node = root
+        for _ in range(50000):
+            child = MagiDict()
+            dict.__setitem__(node, "next", [child])
+            node = child
+        result = root.disenchant()
+        depth = 0
+        while result:
+            result = result["next"][0]
+            depth += 1
+        self.assertEqual(depth, 50000)
+
 
 class TestMagiDictHelperFunctions(TestCase):
     """Test helper functions"""
@@ -4724,7 +6466,7 @@ class TestHelperFunctionsAgain(TestCase):
         plain_dict = {"nested": "value"}
 
         # Bypass __setitem__ to insert a plain dict without hooking.
-        super(MagiDict, md).__setitem__("plain", plain_dict)
+        dict.__setitem__(md, "plain", plain_dict)
 
         # Verify it's still a plain dict when accessed via brackets.
         self.assertIs(type(md["plain"]), dict)
@@ -5316,6 +7058,21 @@ class TestProtectionMechanisms(TestCase):
             ):
                 op()
 
+    def test_inplace_or_and_init_blocked_on_shared_sentinels(self):
+        """|= and __init__ cannot change the MagiDicts every miss returns"""
+        md = MagiDict({"a": None})
+        for sentinel in (md.missing_key, md.a):
+            with self.assertRaises(TypeError):
+                x = sentinel
+                x |= {"k": 1}
+            with self.assertRaises(TypeError):
+                sentinel.__init__({"k": 1})
+            self.assertEqual(len(sentinel), 0)
+        self.assertEqual(MagiDict({"b": 2}).other, {})
+        self.assertEqual(MagiDict({"b": None}).b, {})
+        md |= {"c": {"d": 1}}
+        self.assertEqual(md.c.d, 1)
+
     def test_read_operations_work_on_protected(self):
         """Test that read operations work fine on protected MagiDicts."""
         md = MagiDict({"a": None})
@@ -5716,6 +7473,266 @@ class TestMagiLoad(TestCase):
         self.assertEqual(reloaded.settings.theme, "dark")
 
 
+class TestMagiLoadsDecoder(TestCase):
+    """Test suite for magi_loads parity with json.loads object_hook decoding."""
+
+    def assertSameTree(self, expected, actual):
+        if isinstance(expected, dict):
+            self.assertIs(type(actual), MagiDict)
+            self.assertEqual(list(expected), list(actual))
+            for k in expected:
+                self.assertSameTree(expected[k], actual[k])
+        elif isinstance(expected, list):
+            self.assertIs(type(actual), list)
+            self.assertEqual(len(expected), len(actual))
+            for a, b in zip(expected, actual):
+                self.assertSameTree(a, b)
+        else:
+            self.assertIs(type(actual), type(expected))
+            self.assertEqual(actual, expected)
+
+    def test_matches_json_loads(self):
+        """Test a range of documents decode exactly as json.loads would."""
+        documents = [
+            "{}",
+            "[]",
+            "-0",
+            "1.5e-3",
+            "123456789012345678901234567890",
+            r'"caf\u00e9 \ud83d\ude00 \n\t\"\/"',
+            r'{"a": [1, 2, {"b": null}], "c": true, "d": false, "e": "\u00fc"}',
+            '{"a": 1, "a": 2}',
+            ' \n {"nested": {"deeper": [[], [{}]]}} \t',
+            '"h\u00e9llo w\u00f6rld"',
+        ]
+        for doc in documents:
+            with self.subTest(doc=doc):
+                self.assertSameTree(json.loads(doc), magi_loads(doc))
+
+    def test_non_ascii_and_surrogates(self):
+        """Test raw non-ASCII text and lone surrogate escapes are preserved."""
+        self.assertEqual(magi_loads('{"k": "h\u00e9 😀"}').k, "h\u00e9 😀")
+        self.assertEqual(magi_loads('"\\ud800"'), json.loads('"\\ud800"'))
+
+    def test_special_float_constants(self):
+        """Test NaN and Infinity are accepted like json.loads does by default."""
+        result = magi_loads('{"a": NaN, "b": Infinity, "c": -Infinity}')
+        self.assertNotEqual(result.a, result.a)
+        self.assertEqual(result.b, float("inf"))
+        self.assertEqual(result.c, float("-inf"))
+
+    def test_bytes_input(self):
+        """Test UTF-8, UTF-8 with BOM and UTF-16 bytes are decoded."""
+        self.assertEqual(magi_loads(b'{"a": {"b": 1}}').a.b, 1)
+        self.assertEqual(magi_loads(bytearray(b'{"a": 1}')).a, 1)
+        self.assertEqual(magi_loads(b'\xef\xbb\xbf{"a": 1}').a, 1)
+        self.assertEqual(magi_loads('{"a": 1}'.encode("utf-16")).a, 1)
+
+    def test_errors_match_json(self):
+        """Test invalid documents raise JSONDecodeError with json's message and position."""
+        escapes = ['"\\u00e9', '"ab\\u12', '"\\ud83d\\ude00', '"\\ud800\\u12"', '"\\u12x"', '"abc\\']
+        others = ["", "{", '{"a": 1,}', "[1,]", "[1 , ]", '{"a": 1 ,\n}', '{"a" 1}', "[1 2]", '"abc', "01", "[1]x", "\ufeff{}"]
+        for doc in others + escapes:
+            with self.subTest(doc=doc):
+                with self.assertRaises(json.JSONDecodeError) as expected:
+                    json.loads(doc)
+                with self.assertRaises(json.JSONDecodeError) as actual:
+                    magi_loads(doc)
+                self.assertEqual(actual.exception.msg, expected.exception.msg)
+                self.assertEqual(actual.exception.pos, expected.exception.pos)
+
+    def test_rejects_non_string_input(self):
+        """Test that non str/bytes input raises TypeError."""
+        with self.assertRaises(TypeError):
+            magi_loads(123)
+
+    def test_deep_nesting_raises_recursion_error(self):
+        """Test that pathologically nested input raises instead of crashing."""
+        with self.assertRaises(RecursionError):
+            magi_loads("[" * 100000)
+
+    def test_kwargs_use_json_module(self):
+        """Test that passing json.loads keyword arguments still works."""
+        result = magi_loads('{"a": 1.5}', parse_float=str)
+        self.assertEqual(result.a, "1.5")
+
+    def test_loaded_instances_behave_like_magidicts(self):
+        """Test decoded objects support the usual MagiDict features."""
+        result = magi_loads('{"a": {"b": null}, "items": [{"x": 1}]}')
+        self.assertTrue(result.a.b._from_none)
+        self.assertEqual(result["items.0.x"], 1)
+        result["new"] = {"c": 2}
+        self.assertIsInstance(result.new, MagiDict)
+        self.assertEqual(pickle.loads(pickle.dumps(result)), result)
+
+
+class TestMagiDumps(TestCase):
+    """Test suite for serializing MagiDicts with magi_dumps and magi_dump."""
+
+    def test_matches_json_dumps(self):
+        """Test output matches json.dumps for a range of values and options."""
+        documents = [
+            {},
+            {"list": []},
+            {"a": [1, 2.5, -0.0, 10**30, True, False, None], "b": {"c": ()}},
+            {"text": 'quote " backslash \\ newline \n tab \t nul \x00 del \x7f'},
+            {"unicode": "caf\xe9 \u20ac \U0001f600", "lone": "\ud800"},
+            {1: "int", 2.5: "float", True: "bool", None: "null"},
+            {"nan": float("nan"), "inf": float("inf"), "-inf": float("-inf")},
+            {"b": 1, "a": {"d": [{"f": 2}, []], "c": {}}},
+        ]
+        options = [
+            {},
+            {"indent": 2},
+            {"indent": "\t", "sort_keys": True},
+            {"indent": 0, "ensure_ascii": False},
+        ]
+        for doc in documents:
+            for opts in options:
+                if opts.get("sort_keys") and any(not isinstance(k, str) for k in doc):
+                    continue
+                with self.subTest(doc=doc, opts=opts):
+                    self.assertEqual(magi_dumps(MagiDict(doc), **opts), json.dumps(doc, **opts))
+
+    def test_sentinels_are_null(self):
+        """Test the empty MagiDicts for None values and missing keys are written as null."""
+        md = MagiDict({"a": None, "b": {"c": 1}})
+        result = magi_dumps({"none": md.a, "missing": md.nope.deeper, "empty": MagiDict()})
+        self.assertEqual(result, '{"none": null, "missing": null, "empty": {}}')
+
+    def test_round_trip(self):
+        """Test magi_loads(magi_dumps(md)) gives back an equal tree."""
+        md = magi_loads('{"users": [{"name": "Alice", "tags": ["x"]}], "n": null}')
+        self.assertEqual(magi_loads(magi_dumps(md)), md)
+
+    def test_lazy_values_are_not_materialized(self):
+        """Test serializing a lazy MagiDict leaves nested dicts untouched."""
+        md = enchant({"a": {"b": [{"c": 1}]}}, lazy=True)
+        self.assertEqual(magi_dumps(md), '{"a": {"b": [{"c": 1}]}}')
+        self.assertIs(type(dict.__getitem__(md, "a")), dict)
+
+    def test_views_are_serialized(self):
+        """Test MagiView and MagiViewList serialize as their underlying data."""
+        view = MagiView({"a": [1, {"b": 2}]})
+        self.assertEqual(magi_dumps(view), '{"a": [1, {"b": 2}]}')
+        self.assertEqual(magi_dumps(view.a), '[1, {"b": 2}]')
+
+    def test_default_callback(self):
+        """Test default is called for unsupported objects."""
+        self.assertEqual(magi_dumps({"s": {1}}, default=sorted), '{"s": [1]}')
+        with self.assertRaises(TypeError):
+            magi_dumps({"s": {1}})
+
+    def test_default_called_for_other_containers(self):
+        """Test non-builtin mappings and sequences go to default like json.dumps."""
+        from collections import UserDict, deque
+
+        self.assertEqual(magi_dumps({"q": deque([1, 2])}, default=lambda o: "deque"), '{"q": "deque"}')
+        self.assertEqual(magi_dumps({"u": UserDict(a=1)}, default=dict), '{"u": {"a": 1}}')
+        self.assertEqual(magi_dumps(range(2), default=list), "[0, 1]")
+        for value in (deque([1]), UserDict(a=1), range(2)):
+            with self.assertRaises(TypeError):
+                magi_dumps({"v": value})
+
+    def test_invalid_keys_and_cycles(self):
+        """Test unsupported keys and circular references raise like json.dumps."""
+        with self.assertRaises(TypeError):
+            magi_dumps({(1, 2): "tuple key"})
+        md = MagiDict()
+        dict.__setitem__(md, "self", md)
+        with self.assertRaises(ValueError):
+            magi_dumps(md)
+
+    def test_kwargs_use_json_module(self):
+        """Test that other json.dumps keyword arguments still work."""
+        md = MagiDict({"a": None, "b": [1, 2]})
+        self.assertEqual(
+            magi_dumps({"a": md.a, "b": md.b}, separators=(",", ":")), '{"a":null,"b":[1,2]}'
+        )
+
+    def test_magi_dump_writes_to_file(self):
+        """Test magi_dump writes the document to a file-like object."""
+        buffer = io.StringIO()
+        magi_dump(MagiDict({"a": {"b": 1}}), buffer, indent=2)
+        self.assertEqual(buffer.getvalue(), json.dumps({"a": {"b": 1}}, indent=2))
+
+
+class TestMagiIter(TestCase):
+    """Test suite for streaming deserialization with magi_iter."""
+
+    def setUp(self):
+        self.records = [
+            {"id": 1, "user": {"name": "Alice", "tags": ["a", "b"]}},
+            {"id": 2, "user": None, "score": -2.5e3},
+            [1, {"nested": True}],
+            "plain é string \\ with \"escapes\"",
+            12345678901234567890,
+        ]
+
+    def test_json_lines_records(self):
+        """Test each line of a JSON Lines stream is yielded as its own record."""
+        text = "\n".join(json.dumps(r) for r in self.records) + "\n"
+        result = list(magi_iter(io.StringIO(text)))
+        self.assertEqual(result, self.records)
+        self.assertIsInstance(result[0], MagiDict)
+        self.assertIsInstance(result[0].user, MagiDict)
+        self.assertIsInstance(result[2][1], MagiDict)
+
+    def test_tiny_chunks_and_binary_input(self):
+        """Test records split across chunk boundaries decode correctly."""
+        text = "\n\n".join(json.dumps(r, indent=2, ensure_ascii=False) for r in self.records)
+        for chunk_size in (1, 2, 3, 7):
+            with self.subTest(chunk_size=chunk_size):
+                self.assertEqual(list(magi_iter(io.StringIO(text), chunk_size=chunk_size)), self.records)
+                self.assertEqual(
+                    list(magi_iter(io.BytesIO(text.encode()), chunk_size=chunk_size)), self.records
+                )
+
+    def test_concatenated_scalars(self):
+        """Test whitespace separated top-level values, including numbers at chunk ends."""
+        self.assertEqual(list(magi_iter(io.StringIO("1 -2.5 3e2 true null"), chunk_size=1)), [1, -2.5, 300.0, True, None])
+
+    def test_path_yields_array_elements(self):
+        """Test a dotted path yields elements of the nested array only."""
+        doc = {
+            "meta": {"items": "decoy", "tricky": "]}\"{["},
+            "data": {"count": 3, "items": self.records},
+            "after": [1, 2],
+        }
+        text = json.dumps(doc)
+        for chunk_size in (1, 5, 4096):
+            with self.subTest(chunk_size=chunk_size):
+                result = list(magi_iter(io.StringIO(text), "data.items", chunk_size=chunk_size))
+                self.assertEqual(result, self.records)
+
+    def test_path_with_index_and_scalar_target(self):
+        """Test integer segments index arrays and non-array targets are yielded once."""
+        text = json.dumps({"pages": [{"rows": [1]}, {"rows": [{"a": 1}, {"a": 2}]}], "total": 2})
+        self.assertEqual(list(magi_iter(io.StringIO(text), "pages.1.rows")), [{"a": 1}, {"a": 2}])
+        self.assertEqual(list(magi_iter(io.StringIO(text), "total")), [2])
+        self.assertEqual(list(magi_iter(io.StringIO(text), "missing.path")), [])
+
+    def test_empty_path_iterates_top_level_array(self):
+        """Test an empty path yields the elements of a top-level array."""
+        result = list(magi_iter(io.StringIO('[{"a": 1}, {"b": 2}]'), ""))
+        self.assertEqual(result, [{"a": 1}, {"b": 2}])
+        self.assertIsInstance(result[0], MagiDict)
+
+    def test_truncated_and_invalid_input(self):
+        """Test stream errors surface as JSONDecodeError."""
+        with self.assertRaises(json.JSONDecodeError):
+            list(magi_iter(io.StringIO('{"a": 1}\n{"b": ')))
+        with self.assertRaises(json.JSONDecodeError):
+            list(magi_iter(io.StringIO('{"a": 1}\n{"b" 1}\n')))
+
+    def test_records_are_yielded_lazily(self):
+        """Test records are produced before the whole stream has been read."""
+        stream = io.StringIO("\n".join(json.dumps({"i": i}) for i in range(1000)))
+        iterator = magi_iter(stream, chunk_size=64)
+        self.assertEqual(next(iterator).i, 0)
+        self.assertLess(stream.tell(), 1000)
+
+
 class TestStandardDictAccess(TestCase):
     """Test standard dictionary key access (STRICT)."""
 
@@ -6409,6 +8426,75 @@ class TestMagiDictSearchKeys(TestCase):
         self.assertEqual(sorted(results), ["v1", "v2"])
 
 
+class TestMagiDictKeyIndex(TestCase):
+    """Test search_key and search_keys backed by build_index()."""
+
+    def setUp(self):
+        self.md = MagiDict(
+            {
+                "id": 0,
+                "a": {"id": None, "b": {"id": 1}},
+                "items": [{"id": 2}, [{"id": 3}]],
+                "c": {"id": 4},
+            }
+        )
+
+    def test_indexed_results_match_scan(self):
+        """Test indexed lookups return what the recursive search returns."""
+        expected = [self.md.search_key(k) for k in ("id", "b", "nope")]
+        expected_all = [self.md.search_keys(k) for k in ("id", "b", "nope")]
+        self.md.build_index()
+        self.assertEqual([self.md.search_key(k) for k in ("id", "b", "nope")], expected)
+        self.assertEqual([self.md.search_keys(k) for k in ("id", "b", "nope")], expected_all)
+        self.assertEqual(self.md.search_keys("id"), [0, None, 1, 2, 3, 4])
+
+    def test_indexed_search_key_semantics(self):
+        """Test a nested None hides the rest of its mapping and lists of lists are skipped."""
+        md = MagiDict({"a": {"id": None, "b": {"id": 1}}, "l": [[{"id": 2}]], "c": {"id": 3}})
+        md.build_index()
+        self.assertEqual(md.search_key("id"), 3)
+        self.assertEqual(md.search_key("missing", "default"), "default")
+
+    def test_nested_mutation_invalidates_index(self):
+        """Test changes anywhere in the tree are reflected in later searches."""
+        self.md.build_index()
+        self.md.c["id"] = 40
+        self.assertEqual(self.md.search_keys("id")[-1], 40)
+        self.md.a.b["new"] = {"id": 5}
+        self.assertIn(5, self.md.search_keys("id"))
+        del self.md.a["b"]
+        self.assertNotIn(1, self.md.search_keys("id"))
+        self.md.c.pop("id")
+        self.assertNotIn(40, self.md.search_keys("id"))
+        self.md.update({"extra": {"id": 6}})
+        self.assertEqual(self.md.search_keys("id")[-1], 6)
+        self.md["items"][0].clear()
+        self.assertNotIn(2, self.md.search_keys("id"))
+
+    def test_inplace_or_invalidates_index(self):
+        """Test |= on a nested MagiDict is reflected in later searches."""
+        self.md.build_index()
+        self.assertEqual(self.md.search_keys("k"), [])
+        nested = self.md.a
+        nested |= {"k": 2}
+        self.assertEqual(self.md.search_keys("k"), [2])
+        self.assertEqual(self.md.search_key("k"), 2)
+
+    def test_unhashable_key(self):
+        """Test searching for an unhashable key falls back to a scan."""
+        self.md.build_index()
+        self.assertEqual(self.md.search_keys(["id"]), [])
+        self.assertIsNone(self.md.search_key(["id"]))
+
+    def test_copies_do_not_share_index(self):
+        """Test copies of an indexed MagiDict search their own contents."""
+        self.md.build_index()
+        copied = deepcopy(self.md)
+        copied.c["id"] = 44
+        self.assertEqual(copied.search_keys("id")[-1], 44)
+        self.assertEqual(self.md.search_keys("id")[-1], 4)
+
+
 class TestSearchKeyEdgeCases(TestCase):
     """Edge case tests for both search_key and search_keys."""
 
@@ -6449,6 +8535,28 @@ class TestSearchKeyEdgeCases(TestCase):
         results = md.search_keys("key")
         self.assertEqual(results, ["value"])
 
+    def test_search_circular_structure(self):
+        """Test searches terminate on circular references."""
+        md = MagiDict({"a": {"id": 1}})
+        md["a"]["loop"] = md
+        dict.__setitem__(md, "items", [md, {"id": 2}])
+        self.assertEqual(md.search_keys("id"), [1, 2])
+        self.assertEqual(md.search_key("id"), 1)
+        self.assertIsNone(md.search_key("missing"))
+
+    def test_search_reads_plain_mappings_in_place(self):
+        """Test values under non-MagiDict mappings are returned without copying."""
+        inner = {"deep": 1}
+        md = MagiDict({"proxy": MappingProxyType({"key": inner})})
+        self.assertIs(md.search_key("key"), inner)
+        self.assertIs(md.search_keys("key")[0], inner)
+
+    def test_search_shared_subtree_counted_per_path(self):
+        """Test a subtree reachable twice (without a cycle) is searched twice."""
+        shared = MagiDict({"id": 1})
+        md = MagiDict({"a": shared, "b": [shared]})
+        self.assertEqual(md.search_keys("id"), [1, 1])
+
 
 class TestFilterBasic(TestCase):
     """Test basic filtering functionality."""
@@ -6644,6 +8752,49 @@ class TestFilterComplexScenarios(TestCase):
         self.assertEqual(result, MagiDict({"active": True, "enabled": True}))
 
 
+class TestFilterBatch(TestCase):
+    """Test filter() with batch predicates."""
+
+    def setUp(self):
+        self.md = MagiDict({"a": 1, "b": None, "c": {"d": 2, "e": None}, "f": [3, None, {"g": 4}]})
+
+    def test_batch_single_argument(self):
+        """Test a batch predicate receives all leaf values at once."""
+        calls = []
+
+        def predicate(values):
+            calls.append(list(values))
+            return [v is not None for v in values]
+
+        result = self.md.filter(predicate, batch=True)
+        self.assertEqual(calls, [[1, None, 2, None, 3, None, 4]])
+        self.assertEqual(result, self.md.filter(None))
+
+    def test_batch_two_arguments(self):
+        """Test a two-argument batch predicate receives keys (or indices) and values."""
+        result = self.md.filter(lambda keys, values: [k in ("a", "d", 0) for k in keys], batch=True)
+        self.assertEqual(result, MagiDict({"a": 1, "c": {"d": 2}, "f": [3, {}]}))
+
+    def test_batch_none_predicate(self):
+        """Test batch=True with no predicate drops None values."""
+        self.assertEqual(self.md.filter(None, batch=True), self.md.filter(None))
+
+    def test_batch_drop_empty(self):
+        """Test drop_empty applies to results of a batch predicate."""
+        result = self.md.filter(lambda values: [v == 1 for v in values], drop_empty=True, batch=True)
+        self.assertEqual(result, MagiDict({"a": 1}))
+
+    def test_batch_wrong_length(self):
+        """Test a batch predicate must return one result per value."""
+        with self.assertRaises(ValueError):
+            self.md.filter(lambda values: [True], batch=True)
+
+    def test_batch_on_view(self):
+        """Test MagiView.filter supports batch predicates."""
+        view = MagiView({"a": {"b": None, "c": 1}})
+        self.assertEqual(view.filter(None, batch=True), MagiDict({"a": {"c": 1}}))
+
+
 class TestFilterEdgeCases(TestCase):
     """Test edge cases and special scenarios."""
 
@@ -6691,6 +8842,19 @@ class TestFilterEdgeCases(TestCase):
         keys = list(result.keys())
         self.assertEqual(keys, ["z", "y", "x"])
 
+    def test_filter_keeps_leaf_objects(self):
+        """Test kept leaf values are stored as they are, not converted again."""
+        tags = {"x", "y"}
+        md = MagiDict({"tags": tags, "nested": {"tags": tags}})
+        result = md.filter(lambda v: True)
+        self.assertIs(result["tags"], tags)
+        self.assertIs(result.nested["tags"], tags)
+
+    def test_filter_predicate_with_defaults(self):
+        """Test the predicate arity counts parameters like inspect.signature."""
+        md = MagiDict({"a": 1, "b": 2})
+        self.assertEqual(md.filter(lambda k, v=None: k == "a"), MagiDict({"a": 1}))
+
     def test_filter_nested_empty_after_filtering(self):
         """Test nested dict becomes empty after filtering."""
         md = MagiDict({"outer": {"a": 10, "b": 20}, "keep": {"x": 1}})